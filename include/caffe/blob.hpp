@@ -211,10 +211,22 @@ class Blob {
     return data_;
   }
 
+  /**
+   * @brief Returns the SyncedMemory holding the diff, which is only created
+   *        here on first access so that blobs that never take a gradient,
+   *        as in inference, never hold diff memory.
+   */
   inline const shared_ptr<SyncedMemory>& diff() const {
-    CHECK(diff_);
+    CHECK(data_);
+    if (!diff_) {
+      diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    }
     return diff_;
   }
+  /// @brief Whether the diff memory has been allocated, on host or device.
+  inline bool diff_allocated() const {
+    return diff_ && diff_->head() != SyncedMemory::UNINITIALIZED;
+  }
 
   const Dtype* cpu_data() const;
   void set_cpu_data(Dtype* data);
@@ -268,7 +280,7 @@ class Blob {
 
  protected:
   shared_ptr<SyncedMemory> data_;
-  shared_ptr<SyncedMemory> diff_;
+  mutable shared_ptr<SyncedMemory> diff_;
   shared_ptr<SyncedMemory> shape_data_;
   vector<int> shape_;
   int count_;
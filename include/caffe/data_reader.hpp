@@ -40,7 +40,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include "caffe/common.hpp"
@@ -52,69 +51,51 @@ namespace caffe {
 
 /**
  * @brief Reads data from a source to queues available to data layers.
- * A single reading thread is created per source, even if multiple solvers
- * are running in parallel, e.g. for multi-GPU training. This makes sure
- * databases are read sequentially, and that each solver accesses a different
- * subset of the database. Data is distributed to solvers in a round-robin
- * way to keep parallel training deterministic.
+ * A single reading thread is created per source, shared by all the readers of
+ * the process with the same layer name, e.g. the nets of solvers running in
+ * parallel for multi-GPU training. This makes sure databases are read
+ * sequentially and only once, and that each reader gets a different subset
+ * of the database. Records are dealt to the readers strictly round-robin, so
+ * that parallel training is deterministic: the thread starts once the
+ * readers of all the solvers exist, and waits for a reader whose queue is
+ * full.
+ *
+ * Each reader reads ahead up to prefetch * batch_size records, into buffers
+ * of its own, which bounds the memory of the source.
+ *
+ * When each solver runs in its own process, the reader of solver rank r only
+ * reads the records whose index modulo the solver count is r.
  */
 class DataReader {
  public:
   explicit DataReader(const LayerParameter& param);
   ~DataReader();
 
-  inline BlockingQueue<std::string*>& free() const {
-    return queue_pair_->free_;
+  /// @brief Where the records go back once they are consumed.
+  inline BlockingQueue<string*>& free() const {
+    return queue_->free_;
   }
-  inline BlockingQueue<std::string*>& full() const {
-    return queue_pair_->full_;
+  /// @brief The records read ahead for this reader.
+  inline BlockingQueue<string*>& full() const {
+    return queue_->full_;
   }
+  /// @brief The number of records read ahead and not consumed yet.
+  inline int queue_depth() const { return queue_->full_.size(); }
+  /// @brief The maximum number of records read ahead.
+  inline int queue_capacity() const { return queue_->capacity_; }
 
  protected:
-  // Queue pairs are shared between a body and its readers
-  class QueuePair {
+  // The buffers of a reader, free or holding a record read ahead.
+  class Queue {
    public:
-    explicit QueuePair(int size);
-    ~QueuePair();
+    explicit Queue(int capacity);
+    ~Queue();
 
-    BlockingQueue<std::string*> free_;
-    BlockingQueue<std::string*> full_;
+    BlockingQueue<string*> free_;
+    BlockingQueue<string*> full_;
+    const int capacity_;
 
-  DISABLE_COPY_AND_ASSIGN(QueuePair);
-  };
-
-  class DBWrapper  {
-   public:
-    explicit DBWrapper(const LayerParameter& param);
-    virtual ~DBWrapper();
-    virtual string value() = 0;
-    virtual void Next() = 0;
-   protected:
-    shared_ptr<db::DB> db;
-    shared_ptr<db::Cursor> cursor;
-  };
-
-  class DBShuffle: public DBWrapper {
-   public:
-    explicit DBShuffle(const LayerParameter& param);
-    virtual string value() {
-      return string(static_cast<const char*>(current_image_->first),
-                                                      current_image_->second);
-    }
-    virtual void Next();
-   protected:
-    vector<std::pair<void*, int> > image_pointers_;
-    vector<std::pair<void*, int> >::iterator current_image_;
-    shared_ptr<Caffe::RNG> prefetch_rng_;
-
-    void ShuffleImages();
-  };
-
-  class DBSequential: public DBWrapper {
-   public:
-    explicit DBSequential(const LayerParameter& param): DBWrapper(param)  {}
-    virtual string value()  { return cursor->value(); }
-    virtual void Next();
+  DISABLE_COPY_AND_ASSIGN(Queue);
   };
 
   // A single body is created per source
@@ -125,28 +106,30 @@ class DataReader {
 
    protected:
     void InternalThreadEntry();
-    void read_one(DBWrapper* img, QueuePair* qp);
-    void ShuffleImages();
+    // Registers the new queues and drops the removed ones.
+    void UpdateQueues(vector<shared_ptr<Queue> >* queues);
+    // Moves the cursor to the next record, wrapping around at the end.
+    static void Next(db::Cursor* cursor, uint64_t* offset);
 
     const LayerParameter param_;
-    BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
-    bool first_read_;
+    BlockingQueue<shared_ptr<Queue> > new_queues_;
+    BlockingQueue<shared_ptr<Queue> > removed_queues_;
 
     friend class DataReader;
 
   DISABLE_COPY_AND_ASSIGN(Body);
   };
 
-  // A source is uniquely identified by its layer name + path, in case
-  // the same database is read from two different locations in the net.
+  // A source is uniquely identified by its layer name and path, so that
+  // the replicas of a layer share it.
   static inline string source_key(const LayerParameter& param) {
     return param.name() + ":" + param.data_param().source();
   }
 
-  const shared_ptr<QueuePair> queue_pair_;
+  const shared_ptr<Queue> queue_;
   shared_ptr<Body> body_;
 
-  map<const string, boost::weak_ptr<DataReader::Body> > bodies_;
+  static map<const string, boost::weak_ptr<DataReader::Body> > bodies_;
 
 DISABLE_COPY_AND_ASSIGN(DataReader);
 };
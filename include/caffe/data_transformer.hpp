@@ -75,6 +75,42 @@ class DataTransformer {
    *    set_cpu_data() is used. See image_data_layer.cpp for an example.
    */
   void Transform(const cv::Mat& cv_img, Blob<Dtype>* transformed_blob);
+
+  /**
+   * @brief As Transform(cv_img, transformed_blob), also returning the crop
+   *    window in normalized coordinates of cv_img and whether the image was
+   *    mirrored, so that annotations can be transformed alike.
+   */
+  void Transform(const cv::Mat& cv_img, Blob<Dtype>* transformed_blob,
+                 NormalizedBBox* crop_bbox, bool* do_mirror);
+
+  /**
+   * @brief Transforms the annotations of an img_width x img_height image the
+   *    way its pixels were: by the resize policy if do_resize, then cropped
+   *    to crop_bbox and mirrored. Annotations failing the emit constraint
+   *    or outside of crop_bbox are dropped, and so are empty groups.
+   */
+  void TransformAnnotation(
+      const google::protobuf::RepeatedPtrField<AnnotationGroup>& anno_groups,
+      const int img_width, const int img_height, const bool do_resize,
+      const NormalizedBBox& crop_bbox, const bool do_mirror,
+      google::protobuf::RepeatedPtrField<AnnotationGroup>* transformed_groups);
+
+  /**
+   * @brief Crops cv_img to bbox, given in normalized coordinates and clipped
+   *    to the image. crop_img shares the pixels of cv_img.
+   */
+  void CropImage(const cv::Mat& cv_img, const NormalizedBBox& bbox,
+                 cv::Mat* crop_img);
+
+  /**
+   * @brief With probability expand_param.prob(), places cv_img at a random
+   *    position of a canvas up to max_expand_ratio times larger and filled
+   *    with the mean values. expand_bbox receives the canvas in normalized
+   *    coordinates of cv_img, to be used as crop_bbox of TransformAnnotation.
+   */
+  void ExpandImage(const cv::Mat& cv_img, cv::Mat* expand_img,
+                   NormalizedBBox* expand_bbox);
 #endif  // USE_OPENCV
 
   /**
@@ -0,0 +1,152 @@
+#ifndef CAFFE_INFERENCE_SERVER_HPP_
+#define CAFFE_INFERENCE_SERVER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A forward pass requested from an InferenceServer.
+ *
+ * The inputs are read by the worker serving the request, so they should not
+ * change until Wait returns. The outputs are then copies of the output blobs
+ * of the net, in order.
+ */
+template <typename Dtype>
+class InferenceRequest {
+ public:
+  explicit InferenceRequest(const vector<shared_ptr<Blob<Dtype> > >& inputs);
+
+  /// @brief Blocks until the request is served.
+  void Wait();
+  bool done() const;
+
+  inline const vector<shared_ptr<Blob<Dtype> > >& inputs() const {
+    return inputs_;
+  }
+  inline const vector<shared_ptr<Blob<Dtype> > >& outputs() const {
+    return outputs_;
+  }
+  /// @brief The milliseconds spent in the queue, in the forward pass
+  ///        (with the copies of the inputs and outputs), and in total.
+  inline double queue_ms() const { return (started_ - submitted_) / 1000.; }
+  inline double run_ms() const { return (finished_ - started_) / 1000.; }
+  inline double latency_ms() const {
+    return (finished_ - submitted_) / 1000.;
+  }
+
+ protected:
+  template <typename T> friend class InferenceServer;
+  // See BlockingQueue::sync.
+  class sync;
+
+  /// @brief Marks the request done, once its outputs and times are set.
+  void Finish();
+
+  vector<shared_ptr<Blob<Dtype> > > inputs_;
+  vector<shared_ptr<Blob<Dtype> > > outputs_;
+  /// Microseconds since the epoch.
+  int64_t submitted_;
+  int64_t started_;
+  int64_t finished_;
+  bool done_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(InferenceRequest);
+};
+
+/// @brief The requests served so far by an InferenceServer.
+struct InferenceStats {
+  InferenceStats()
+      : requests(0), queue_depth(0), mean_latency_ms(0), max_latency_ms(0),
+        mean_queue_ms(0) {}
+  uint64_t requests;
+  /// The requests waiting for a worker.
+  size_t queue_depth;
+  double mean_latency_ms;
+  double max_latency_ms;
+  double mean_queue_ms;
+};
+
+/**
+ * @brief Serves concurrent forward passes of a TEST net from one copy of its
+ *        trained weights.
+ *
+ * The server builds replicas of the net, each with its own activations, and
+ * loads the weights into the first one; the others share its parameter blobs
+ * (see Net::ShareTrainedLayersWith), so the weights are held once whatever
+ * the number of replicas. Each replica is driven by a worker thread taking
+ * requests from a common queue, optionally pinned to its own core. Workers
+ * inherit the Caffe mode and device of the thread creating the server, like
+ * InternalThread.
+ *
+ * The parameters are synced to the device of the workers before they start,
+ * and are then only read. Layers must therefore not write their parameter
+ * blobs in Forward, nor read them in another mode than that of the server.
+ *
+ * Submit may be called from any thread. Destroying the server serves the
+ * requests already queued, then stops the workers.
+ */
+template <typename Dtype>
+class InferenceServer {
+ public:
+  /**
+   * @param param the net, run in the TEST phase.
+   * @param weights the trained weights, as for Net::CopyTrainedLayersFrom.
+   * @param replicas the number of nets and worker threads.
+   * @param first_core if not negative, worker i is pinned to core
+   *        first_core + i (modulo the number of cores; Linux only).
+   * @param threads_per_replica if positive, the OpenMP and BLAS threads of
+   *        each worker, e.g. 1 so that the replicas do not oversubscribe
+   *        the cores. MKL and OpenMP take it per worker; OpenBLAS has a
+   *        single setting for the process.
+   */
+  InferenceServer(const NetParameter& param, const string& weights,
+      int replicas, int first_core = -1, int threads_per_replica = 0);
+  ~InferenceServer();
+
+  /// @brief Queues a forward pass of inputs, one per input blob of the net.
+  shared_ptr<InferenceRequest<Dtype> > Submit(
+      const vector<shared_ptr<Blob<Dtype> > >& inputs);
+  /// @brief Submits a forward pass and waits for it.
+  shared_ptr<InferenceRequest<Dtype> > Run(
+      const vector<shared_ptr<Blob<Dtype> > >& inputs);
+
+  InferenceStats stats() const;
+
+  inline const vector<shared_ptr<Net<Dtype> > >& nets() const {
+    return nets_;
+  }
+
+ protected:
+  // See BlockingQueue::sync.
+  class sync;
+
+  void Entry(int worker, int device, Caffe::Brew mode, int core,
+      int threads);
+  void Serve(Net<Dtype>* net, InferenceRequest<Dtype>* request);
+
+  vector<shared_ptr<Net<Dtype> > > nets_;
+  vector<shared_ptr<boost::thread> > threads_;
+  /// A NULL request stops the worker taking it.
+  BlockingQueue<shared_ptr<InferenceRequest<Dtype> > > queue_;
+  shared_ptr<sync> sync_;
+  InferenceStats stats_;
+  double total_latency_ms_;
+  double total_queue_ms_;
+
+DISABLE_COPY_AND_ASSIGN(InferenceServer);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SERVER_HPP_
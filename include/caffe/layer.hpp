@@ -158,6 +158,17 @@ class Layer {
     return blobs_;
   }
 
+  /**
+   * @brief Called after the parameter blobs were given new values or memory
+   *        from outside the layer, e.g. by Net::CopyTrainedLayersFrom or
+   *        Net::ShareTrainedLayersWith.
+   *
+   * Layers keeping data derived from their parameters, such as transformed
+   * or quantized weights, override this to recompute it on the next forward
+   * pass.
+   */
+  virtual void ParamsChanged() {}
+
   /**
    * @brief Returns the layer parameter.
    */
@@ -257,6 +268,27 @@ class Layer {
    */
   virtual inline bool AutoTopBlobs() const { return false; }
 
+  /**
+   * @brief Return whether the top blobs depend only on the layer parameters
+   *        and the shapes of the bottom blobs, not on their data.
+   *
+   * If this method returns true, Net may compute the layer once and skip it
+   * in later forward passes while the bottom shapes stay the same (see
+   * NetParameter.fold_constant_layers).
+   */
+  virtual inline bool OutputDependsOnlyOnShapes() const { return false; }
+
+  /**
+   * @brief Return the blobs holding the state a recurrent layer carries over
+   *        from one forward pass to the next.
+   *
+   * Axis 1 of each blob indexes the independent streams of the batch, so
+   * that Net::ForwardStreams can save and restore the state of each stream.
+   */
+  virtual vector<Blob<Dtype>*> RecurrentState() {
+    return vector<Blob<Dtype>*>();
+  }
+
   /**
    * @brief Return whether to allow force_backward for a given bottom blob
    *        index.
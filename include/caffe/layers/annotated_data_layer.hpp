@@ -0,0 +1,73 @@
+#ifndef CAFFE_ANNOTATED_DATA_LAYER_HPP_
+#define CAFFE_ANNOTATED_DATA_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/data_reader.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides AnnotatedDatum records of a DB to the Net, with the
+ *        augmentations used to train SSD style detectors.
+ *
+ * Each image is decoded, distorted and expanded (transform_param
+ * distort_param and expand_param), cropped to one of the boxes generated by
+ * the batch_samplers, resized (resize_param) and finally cropped, mirrored
+ * and normalized like in DataLayer. The items of a batch are processed in
+ * parallel by annotated_data_param.threads threads, each item with its own
+ * random seed so that the batches do not depend on the number of threads.
+ *
+ * With an annotation type, the second top is the [1, 1, N, 8] ground truth of
+ * the batch with one row [item_id, group_label, instance_id, xmin, ymin, xmax,
+ * ymax, difficult] per box, as read by GetGroundTruth. A batch without boxes
+ * gives a single row of -1. Without annotation type, it holds the labels.
+ *
+ * Without crop_size nor resize_param, all images must have the size of the
+ * first one.
+ */
+template <typename Dtype>
+class AnnotatedDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit AnnotatedDataLayer(const LayerParameter& param);
+  virtual ~AnnotatedDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual inline const char* type() const { return "AnnotatedData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Decodes and augments items_[item_id] into its slot of top_data, and
+  // transforms its annotations in place.
+  void LoadItem(Dtype* top_data, int item_id, int worker);
+
+  DataReader reader_;
+  bool has_anno_type_;
+  AnnotatedDatum_AnnotationType anno_type_;
+  vector<BatchSampler> batch_samplers_;
+
+  // Seeds the items of the batches.
+  shared_ptr<Caffe::RNG> seed_rng_;
+  shared_ptr<ThreadPool> pool_;
+  // Per worker state.
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  vector<shared_ptr<Blob<Dtype> > > item_data_;
+  // Per item state of the batch being loaded.
+  vector<AnnotatedDatum> items_;
+  vector<unsigned int> seeds_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_ANNOTATED_DATA_LAYER_HPP_
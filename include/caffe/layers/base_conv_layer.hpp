@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fused_activation.hpp"
 #include "caffe/util/im2col.hpp"
 
 namespace caffe {
@@ -35,6 +36,11 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // Convolves images inputs at once with a single gemm per group over their
+  // columns laid side by side, adding the bias (if not NULL) while the
+  // products are scattered back to the outputs. At most im2col_batch_ images.
+  void forward_cpu_gemm_batch(const Dtype* input, int images,
+      const Dtype* weights, const Dtype* bias, Dtype* output);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
@@ -92,6 +98,10 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The images convolved by one forward_cpu_gemm_batch call, from
+  ///        col_buffer_budget; 1 when the forward pass goes image by image.
+  int im2col_batch_;
+  FusedActivation fused_activation_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -167,6 +177,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  /// The columns and products of im2col_batch_ images, side by side.
+  Blob<Dtype> batch_col_buffer_;
+  Blob<Dtype> batch_output_buffer_;
 };
 
 }  // namespace caffe
@@ -42,6 +42,10 @@ class BNLayer : public Layer<Dtype> {
   void BroadcastChannel(const Dtype* input, Dtype* output);
 
   bool frozen_;
+  // INFERENCE mode computes top = bottom * slope + bias per channel, with
+  // BatchNormParameter.relu optionally applied in the same pass.
+  bool inference_;
+  bool fuse_relu_;
   Dtype bn_momentum_;
   Dtype bn_eps_;
 
@@ -5,6 +5,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fused_activation.hpp"
 
 namespace caffe {
 
@@ -42,6 +43,7 @@ class ConvolutionDepthwiseLayer : public Layer<Dtype> {
   Blob<Dtype> weight_multiplier_;
   Blob<Dtype> bias_buffer_;
   Blob<Dtype> bias_multiplier_;
+  FusedActivation fused_activation_;
 };
 
 }  // namespace caffe
@@ -100,6 +100,16 @@ class DetectionOutputLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  /**
+   * @brief Fills kept_bboxes_[i] with the detections of image i and returns
+   *        their number.
+   *
+   * The scores of each class are filtered by confidence_threshold_ first, and
+   * only the top_k remaining predictions are decoded, straight from the blobs
+   * into the separate coordinate arrays used by ApplyNMSFlat.
+   */
+  int DetectImage(int i, const Dtype* loc_data, const Dtype* conf_data,
+      const Dtype* prior_data);
   /// @brief Not implemented
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
@@ -148,6 +158,17 @@ class DetectionOutputLayer : public Layer<Dtype> {
   Blob<Dtype> bbox_preds_;
   Blob<Dtype> bbox_permute_;
   Blob<Dtype> conf_permute_;
+
+  // Per image buffers of Forward_cpu, which keep their capacity across
+  // batches: the (score, prior) candidates of the current class, their
+  // decoded xmin, ymin, xmax, ymax and size arrays, the positions kept by the
+  // nms, the detections as rows of [label, score, xmin, ymin, xmax, ymax] and
+  // their (score, row) for keep_top_k.
+  vector<pair<float, int> > score_index_;
+  vector<float> decode_bboxes_;
+  vector<vector<int> > nms_indices_;
+  vector<vector<float> > kept_bboxes_;
+  vector<vector<pair<float, int> > > kept_score_index_;
 };
 
 }  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fused_activation.hpp"
 
 namespace caffe {
 
@@ -44,6 +45,7 @@ class EltwiseLayer : public Layer<Dtype> {
   Blob<int> max_idx_;
 
   bool stable_prod_grad_;
+  FusedActivation fused_activation_;
 };
 
 }  // namespace caffe
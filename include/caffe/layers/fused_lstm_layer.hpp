@@ -0,0 +1,114 @@
+#ifndef CAFFE_FUSED_LSTM_LAYER_HPP_
+#define CAFFE_FUSED_LSTM_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The FUSED engine of the LSTM layer: computes the same function as
+ *        LSTMLayer, with the same parameters, without unrolling it into a net.
+ *
+ * The input transform W_xc * x_t + b_c of all the timesteps is a single GEMM.
+ * Each timestep then takes one GEMM for W_hc * h_conted_{t-1} and a single
+ * pass that applies the gate nonlinearities and updates c_t and h_t, all in
+ * buffers allocated by Reshape. The backward pass goes through the timesteps
+ * in reverse and computes the parameter gradients of the whole sequence with
+ * one GEMM each.
+ *
+ * Unlike LSTMLayer, the number of timesteps may change between batches, and
+ * with expose_hidden the gradient flows back to the initial hidden state.
+ */
+template <typename Dtype>
+class FusedLSTMLayer : public Layer<Dtype> {
+ public:
+  explicit FusedLSTMLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  /// @brief Zeroes the hidden state carried over to the next batch.
+  virtual void Reset();
+  /// @brief h_T and c_T, unless the hidden state is exposed.
+  virtual vector<Blob<Dtype>*> RecurrentState();
+
+  virtual inline const char* type() const { return "LSTM"; }
+  virtual inline int MinBottomBlobs() const {
+    return this->layer_param_.recurrent_param().expose_hidden() ? 4 : 2;
+  }
+  virtual inline int MaxBottomBlobs() const { return MinBottomBlobs() + 1; }
+  virtual inline int ExactNumTopBlobs() const {
+    return this->layer_param_.recurrent_param().expose_hidden() ? 3 : 1;
+  }
+
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    // Can't propagate to sequence continuation indicators.
+    return bottom_index != 1;
+  }
+
+ protected:
+  /**
+   * @param bottom input Blob vector (length 2-5), as for LSTMLayer
+   *   -# @f$ (T \times N \times ...) @f$
+   *      the time-varying input @f$ x @f$
+   *   -# @f$ (T \times N) @f$
+   *      the sequence continuation indicators @f$ \delta @f$
+   *   -# @f$ (N \times ...) @f$ (optional)
+   *      the static input @f$ x_{static} @f$
+   *   -# @f$ (1 \times N \times D) @f$ (with expose_hidden)
+   *      the initial hidden state @f$ h_0 @f$
+   *   -# @f$ (1 \times N \times D) @f$ (with expose_hidden)
+   *      the initial cell state @f$ c_0 @f$
+   * @param top output Blob vector (length 1 or 3)
+   *   -# @f$ (T \times N \times D) @f$
+   *      the hidden states @f$ h_t @f$
+   *   -# @f$ (1 \times N \times D) @f$ (with expose_hidden)
+   *      the final hidden state @f$ h_T @f$
+   *   -# @f$ (1 \times N \times D) @f$ (with expose_hidden)
+   *      the final cell state @f$ c_T @f$
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The number of timesteps in the layer's input.
+  int T_;
+  /// @brief The number of independent streams to process simultaneously.
+  int N_;
+  /// @brief The dimension of the hidden and cell states.
+  int hidden_dim_;
+  /// @brief The dimension of a timestep of the input.
+  int input_dim_;
+  /// @brief The dimension of the static input, if any.
+  int static_dim_;
+  bool static_input_;
+  bool expose_hidden_;
+
+  /// The gate inputs, then the gate activations, of all the timesteps.
+  Blob<Dtype> gates_;
+  /// The cell states c_1 to c_T.
+  Blob<Dtype> cell_;
+  /// The hidden states fed to the timesteps, cont_t * h_{t-1}.
+  Blob<Dtype> h_conted_;
+  /// W_hc * h_conted_{t-1} for the current timestep.
+  Blob<Dtype> hidden_gates_;
+  /// W_xc_static * x_static, added to the gate inputs of every timestep.
+  Blob<Dtype> static_gates_;
+  /// The initial states of the batch being processed.
+  Blob<Dtype> h_0_;
+  Blob<Dtype> c_0_;
+  /// The final states, carried over to the next batch without expose_hidden.
+  Blob<Dtype> h_T_;
+  Blob<Dtype> c_T_;
+  Blob<Dtype> bias_multiplier_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FUSED_LSTM_LAYER_HPP_
@@ -11,12 +11,23 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
 
 namespace caffe {
 
 /**
  * @brief Provides data to the Net from image files.
  *
+ * The images of a batch are decoded and transformed in parallel by
+ * image_data_param.threads threads, each image with its own random seed so
+ * that the batches do not depend on the number of threads. With new_height
+ * and new_width, the shape of the batches is inferred once; otherwise it is
+ * the shape of the first image of each batch.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 
@@ -38,9 +49,27 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Decodes, unless it is the first image already decoded by load_batch, and
+  // transforms image item_id into its slot of top_data.
+  void LoadItem(Dtype* top_data, int item_id, int worker);
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+  // Whether the images are resized, so that all batches have the same shape.
+  bool fixed_shape_;
+
+  // Seeds the images of the batches.
+  shared_ptr<Caffe::RNG> seed_rng_;
+  shared_ptr<ThreadPool> pool_;
+  // Per worker state.
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  vector<shared_ptr<Blob<Dtype> > > item_data_;
+  vector<double> decode_time_;
+  vector<double> trans_time_;
+  // Per item state of the batch being loaded.
+  vector<std::pair<std::string, int> > items_;
+  vector<unsigned int> seeds_;
+  cv::Mat first_image_;
 };
 #else
 template <typename Dtype>
@@ -0,0 +1,46 @@
+#ifndef CAFFE_INT8_CONCAT_LAYER_HPP_
+#define CAFFE_INT8_CONCAT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/concat_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 engine of ConcatLayer, see caffe/util/quantize.hpp.
+ *
+ * Concatenates the inputs quantized to bw_layer_in bits, each at its own
+ * scale, then requantizes the output to the single scale of bw_layer_out bits
+ * like Int8ConvolutionLayer.
+ */
+template <typename Dtype>
+class Int8ConcatLayer : public ConcatLayer<Dtype> {
+ public:
+  explicit Int8ConcatLayer(const LayerParameter& param)
+      : ConcatLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+
+  /// The inputs rounded to their quantization grid.
+  vector<shared_ptr<Blob<Dtype> > > quantized_;
+  vector<Blob<Dtype>*> quantized_vec_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_CONCAT_LAYER_HPP_
@@ -0,0 +1,47 @@
+#ifndef CAFFE_INT8_CONV_DW_LAYER_HPP_
+#define CAFFE_INT8_CONV_DW_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_dw_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 engine of ConvolutionDepthwiseLayer, see Int8ConvolutionLayer.
+ *
+ * Each channel is quantized once and convolved with its quantized filter in
+ * int32, taps falling in the padding being skipped.
+ */
+template <typename Dtype>
+class Int8ConvolutionDepthwiseLayer : public ConvolutionDepthwiseLayer<Dtype> {
+ public:
+  explicit Int8ConvolutionDepthwiseLayer(const LayerParameter& param)
+      : ConvolutionDepthwiseLayer<Dtype>(param), weights_quantized_(false) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ParamsChanged() { weights_quantized_ = false; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+
+  bool weights_quantized_;
+  vector<int8_t> weights_;
+  /// The quantized channel being convolved, offset as in Int8ConvolutionLayer.
+  vector<uint8_t> plane_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_CONV_DW_LAYER_HPP_
@@ -0,0 +1,69 @@
+#ifndef CAFFE_INT8_CONV_LAYER_HPP_
+#define CAFFE_INT8_CONV_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 engine of ConvolutionLayer, selected by engine: "INT8" on a
+ *        layer with a quantization_param (see caffe/util/quantize.hpp).
+ *
+ * The input columns are quantized to bw_layer_in bits and the weights to
+ * bw_params bits, at most 8, and multiplied in int32 by caffe_cpu_gemm_u8s8.
+ * The products are scaled back to real values and the bias is added in
+ * floating point; with bw_layer_out bits the output is then rounded to the
+ * grid of the output scale, as the next INT8 layer would see it.
+ *
+ * The weights are quantized on every forward pass in the TRAIN phase, where
+ * the solver updates them. In the TEST phase they are quantized on the first
+ * forward pass, and again after the Net copies or shares new ones (see
+ * Layer::ParamsChanged). The same holds for the other INT8 layers. The
+ * backward pass is that of ConvolutionLayer, i.e. the straight-through
+ * estimator of the quantization.
+ */
+template <typename Dtype>
+class Int8ConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit Int8ConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), weights_quantized_(false) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ParamsChanged() { weights_quantized_ = false; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+
+  void QuantizeWeights();
+  void im2col(const Dtype* data, Dtype* col_buff);
+
+  bool weights_quantized_;
+  /// The quantized weights, packed by group for the GEMM, and the sum of
+  /// each of their rows.
+  vector<int8_t> weights_;
+  vector<int32_t> weight_sums_;
+  Blob<Dtype> col_data_;
+  /// The quantized columns of a group, transposed for the GEMM, and their
+  /// products with the weights, one row per output position.
+  vector<uint8_t> col_quantized_;
+  vector<int32_t> products_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_CONV_LAYER_HPP_
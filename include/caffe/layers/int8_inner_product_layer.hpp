@@ -0,0 +1,49 @@
+#ifndef CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+#define CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/inner_product_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 engine of InnerProductLayer, see Int8ConvolutionLayer.
+ */
+template <typename Dtype>
+class Int8InnerProductLayer : public InnerProductLayer<Dtype> {
+ public:
+  explicit Int8InnerProductLayer(const LayerParameter& param)
+      : InnerProductLayer<Dtype>(param), weights_quantized_(false) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ParamsChanged() { weights_quantized_ = false; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+
+  void QuantizeWeights();
+
+  bool weights_quantized_;
+  /// The quantized N_ x K_ weights, packed for the GEMM, and the sum of
+  /// each of their rows.
+  vector<int8_t> weights_;
+  vector<int32_t> weight_sums_;
+  vector<uint8_t> bottom_quantized_;
+  vector<int32_t> products_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
@@ -19,7 +19,8 @@ template <typename Dtype> class RecurrentLayer;
 /**
  * @brief Processes sequential inputs using a "Long Short-Term Memory" (LSTM)
  *        [1] style recurrent neural network (RNN). Implemented by unrolling
- *        the LSTM computation through time.
+ *        the LSTM computation through time; see FusedLSTMLayer for the
+ *        FUSED engine, which runs the recurrence directly.
  *
  * The specific architecture used in this implementation is as described in
  * "Learning to Execute" [2], reproduced below:
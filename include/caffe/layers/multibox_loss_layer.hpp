@@ -0,0 +1,165 @@
+#ifndef CAFFE_MULTIBOX_LOSS_LAYER_HPP_
+#define CAFFE_MULTIBOX_LOSS_LAYER_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/bbox_util.hpp"
+
+#include "caffe/layers/loss_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Perform MultiBox operations. Including the following:
+ *
+ *  - decode the predictions.
+ *  - perform matching between priors/predictions and ground truth.
+ *  - use matched boxes and confidences to compute loss.
+ *
+ * The matching and the hard negative mining of the images of a batch run in
+ * parallel. Their state lives in flat per-batch buffers indexed by image,
+ * location class and prior, which keep their capacity across iterations.
+ *
+ * @param bottom input Blob vector (length 4)
+ *   -# @f$ (N \times P * 4 * L) @f$ the location predictions of the P priors,
+ *      with L = 1 if share_location and L = num_classes otherwise
+ *   -# @f$ (N \times P * C) @f$ the confidence predictions
+ *   -# @f$ (1 \times 2 \times P * 4) @f$ the priors and their variances
+ *   -# @f$ (1 \times 1 \times G \times 8) @f$ the ground truth of the batch,
+ *      as produced by AnnotatedDataLayer
+ * @param top output Blob vector (length 1)
+ *   -# @f$ (1 \times 1 \times 1 \times 1) @f$ the computed loss
+ */
+template <typename Dtype>
+class MultiBoxLossLayer : public LossLayer<Dtype> {
+ public:
+  explicit MultiBoxLossLayer(const LayerParameter& param)
+      : LossLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "MultiBoxLoss"; }
+  // bottom[0] stores the location predictions.
+  // bottom[1] stores the confidence predictions.
+  // bottom[2] stores the prior bounding boxes.
+  // bottom[3] stores the ground truth bounding boxes.
+  virtual inline int ExactNumBottomBlobs() const { return 4; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Normalizer of the loss for the given number of matches.
+  Dtype get_normalizer(LossParameter_NormalizationMode normalization_mode,
+      int valid_count);
+
+  // Per image steps, each only touching the state of image i.
+  void MatchImage(int i, const Dtype* loc_data);
+  void MatchLabel(int i, int label, const Dtype* loc_data, int* match_index,
+      float* match_overlap);
+  void MineImage(int i, const Dtype* loc_data, const Dtype* conf_data);
+  void EncodeImage(int i, const Dtype* loc_data, const Dtype* conf_data,
+      Dtype* loc_pred_data, Dtype* loc_gt_data, Dtype* conf_pred_data,
+      Dtype* conf_gt_data);
+  // Encodes the location prediction and ground truth of prior j, matched in
+  // the location class c of image i.
+  void EncodeMatch(int i, int c, int j, const Dtype* loc_data,
+      Dtype* loc_pred, Dtype* loc_gt);
+  void GetLocPrediction(int i, int c, int j, const Dtype* loc_data,
+      NormalizedBBox* bbox) const;
+  Dtype ConfLoss(const Dtype* conf, int label) const;
+
+  /// Whether the location class c has matches, i.e. is not the background.
+  inline bool is_loc_class(int c) const {
+    return share_location_ || c != background_label_id_;
+  }
+  inline int* match_indices(int i, int c) {
+    return &match_indices_[(i * loc_classes_ + c) * num_priors_];
+  }
+  inline float* match_overlaps(int i, int c) {
+    return &match_overlaps_[(i * loc_classes_ + c) * num_priors_];
+  }
+
+  /// The internal localization loss layer.
+  shared_ptr<Layer<Dtype> > loc_loss_layer_;
+  MultiBoxLossParameter_LocLossType loc_loss_type_;
+  float loc_weight_;
+  /// bottom vector holder used in Forward function.
+  vector<Blob<Dtype>*> loc_bottom_vec_;
+  /// top vector holder used in Forward function.
+  vector<Blob<Dtype>*> loc_top_vec_;
+  /// blob which stores the matched location prediction.
+  Blob<Dtype> loc_pred_;
+  /// blob which stores the corresponding matched ground truth.
+  Blob<Dtype> loc_gt_;
+  /// localization loss.
+  Blob<Dtype> loc_loss_;
+
+  /// The internal confidence loss layer.
+  shared_ptr<Layer<Dtype> > conf_loss_layer_;
+  MultiBoxLossParameter_ConfLossType conf_loss_type_;
+  /// bottom vector holder used in Forward function.
+  vector<Blob<Dtype>*> conf_bottom_vec_;
+  /// top vector holder used in Forward function.
+  vector<Blob<Dtype>*> conf_top_vec_;
+  /// blob which stores the confidence prediction.
+  Blob<Dtype> conf_pred_;
+  /// blob which stores the corresponding ground truth label.
+  Blob<Dtype> conf_gt_;
+  /// confidence loss.
+  Blob<Dtype> conf_loss_;
+
+  MultiBoxLossParameter multibox_loss_param_;
+  int num_classes_;
+  bool share_location_;
+  int loc_classes_;
+  int background_label_id_;
+  bool use_difficult_gt_;
+  bool do_neg_mining_;
+  MultiBoxLossParameter_MiningType mining_type_;
+  /// How to normalize the output loss.
+  LossParameter_NormalizationMode normalization_;
+
+  int num_;
+  int num_priors_;
+  int num_gt_;
+  int num_matches_;
+  int num_conf_;
+
+  vector<NormalizedBBox> prior_bboxes_;
+  vector<vector<float> > prior_variances_;
+  /// Ground truth of the batch, grouped by image in the order of bottom[3].
+  vector<NormalizedBBox> gt_bboxes_;
+  /// The ground truth of image i is [gt_offset_[i], gt_offset_[i + 1]).
+  vector<int> gt_offset_;
+  /// num_ x loc_classes_ x num_priors_ index of the matched ground truth in
+  /// the image, -1 for none and -2 for ignored priors.
+  vector<int> match_indices_;
+  vector<float> match_overlaps_;
+  /// num_priors_ x ground truth overlaps, at num_priors_ * gt_offset_[i].
+  vector<float> overlaps_;
+  /// Per image scratch of the matching and the mining.
+  vector<int> gt_pool_;
+  vector<float> mining_loss_;
+  vector<pair<float, int> > mining_pairs_;
+  vector<char> mining_selected_;
+  /// Selected negatives of each image.
+  vector<vector<int> > neg_indices_;
+  /// Offsets of the matches of image i in loc_pred_, and of its matches
+  /// and negatives in conf_pred_.
+  vector<int> loc_offset_;
+  vector<int> conf_offset_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_MULTIBOX_LOSS_LAYER_HPP_
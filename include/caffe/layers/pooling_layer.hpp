@@ -54,6 +54,8 @@ class PoolingLayer : public Layer<Dtype> {
   PoolingParameter_RoundMode round_mode_;
   bool ceil_mode_;
   Blob<Dtype> rand_idx_;
+  /// The argmax of MAX pooling without mask top, not written in the TEST
+  /// phase.
   Blob<int> max_idx_;
   bool yolo_;
 };
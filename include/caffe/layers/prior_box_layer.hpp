@@ -77,6 +77,7 @@ class PriorBoxLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "PriorBox"; }
   virtual inline int ExactBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool OutputDependsOnlyOnShapes() const { return true; }
 
  protected:
   /**
@@ -32,6 +32,8 @@ class RecurrentLayer : public Layer<Dtype> {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reset();
+  /// @brief The recurrent outputs, unless the hidden state is exposed.
+  virtual vector<Blob<Dtype>*> RecurrentState();
 
   virtual inline const char* type() const { return "Recurrent"; }
   virtual inline int MinBottomBlobs() const {
@@ -0,0 +1,73 @@
+#ifndef CAFFE_SMOOTH_L1_LOSS_LAYER_HPP_
+#define CAFFE_SMOOTH_L1_LOSS_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/loss_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Computes the SmoothL1 loss of Fast R-CNN, used for bounding box
+ *        regression: @f$
+ *          E = \frac{1}{N} \sum w_{out} f(w_{in} (\hat{y} - y))
+ *        @f$ with @f$ f(x) = 0.5 (\sigma x)^2 @f$ if
+ *        @f$ |x| < 1 / \sigma^2 @f$ and @f$ |x| - 0.5 / \sigma^2 @f$
+ *        otherwise.
+ *
+ * @param bottom input Blob vector (length 2 or 4)
+ *   -# @f$ (N \times C \times H \times W) @f$
+ *      the predictions @f$ \hat{y} @f$
+ *   -# @f$ (N \times C \times H \times W) @f$
+ *      the targets @f$ y @f$
+ *   -# @f$ (N \times C \times H \times W) @f$ (optional)
+ *      the inside weights @f$ w_{in} @f$
+ *   -# @f$ (N \times C \times H \times W) @f$ (optional)
+ *      the outside weights @f$ w_{out} @f$
+ * @param top output Blob vector (length 1)
+ *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
+ *      the computed loss @f$ E @f$
+ */
+template <typename Dtype>
+class SmoothL1LossLayer : public LossLayer<Dtype> {
+ public:
+  explicit SmoothL1LossLayer(const LayerParameter& param)
+      : LossLayer<Dtype>(param), diff_() {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "SmoothL1Loss"; }
+
+  virtual inline int ExactNumBottomBlobs() const { return -1; }
+  virtual inline int MinBottomBlobs() const { return 2; }
+  virtual inline int MaxBottomBlobs() const { return 4; }
+
+  /**
+   * Like EuclideanLossLayer, SmoothL1LossLayer can backpropagate to both the
+   * predictions and the targets, but not to the weights.
+   */
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    return bottom_index < 2;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// w_in * (prediction - target)
+  Blob<Dtype> diff_;
+  Dtype sigma2_;
+  bool has_weights_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_SMOOTH_L1_LOSS_LAYER_HPP_
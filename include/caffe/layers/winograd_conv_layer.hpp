@@ -0,0 +1,75 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief WINOGRAD engine of ConvolutionLayer: 2D 3x3 convolution of stride
+ *        and dilation 1 by the minimal filtering algorithm F(m x m, 3 x 3)
+ *        of Lavin & Gray, with m = winograd_tile (2 or 4).
+ *
+ * The output is cut into m x m tiles, each computed from an
+ * (m + 2) x (m + 2) tile of the input. Filters and input tiles are taken to
+ * the transform domain, where the convolution becomes (m + 2)^2 independent
+ * matrix products, one per transform element, of the filters by the input
+ * channels of a block of tiles; the products are then taken back to m x m
+ * outputs and the bias added. The tiles of all the images of the batch are
+ * taken in blocks whose transforms fit in the L2 cache, of at least 64 tiles
+ * so that the products stay wide with many channels. A batch of fewer than
+ * 32 tiles, e.g. a single 7 x 7 image, is convolved as ConvolutionLayer.
+ *
+ * The filters are transformed on every forward pass in the TRAIN phase,
+ * where they change. In the TEST phase they are transformed on the first
+ * forward pass, and again after the Net copies or shares new ones (see
+ * Layer::ParamsChanged), e.g. for each test of a Solver. Other shapes, and
+ * the backward pass, are those of ConvolutionLayer.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), weights_transformed_(false) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ParamsChanged() { weights_transformed_ = false; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  void TransformWeights();
+
+  /// Whether the layer's shape takes the Winograd path, and whether the
+  /// batch has enough tiles for it.
+  bool winograd_;
+  bool use_winograd_;
+  /// The output tile size m, and the input tile size m + 2.
+  int tile_;
+  int alpha_;
+  /// The tiles per image, per row of tiles, and per block.
+  int tiles_;
+  int tiles_w_;
+  int block_tiles_;
+  bool weights_transformed_;
+  /// Per group and transform element, the num_output / group x
+  /// channels / group transformed filters.
+  Blob<Dtype> transformed_weights_;
+  /// Per transform element, the channels / group x block_tiles_ transformed
+  /// input and num_output / group x block_tiles_ products of a block.
+  Blob<Dtype> transformed_input_;
+  Blob<Dtype> products_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
@@ -14,6 +14,8 @@
 
 namespace caffe {
 
+class MappedWeights;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -58,6 +60,25 @@ class Net {
   const vector<Blob<Dtype>*>& Forward(const vector<Blob<Dtype>* > & bottom,
       Dtype* loss = NULL);
 
+  /**
+   * @brief Run Forward on a batch of independent streams, e.g. sequences
+   *        scored online one timestep or chunk at a time.
+   *
+   * Slot n of the batch, i.e. index n of axis 1 of the recurrent layer
+   * inputs, continues the stream stream_ids[n]: the recurrent layers start
+   * from the state the stream reached at its previous call, or from zeros
+   * for a new stream, and the state they end in is kept for its next call.
+   * Each call may batch any set of distinct streams.
+   */
+  const vector<Blob<Dtype>*>& ForwardStreams(const vector<int>& stream_ids,
+      Dtype* loss = NULL);
+  /// @brief Forgets the state of a stream, which starts over at its next call.
+  void EndStream(int stream_id) { stream_states_.erase(stream_id); }
+  /// @brief Forgets the state of all the streams.
+  void EndAllStreams() { stream_states_.clear(); }
+  /// @brief The number of streams whose state is kept.
+  int num_streams() const { return stream_states_.size(); }
+
   /**
    * @brief Zeroes out the diffs of all net parameters.
    *        Should be run before Backward.
@@ -111,9 +132,16 @@ class Net {
    *        another Net.
    */
   void CopyTrainedLayersFrom(const NetParameter& param);
+  /// @brief Reads a file written by MappedWeights::Write, or a binary proto.
   void CopyTrainedLayersFrom(const string& trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string& trained_filename);
   void CopyTrainedLayersFromHDF5(const string& trained_filename);
+  /**
+   * @brief Maps a file written by MappedWeights::Write. The parameters of a
+   *        float net point into the mapping, which the net keeps, rather than
+   *        being copied.
+   */
+  void CopyTrainedLayersFromMapped(const string& trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -135,6 +163,10 @@ class Net {
   }
   /// @brief returns the phase: TRAIN or TEST
   inline Phase phase() const { return phase_; }
+  /// @brief returns the layer folds applied by CompileNet
+  inline const CompileNetState& compile_net_state() const {
+    return compile_net_state_;
+  }
   /**
    * @brief returns the bottom vecs for each layer -- usually you won't
    *        need this unless you do per-layer checks such as gradients.
@@ -167,6 +199,19 @@ class Net {
   inline const vector<Dtype>& blob_loss_weights() const {
     return blob_loss_weights_;
   }
+  /// @brief The bytes of the memory shared by the intermediate blobs (see
+  ///        NetParameter.plan_activation_memory).
+  inline size_t activation_arena_size() const {
+    return activation_arena_ ? activation_arena_->size() : 0;
+  }
+  /**
+   * @brief Returns the bytes of host and device memory actually allocated for
+   *        the data and diffs of the blobs and parameters of the net,
+   *        counting the memory shared by several blobs once.
+   *
+   * @param log_blobs whether to also log the bytes held by each blob.
+   */
+  size_t ResidentBytes(bool log_blobs = false) const;
   inline const vector<bool>& layer_need_backward() const {
     return layer_need_backward_;
   }
@@ -251,6 +296,8 @@ class Net {
   void add_after_backward(Callback* value) {
     after_backward_.push_back(value);
   }
+  /// @brief Removes a callback from all the lists it was added to.
+  void remove_callback(Callback* value);
 
  protected:
   // Helpers for Init.
@@ -266,6 +313,24 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Compute the layers whose outputs only depend on input shapes.
+  void FoldConstantLayers();
+  /// @brief Whether folded layer layer_id still holds valid outputs.
+  bool FoldedLayerUpToDate(const int layer_id);
+  /// @brief Let the intermediate blobs with disjoint lifetimes share memory.
+  void PlanActivationMemory();
+  /// @brief Whether the planned blobs still use the memory of the plan.
+  bool ActivationMemoryPlanUpToDate() const;
+  /// @brief Whether the diffs of the bottoms, tops and params of layer
+  ///        layer_id are allocated, in this order.
+  void DiffsAllocated(const int layer_id, vector<bool>* allocated) const;
+  /// @brief Fail if layer layer_id allocated a diff since DiffsAllocated.
+  void CheckNoNewDiff(const int layer_id) const;
+  /// @brief Copies the layers of param, taking the blob data from mapped
+  ///        rather than from param if it is not NULL.
+  void CopyTrainedLayers(const NetParameter& param,
+                         const MappedWeights* mapped);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -275,8 +340,13 @@ class Net {
 
   /// @brief The network name
   string name_;
+  /// @brief The weight files the parameters point into; they must outlive
+  /// the layers.
+  vector<shared_ptr<MappedWeights> > mapped_weights_;
   /// @brief The phase: TRAIN or TEST
   Phase phase_;
+  /// @brief The compilation applied to the net parameter at Init
+  CompileNetState compile_net_state_;
   /// @brief Individual layers in the net
   vector<shared_ptr<Layer<Dtype> > > layers_;
   vector<string> layer_names_;
@@ -330,6 +400,21 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Layers computed once by FoldConstantLayers, and the bottom shapes
+  /// their outputs were computed for.
+  vector<bool> layer_folded_;
+  vector<vector<vector<int> > > folded_bottom_shapes_;
+  /// Whether PlanActivationMemory shares the memory of the intermediate
+  /// blobs, the arena they share and the memory each blob was planned with.
+  bool plan_activation_memory_;
+  shared_ptr<SyncedMemory> activation_arena_;
+  vector<pair<Blob<Dtype>*, SyncedMemory*> > planned_blobs_;
+  /// Whether forward passes check that no diff gets allocated, and the diffs
+  /// allocated before the current layer ran.
+  bool check_no_diff_;
+  vector<bool> diffs_allocated_;
+  /// The recurrent state of each stream of ForwardStreams, by stream ID.
+  map<int, vector<Dtype> > stream_states_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
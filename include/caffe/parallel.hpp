@@ -1,8 +1,6 @@
 #ifndef CAFFE_PARALLEL_HPP_
 #define CAFFE_PARALLEL_HPP_
 
-#ifdef USE_NCCL
-
 #include <boost/thread.hpp>
 
 #include <string>
@@ -16,7 +14,9 @@
 #include "caffe/solver.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#ifdef USE_NCCL
 #include "caffe/util/nccl.hpp"
+#endif
 
 namespace caffe {
 
@@ -48,6 +48,70 @@ class Params {
 DISABLE_COPY_AND_ASSIGN(Params);
 };
 
+// Params stored in host memory, one copy per solver replica.
+template<typename Dtype>
+class CPUParams : public Params<Dtype> {
+ public:
+  explicit CPUParams(shared_ptr<Solver<Dtype> > root_solver);
+  virtual ~CPUParams();
+
+  void Configure(Solver<Dtype>* solver) const;
+
+ protected:
+  bool data_use_cuda_;
+  bool diff_use_cuda_;
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+/**
+ * @brief Data parallel training of solver replicas on the CPU threads of one
+ *        process.
+ *
+ * Each replica reads its own shard of the training data (see
+ * DataLayer::Skip). Before every update the gradients are averaged over the
+ * contiguous diff buffers: each replica reduces one chunk of the buffer from
+ * all the others and writes the result back to them, so that only two
+ * barriers are needed per iteration.
+ */
+template<typename Dtype>
+class CPUSync : public CPUParams<Dtype>,
+                public Solver<Dtype>::Callback {
+ public:
+  explicit CPUSync(shared_ptr<Solver<Dtype> > solver);
+  virtual ~CPUSync() {}
+
+  /**
+   * Connect the replicas of a Run; syncs is indexed by solver rank.
+   */
+  void set_group(vector<CPUSync<Dtype>*>* syncs, boost::barrier* barrier);
+
+  /**
+   * Broadcast weights from rank 0 to the other solvers.
+   */
+  void Broadcast();
+
+  /**
+   * Train on this solver and threads - 1 replicas of it.
+   */
+  void Run(int threads, const char* restore);
+
+ protected:
+  void on_start() {}
+  void on_gradients_ready();
+
+  shared_ptr<Solver<Dtype> > solver_;
+  int rank_;
+  vector<CPUSync<Dtype>*>* syncs_;
+  boost::barrier* barrier_;
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+#ifdef USE_NCCL
+
 // Params stored in GPU memory.
 template<typename Dtype>
 class GPUParams : public Params<Dtype> {
@@ -117,7 +181,8 @@ class NCCL : public GPUParams<Dtype>,
   using Params<Dtype>::diff_;
 };
 
+#endif  // USE_NCCL
+
 }  // namespace caffe
 
-#endif  // USE_NCCL
 #endif  // header
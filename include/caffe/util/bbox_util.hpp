@@ -157,6 +157,14 @@ void DecodeBBox(const NormalizedBBox& prior_bbox,
     const bool variance_encoded_in_target, const bool clip_bbox,
     const NormalizedBBox& bbox, NormalizedBBox* decode_bbox);
 
+// Decode a bbox according to a prior bbox, from and to [xmin, ymin, xmax, ymax]
+// arrays. The result is the one of DecodeBBox without clipping, inputs are
+// rounded to float like the fields of NormalizedBBox.
+template <typename Dtype>
+void DecodeBBox(const Dtype* prior_bbox, const Dtype* prior_variance,
+    const CodeType code_type, const bool variance_encoded_in_target,
+    const Dtype* bbox, float* decode_bbox);
+
 // Decode a set of bboxes according to a set of prior bboxes.
 void DecodeBBoxes(const vector<NormalizedBBox>& prior_bboxes,
     const vector<vector<float> >& prior_variances,
@@ -245,15 +253,6 @@ Dtype Calc_iou(const vector<Dtype>& box, const vector<Dtype>& truth) {
   return JaccardOverlap(Bbox1, Bbox2, true);
 }
 
-//Real optimization core of NMS
-void cpu_nms_avx512_parallize_inner(int* __restrict keep_out,
-    int* __restrict num_out,
-    const float* __restrict x1,
-    const float* __restrict y1,
-    const float* __restrict x2,
-    const float* __restrict y2,
-    int64_t boxes_num, float thresh_f);
-
 // Find matches between prediction bboxes and ground truth bboxes.
 //    all_loc_preds: stores the location prediction, where each item contains
 //      location prediction for an image.
@@ -522,7 +521,8 @@ void ApplyNMS(const bool* overlapped, const int num, vector<int>* indices);
 //    scores: a set of corresponding confidences.
 //    score_threshold: a threshold used to filter detection results.
 //    nms_threshold: a threshold used in non maximum suppression.
-//    eta: adaptation rate for nms threshold (see Piotr's paper).
+//    eta: adaptation rate for nms threshold (see Piotr's paper). If eta >= 1
+//      the threshold is fixed and the work is done by ApplyNMSFlat.
 //    top_k: if not -1, keep at most top_k picked indices.
 //    indices: the kept indices of bboxes after nms.
 void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
@@ -546,6 +546,33 @@ void ApplyNMSFast(const Dtype* bboxes, const Dtype* scores, const int num,
       const float score_threshold, const float nms_threshold,
       const float eta, const int top_k, vector<int>* indices);
 
+// The instruction set used by ApplyNMSFlat to compute overlaps.
+enum NMSKernel {
+  NMS_KERNEL_AUTO,
+  NMS_KERNEL_SCALAR,
+  NMS_KERNEL_AVX2,
+  NMS_KERNEL_AVX512
+};
+
+// Get the widest NMS kernel supported by the running cpu.
+NMSKernel GetNMSKernel();
+
+// Do greedy non maximum suppression on bboxes stored as separate arrays and
+// already sorted by descending score. Suppressed bboxes are tracked in a
+// bitmask, and the overlaps of each kept bbox with all later bboxes are
+// computed with the SIMD kernel picked at runtime (see GetNMSKernel).
+//    xmin, ymin, xmax, ymax: the coordinates of the bboxes.
+//    size: the size of each bbox, as returned by BBoxSize.
+//    num: number of bboxes.
+//    nms_threshold: a bbox is suppressed if its overlap with a kept bbox is
+//      larger than nms_threshold.
+//    indices: the kept positions (in [0, num)) after nms.
+//    kernel: force a kernel instead of picking the widest supported one.
+void ApplyNMSFlat(const float* xmin, const float* ymin, const float* xmax,
+      const float* ymax, const float* size, const int num,
+      const float nms_threshold, vector<int>* indices,
+      NMSKernel kernel = NMS_KERNEL_AUTO);
+
 // Compute cumsum of a set of pairs.
 void CumSum(const vector<pair<float, int> >& pairs, vector<int>* cumsum);
 
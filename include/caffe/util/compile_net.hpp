@@ -0,0 +1,42 @@
+#ifndef CAFFE_UTIL_COMPILE_NET_HPP_
+#define CAFFE_UTIL_COMPILE_NET_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Copy a TEST NetParameter with its BatchNorm, BN, Scale and Bias
+ *        layers folded into the Convolution or InnerProduct layer they
+ *        follow (with compile_net_state.bn_scale_merge), and its activations
+ *        fused into the layer they follow (with fuse_activations).
+ *
+ * A layer is folded when it computes a per-channel affine transform of the
+ * target output and no other layer reads that output before it (or after
+ * it, unless it works in place). Folded layers are removed, their targets
+ * get a bias term, and each fold is recorded in compile_net_state.fold so
+ * the trained weights can be rewritten with FoldLayerIntoParams.
+ *
+ * A ReLU, ReLU6, Mish or Swish layer is then fused under the same condition
+ * into a Convolution, ConvolutionDepthwise, InnerProduct or Eltwise SUM
+ * layer: it is removed and becomes the fused_activation of the layer, which
+ * applies it to its output on the CPU forward pass. Activations are only
+ * fused in CPU mode.
+ */
+void CompileNet(const NetParameter& param, NetParameter* param_compiled);
+
+/**
+ * @brief Rewrite the weights and bias of a fold target so that they also
+ *        apply the folded layer, given with its trained blobs.
+ */
+template <typename Dtype>
+void FoldLayerIntoParams(const LayerParameter& folded,
+    const vector<shared_ptr<Blob<Dtype> > >& target_blobs);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_COMPILE_NET_HPP_
@@ -26,6 +26,7 @@ class LMDBCursor : public Cursor {
     mdb_txn_abort(mdb_txn_);
   }
   virtual void SeekToFirst() { Seek(MDB_FIRST); }
+  virtual void SeekToLast() { Seek(MDB_LAST); }
   virtual void Next() { Seek(MDB_NEXT); }
   virtual string key() {
     return string(static_cast<const char*>(mdb_key_.mv_data), mdb_key_.mv_size);
@@ -64,6 +65,10 @@ class LMDBTransaction : public Transaction {
   MDB_env* mdb_env_;
   vector<string> keys, values;
 
+  // Writes the records in a single transaction, false if the map is full.
+  bool TryCommit();
+  // Grows the map so that bytes more of records are likely to fit.
+  void ReserveMapSize(size_t bytes);
   void DoubleMapSize();
 
   DISABLE_COPY_AND_ASSIGN(LMDBTransaction);
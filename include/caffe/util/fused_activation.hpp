@@ -0,0 +1,64 @@
+#ifndef CAFFE_UTIL_FUSED_ACTIVATION_HPP_
+#define CAFFE_UTIL_FUSED_ACTIVATION_HPP_
+
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The ReLU, ReLU6, Mish or Swish layer that CompileNet fused into the
+ *        layer it follows, given by LayerParameter.fused_activation.
+ *
+ * The layers taking a fused activation (Convolution, ConvolutionDepthwise,
+ * InnerProduct and Eltwise) apply it on their CPU forward pass, to each
+ * output value as it is written or in one pass over the output while it is
+ * still in cache. Their GPU forward passes refuse a fused activation, so a
+ * net compiled in CPU mode must not be run in GPU mode. Without a fused
+ * activation it is the identity.
+ */
+class FusedActivation {
+ public:
+  FusedActivation() : type_(NONE), negative_slope_(0), beta_(1) {}
+  explicit FusedActivation(const LayerParameter& layer_param);
+
+  /// @brief Whether the layer has a fused activation.
+  inline bool enabled() const { return type_ != NONE; }
+
+  template <typename Dtype>
+  inline Dtype operator()(Dtype x) const {
+    switch (type_) {
+    case RELU:
+      return x > 0 ? x : x * negative_slope_;
+    case RELU6:
+      return std::min(x > 0 ? x : x * negative_slope_, Dtype(6));
+    case MISH: {
+      // x * tanh(softplus(x)), as MishLayer.
+      const Dtype softplus = x > 20 ? x :
+          (x < -20 ? std::exp(x) : std::log(std::exp(x) + 1));
+      return x * std::tanh(softplus);
+    }
+    case SWISH:
+      return x / (1 + std::exp(-beta_ * x));
+    default:
+      return x;
+    }
+  }
+
+  /// @brief Applies the activation to n values in place.
+  template <typename Dtype>
+  void Forward_cpu(const int n, Dtype* data) const;
+
+ private:
+  enum Type { NONE, RELU, RELU6, MISH, SWISH };
+  Type type_;
+  float negative_slope_;
+  float beta_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSED_ACTIVATION_HPP_
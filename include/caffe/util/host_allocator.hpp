@@ -0,0 +1,66 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include "caffe/common.hpp"
+
+// The alignment of the host memory given by HostAllocator, in bytes. It must
+// be a power of two of at least 16.
+#ifndef CAFFE_HOST_ALIGNMENT
+#define CAFFE_HOST_ALIGNMENT 64
+#endif
+
+namespace caffe {
+
+/**
+ * @brief A caching allocator for the host memory of SyncedMemory, see
+ *        CaffeMallocHost.
+ *
+ * Requests are rounded up to size classes, four per power of two, and freed
+ * blocks are kept in free lists by size class, so that blobs reshaped to
+ * varying sizes reuse their memory instead of going back to the system. Each
+ * thread has its own free lists, backed by a shared pool that holds what
+ * does not fit in them and the blocks of the threads that exited. All the
+ * blocks are aligned to CAFFE_HOST_ALIGNMENT bytes.
+ *
+ * The settings are global and meant to be set before the allocations.
+ */
+class HostAllocator {
+ public:
+  struct Stats {
+    /// The calls to Allocate.
+    uint64_t allocations;
+    /// The allocations served by a free list rather than by the system.
+    uint64_t cache_hits;
+    /// The bytes of the blocks allocated and not freed yet, by size class.
+    int64_t bytes_in_use;
+    /// The bytes of the blocks held in the free lists.
+    int64_t bytes_cached;
+  };
+
+  static void* Allocate(size_t size);
+  static void Free(void* ptr);
+
+  /// @brief The counters summed over all the threads.
+  static Stats GetStats();
+  /// @brief The bytes actually allocated for a request of size bytes.
+  static size_t SizeClass(size_t size);
+  /// @brief Returns the blocks cached by the shared pool and the calling
+  ///        thread to the system.
+  static void Trim();
+
+  /// @brief Sets the bytes each thread and the shared pool may cache; 0
+  ///        disables caching. The default is 32 MB, so a process with many
+  ///        threads does not hold on to gigabytes of idle blocks.
+  static void set_cache_limit(size_t bytes);
+  static size_t cache_limit();
+  /**
+   * @brief Backs the blocks of 2 MB and more with transparent huge pages,
+   *        where the system supports them. Off by default.
+   */
+  static void set_huge_pages(bool huge_pages);
+  static bool huge_pages();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
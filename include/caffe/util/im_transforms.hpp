@@ -0,0 +1,45 @@
+#ifdef USE_OPENCV
+#ifndef CAFFE_UTIL_IM_TRANSFORMS_HPP_
+#define CAFFE_UTIL_IM_TRANSFORMS_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Map a NormalizedBBox of the original image to the image produced by
+// ApplyResize with the given parameter.
+void UpdateBBoxByResizePolicy(const ResizeParameter& param,
+                              const int old_width, const int old_height,
+                              NormalizedBBox* bbox);
+
+// Resize an image to param.height() x param.width(), either warping it
+// (WARP) or scaling it to fit and padding the borders
+// (FIT_LARGE_SIZE_AND_PAD). If several interp_mode are given, one is picked
+// at random.
+cv::Mat ApplyResize(const cv::Mat& in_img, const ResizeParameter& param);
+
+// Randomly adjust brightness, contrast, saturation and hue and reorder the
+// channels of a BGR image, each with the probability given in param.
+cv::Mat ApplyDistort(const cv::Mat& in_img, const DistortionParameter& param);
+
+void RandomBrightness(const cv::Mat& in_img, cv::Mat* out_img,
+    const float brightness_prob, const float brightness_delta);
+
+void RandomContrast(const cv::Mat& in_img, cv::Mat* out_img,
+    const float contrast_prob, const float lower, const float upper);
+
+void RandomSaturation(const cv::Mat& in_img, cv::Mat* out_img,
+    const float saturation_prob, const float lower, const float upper);
+
+void RandomHue(const cv::Mat& in_img, cv::Mat* out_img,
+               const float hue_prob, const float hue_delta);
+
+void RandomOrderChannels(const cv::Mat& in_img, cv::Mat* out_img,
+                         const float random_order_prob);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IM_TRANSFORMS_HPP_
+#endif  // USE_OPENCV
@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Trained weights in a file laid out to be memory-mapped, so that
+ *        Net::CopyTrainedLayersFrom can point the parameters of a float net
+ *        into the file instead of parsing and copying them.
+ *
+ * The file starts with the magic "CAFFEMAP", a version and the size of the
+ * index: a NetParameter holding the name, type and blob shapes of the layers,
+ * without their data. The data of the blobs follows, as float, in the order
+ * of the index, each blob starting at a multiple of CAFFE_HOST_ALIGNMENT
+ * bytes. Use Write, or tools/map_weights, to convert a .caffemodel.
+ *
+ * The file is mapped copy-on-write: the pages are shared with the page cache
+ * and the other processes mapping the file until a net writes to its
+ * parameters, e.g. when training, and the file itself is never modified.
+ */
+class MappedWeights {
+ public:
+  /// @brief Maps filename, which must have been written by Write.
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  /// @brief The layers and blob shapes of the file, without data.
+  inline const NetParameter& index() const { return index_; }
+  /// @brief The data of blob j of layer i of the index.
+  float* data(int i, int j) const;
+  /// @brief The shape of blob j of layer i of the index.
+  const vector<int>& shape(int i, int j) const { return shapes_[i][j]; }
+  /// @brief Copies blob j of layer i of the index, with its data, to proto.
+  void ToProto(int i, int j, BlobProto* proto) const;
+
+  /// @brief Whether filename starts like a file written by Write.
+  static bool IsMappedWeights(const string& filename);
+  /// @brief Writes the blobs of the layers of param to filename.
+  static void Write(const NetParameter& param, const string& filename);
+
+ protected:
+  void* addr_;
+  size_t size_;
+  NetParameter index_;
+  vector<vector<size_t> > offsets_;
+  vector<vector<vector<int> > > shapes_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
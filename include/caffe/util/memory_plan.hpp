@@ -0,0 +1,26 @@
+#ifndef CAFFE_UTIL_MEMORY_PLAN_HPP_
+#define CAFFE_UTIL_MEMORY_PLAN_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Place buffers in a shared arena so that buffers alive at the same
+ *        time never overlap.
+ *
+ * Buffer i has sizes[i] bytes and is alive from step first[i] to step last[i]
+ * included. The buffers are placed from the largest to the smallest, each at
+ * the lowest offset, aligned to alignment bytes, where it overlaps none of the
+ * buffers already placed that are alive at the same time.
+ *
+ * @return the size of the arena, in bytes.
+ */
+size_t PlanMemory(const vector<size_t>& sizes, const vector<int>& first,
+    const vector<int>& last, size_t alignment, vector<size_t>* offsets);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MEMORY_PLAN_HPP_
@@ -0,0 +1,122 @@
+#ifndef CAFFE_UTIL_NET_PROFILER_HPP_
+#define CAFFE_UTIL_NET_PROFILER_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Measures the layers of a Net through its forward and backward
+ *        callbacks, so that any caller of Forward or Backward is profiled.
+ *
+ * Each layer run records its wall time and an estimate of the floating point
+ * operations and of the bytes it moves, computed from the current shapes of
+ * its blobs. The last max_samples times of each layer and pass give the
+ * percentiles, and the first max_trace_events runs are kept for the Chrome
+ * trace (chrome://tracing, or https://ui.perfetto.dev).
+ *
+ * The profiler attaches itself to the net on construction and detaches on
+ * destruction. In GPU mode, the timer synchronizes the device after each
+ * layer, which serializes the kernels of consecutive layers.
+ */
+template <typename Dtype>
+class NetProfiler {
+ public:
+  enum Pass { FORWARD = 0, BACKWARD = 1 };
+
+  struct Stats {
+    Stats() : count(0), total_us(0), min_us(0), max_us(0), flops(0),
+        bytes(0), next_sample(0) {}
+    int count;
+    double total_us;
+    double min_us;
+    double max_us;
+    /// Estimates of the last run.
+    double flops;
+    double bytes;
+    /// Ring of the last max_samples times.
+    vector<float> samples;
+    int next_sample;
+  };
+
+  explicit NetProfiler(Net<Dtype>* net, int max_samples = 1000,
+      int max_trace_events = 100000);
+  ~NetProfiler();
+
+  /// Clears all the measurements, e.g. after warming up.
+  void Reset();
+
+  inline const Stats& stats(int layer, Pass pass) const {
+    return stats_[pass][layer];
+  }
+  /// The p-th percentile, p in [0, 100], of the recent times of a layer.
+  double Percentile(int layer, Pass pass, double p) const;
+  /// The sum over the layers of the total time of a pass.
+  double TotalMicroSeconds(Pass pass) const;
+
+  /// The estimates for the current shapes of the blobs of a layer.
+  double EstimateFlops(int layer, Pass pass) const;
+  double EstimateBytes(int layer, Pass pass) const;
+
+  /// The per layer statistics as a JSON document.
+  string ToJSON() const;
+  void WriteJSON(const string& filename) const;
+  /// The recorded runs in the Chrome trace event format.
+  void WriteChromeTrace(const string& filename) const;
+  /// Logs the average time of each layer and pass, as `caffe time` does.
+  void LogSummary() const;
+
+ protected:
+  class Hook : public Net<Dtype>::Callback {
+   public:
+    Hook(NetProfiler* profiler, Pass pass, bool start)
+        : profiler_(profiler), pass_(pass), start_(start) {}
+
+   protected:
+    virtual void run(int layer) {
+      if (start_) {
+        profiler_->Start(layer, pass_);
+      } else {
+        profiler_->Stop(layer, pass_);
+      }
+    }
+
+    NetProfiler* profiler_;
+    Pass pass_;
+    bool start_;
+  };
+
+  struct TraceEvent {
+    int layer;
+    Pass pass;
+    double start_us;
+    double duration_us;
+  };
+
+  void Start(int layer, Pass pass);
+  void Stop(int layer, Pass pass);
+  void StatsToJSON(int layer, Pass pass, std::ostream* os) const;
+
+  Net<Dtype>* net_;
+  const int max_samples_;
+  const int max_trace_events_;
+  vector<shared_ptr<Hook> > hooks_;
+  vector<Stats> stats_[2];
+  vector<TraceEvent> trace_;
+  Timer timer_;
+  boost::posix_time::ptime epoch_;
+  boost::posix_time::ptime start_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NET_PROFILER_HPP_
@@ -0,0 +1,102 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * Helpers of the INT8 engine, which runs the layers having a
+ * quantization_param in dynamic fixed point.
+ *
+ * A real value x of a tensor of scale s and bit width bw is quantized to
+ * q = clamp(round(x * s)), within [0, 2^bw - 1] for an unsigned tensor and
+ * [-2^(bw-1), 2^(bw-1) - 1] for a signed one, and stands for q / s. The scale
+ * of input i of a layer is scale_in(i) when given, else 2^fl_layer_in(i), and
+ * likewise for the outputs and the parameters.
+ */
+
+/// @brief The integers of bw bits, signed or not.
+struct QuantizedRange {
+  QuantizedRange(int bw, bool is_unsigned)
+      : min(is_unsigned ? 0 : -(1 << (bw - 1))),
+        max(is_unsigned ? (1 << bw) - 1 : (1 << (bw - 1)) - 1) {}
+  int min;
+  int max;
+};
+
+/// @brief The scale of input i of the layer.
+float QuantizationScaleIn(const QuantizationParameter& param, int i);
+/// @brief The scale of output i of the layer.
+float QuantizationScaleOut(const QuantizationParameter& param, int i);
+/// @brief The scale of parameter blob i of the layer.
+float QuantizationScaleParams(const QuantizationParameter& param, int i);
+/// @brief Whether the inputs are quantized unsigned, clipping negative values.
+inline bool QuantizedInputIsUnsigned(const QuantizationParameter& param) {
+  return param.force_u8_input() || !param.is_negative_input();
+}
+/// @brief Whether the outputs are rounded to bw_layer_out bits.
+bool QuantizesOutput(const QuantizationParameter& param);
+
+/// @brief q[i] = clamp(round(x[i] * scale)) + offset, e.g. 128 to store signed
+///        values in the unsigned operand of caffe_cpu_gemm_u8s8.
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, const int offset, uint8_t* q);
+
+/// @brief q[i] = clamp(round(x[i] * scale)).
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, int8_t* q);
+
+/// @brief y[i] = clamp(round(x[i] * scale)) / scale, in place or not.
+template <typename Dtype>
+void caffe_cpu_fake_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, Dtype* y);
+
+/// @brief q[j * ldq + i] = clamp(round(x[i * cols + j] * scale)) + offset
+///        for the rows x cols x, e.g. to quantize the columns of im2col
+///        straight into the rows of the unsigned operand of
+///        caffe_cpu_gemm_u8s8.
+template <typename Dtype>
+void caffe_cpu_quantize_transposed(const int rows, const int cols,
+    const Dtype* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q);
+
+/// @brief The distance between the rows of the unsigned operand of
+///        caffe_cpu_gemm_u8s8: K rounded up to a multiple of 4.
+inline int GemmU8S8Stride(const int K) { return (K + 3) / 4 * 4; }
+/// @brief The size of the M x K signed operand packed by caffe_cpu_pack_s8.
+inline int GemmU8S8PackedSize(const int M, const int K) {
+  return (M + 15) / 16 * 16 * GemmU8S8Stride(K);
+}
+
+/**
+ * @brief Packs the M x K signed operand of caffe_cpu_gemm_u8s8, e.g. the
+ *        weights of a layer once for all its forward passes.
+ *
+ * The rows go by blocks of 16, padded with zeros. A block holds the 16 rows
+ * of each group of 4 columns in turn, 4 bytes per row: the layout of an
+ * operand of vpdpbusd, with a row per 32 bit lane.
+ */
+void caffe_cpu_pack_s8(const int M, const int K, const int8_t* A,
+    int8_t* packed);
+
+/**
+ * @brief C = B * A^T for the M x K signed A, packed by caffe_cpu_pack_s8,
+ *        and the N x K unsigned B, in int32. C is N x M, and the rows of B
+ *        are GemmU8S8Stride(K) apart.
+ *
+ * Runs the AVX512-VNNI or AVX2 kernel the CPU supports. The products are
+ * accumulated exactly: the AVX2 kernel splits the unsigned values so that
+ * the 16 bit intermediates of pmaddubsw cannot saturate.
+ */
+void caffe_cpu_gemm_u8s8(const int M, const int N, const int K,
+    const int8_t* A, const uint8_t* B, int32_t* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
@@ -0,0 +1,61 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads sharing the iterations of a loop.
+ *
+ * The thread calling Run works on the loop too, so a pool of size 1 starts no
+ * thread. Workers inherit the Caffe mode, device and solver rank of the thread
+ * creating the pool, like InternalThread.
+ */
+class ThreadPool {
+ public:
+  // fn(i, worker) with worker in [0, size()), unique among concurrent calls.
+  typedef boost::function<void(int, int)> Task;
+
+  explicit ThreadPool(int size);
+  ~ThreadPool();
+
+  inline int size() const { return size_; }
+
+  /**
+   * Calls fn(i, worker) for i in [0, n) and returns when all calls are done.
+   * Run is not reentrant, and is not an interruption point so that a
+   * prefetch thread stopped while waiting does not leave the tasks running.
+   */
+  void Run(int n, const Task& fn);
+
+ protected:
+  // See BlockingQueue::sync.
+  class sync;
+
+  void Entry(int worker, int device, Caffe::Brew mode, int solver_count,
+      int solver_rank);
+  void Work(int worker);
+
+  const int size_;
+  vector<shared_ptr<boost::thread> > threads_;
+  shared_ptr<sync> sync_;
+  const Task* task_;
+  int count_;
+  int next_;
+  int running_;
+  uint64_t generation_;
+  bool stop_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
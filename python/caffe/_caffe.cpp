@@ -18,6 +18,7 @@
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/net_profiler.hpp"
 
 // Temporary solution for numpy < 1.7 versions: old macro, no promises.
 // You're strongly advised to upgrade to >= 1.7.
@@ -196,6 +197,16 @@ void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
       PyArray_DIMS(data_arr)[0]);
 }
 
+Dtype Net_ForwardStreams(Net<Dtype>* net, bp::object stream_ids_obj) {
+  vector<int> stream_ids;
+  for (int i = 0; i < bp::len(stream_ids_obj); ++i) {
+    stream_ids.push_back(bp::extract<int>(stream_ids_obj[i]));
+  }
+  Dtype loss;
+  net->ForwardStreams(stream_ids, &loss);
+  return loss;
+}
+
 Solver<Dtype>* GetSolverFromFile(const string& filename) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(filename, &param);
@@ -413,6 +424,10 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("__init__", bp::make_constructor(&Net_Init_Load))
     .def("_forward", &Net<Dtype>::ForwardFromTo)
     .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward_streams", &Net_ForwardStreams)
+    .def("end_stream", &Net<Dtype>::EndStream)
+    .def("end_all_streams", &Net<Dtype>::EndAllStreams)
+    .add_property("num_streams", &Net<Dtype>::num_streams)
     .def("reshape", &Net<Dtype>::Reshape)
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
@@ -574,6 +589,17 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("ms", &Timer::MilliSeconds);
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Timer);
 
+  // The profiler keeps its net alive, and detaches from it when collected.
+  bp::class_<NetProfiler<Dtype>, shared_ptr<NetProfiler<Dtype> >,
+    boost::noncopyable>("NetProfiler",
+        bp::init<Net<Dtype>*>()[bp::with_custodian_and_ward<1, 2>()])
+    .def("reset", &NetProfiler<Dtype>::Reset)
+    .def("to_json", &NetProfiler<Dtype>::ToJSON)
+    .def("write_json", &NetProfiler<Dtype>::WriteJSON)
+    .def("write_chrome_trace", &NetProfiler<Dtype>::WriteChromeTrace)
+    .def("log_summary", &NetProfiler<Dtype>::LogSummary);
+  BP_REGISTER_SHARED_PTR_TO_PYTHON(NetProfiler<Dtype>);
+
   // boost python expects a void (missing) return value, while import_array
   // returns NULL for python3. import_array1() forces a void return value.
   import_array1();
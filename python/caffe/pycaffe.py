@@ -11,7 +11,7 @@ except:
 import numpy as np
 
 from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
-        RMSPropSolver, AdaDeltaSolver, AdamSolver, NCCL, Timer
+        RMSPropSolver, AdaDeltaSolver, AdamSolver, NCCL, Timer, NetProfiler
 import caffe.io
 
 import six
@@ -134,6 +134,40 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     return {out: self.blobs[out].data for out in outputs}
 
 
+def _Net_forward_streams(self, stream_ids, blobs=None, **kwargs):
+    """
+    Forward pass over a batch of independent streams, keeping the recurrent
+    state of each stream from one call to the next.
+
+    Parameters
+    ----------
+    stream_ids : IDs of the distinct streams continued by the batch, one per
+                 index of axis 1 of the recurrent inputs. New IDs start from
+                 a zero state; call end_stream(id) when a stream is done.
+    blobs : list of blobs to return in addition to output blobs.
+    kwargs : Keys are input blob names and values are blob ndarrays, shaped
+             (timesteps, streams, ...) for the recurrent inputs. The input
+             blobs are reshaped to them.
+
+    Returns
+    -------
+    outs : {blob name: blob ndarray} dict.
+    """
+    if blobs is None:
+        blobs = []
+
+    if kwargs:
+        if set(kwargs.keys()) != set(self.inputs):
+            raise Exception('Input blob arguments do not match net inputs.')
+        for in_, blob in six.iteritems(kwargs):
+            self.blobs[in_].reshape(*blob.shape)
+            self.blobs[in_].data[...] = blob
+
+    self._forward_streams(list(stream_ids))
+
+    return {out: self.blobs[out].data for out in set(self.outputs + blobs)}
+
+
 def _Net_backward(self, diffs=None, start=None, end=None, **kwargs):
     """
     Backward pass: prepare diffs and run the net backward.
@@ -340,6 +374,7 @@ Net.blob_loss_weights = _Net_blob_loss_weights
 Net.layer_dict = _Net_layer_dict
 Net.params = _Net_params
 Net.forward = _Net_forward
+Net.forward_streams = _Net_forward_streams
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
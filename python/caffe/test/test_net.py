@@ -108,6 +108,22 @@ class TestNet(unittest.TestCase):
 
         np.testing.assert_allclose(conv_blob.diff,manual_backward,rtol=1e-3,atol=1e-5)
 
+    def test_profiler(self):
+        import json
+        profiler = caffe.NetProfiler(self.net)
+        for _ in range(3):
+            self.net.forward()
+            self.net.backward()
+        profile = json.loads(profiler.to_json())
+        self.assertEqual([l['name'] for l in profile['layers']],
+                         list(self.net._layer_names))
+        for l in profile['layers']:
+            self.assertEqual(l['forward']['count'], 3)
+            self.assertEqual(l['backward']['count'], 3)
+        del profiler
+        # The net runs on without the profiler.
+        self.net.forward()
+
     def test_clear_param_diffs(self):
         # Run a forward/backward step to have non-zero diffs
         self.net.forward()
@@ -387,3 +403,59 @@ layer {
         net = caffe.Net(self.f.name, caffe.TEST, stages=['deploy'])
         self.check_net(net, ['pred'])
 
+
+
+class TestForwardStreams(unittest.TestCase):
+
+    TEST_NET = """
+layer {
+  name: "input"
+  type: "Input"
+  top: "x"
+  top: "cont"
+  input_param { shape { dim: 1 dim: 2 dim: 3 } shape { dim: 1 dim: 2 } }
+}
+layer {
+  name: "lstm"
+  type: "LSTM"
+  bottom: "x"
+  bottom: "cont"
+  top: "h"
+  recurrent_param {
+    num_output: 4
+    weight_filler { type: "gaussian" std: 0.5 }
+    engine: FUSED
+  }
+}
+"""
+
+    def setUp(self):
+        f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+        f.write(self.TEST_NET)
+        f.close()
+        self.net = caffe.Net(f.name, caffe.TEST)
+        os.remove(f.name)
+
+    def test_streams(self):
+        xs = np.random.randn(3, 2, 3).astype(np.float32)
+        cont = np.ones((1, 1), dtype=np.float32)
+        # Each stream alone, one step at a time.
+        alone = {}
+        for sid in range(2):
+            alone[sid] = [self.net.forward_streams(
+                [sid], x=xs[t, sid].reshape(1, 1, 3), cont=cont)['h'].copy()
+                for t in range(3)]
+        self.net.end_all_streams()
+        self.assertEqual(self.net.num_streams, 0)
+        # Both streams batched, in swapped slots at every other step.
+        for t in range(3):
+            order = [0, 1] if t % 2 == 0 else [1, 0]
+            x = np.stack([xs[t, sid] for sid in order]).reshape(1, 2, 3)
+            h = self.net.forward_streams(order, x=x,
+                                         cont=np.ones((1, 2), np.float32))['h']
+            for slot, sid in enumerate(order):
+                np.testing.assert_allclose(h[0, slot], alone[sid][t][0, 0],
+                                           rtol=1e-5, atol=1e-6)
+        self.assertEqual(self.net.num_streams, 2)
+        self.net.end_stream(0)
+        self.assertEqual(self.net.num_streams, 1)
@@ -0,0 +1,144 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/data_reader.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+using boost::weak_ptr;
+
+map<const string, weak_ptr<DataReader::Body> > DataReader::bodies_;
+static boost::mutex bodies_mutex_;
+
+DataReader::DataReader(const LayerParameter& param)
+    : queue_(new Queue(param.data_param().prefetch() *
+        param.data_param().batch_size())) {
+  // Get or create a body
+  boost::mutex::scoped_lock lock(bodies_mutex_);
+  string key = source_key(param);
+  weak_ptr<Body>& weak = bodies_[key];
+  body_ = weak.lock();
+  if (!body_) {
+    body_.reset(new Body(param));
+    bodies_[key] = weak_ptr<Body>(body_);
+  }
+  body_->new_queues_.push(queue_);
+}
+
+DataReader::~DataReader() {
+  string key = source_key(body_->param_);
+  // The body drops the queue, and a null buffer wakes it up if it waits for
+  // room in it.
+  body_->removed_queues_.push(queue_);
+  queue_->free_.push(NULL);
+  body_.reset();
+  boost::mutex::scoped_lock lock(bodies_mutex_);
+  if (bodies_[key].expired()) {
+    bodies_.erase(key);
+  }
+}
+
+DataReader::Queue::Queue(int capacity)
+    : capacity_(capacity) {
+  for (int i = 0; i < capacity_; ++i) {
+    free_.push(new string());
+  }
+}
+
+DataReader::Queue::~Queue() {
+  string* buffer;
+  while (free_.try_pop(&buffer)) {
+    delete buffer;
+  }
+  while (full_.try_pop(&buffer)) {
+    delete buffer;
+  }
+}
+
+DataReader::Body::Body(const LayerParameter& param)
+    : param_(param) {
+  StartInternalThread();
+}
+
+DataReader::Body::~Body() {
+  StopInternalThread();
+}
+
+void DataReader::Body::UpdateQueues(vector<shared_ptr<Queue> >* queues) {
+  shared_ptr<Queue> queue;
+  while (new_queues_.try_pop(&queue)) {
+    queues->push_back(queue);
+  }
+  while (removed_queues_.try_pop(&queue)) {
+    vector<shared_ptr<Queue> >::iterator it =
+        std::find(queues->begin(), queues->end(), queue);
+    CHECK(it != queues->end());
+    queues->erase(it);
+  }
+}
+
+void DataReader::Body::InternalThreadEntry() {
+  shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
+  db->Open(param_.data_param().source(), db::READ);
+  shared_ptr<db::Cursor> cursor(db->NewCursor());
+  // When each solver runs in its own process, the solvers read disjoint
+  // subsets of the records. In test mode, only rank 0 runs.
+  const bool shard = Caffe::multiprocess() && Caffe::solver_count() > 1 &&
+      param_.phase() == TRAIN;
+  const int solver_count = Caffe::solver_count();
+  const int solver_rank = Caffe::solver_rank();
+  uint64_t offset = 0;
+  vector<shared_ptr<Queue> > queues;
+  int next = 0;
+  try {
+    // Wait for the readers of all the solvers of the process, so that the
+    // first records are dealt round-robin too.
+    const size_t readers = param_.phase() == TRAIN && !Caffe::multiprocess() ?
+        solver_count : 1;
+    while (queues.size() < readers) {
+      queues.push_back(new_queues_.pop());
+    }
+    while (!must_stop()) {
+      UpdateQueues(&queues);
+      if (queues.empty()) {
+        queues.push_back(new_queues_.pop());
+        continue;
+      }
+      // Deal the records strictly round-robin, waiting for the next reader
+      // to consume, so that each reader gets the same records every run.
+      next %= queues.size();
+      const shared_ptr<Queue>& queue = queues[next];
+      string* buffer = queue->free_.pop();
+      if (!buffer) {
+        // The reader went away; the next update drops its queue.
+        continue;
+      }
+      while (shard && offset % solver_count != solver_rank) {
+        Next(cursor.get(), &offset);
+      }
+      *buffer = cursor->value();
+      Next(cursor.get(), &offset);
+      queue->full_.push(buffer);
+      ++next;
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+void DataReader::Body::Next(db::Cursor* cursor, uint64_t* offset) {
+  cursor->Next();
+  if (!cursor->valid()) {
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Restarting data prefetching from start.";
+    cursor->SeekToFirst();
+  }
+  ++*offset;
+}
+
+}  // namespace caffe
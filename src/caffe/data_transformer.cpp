@@ -2,16 +2,22 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
+#include "caffe/util/bbox_util.hpp"
+#include "caffe/util/im_transforms.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+using google::protobuf::RepeatedPtrField;
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -225,6 +231,16 @@ void DataTransformer<Dtype>::Transform(const vector<cv::Mat> & mat_vector,
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
                                        Blob<Dtype>* transformed_blob) {
+  NormalizedBBox crop_bbox;
+  bool do_mirror;
+  Transform(cv_img, transformed_blob, &crop_bbox, &do_mirror);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
+                                       Blob<Dtype>* transformed_blob,
+                                       NormalizedBBox* crop_bbox,
+                                       bool* do_mirror) {
   const int crop_size = param_.crop_size();
   const int img_channels = cv_img.channels();
   const int img_height = cv_img.rows;
@@ -244,7 +260,7 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
 
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
+  const bool mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
   const bool has_mean_values = mean_values_.size() > 0;
 
@@ -290,6 +306,11 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     CHECK_EQ(img_height, height);
     CHECK_EQ(img_width, width);
   }
+  crop_bbox->set_xmin(static_cast<float>(w_off) / img_width);
+  crop_bbox->set_ymin(static_cast<float>(h_off) / img_height);
+  crop_bbox->set_xmax(static_cast<float>(w_off + width) / img_width);
+  crop_bbox->set_ymax(static_cast<float>(h_off + height) / img_height);
+  *do_mirror = mirror;
 
   CHECK(cv_cropped_img.data);
 
@@ -300,7 +321,7 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     int img_index = 0;
     for (int w = 0; w < width; ++w) {
       for (int c = 0; c < img_channels; ++c) {
-        if (do_mirror) {
+        if (mirror) {
           top_index = (c * height + h) * width + (width - 1 - w);
         } else {
           top_index = (c * height + h) * width + w;
@@ -323,6 +344,114 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     }
   }
 }
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformAnnotation(
+    const RepeatedPtrField<AnnotationGroup>& anno_groups,
+    const int img_width, const int img_height, const bool do_resize,
+    const NormalizedBBox& crop_bbox, const bool do_mirror,
+    RepeatedPtrField<AnnotationGroup>* transformed_groups) {
+  transformed_groups->Clear();
+  for (int g = 0; g < anno_groups.size(); ++g) {
+    const AnnotationGroup& anno_group = anno_groups.Get(g);
+    AnnotationGroup transformed_group;
+    for (int a = 0; a < anno_group.annotation_size(); ++a) {
+      const Annotation& anno = anno_group.annotation(a);
+      NormalizedBBox resize_bbox = anno.bbox();
+      if (do_resize && param_.has_resize_param()) {
+        CHECK_GT(img_height, 0);
+        CHECK_GT(img_width, 0);
+        UpdateBBoxByResizePolicy(param_.resize_param(), img_width, img_height,
+                                 &resize_bbox);
+      }
+      if (param_.has_emit_constraint() &&
+          !MeetEmitConstraint(crop_bbox, resize_bbox,
+                              param_.emit_constraint())) {
+        continue;
+      }
+      NormalizedBBox proj_bbox;
+      if (ProjectBBox(crop_bbox, resize_bbox, &proj_bbox)) {
+        Annotation* transformed_anno = transformed_group.add_annotation();
+        transformed_anno->set_instance_id(anno.instance_id());
+        NormalizedBBox* transformed_bbox = transformed_anno->mutable_bbox();
+        transformed_bbox->CopyFrom(proj_bbox);
+        if (do_mirror) {
+          const float xmin = transformed_bbox->xmin();
+          transformed_bbox->set_xmin(1 - transformed_bbox->xmax());
+          transformed_bbox->set_xmax(1 - xmin);
+        }
+      }
+    }
+    if (transformed_group.annotation_size() > 0) {
+      transformed_group.set_group_label(anno_group.group_label());
+      transformed_groups->Add()->Swap(&transformed_group);
+    }
+  }
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::CropImage(const cv::Mat& cv_img,
+                                       const NormalizedBBox& bbox,
+                                       cv::Mat* crop_img) {
+  const int img_height = cv_img.rows;
+  const int img_width = cv_img.cols;
+  NormalizedBBox clipped_bbox;
+  ClipBBox(bbox, &clipped_bbox);
+  NormalizedBBox scaled_bbox;
+  ScaleBBox(clipped_bbox, img_height, img_width, &scaled_bbox);
+  const int w_off = static_cast<int>(scaled_bbox.xmin());
+  const int h_off = static_cast<int>(scaled_bbox.ymin());
+  const int width = std::max(1, std::min(img_width - w_off,
+      static_cast<int>(scaled_bbox.xmax() - scaled_bbox.xmin())));
+  const int height = std::max(1, std::min(img_height - h_off,
+      static_cast<int>(scaled_bbox.ymax() - scaled_bbox.ymin())));
+  *crop_img = cv_img(cv::Rect(w_off, h_off, width, height));
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::ExpandImage(const cv::Mat& cv_img,
+                                         cv::Mat* expand_img,
+                                         NormalizedBBox* expand_bbox) {
+  const ExpansionParameter& expand_param = param_.expand_param();
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  const float max_expand_ratio = expand_param.max_expand_ratio();
+  if (prob > expand_param.prob() || fabs(max_expand_ratio - 1.) < 1e-2) {
+    *expand_img = cv_img;
+    expand_bbox->CopyFrom(UnitBBox());
+    return;
+  }
+  CHECK_GT(max_expand_ratio, 1.) << "expand ratio must be >= 1.";
+  float expand_ratio;
+  caffe_rng_uniform(1, 1.f, max_expand_ratio, &expand_ratio);
+  const int img_height = cv_img.rows;
+  const int img_width = cv_img.cols;
+  const int img_channels = cv_img.channels();
+  const int height = static_cast<int>(img_height * expand_ratio);
+  const int width = static_cast<int>(img_width * expand_ratio);
+  float h_off, w_off;
+  caffe_rng_uniform(1, 0.f, static_cast<float>(height - img_height), &h_off);
+  caffe_rng_uniform(1, 0.f, static_cast<float>(width - img_width), &w_off);
+  h_off = floor(h_off);
+  w_off = floor(w_off);
+  expand_bbox->set_xmin(-w_off / img_width);
+  expand_bbox->set_ymin(-h_off / img_height);
+  expand_bbox->set_xmax((width - w_off) / img_width);
+  expand_bbox->set_ymax((height - h_off) / img_height);
+
+  // Fill the canvas with the mean, so that it is zero after subtraction.
+  cv::Scalar fill;
+  if (mean_values_.size() > 0) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == img_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << img_channels;
+    for (int c = 0; c < img_channels && c < 4; ++c) {
+      fill[c] = mean_values_[mean_values_.size() == 1 ? 0 : c];
+    }
+  }
+  expand_img->create(height, width, cv_img.type());
+  expand_img->setTo(fill);
+  cv_img.copyTo((*expand_img)(cv::Rect(w_off, h_off, img_width, img_height)));
+}
 #endif  // USE_OPENCV
 
 template<typename Dtype>
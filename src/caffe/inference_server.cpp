@@ -0,0 +1,236 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "caffe/inference_server.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+// Microseconds since the epoch.
+static int64_t Now() {
+  static const boost::posix_time::ptime epoch(
+      boost::gregorian::date(1970, 1, 1));
+  return (boost::posix_time::microsec_clock::universal_time() - epoch)
+      .total_microseconds();
+}
+
+template <typename Dtype>
+class InferenceRequest<Dtype>::sync {
+ public:
+  mutable boost::mutex mutex_;
+  boost::condition_variable done_;
+};
+
+template <typename Dtype>
+InferenceRequest<Dtype>::InferenceRequest(
+    const vector<shared_ptr<Blob<Dtype> > >& inputs)
+    : inputs_(inputs), submitted_(0), started_(0), finished_(0), done_(false),
+      sync_(new sync()) {}
+
+template <typename Dtype>
+void InferenceRequest<Dtype>::Wait() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (!done_) {
+    sync_->done_.wait(lock);
+  }
+}
+
+template <typename Dtype>
+bool InferenceRequest<Dtype>::done() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return done_;
+}
+
+template <typename Dtype>
+void InferenceRequest<Dtype>::Finish() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    done_ = true;
+  }
+  sync_->done_.notify_all();
+}
+
+template <typename Dtype>
+class InferenceServer<Dtype>::sync {
+ public:
+  // Guards the stats.
+  mutable boost::mutex mutex_;
+};
+
+template <typename Dtype>
+InferenceServer<Dtype>::InferenceServer(const NetParameter& param,
+    const string& weights, int replicas, int first_core,
+    int threads_per_replica)
+    : sync_(new sync()), total_latency_ms_(0), total_queue_ms_(0) {
+  CHECK_GE(replicas, 1) << "An inference server needs at least one replica.";
+  NetParameter net_param(param);
+  net_param.mutable_state()->set_phase(TEST);
+  for (int i = 0; i < replicas; ++i) {
+    nets_.push_back(shared_ptr<Net<Dtype> >(new Net<Dtype>(net_param)));
+    if (i == 0) {
+      nets_[0]->CopyTrainedLayersFrom(weights);
+    } else {
+      nets_[i]->ShareTrainedLayersWith(nets_[0].get());
+    }
+  }
+  // The first read of a blob in a mode copies it there, without a lock, so
+  // the shared parameters are synced before the workers read them at once.
+  const vector<shared_ptr<Blob<Dtype> > >& params = nets_[0]->params();
+  for (int i = 0; i < params.size(); ++i) {
+    if (Caffe::mode() == Caffe::GPU) {
+      params[i]->gpu_data();
+    } else {
+      params[i]->cpu_data();
+    }
+  }
+  int device = 0;
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaGetDevice(&device));
+#endif
+  const int cores = std::max(1U, boost::thread::hardware_concurrency());
+  try {
+    for (int i = 0; i < replicas; ++i) {
+      const int core = first_core < 0 ? -1 : (first_core + i) % cores;
+      threads_.push_back(shared_ptr<boost::thread>(new boost::thread(
+          boost::bind(&InferenceServer::Entry, this, i, device, Caffe::mode(),
+                      core, threads_per_replica))));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+  LOG(INFO) << "Serving " << nets_[0]->name() << " with " << replicas
+      << " replicas";
+}
+
+template <typename Dtype>
+InferenceServer<Dtype>::~InferenceServer() {
+  for (int i = 0; i < threads_.size(); ++i) {
+    queue_.push(shared_ptr<InferenceRequest<Dtype> >());
+  }
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+template <typename Dtype>
+shared_ptr<InferenceRequest<Dtype> > InferenceServer<Dtype>::Submit(
+    const vector<shared_ptr<Blob<Dtype> > >& inputs) {
+  CHECK_EQ(inputs.size(), nets_[0]->input_blobs().size())
+      << "A request takes one blob per input of the net.";
+  shared_ptr<InferenceRequest<Dtype> > request(
+      new InferenceRequest<Dtype>(inputs));
+  request->submitted_ = Now();
+  queue_.push(request);
+  return request;
+}
+
+template <typename Dtype>
+shared_ptr<InferenceRequest<Dtype> > InferenceServer<Dtype>::Run(
+    const vector<shared_ptr<Blob<Dtype> > >& inputs) {
+  shared_ptr<InferenceRequest<Dtype> > request = Submit(inputs);
+  request->Wait();
+  return request;
+}
+
+template <typename Dtype>
+InferenceStats InferenceServer<Dtype>::stats() const {
+  InferenceStats stats;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stats = stats_;
+    if (stats.requests > 0) {
+      stats.mean_latency_ms = total_latency_ms_ / stats.requests;
+      stats.mean_queue_ms = total_queue_ms_ / stats.requests;
+    }
+  }
+  stats.queue_depth = queue_.size();
+  return stats;
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::Entry(int worker, int device, Caffe::Brew mode,
+    int core, int threads) {
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaSetDevice(device));
+#endif
+  Caffe::set_mode(mode);
+  if (core >= 0) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+      LOG(WARNING) << "Could not pin inference worker " << worker
+          << " to core " << core;
+    }
+#else
+    LOG(WARNING) << "Inference workers can only be pinned on Linux.";
+#endif
+  }
+  if (threads > 0) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+#ifdef USE_MKL
+    mkl_set_num_threads_local(threads);
+#elif defined(USE_OPENBLAS)
+    openblas_set_num_threads(threads);
+#endif
+  }
+  Net<Dtype>* net = nets_[worker].get();
+  for (;;) {
+    shared_ptr<InferenceRequest<Dtype> > request = queue_.pop();
+    if (!request) {
+      return;
+    }
+    Serve(net, request.get());
+  }
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::Serve(Net<Dtype>* net,
+    InferenceRequest<Dtype>* request) {
+  request->started_ = Now();
+  const vector<Blob<Dtype>*>& input_blobs = net->input_blobs();
+  for (int i = 0; i < input_blobs.size(); ++i) {
+    input_blobs[i]->CopyFrom(*request->inputs_[i], false, true);
+  }
+  const vector<Blob<Dtype>*>& output_blobs = net->Forward();
+  request->outputs_.resize(output_blobs.size());
+  for (int i = 0; i < output_blobs.size(); ++i) {
+    request->outputs_[i].reset(new Blob<Dtype>());
+    request->outputs_[i]->CopyFrom(*output_blobs[i], false, true);
+  }
+  request->finished_ = Now();
+  // The stats count the request before it is done, so that they include it
+  // once Wait returns.
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    ++stats_.requests;
+    total_latency_ms_ += request->latency_ms();
+    total_queue_ms_ += request->queue_ms();
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms,
+                                     request->latency_ms());
+  }
+  request->Finish();
+}
+
+INSTANTIATE_CLASS(InferenceRequest);
+INSTANTIATE_CLASS(InferenceServer);
+
+}  // namespace caffe
@@ -8,14 +8,27 @@
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/clip_layer.hpp"
+#include "caffe/layers/concat_layer.hpp"
+#include "caffe/layers/conv_dw_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/layers/eltwise_layer.hpp"
+#include "caffe/layers/fused_lstm_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/int8_concat_layer.hpp"
+#include "caffe/layers/int8_conv_dw_layer.hpp"
+#include "caffe/layers/int8_conv_layer.hpp"
+#include "caffe/layers/int8_eltwise_layer.hpp"
+#include "caffe/layers/int8_inner_product_layer.hpp"
+#include "caffe/layers/int8_pooling_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
+#include "caffe/layers/lstm_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
 #include "caffe/layers/sigmoid_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #ifdef USE_CUDNN
@@ -36,10 +49,19 @@
 
 namespace caffe {
 
+// Whether the layer runs on the INT8 engine: the engine "INT8", which layers
+// inherit from their net, on a layer having a quantization_param.
+static bool UseInt8Engine(const LayerParameter& param) {
+  return param.engine() == "INT8" && param.has_quantization_param();
+}
+
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(
     const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(new Int8ConvolutionLayer<Dtype>(param));
+  }
   ConvolutionParameter conv_param = param.convolution_param();
   ConvolutionParameter_Engine engine = conv_param.engine();
 #ifdef USE_CUDNN
@@ -50,6 +72,12 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
     }
   }
 #endif
+  // The engine "WINOGRAD", which layers inherit from their net, selects it
+  // for the convolutions that leave their own engine to the default.
+  if (engine == ConvolutionParameter_Engine_DEFAULT
+      && param.engine() == "WINOGRAD") {
+    engine = ConvolutionParameter_Engine_WINOGRAD;
+  }
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
 #ifdef USE_CUDNN
@@ -60,6 +88,9 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     if (use_dilation) {
@@ -76,6 +107,30 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
 
+// Get depthwise convolution layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetConvolutionDepthwiseLayer(
+    const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(
+        new Int8ConvolutionDepthwiseLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new ConvolutionDepthwiseLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(ConvolutionDepthwise, GetConvolutionDepthwiseLayer);
+
+// Get inner product layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetInnerProductLayer(const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(new Int8InnerProductLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new InnerProductLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(InnerProduct, GetInnerProductLayer);
+
 // Get deconvolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetDeconvolutionLayer(const LayerParameter& param) {
@@ -118,6 +173,9 @@ REGISTER_LAYER_CREATOR(Deconvolution, GetDeconvolutionLayer);
 // Get pooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(new Int8PoolingLayer<Dtype>(param));
+  }
   PoolingParameter_Engine engine = param.pooling_param().engine();
   if (engine == PoolingParameter_Engine_DEFAULT) {
     engine = PoolingParameter_Engine_CAFFE;
@@ -153,6 +211,28 @@ shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
 
 REGISTER_LAYER_CREATOR(Pooling, GetPoolingLayer);
 
+// Get eltwise layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetEltwiseLayer(const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(new Int8EltwiseLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new EltwiseLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(Eltwise, GetEltwiseLayer);
+
+// Get concat layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetConcatLayer(const LayerParameter& param) {
+  if (UseInt8Engine(param)) {
+    return shared_ptr<Layer<Dtype> >(new Int8ConcatLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new ConcatLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(Concat, GetConcatLayer);
+
 // Get LRN layer according to engine
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetLRNLayer(const LayerParameter& param) {
@@ -287,6 +367,25 @@ shared_ptr<Layer<Dtype> > GetTanHLayer(const LayerParameter& param) {
 
 REGISTER_LAYER_CREATOR(TanH, GetTanHLayer);
 
+// Get LSTM layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetLSTMLayer(const LayerParameter& param) {
+  RecurrentParameter_Engine engine = param.recurrent_param().engine();
+  if (engine == RecurrentParameter_Engine_DEFAULT) {
+    engine = RecurrentParameter_Engine_UNROLLED;
+  }
+  if (engine == RecurrentParameter_Engine_UNROLLED) {
+    return shared_ptr<Layer<Dtype> >(new LSTMLayer<Dtype>(param));
+  } else if (engine == RecurrentParameter_Engine_FUSED) {
+    return shared_ptr<Layer<Dtype> >(new FusedLSTMLayer<Dtype>(param));
+  } else {
+    LOG(FATAL) << "Layer " << param.name() << " has unknown engine.";
+    throw;  // Avoids missing return warning
+  }
+}
+
+REGISTER_LAYER_CREATOR(LSTM, GetLSTMLayer);
+
 #ifdef WITH_PYTHON_LAYER
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPythonLayer(const LayerParameter& param) {
@@ -0,0 +1,278 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/data_transformer.hpp"
+#include "caffe/layers/annotated_data_layer.hpp"
+#include "caffe/util/bbox_util.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/im_transforms.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/sampler.hpp"
+
+namespace caffe {
+
+using google::protobuf::RepeatedPtrField;
+
+template <typename Dtype>
+AnnotatedDataLayer<Dtype>::AnnotatedDataLayer(const LayerParameter& param)
+  : BasePrefetchingDataLayer<Dtype>(param),
+    reader_(param) {
+}
+
+template <typename Dtype>
+AnnotatedDataLayer<Dtype>::~AnnotatedDataLayer() {
+  this->StopInternalThread();
+}
+
+// Decodes the image of a datum the way DataTransformer does.
+static cv::Mat DecodeItem(const Datum& datum,
+                          const TransformationParameter& param) {
+  if (!datum.encoded()) {
+    return DatumToCVMat(datum);
+  }
+  CHECK(!(param.force_color() && param.force_gray()))
+      << "cannot set both force_color and force_gray";
+  if (param.force_color() || param.force_gray()) {
+    // If force_color then decode in color otherwise decode in gray.
+    return DecodeDatumToCVMat(datum, param.force_color());
+  }
+  return DecodeDatumToCVMatNative(datum);
+}
+
+template <typename Dtype>
+void AnnotatedDataLayer<Dtype>::DataLayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int batch_size = this->layer_param_.data_param().batch_size();
+  const AnnotatedDataParameter& anno_data_param =
+      this->layer_param_.annotated_data_param();
+  const TransformationParameter& transform_param =
+      this->layer_param_.transform_param();
+  for (int i = 0; i < anno_data_param.batch_sampler_size(); ++i) {
+    batch_samplers_.push_back(anno_data_param.batch_sampler(i));
+  }
+
+  // Read a data point, and use it to initialize the top blob.
+  AnnotatedDatum anno_datum;
+  anno_datum.ParseFromString(*(reader_.full().peek()));
+  has_anno_type_ = anno_datum.has_type() || anno_data_param.has_anno_type();
+  anno_type_ = anno_data_param.has_anno_type() ?
+      anno_data_param.anno_type() : anno_datum.type();
+  if (has_anno_type_) {
+    CHECK_EQ(anno_type_, AnnotatedDatum_AnnotationType_BBOX)
+        << "Unknown annotation type.";
+  }
+
+  // Items have the channels of the image and the size of the last crop or
+  // resize applied to it.
+  const cv::Mat cv_img = DecodeItem(anno_datum.datum(), transform_param);
+  vector<int> top_shape(4, 1);
+  top_shape[1] = cv_img.channels();
+  top_shape[2] = cv_img.rows;
+  top_shape[3] = cv_img.cols;
+  if (transform_param.has_resize_param()) {
+    top_shape[2] = transform_param.resize_param().height();
+    top_shape[3] = transform_param.resize_param().width();
+  }
+  if (transform_param.crop_size()) {
+    top_shape[2] = transform_param.crop_size();
+    top_shape[3] = transform_param.crop_size();
+  }
+
+  int threads = anno_data_param.threads();
+  if (threads == 0) {
+    threads = std::max(1u, boost::thread::hardware_concurrency());
+  }
+  pool_.reset(new ThreadPool(threads));
+  for (int i = 0; i < threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(transform_param, this->phase_)));
+    item_data_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(top_shape)));
+  }
+  seed_rng_.reset(new Caffe::RNG(caffe_rng_rand()));
+  items_.resize(batch_size);
+  seeds_.resize(batch_size);
+
+  // Reshape top[0] and prefetch_data according to the batch_size.
+  top_shape[0] = batch_size;
+  top[0]->Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "output data size: " << top[0]->num() << ","
+      << top[0]->channels() << "," << top[0]->height() << ","
+      << top[0]->width() << ", " << threads << " threads";
+  // label
+  if (this->output_labels_) {
+    vector<int> label_shape(1, batch_size);
+    if (has_anno_type_) {
+      // The number of boxes varies, each batch reshapes the label.
+      label_shape.resize(4, 1);
+      label_shape[0] = 1;
+      label_shape[3] = 8;
+    }
+    top[1]->Reshape(label_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(label_shape);
+    }
+  }
+}
+
+// This function is called on prefetch thread
+template<typename Dtype>
+void AnnotatedDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  CPUTimer batch_timer;
+  batch_timer.Start();
+  CPUTimer timer;
+  CHECK(batch->data_.count());
+  const int batch_size = this->layer_param_.data_param().batch_size();
+
+  // Read the records, and draw the seed of each item.
+  timer.Start();
+  caffe::rng_t* seed_rng = static_cast<caffe::rng_t*>(seed_rng_->generator());
+  DLOG(INFO) << "Records read ahead: " << reader_.queue_depth() << " of "
+      << reader_.queue_capacity();
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    string* data = reader_.full().pop("Waiting for data");
+    items_[item_id].ParseFromString(*data);
+    reader_.free().push(data);
+    seeds_[item_id] = (*seed_rng)();
+  }
+  const double read_time = timer.MicroSeconds();
+
+  // Decode and augment the items in parallel. Allocate the batch here, the
+  // workers only write to their slots.
+  timer.Start();
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  pool_->Run(batch_size, boost::bind(&AnnotatedDataLayer<Dtype>::LoadItem,
+                                     this, top_data, _1, _2));
+  const double trans_time = timer.MicroSeconds();
+
+  if (this->output_labels_ && !has_anno_type_) {
+    Dtype* top_label = batch->label_.mutable_cpu_data();
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      top_label[item_id] = items_[item_id].datum().label();
+    }
+  } else if (this->output_labels_) {
+    int num_bboxes = 0;
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      const AnnotatedDatum& anno_datum = items_[item_id];
+      for (int g = 0; g < anno_datum.annotation_group_size(); ++g) {
+        num_bboxes += anno_datum.annotation_group(g).annotation_size();
+      }
+    }
+    vector<int> label_shape(4, 1);
+    label_shape[2] = std::max(num_bboxes, 1);
+    label_shape[3] = 8;
+    batch->label_.Reshape(label_shape);
+    Dtype* top_label = batch->label_.mutable_cpu_data();
+    if (num_bboxes == 0) {
+      // Store all -1 in the label.
+      caffe_set<Dtype>(8, -1, top_label);
+    }
+    int idx = 0;
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      const AnnotatedDatum& anno_datum = items_[item_id];
+      for (int g = 0; g < anno_datum.annotation_group_size(); ++g) {
+        const AnnotationGroup& anno_group = anno_datum.annotation_group(g);
+        for (int a = 0; a < anno_group.annotation_size(); ++a) {
+          const Annotation& anno = anno_group.annotation(a);
+          const NormalizedBBox& bbox = anno.bbox();
+          top_label[idx++] = item_id;
+          top_label[idx++] = anno_group.group_label();
+          top_label[idx++] = anno.instance_id();
+          top_label[idx++] = bbox.xmin();
+          top_label[idx++] = bbox.ymin();
+          top_label[idx++] = bbox.xmax();
+          top_label[idx++] = bbox.ymax();
+          top_label[idx++] = bbox.difficult();
+        }
+      }
+    }
+  }
+  batch_timer.Stop();
+  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+}
+
+// This function is called on the workers of pool_
+template<typename Dtype>
+void AnnotatedDataLayer<Dtype>::LoadItem(Dtype* top_data, int item_id,
+                                         int worker) {
+  // Draw all random numbers of the item from its own seed.
+  Caffe::RNG item_rng(seeds_[item_id]);
+  Caffe::rng_stream() = item_rng;
+  DataTransformer<Dtype>* transformer = transformers_[worker].get();
+  transformer->InitRand();
+  const TransformationParameter& transform_param =
+      this->layer_param_.transform_param();
+
+  AnnotatedDatum& anno_datum = items_[item_id];
+  RepeatedPtrField<AnnotationGroup>* groups =
+      anno_datum.mutable_annotation_group();
+  RepeatedPtrField<AnnotationGroup> transformed_groups;
+  cv::Mat cv_img = DecodeItem(anno_datum.datum(), transform_param);
+  if (transform_param.has_distort_param()) {
+    cv_img = ApplyDistort(cv_img, transform_param.distort_param());
+  }
+  if (transform_param.has_expand_param()) {
+    cv::Mat expand_img;
+    NormalizedBBox expand_bbox;
+    transformer->ExpandImage(cv_img, &expand_img, &expand_bbox);
+    transformer->TransformAnnotation(*groups, cv_img.cols, cv_img.rows,
+        false, expand_bbox, false, &transformed_groups);
+    groups->Swap(&transformed_groups);
+    cv_img = expand_img;
+  }
+  if (batch_samplers_.size() > 0) {
+    // Crop the image to one of the boxes satisfying a sampler.
+    vector<NormalizedBBox> sampled_bboxes;
+    GenerateBatchSamples(anno_datum, batch_samplers_, &sampled_bboxes);
+    if (sampled_bboxes.size() > 0) {
+      const int rand_idx = caffe_rng_rand() % sampled_bboxes.size();
+      NormalizedBBox crop_bbox;
+      ClipBBox(sampled_bboxes[rand_idx], &crop_bbox);
+      cv::Mat crop_img;
+      transformer->CropImage(cv_img, crop_bbox, &crop_img);
+      transformer->TransformAnnotation(*groups, cv_img.cols, cv_img.rows,
+          false, crop_bbox, false, &transformed_groups);
+      groups->Swap(&transformed_groups);
+      cv_img = crop_img;
+    }
+  }
+  const int img_width = cv_img.cols;
+  const int img_height = cv_img.rows;
+  if (transform_param.has_resize_param()) {
+    cv_img = ApplyResize(cv_img, transform_param.resize_param());
+  }
+
+  // Apply data transformations (mirror, scale, crop...) into the slot.
+  Blob<Dtype>* item_data = item_data_[worker].get();
+  item_data->set_cpu_data(top_data + item_id * item_data->count());
+  NormalizedBBox crop_bbox;
+  bool do_mirror;
+  transformer->Transform(cv_img, item_data, &crop_bbox, &do_mirror);
+  if (has_anno_type_) {
+    transformer->TransformAnnotation(*groups, img_width, img_height,
+        transform_param.has_resize_param(), crop_bbox, do_mirror,
+        &transformed_groups);
+    groups->Swap(&transformed_groups);
+  }
+}
+
+INSTANTIATE_CLASS(AnnotatedDataLayer);
+REGISTER_LAYER_CLASS(AnnotatedData);
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -14,6 +14,7 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
+  fused_activation_ = FusedActivation(this->layer_param_);
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = channel_axis_ + 1;
   const int num_axes = bottom[0]->num_axes();
@@ -240,6 +241,25 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   col_buffer_.Reshape(col_buffer_shape_);
+  // Within col_buffer_budget, the forward pass may instead lay the columns of
+  // several images side by side and take them in one gemm per group.
+  im2col_batch_ = 1;
+  const uint64_t budget =
+      this->layer_param_.convolution_param().col_buffer_budget();
+  if (budget > 0 && !reverse_dimensions()) {
+    const uint64_t image_bytes = static_cast<uint64_t>(kernel_dim_ * group_
+        + conv_out_channels_) * conv_out_spatial_dim_ * sizeof(Dtype);
+    im2col_batch_ = static_cast<int>(std::min<uint64_t>(num_,
+        std::max<uint64_t>(1, budget / image_bytes)));
+  }
+  if (im2col_batch_ > 1) {
+    vector<int> batch_shape(2);
+    batch_shape[0] = kernel_dim_ * group_;
+    batch_shape[1] = im2col_batch_ * conv_out_spatial_dim_;
+    batch_col_buffer_.Reshape(batch_shape);
+    batch_shape[0] = conv_out_channels_;
+    batch_output_buffer_.Reshape(batch_shape);
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -280,6 +300,60 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    int images, const Dtype* weights, const Dtype* bias, Dtype* output) {
+  CHECK_LE(images, im2col_batch_);
+  const int spatial_dim = conv_out_spatial_dim_;
+  const int width = images * spatial_dim;
+  const int rows = kernel_dim_ * group_;
+  Dtype* col_buff = batch_col_buffer_.mutable_cpu_data();
+  for (int n = 0; n < images; ++n) {
+    const Dtype* image = input + n * bottom_dim_;
+    if (!is_1x1_ && !force_nd_im2col_ && num_spatial_axes_ == 2) {
+      im2col_strided_cpu(image, conv_in_channels_,
+          conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+          kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+          pad_.cpu_data()[0], pad_.cpu_data()[1],
+          stride_.cpu_data()[0], stride_.cpu_data()[1],
+          dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+          width, col_buff + n * spatial_dim);
+      continue;
+    }
+    if (!is_1x1_) {
+      conv_im2col_cpu(image, col_buffer_.mutable_cpu_data());
+      image = col_buffer_.cpu_data();
+    }
+    for (int r = 0; r < rows; ++r) {
+      caffe_copy(spatial_dim, image + r * spatial_dim,
+          col_buff + r * width + n * spatial_dim);
+    }
+  }
+  const int group_outputs = conv_out_channels_ / group_;
+  Dtype* products = batch_output_buffer_.mutable_cpu_data();
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_outputs, width,
+        kernel_dim_, (Dtype)1., weights + weight_offset_ * g,
+        col_buff + kernel_dim_ * width * g, (Dtype)0.,
+        products + group_outputs * width * g);
+  }
+  for (int n = 0; n < images; ++n) {
+    for (int o = 0; o < conv_out_channels_; ++o) {
+      const Dtype* product = products + o * width + n * spatial_dim;
+      Dtype* out = output + n * top_dim_ + o * spatial_dim;
+      if (bias) {
+        const Dtype b = bias[o];
+        for (int s = 0; s < spatial_dim; ++s) {
+          out[s] = product[s] + b;
+        }
+      } else {
+        caffe_copy(spatial_dim, product, out);
+      }
+      fused_activation_.Forward_cpu(spatial_dim, out);
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
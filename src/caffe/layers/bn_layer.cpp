@@ -13,6 +13,11 @@ void BNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   frozen_ = this->layer_param_.bn_param().frozen();
   bn_momentum_ = this->layer_param_.bn_param().momentum();
   bn_eps_ = this->layer_param_.bn_param().eps();
+  inference_ =
+      this->layer_param_.bn_param().bn_mode() == BNParameter_BNMode_INFERENCE;
+  fuse_relu_ = this->layer_param_.batch_norm_param().relu();
+  CHECK(inference_ || !fuse_relu_)
+      << "A fused ReLU is only supported in INFERENCE mode.";
   // Initialize parameters
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -95,6 +100,10 @@ void BNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   width_ = bottom[0]->width();
 
   top[0]->ReshapeLike(*(bottom[0]));
+  // The inference path is a single per-channel affine pass without buffers.
+  if (inference_) {
+    return;
+  }
 
   broadcast_buffer_.ReshapeLike(*(bottom[0]));
   spatial_statistic_.Reshape(num_, channels_, 1, 1);
@@ -122,31 +131,27 @@ void BNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* shift_data = this->blobs_[1]->cpu_data();
 
 
-  if (this->layer_param_.bn_param().bn_mode() == BNParameter_BNMode_INFERENCE) {
-      // scale
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_, channels_, 1, Dtype(1),
-          batch_sum_multiplier_.cpu_data(), scale_data, Dtype(0),
-          spatial_statistic_.mutable_cpu_data());
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_ * channels_,
-          height_ * width_, 1, Dtype(1),
-          spatial_statistic_.cpu_data(),
-          spatial_sum_multiplier_.cpu_data(), Dtype(0),
-          broadcast_buffer_.mutable_cpu_data());
-      caffe_mul(broadcast_buffer_.count(), const_bottom_data,
-          broadcast_buffer_.cpu_data(), top_data);
-
-      // shift
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_, channels_, 1, Dtype(1),
-          batch_sum_multiplier_.cpu_data(), shift_data, Dtype(0),
-          spatial_statistic_.mutable_cpu_data());
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
-          num_ * channels_, height_ * width_, 1, Dtype(1),
-          spatial_statistic_.cpu_data(),
-          spatial_sum_multiplier_.cpu_data(), Dtype(0),
-          broadcast_buffer_.mutable_cpu_data());
-      caffe_add(broadcast_buffer_.count(), const_top_data,
-          broadcast_buffer_.cpu_data(), top_data);
-      return;
+  if (inference_) {
+    const int spatial_dim = height_ * width_;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int nc = 0; nc < num_ * channels_; ++nc) {
+      const Dtype scale = scale_data[nc % channels_];
+      const Dtype shift = shift_data[nc % channels_];
+      const Dtype* x = const_bottom_data + nc * spatial_dim;
+      Dtype* y = top_data + nc * spatial_dim;
+      if (fuse_relu_) {
+        for (int i = 0; i < spatial_dim; ++i) {
+          y[i] = std::max(x[i] * scale + shift, Dtype(0));
+        }
+      } else {
+        for (int i = 0; i < spatial_dim; ++i) {
+          y[i] = x[i] * scale + shift;
+        }
+      }
+    }
+    return;
   }
 
   // Mean normalization
@@ -260,6 +265,9 @@ void BNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  // Reshape does not size the statistics buffers in INFERENCE mode.
+  CHECK(!inference_) << "BN layer " << this->layer_param_.name()
+      << " has no backward pass in INFERENCE mode.";
   if (frozen_) {
     if (propagate_down[0]) {
       const Dtype* const_top_diff = top[0]->cpu_diff();
@@ -4,8 +4,212 @@
 #include "caffe/layers/conv_dw_layer.hpp"
 #include "caffe/util/math_functions.hpp"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_CONV_DW_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 namespace caffe {
 
+namespace {
+
+struct DepthwiseGeometry {
+  int bottom_height, bottom_width;
+  int top_height, top_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+  int dilation_h, dilation_w;
+};
+
+// Bounds checked sum over the taps of top pixel (h, w), without bias.
+template <typename Dtype>
+inline Dtype DepthwisePixel(const DepthwiseGeometry& g, const Dtype* bottom,
+    const Dtype* weight, const int h, const int w) {
+  Dtype value = 0;
+  for (int kh = 0; kh < g.kernel_h; ++kh) {
+    const int h_in = -g.pad_h + h * g.stride_h + kh * g.dilation_h;
+    if (h_in < 0 || h_in >= g.bottom_height) {
+      continue;
+    }
+    for (int kw = 0; kw < g.kernel_w; ++kw) {
+      const int w_in = -g.pad_w + w * g.stride_w + kw * g.dilation_w;
+      if (w_in >= 0 && w_in < g.bottom_width) {
+        value += weight[kh * g.kernel_w + kw]
+            * bottom[h_in * g.bottom_width + w_in];
+      }
+    }
+  }
+  return value;
+}
+
+#ifdef CAFFE_CONV_DW_X86_KERNELS
+// The row kernels below compute top[w] for w in [w_begin, w_end), where
+// every tap of a KxK window with stride S lies inside the bottom. bottom
+// points at the first of the K bottom rows. They return the first column
+// left for the scalar loop.
+
+template <int K, int S>
+__attribute__((target("avx2,fma")))
+int DepthwiseRowAVX2(const float* bottom, const int bottom_width,
+    const int pad_w, const float* weight, const float bias,
+    const int w_begin, const int w_end, float* top) {
+  // With stride 2 each step loads one column past the last tap.
+  const int vec_end = S == 1 ? w_end : w_end - 1;
+  const __m256 bias_v = _mm256_set1_ps(bias);
+  int w = w_begin;
+  for (; w + 8 <= vec_end; w += 8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int kh = 0; kh < K; ++kh) {
+      const float* row = bottom + kh * bottom_width + w * S - pad_w;
+      for (int kw = 0; kw < K; ++kw) {
+        __m256 x;
+        if (S == 1) {
+          x = _mm256_loadu_ps(row + kw);
+        } else {
+          const __m256 even = _mm256_shuffle_ps(_mm256_loadu_ps(row + kw),
+              _mm256_loadu_ps(row + kw + 8), _MM_SHUFFLE(2, 0, 2, 0));
+          x = _mm256_castpd_ps(_mm256_permute4x64_pd(
+              _mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(weight[kh * K + kw]), x, acc);
+      }
+    }
+    _mm256_storeu_ps(top + w, _mm256_add_ps(acc, bias_v));
+  }
+  return w;
+}
+
+template <int K, int S>
+__attribute__((target("avx512f")))
+int DepthwiseRowAVX512(const float* bottom, const int bottom_width,
+    const int pad_w, const float* weight, const float bias,
+    const int w_begin, const int w_end, float* top) {
+  const int vec_end = S == 1 ? w_end : w_end - 1;
+  const __m512 bias_v = _mm512_set1_ps(bias);
+  const __m512i even_idx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+      16, 18, 20, 22, 24, 26, 28, 30);
+  int w = w_begin;
+  for (; w + 16 <= vec_end; w += 16) {
+    __m512 acc = _mm512_setzero_ps();
+    for (int kh = 0; kh < K; ++kh) {
+      const float* row = bottom + kh * bottom_width + w * S - pad_w;
+      for (int kw = 0; kw < K; ++kw) {
+        __m512 x;
+        if (S == 1) {
+          x = _mm512_loadu_ps(row + kw);
+        } else {
+          x = _mm512_permutex2var_ps(_mm512_loadu_ps(row + kw), even_idx,
+              _mm512_loadu_ps(row + kw + 16));
+        }
+        acc = _mm512_fmadd_ps(_mm512_set1_ps(weight[kh * K + kw]), x, acc);
+      }
+    }
+    _mm512_storeu_ps(top + w, _mm512_add_ps(acc, bias_v));
+  }
+  return w;
+}
+
+enum DepthwiseISA { DW_ISA_SCALAR, DW_ISA_AVX2, DW_ISA_AVX512 };
+
+DepthwiseISA GetDepthwiseISA() {
+  static const DepthwiseISA isa = __builtin_cpu_supports("avx512f") ?
+      DW_ISA_AVX512 : (__builtin_cpu_supports("avx2")
+      && __builtin_cpu_supports("fma")) ? DW_ISA_AVX2 : DW_ISA_SCALAR;
+  return isa;
+}
+#endif  // CAFFE_CONV_DW_X86_KERNELS
+
+template <int K, int S>
+int DepthwiseRowSIMD(const float* bottom, const int bottom_width,
+    const int pad_w, const float* weight, const float bias,
+    const int w_begin, const int w_end, float* top) {
+#ifdef CAFFE_CONV_DW_X86_KERNELS
+  switch (GetDepthwiseISA()) {
+  case DW_ISA_AVX512:
+    return DepthwiseRowAVX512<K, S>(bottom, bottom_width, pad_w, weight,
+        bias, w_begin, w_end, top);
+  case DW_ISA_AVX2:
+    return DepthwiseRowAVX2<K, S>(bottom, bottom_width, pad_w, weight,
+        bias, w_begin, w_end, top);
+  default:
+    break;
+  }
+#endif
+  return w_begin;
+}
+
+template <int K, int S>
+int DepthwiseRowSIMD(const double* bottom, const int bottom_width,
+    const int pad_w, const double* weight, const double bias,
+    const int w_begin, const int w_end, double* top) {
+  return w_begin;
+}
+
+// KxK, stride S, undilated depthwise convolution of one channel. Padding is
+// only checked on the border rows and columns; the interior of each row goes
+// through the SIMD kernels, then an unrolled scalar loop.
+template <typename Dtype, int K, int S>
+void DepthwisePlane(const DepthwiseGeometry& g, const Dtype* bottom,
+    const Dtype* weight, const Dtype bias, Dtype* top) {
+  const int w_begin = std::min(g.top_width, (g.pad_w + S - 1) / S);
+  const int w_end = std::max(w_begin, g.bottom_width + g.pad_w < K ? 0 :
+      std::min(g.top_width, (g.bottom_width + g.pad_w - K) / S + 1));
+  for (int h = 0; h < g.top_height; ++h) {
+    Dtype* top_row = top + h * g.top_width;
+    const int h_in = h * S - g.pad_h;
+    if (h_in < 0 || h_in + K > g.bottom_height) {
+      for (int w = 0; w < g.top_width; ++w) {
+        top_row[w] = DepthwisePixel(g, bottom, weight, h, w) + bias;
+      }
+      continue;
+    }
+    for (int w = 0; w < w_begin; ++w) {
+      top_row[w] = DepthwisePixel(g, bottom, weight, h, w) + bias;
+    }
+    const Dtype* bottom_rows = bottom + h_in * g.bottom_width;
+    int w = DepthwiseRowSIMD<K, S>(bottom_rows, g.bottom_width, g.pad_w,
+        weight, bias, w_begin, w_end, top_row);
+    for (; w < w_end; ++w) {
+      const Dtype* window = bottom_rows + w * S - g.pad_w;
+      Dtype value = 0;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          value += weight[kh * K + kw] * window[kh * g.bottom_width + kw];
+        }
+      }
+      top_row[w] = value + bias;
+    }
+    for (w = w_end; w < g.top_width; ++w) {
+      top_row[w] = DepthwisePixel(g, bottom, weight, h, w) + bias;
+    }
+  }
+}
+
+template <typename Dtype>
+void DepthwisePlane(const DepthwiseGeometry& g, const Dtype* bottom,
+    const Dtype* weight, const Dtype bias, Dtype* top) {
+  if (g.kernel_h == g.kernel_w && g.stride_h == g.stride_w
+      && g.dilation_h == 1 && g.dilation_w == 1) {
+    if (g.kernel_h == 3 && g.stride_h == 1) {
+      return DepthwisePlane<Dtype, 3, 1>(g, bottom, weight, bias, top);
+    } else if (g.kernel_h == 3 && g.stride_h == 2) {
+      return DepthwisePlane<Dtype, 3, 2>(g, bottom, weight, bias, top);
+    } else if (g.kernel_h == 5 && g.stride_h == 1) {
+      return DepthwisePlane<Dtype, 5, 1>(g, bottom, weight, bias, top);
+    } else if (g.kernel_h == 5 && g.stride_h == 2) {
+      return DepthwisePlane<Dtype, 5, 2>(g, bottom, weight, bias, top);
+    }
+  }
+  for (int h = 0; h < g.top_height; ++h) {
+    for (int w = 0; w < g.top_width; ++w) {
+      *top++ = DepthwisePixel(g, bottom, weight, h, w) + bias;
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -85,6 +289,7 @@ void ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(
     }
   }
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  fused_activation_ = FusedActivation(this->layer_param_);
 }
 
 template <typename Dtype>
@@ -135,52 +340,37 @@ void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const int num = top[0]->num();
   const int channels = top[0]->channels();
-  const int top_height = top[0]->height();
-  const int top_width = top[0]->width();
-  const int bottom_height = bottom[0]->height();
-  const int bottom_width = bottom[0]->width();
+  DepthwiseGeometry geometry;
+  geometry.bottom_height = bottom[0]->height();
+  geometry.bottom_width = bottom[0]->width();
+  geometry.top_height = top[0]->height();
+  geometry.top_width = top[0]->width();
+  geometry.kernel_h = kernel_h_;
+  geometry.kernel_w = kernel_w_;
+  geometry.stride_h = stride_h_;
+  geometry.stride_w = stride_w_;
+  geometry.pad_h = pad_h_;
+  geometry.pad_w = pad_w_;
+  geometry.dilation_h = dilation_h_;
+  geometry.dilation_w = dilation_w_;
+  const int bottom_dim = geometry.bottom_height * geometry.bottom_width;
+  const int top_dim = geometry.top_height * geometry.top_width;
+  const int kernel_dim = kernel_h_ * kernel_w_;
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* weight_data_base = this->blobs_[0]->cpu_data();
+  const Dtype* weight_data = this->blobs_[0]->cpu_data();
+  const Dtype* bias_data =
+      this->layer_param_.convolution_param().bias_term() ?
+      this->blobs_[1]->cpu_data() : NULL;
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < num; ++n) {
-    for (int c = 0; c < channels; ++c) {
-      for (int h = 0; h < top_height; ++h) {
-        for (int w = 0; w < top_width; ++w) {
-          const Dtype* weight_data = weight_data_base
-                + c * kernel_h_ * kernel_w_;
-          Dtype value = 0;
-          for (int kh = 0; kh < kernel_h_; ++kh) {
-            for (int kw = 0; kw < kernel_w_; ++kw) {
-              int h_in = -pad_h_ + h * stride_h_ + kh * dilation_h_;
-              int w_in = -pad_w_ + w * stride_w_ + kw * dilation_w_;
-              if ((h_in >= 0) && (h_in < bottom_height)
-                    && (w_in >= 0) && (w_in < bottom_width)) {
-                int offset = ((n * channels + c) * bottom_height + h_in)
-                      * bottom_width + w_in;
-                value += (*weight_data) * bottom_data[offset];
-              }
-              ++weight_data;
-            }
-          }
-          *top_data++ = value;
-        }
-      }
-    }
-  }
-  if (this->layer_param_.convolution_param().bias_term()) {
-    top_data = top[0]->mutable_cpu_data();
-    for (int n = 0; n < num; ++n) {
-      const Dtype* bias_data = this->blobs_[1]->cpu_data();
-      for (int c = 0; c < channels; ++c) {
-        for (int h = 0; h < top_height; ++h) {
-          for (int w = 0; w < top_width; ++w) {
-            *top_data += *bias_data;
-            ++top_data;
-          }
-        }
-        ++bias_data;
-      }
-    }
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int nc = 0; nc < num * channels; ++nc) {
+    const int c = nc % channels;
+    DepthwisePlane(geometry, bottom_data + nc * bottom_dim,
+        weight_data + c * kernel_dim, bias_data ? bias_data[c] : Dtype(0),
+        top_data + nc * top_dim);
+    fused_activation_.Forward_cpu(top_dim, top_data + nc * top_dim);
   }
 }
 
@@ -275,6 +465,5 @@ STUB_GPU(ConvolutionDepthwiseLayer);
 #endif
 
 INSTANTIATE_CLASS(ConvolutionDepthwiseLayer);
-REGISTER_LAYER_CLASS(ConvolutionDepthwise);
 
 }  // namespace caffe
\ No newline at end of file
@@ -49,6 +49,9 @@ __global__ void ConvolutionDepthwiseBiasForward(const int nthreads,
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_gpu(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK(!fused_activation_.enabled()) << "Layer "
+      << this->layer_param_.name() << " has an activation fused on the CPU; "
+      << "build the net in GPU mode to run it on the GPU.";
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   const Dtype* weight_data = this->blobs_[0]->gpu_data();
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -28,6 +29,16 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
+    if (this->im2col_batch_ > 1) {
+      const Dtype* bias =
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+      for (int n = 0; n < this->num_; n += this->im2col_batch_) {
+        this->forward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+            std::min(this->im2col_batch_, this->num_ - n), weight, bias,
+            top_data + n * this->top_dim_);
+      }
+      continue;
+    }
     for (int n = 0; n < this->num_; ++n) {
       this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
           top_data + n * this->top_dim_);
@@ -35,6 +46,8 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
+      this->fused_activation_.Forward_cpu(this->top_dim_,
+          top_data + n * this->top_dim_);
     }
   }
 }
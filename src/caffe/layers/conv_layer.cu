@@ -7,6 +7,9 @@ namespace caffe {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  CHECK(!this->fused_activation_.enabled()) << "Layer "
+      << this->layer_param_.name() << " has an activation fused on the CPU; "
+      << "build the net in GPU mode to run it on the GPU.";
   const Dtype* weight = this->blobs_[0]->gpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->gpu_data();
@@ -217,6 +217,12 @@ void DetectionOutputLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       << "Number of priors must match number of location predictions.";
   CHECK_EQ(num_priors_ * num_classes_, bottom[1]->channels())
       << "Number of priors must match number of confidence predictions.";
+  const int num = bottom[0]->num();
+  score_index_.resize(num * num_priors_);
+  decode_bboxes_.resize(num * num_priors_ * 5);
+  nms_indices_.resize(num);
+  kept_bboxes_.resize(num);
+  kept_score_index_.resize(num);
   // num() and channels() are 1.
   vector<int> top_shape(2, 1);
   // Since the number of bboxes to be kept is unknown before nms, we manually
@@ -228,6 +234,130 @@ void DetectionOutputLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top[0]->Reshape(top_shape);
 }
 
+// Orders the candidates by descending score, and by prior for equal scores
+// like the stable sort of GetMaxScoreIndex.
+static bool SortCandidateDescend(const pair<float, int>& pair1,
+                                 const pair<float, int>& pair2) {
+  return pair1.first > pair2.first ||
+      (pair1.first == pair2.first && pair1.second < pair2.second);
+}
+
+template <typename Dtype>
+int DetectionOutputLayer<Dtype>::DetectImage(int i, const Dtype* loc_data,
+    const Dtype* conf_data, const Dtype* prior_data) {
+  pair<float, int>* score_index = &score_index_[i * num_priors_];
+  float* xmin = &decode_bboxes_[i * num_priors_ * 5];
+  float* ymin = xmin + num_priors_;
+  float* xmax = ymin + num_priors_;
+  float* ymax = xmax + num_priors_;
+  float* size = ymax + num_priors_;
+  vector<int>& indices = nms_indices_[i];
+  vector<float>& kept_bboxes = kept_bboxes_[i];
+  kept_bboxes.clear();
+  const Dtype* image_conf_data = conf_data + i * num_priors_ * num_classes_;
+  for (int c = 0; c < num_classes_; ++c) {
+    if (c == background_label_id_) {
+      // Ignore background class.
+      continue;
+    }
+    // Keep the top_k predictions above the confidence threshold.
+    int num_sel = 0;
+    for (int p = 0; p < num_priors_; ++p) {
+      const float score = image_conf_data[p * num_classes_ + c];
+      if (score > confidence_threshold_) {
+        score_index[num_sel++] = std::make_pair(score, p);
+      }
+    }
+    if (top_k_ > -1 && top_k_ < num_sel) {
+      std::partial_sort(score_index, score_index + top_k_,
+                        score_index + num_sel, SortCandidateDescend);
+      num_sel = top_k_;
+    } else {
+      std::sort(score_index, score_index + num_sel, SortCandidateDescend);
+    }
+    if (num_sel == 0) {
+      continue;
+    }
+    // Decode them only.
+    const int loc_class = share_location_ ? 0 : c;
+    for (int k = 0; k < num_sel; ++k) {
+      const int p = score_index[k].second;
+      float bbox[4];
+      DecodeBBox(prior_data + p * 4, prior_data + (num_priors_ + p) * 4,
+                 code_type_, variance_encoded_in_target_,
+                 loc_data + ((i * num_priors_ + p) * num_loc_classes_ +
+                             loc_class) * 4, bbox);
+      xmin[k] = bbox[0];
+      ymin[k] = bbox[1];
+      xmax[k] = bbox[2];
+      ymax[k] = bbox[3];
+      size[k] = BBoxSize(bbox);
+    }
+    if (eta_ >= 1) {
+      ApplyNMSFlat(xmin, ymin, xmax, ymax, size, num_sel, nms_threshold_,
+                   &indices);
+    } else {
+      // The threshold adapts to the kept bboxes.
+      float adaptive_threshold = nms_threshold_;
+      indices.clear();
+      for (int k = 0; k < num_sel; ++k) {
+        bool keep = true;
+        for (int n = 0; n < indices.size() && keep; ++n) {
+          const int kept = indices[n];
+          const float w = std::min(xmax[k], xmax[kept]) -
+              std::max(xmin[k], xmin[kept]);
+          const float h = std::min(ymax[k], ymax[kept]) -
+              std::max(ymin[k], ymin[kept]);
+          if (w > 0 && h > 0) {
+            const float inter = w * h;
+            keep = inter / (size[k] + size[kept] - inter) <=
+                adaptive_threshold;
+          }
+        }
+        if (keep) {
+          indices.push_back(k);
+          if (adaptive_threshold > 0.5) {
+            adaptive_threshold *= eta_;
+          }
+        }
+      }
+    }
+    for (int n = 0; n < indices.size(); ++n) {
+      const int k = indices[n];
+      kept_bboxes.push_back(c);
+      kept_bboxes.push_back(score_index[k].first);
+      kept_bboxes.push_back(xmin[k]);
+      kept_bboxes.push_back(ymin[k]);
+      kept_bboxes.push_back(xmax[k]);
+      kept_bboxes.push_back(ymax[k]);
+    }
+  }
+  int num_det = kept_bboxes.size() / 6;
+  if (keep_top_k_ > -1 && num_det > keep_top_k_) {
+    // Keep top k results per image, in the order of their label.
+    vector<pair<float, int> >& kept_score_index = kept_score_index_[i];
+    kept_score_index.resize(num_det);
+    for (int n = 0; n < num_det; ++n) {
+      kept_score_index[n] = std::make_pair(kept_bboxes[n * 6 + 1], n);
+    }
+    std::partial_sort(kept_score_index.begin(),
+                      kept_score_index.begin() + keep_top_k_,
+                      kept_score_index.end(), SortCandidateDescend);
+    indices.resize(keep_top_k_);
+    for (int n = 0; n < keep_top_k_; ++n) {
+      indices[n] = kept_score_index[n].second;
+    }
+    std::sort(indices.begin(), indices.end());
+    for (int n = 0; n < keep_top_k_; ++n) {
+      std::copy(&kept_bboxes[indices[n] * 6], &kept_bboxes[indices[n] * 6] + 6,
+                &kept_bboxes[n * 6]);
+    }
+    kept_bboxes.resize(keep_top_k_ * 6);
+    num_det = keep_top_k_;
+  }
+  return num_det;
+}
+
 template <typename Dtype>
 void DetectionOutputLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -236,103 +366,12 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
   const Dtype* prior_data = bottom[2]->cpu_data();
   const int num = bottom[0]->num();
 
-  // Retrieve all location predictions.
-  vector<LabelBBox> all_loc_preds;
-  GetLocPredictions(loc_data, num, num_priors_, num_loc_classes_,
-                    share_location_, &all_loc_preds);
-
-  // Retrieve all confidences.
-  vector<map<int, vector<float> > > all_conf_scores;
-  GetConfidenceScores(conf_data, num, num_priors_, num_classes_,
-                      &all_conf_scores);
-
-  // Retrieve all prior bboxes. It is same within a batch since we assume all
-  // images in a batch are of same dimension.
-  vector<NormalizedBBox> prior_bboxes(num_priors_);
-  vector<vector<float> > prior_variances(num_priors_);
-  GetPriorBBoxes(prior_data, num_priors_, &prior_bboxes, &prior_variances);
-
-  // Decode all loc predictions to bboxes.
-  vector<LabelBBox> all_decode_bboxes;
-  const bool clip_bbox = false;
-  DecodeBBoxesAll(all_loc_preds, prior_bboxes, prior_variances, num,
-                  share_location_, num_loc_classes_, background_label_id_,
-                  code_type_, variance_encoded_in_target_, clip_bbox,
-                  &all_decode_bboxes);
-
   int num_kept = 0;
-  vector<map<int, vector<int> > > all_indices(num);
 #ifdef _OPENMP
-  #pragma omp parallel for
+  #pragma omp parallel for reduction(+:num_kept)
 #endif
   for (int i = 0; i < num; ++i) {
-    const LabelBBox& decode_bboxes = all_decode_bboxes[i];
-    const map<int, vector<float> >& conf_scores = all_conf_scores[i];
-    map<int, vector<int> > indices;
-    int num_det = 0;
-    for (int c = 0; c < num_classes_; ++c) {
-      if (c == background_label_id_) {
-        // Ignore background class.
-        continue;
-      }
-      if (conf_scores.find(c) == conf_scores.end()) {
-        // Something bad happened if there are no predictions for current label.
-        LOG(FATAL) << "Could not find confidence predictions for label " << c;
-      }
-      const vector<float>& scores = conf_scores.find(c)->second;
-      int label = share_location_ ? -1 : c;
-      if (decode_bboxes.find(label) == decode_bboxes.end()) {
-        // Something bad happened if there are no predictions for current label.
-        LOG(FATAL) << "Could not find location predictions for label " << label;
-        continue;
-      }
-      const vector<NormalizedBBox>& bboxes = decode_bboxes.find(label)->second;
-      ApplyNMSFast(bboxes, scores, confidence_threshold_, nms_threshold_, eta_,
-          top_k_, &(indices[c]));
-      num_det += indices[c].size();
-    }
-    // Temporary variable for critical section
-    int num_to_add = 0;
-    if (keep_top_k_ > -1 && num_det > keep_top_k_) {
-      vector<pair<float, pair<int, int> > > score_index_pairs;
-      for (map<int, vector<int> >::iterator it = indices.begin();
-           it != indices.end(); ++it) {
-        int label = it->first;
-        const vector<int>& label_indices = it->second;
-        if (conf_scores.find(label) == conf_scores.end()) {
-          // Something bad happened for current label.
-          LOG(FATAL) << "Could not find location predictions for " << label;
-          continue;
-        }
-        const vector<float>& scores = conf_scores.find(label)->second;
-        for (int j = 0; j < label_indices.size(); ++j) {
-          int idx = label_indices[j];
-          CHECK_LT(idx, scores.size());
-          score_index_pairs.push_back(std::make_pair(
-                  scores[idx], std::make_pair(label, idx)));
-        }
-      }
-      // Keep top k results per image.
-      std::sort(score_index_pairs.begin(), score_index_pairs.end(),
-                SortScorePairDescend<pair<int, int> >);
-      score_index_pairs.resize(keep_top_k_);
-      // Store the new indices.
-      map<int, vector<int> > new_indices;
-      for (int j = 0; j < score_index_pairs.size(); ++j) {
-        int label = score_index_pairs[j].second.first;
-        int idx = score_index_pairs[j].second.second;
-        new_indices[label].push_back(idx);
-      }
-      all_indices[i] = new_indices;
-      num_to_add = keep_top_k_;
-    } else {
-      all_indices[i] = indices;
-      num_to_add = num_det;
-    }
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-    num_kept += num_to_add;
+    num_kept += DetectImage(i, loc_data, conf_data, prior_data);
   }
 
   vector<int> top_shape(2, 1);
@@ -358,76 +397,60 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
   int count = 0;
   boost::filesystem::path output_directory(output_directory_);
   for (int i = 0; i < num; ++i) {
-    const map<int, vector<float> >& conf_scores = all_conf_scores[i];
-    const LabelBBox& decode_bboxes = all_decode_bboxes[i];
-    for (map<int, vector<int> >::iterator it = all_indices[i].begin();
-         it != all_indices[i].end(); ++it) {
-      int label = it->first;
-      if (conf_scores.find(label) == conf_scores.end()) {
-        // Something bad happened if there are no predictions for current label.
-        LOG(FATAL) << "Could not find confidence predictions for " << label;
-        continue;
-      }
-      const vector<float>& scores = conf_scores.find(label)->second;
-      int loc_label = share_location_ ? -1 : label;
-      if (decode_bboxes.find(loc_label) == decode_bboxes.end()) {
-        // Something bad happened if there are no predictions for current label.
-        LOG(FATAL) << "Could not find location predictions for " << loc_label;
-        continue;
-      }
-      const vector<NormalizedBBox>& bboxes =
-          decode_bboxes.find(loc_label)->second;
-      vector<int>& indices = it->second;
+    const vector<float>& kept_bboxes = kept_bboxes_[i];
+    for (int k = 0; k < kept_bboxes.size(); k += 6) {
+      const float* det = &kept_bboxes[k];
+      const int label = det[0];
       if (need_save_) {
         CHECK(label_to_name_.find(label) != label_to_name_.end())
           << "Cannot find label: " << label << " in the label map.";
         CHECK_LT(name_count_, names_.size());
       }
-      for (int j = 0; j < indices.size(); ++j) {
-        int idx = indices[j];
-        top_data[count * 7] = i;
-        top_data[count * 7 + 1] = label;
-        top_data[count * 7 + 2] = scores[idx];
-        const NormalizedBBox& bbox = bboxes[idx];
-        top_data[count * 7 + 3] = bbox.xmin();
-        top_data[count * 7 + 4] = bbox.ymin();
-        top_data[count * 7 + 5] = bbox.xmax();
-        top_data[count * 7 + 6] = bbox.ymax();
-        if (need_save_) {
-          NormalizedBBox out_bbox;
-          OutputBBox(bbox, sizes_[name_count_], has_resize_, resize_param_,
-                     &out_bbox);
-          float score = top_data[count * 7 + 2];
-          float xmin = out_bbox.xmin();
-          float ymin = out_bbox.ymin();
-          float xmax = out_bbox.xmax();
-          float ymax = out_bbox.ymax();
-          ptree pt_xmin, pt_ymin, pt_width, pt_height;
-          pt_xmin.put<float>("", round(xmin * 100) / 100.);
-          pt_ymin.put<float>("", round(ymin * 100) / 100.);
-          pt_width.put<float>("", round((xmax - xmin) * 100) / 100.);
-          pt_height.put<float>("", round((ymax - ymin) * 100) / 100.);
-
-          ptree cur_bbox;
-          cur_bbox.push_back(std::make_pair("", pt_xmin));
-          cur_bbox.push_back(std::make_pair("", pt_ymin));
-          cur_bbox.push_back(std::make_pair("", pt_width));
-          cur_bbox.push_back(std::make_pair("", pt_height));
+      top_data[count * 7] = i;
+      top_data[count * 7 + 1] = label;
+      top_data[count * 7 + 2] = det[1];
+      top_data[count * 7 + 3] = det[2];
+      top_data[count * 7 + 4] = det[3];
+      top_data[count * 7 + 5] = det[4];
+      top_data[count * 7 + 6] = det[5];
+      if (need_save_) {
+        NormalizedBBox bbox, out_bbox;
+        bbox.set_xmin(det[2]);
+        bbox.set_ymin(det[3]);
+        bbox.set_xmax(det[4]);
+        bbox.set_ymax(det[5]);
+        OutputBBox(bbox, sizes_[name_count_], has_resize_, resize_param_,
+                   &out_bbox);
+        float score = top_data[count * 7 + 2];
+        float xmin = out_bbox.xmin();
+        float ymin = out_bbox.ymin();
+        float xmax = out_bbox.xmax();
+        float ymax = out_bbox.ymax();
+        ptree pt_xmin, pt_ymin, pt_width, pt_height;
+        pt_xmin.put<float>("", round(xmin * 100) / 100.);
+        pt_ymin.put<float>("", round(ymin * 100) / 100.);
+        pt_width.put<float>("", round((xmax - xmin) * 100) / 100.);
+        pt_height.put<float>("", round((ymax - ymin) * 100) / 100.);
 
-          ptree cur_det;
-          cur_det.put("image_id", names_[name_count_]);
-          if (output_format_ == "ILSVRC") {
-            cur_det.put<int>("category_id", label);
-          } else {
-            cur_det.put("category_id", label_to_name_[label].c_str());
-          }
-          cur_det.add_child("bbox", cur_bbox);
-          cur_det.put<float>("score", score);
+        ptree cur_bbox;
+        cur_bbox.push_back(std::make_pair("", pt_xmin));
+        cur_bbox.push_back(std::make_pair("", pt_ymin));
+        cur_bbox.push_back(std::make_pair("", pt_width));
+        cur_bbox.push_back(std::make_pair("", pt_height));
 
-          detections_.push_back(std::make_pair("", cur_det));
+        ptree cur_det;
+        cur_det.put("image_id", names_[name_count_]);
+        if (output_format_ == "ILSVRC") {
+          cur_det.put<int>("category_id", label);
+        } else {
+          cur_det.put("category_id", label_to_name_[label].c_str());
         }
-        ++count;
+        cur_det.add_child("bbox", cur_bbox);
+        cur_det.put<float>("score", score);
+
+        detections_.push_back(std::make_pair("", cur_det));
       }
+      ++count;
     }
     if (need_save_) {
       ++name_count_;
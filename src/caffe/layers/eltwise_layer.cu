@@ -33,6 +33,9 @@ __global__ void MaxForward(const int nthreads, const Dtype* bottom_data_a,
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  CHECK(!fused_activation_.enabled()) << "Layer "
+      << this->layer_param_.name() << " has an activation fused on the CPU; "
+      << "build the net in GPU mode to run it on the GPU.";
   int* mask = NULL;
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_gpu_data();
@@ -24,6 +24,9 @@ void FlattenLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   top[0]->Reshape(top_shape);
   CHECK_EQ(top[0]->count(), bottom[0]->count());
+  // Share the data at Reshape too, so that the Net sees the top aliasing the
+  // bottom before any forward pass (see Net::PlanActivationMemory).
+  top[0]->ShareData(*bottom[0]);
 }
 
 template <typename Dtype>
@@ -0,0 +1,354 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/filler.hpp"
+#include "caffe/layers/fused_lstm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The same functions as the LSTMUnitLayer, for the same outputs.
+template <typename Dtype>
+inline Dtype sigmoid(Dtype x) {
+  return 1. / (1. + exp(-x));
+}
+
+template <typename Dtype>
+inline Dtype tanh(Dtype x) {
+  return 2. * sigmoid(2. * x) - 1.;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void FusedLSTMLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const RecurrentParameter& recurrent_param =
+      this->layer_param_.recurrent_param();
+  hidden_dim_ = recurrent_param.num_output();
+  CHECK_GT(hidden_dim_, 0) << "num_output must be positive";
+  CHECK_GE(bottom[0]->num_axes(), 2)
+      << "bottom[0] must have at least 2 axes -- (#timesteps, #streams, ...)";
+  input_dim_ = bottom[0]->count(2);
+  expose_hidden_ = recurrent_param.expose_hidden();
+  static_input_ = (bottom.size() > 2 + 2 * expose_hidden_);
+  static_dim_ = 0;
+  if (static_input_) {
+    CHECK_GE(bottom[2]->num_axes(), 1);
+    static_dim_ = bottom[2]->count(1);
+  }
+  // The parameters are those of the unrolled net of LSTMLayer, in the same
+  // order and filled in the same order: W_xc, b_c, W_xc_static and W_hc.
+  if (this->blobs_.size() > 0) {
+    LOG(INFO) << "Skipping parameter initialization";
+  } else {
+    this->blobs_.resize(3 + static_input_);
+    shared_ptr<Filler<Dtype> > weight_filler(
+        GetFiller<Dtype>(recurrent_param.weight_filler()));
+    shared_ptr<Filler<Dtype> > bias_filler(
+        GetFiller<Dtype>(recurrent_param.bias_filler()));
+    vector<int> weight_shape(2);
+    weight_shape[0] = 4 * hidden_dim_;
+    weight_shape[1] = input_dim_;
+    this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
+    weight_filler->Fill(this->blobs_[0].get());
+    vector<int> bias_shape(1, 4 * hidden_dim_);
+    this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
+    bias_filler->Fill(this->blobs_[1].get());
+    if (static_input_) {
+      weight_shape[1] = static_dim_;
+      this->blobs_[2].reset(new Blob<Dtype>(weight_shape));
+      weight_filler->Fill(this->blobs_[2].get());
+    }
+    weight_shape[1] = hidden_dim_;
+    this->blobs_[2 + static_input_].reset(new Blob<Dtype>(weight_shape));
+    weight_filler->Fill(this->blobs_[2 + static_input_].get());
+  }
+  this->param_propagate_down_.resize(this->blobs_.size(), true);
+}
+
+template <typename Dtype>
+void FusedLSTMLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_GE(bottom[0]->num_axes(), 2)
+      << "bottom[0] must have at least 2 axes -- (#timesteps, #streams, ...)";
+  T_ = bottom[0]->shape(0);
+  N_ = bottom[0]->shape(1);
+  CHECK_EQ(input_dim_, bottom[0]->count(2))
+      << "Input size incompatible with LSTM parameters.";
+  CHECK_EQ(bottom[1]->num_axes(), 2)
+      << "bottom[1] must have exactly 2 axes -- (#timesteps, #streams)";
+  CHECK_EQ(T_, bottom[1]->shape(0));
+  CHECK_EQ(N_, bottom[1]->shape(1));
+  if (static_input_) {
+    CHECK_EQ(N_, bottom[2]->shape(0));
+    CHECK_EQ(static_dim_, bottom[2]->count(1))
+        << "Static input size incompatible with LSTM parameters.";
+  }
+  vector<int> shape(3);
+  shape[0] = T_;
+  shape[1] = N_;
+  shape[2] = hidden_dim_;
+  top[0]->Reshape(shape);
+  cell_.Reshape(shape);
+  h_conted_.Reshape(shape);
+  shape[2] = 4 * hidden_dim_;
+  gates_.Reshape(shape);
+  shape[0] = 1;
+  hidden_gates_.Reshape(shape);
+  if (static_input_) {
+    static_gates_.Reshape(shape);
+  }
+  shape[2] = hidden_dim_;
+  h_0_.Reshape(shape);
+  c_0_.Reshape(shape);
+  h_T_.Reshape(shape);
+  c_T_.Reshape(shape);
+  if (expose_hidden_) {
+    const int bottom_offset = 2 + static_input_;
+    for (int i = bottom_offset; i < bottom.size(); ++i) {
+      CHECK(bottom[i]->shape() == shape)
+          << "shape mismatch - expected initial state of shape "
+          << h_0_.shape_string() << " vs. bottom[" << i << "]: "
+          << bottom[i]->shape_string();
+    }
+    top[1]->Reshape(shape);
+    top[2]->Reshape(shape);
+  }
+  vector<int> multiplier_shape(1, T_ * N_);
+  if (bias_multiplier_.shape() != multiplier_shape) {
+    bias_multiplier_.Reshape(multiplier_shape);
+    caffe_set(T_ * N_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void FusedLSTMLayer<Dtype>::Reset() {
+  caffe_set(h_T_.count(), Dtype(0), h_T_.mutable_cpu_data());
+  caffe_set(c_T_.count(), Dtype(0), c_T_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+vector<Blob<Dtype>*> FusedLSTMLayer<Dtype>::RecurrentState() {
+  vector<Blob<Dtype>*> state;
+  if (!expose_hidden_) {
+    state.push_back(&h_T_);
+    state.push_back(&c_T_);
+  }
+  return state;
+}
+
+template <typename Dtype>
+void FusedLSTMLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int H = hidden_dim_;
+  const int step = N_ * H;
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* W_xc = this->blobs_[0]->cpu_data();
+  const Dtype* W_hc = this->blobs_[2 + static_input_]->cpu_data();
+  Dtype* gates = gates_.mutable_cpu_data();
+  Dtype* cell = cell_.mutable_cpu_data();
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  Dtype* hidden_gates = hidden_gates_.mutable_cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+
+  // W_xc * x + b_c for all the timesteps at once.
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T_ * N_, 4 * H, input_dim_,
+      (Dtype)1., bottom[0]->cpu_data(), W_xc, (Dtype)0., gates);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T_ * N_, 4 * H, 1,
+      (Dtype)1., bias_multiplier_.cpu_data(), this->blobs_[1]->cpu_data(),
+      (Dtype)1., gates);
+  const Dtype* static_gates = NULL;
+  if (static_input_) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N_, 4 * H, static_dim_,
+        (Dtype)1., bottom[2]->cpu_data(), this->blobs_[2]->cpu_data(),
+        (Dtype)0., static_gates_.mutable_cpu_data());
+    static_gates = static_gates_.cpu_data();
+  }
+
+  // Start from the given state, or from where the previous batch ended.
+  if (expose_hidden_) {
+    caffe_copy(step, bottom[2 + static_input_]->cpu_data(),
+        h_0_.mutable_cpu_data());
+    caffe_copy(step, bottom[3 + static_input_]->cpu_data(),
+        c_0_.mutable_cpu_data());
+  } else {
+    caffe_copy(step, h_T_.cpu_data(), h_0_.mutable_cpu_data());
+    caffe_copy(step, c_T_.cpu_data(), c_0_.mutable_cpu_data());
+  }
+
+  for (int t = 0; t < T_; ++t) {
+    const Dtype* h_prev = t ? top_data + (t - 1) * step : h_0_.cpu_data();
+    const Dtype* c_prev = t ? cell + (t - 1) * step : c_0_.cpu_data();
+    Dtype* h_conted_t = h_conted + t * step;
+    for (int n = 0; n < N_; ++n) {
+      caffe_cpu_scale(H, cont[t * N_ + n], h_prev + n * H,
+          h_conted_t + n * H);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N_, 4 * H, H, (Dtype)1.,
+        h_conted_t, W_hc, (Dtype)0., hidden_gates);
+    // The gate inputs are summed in the order of the unrolled net, then
+    // replaced by the activations needed by the backward pass.
+    Dtype* X = gates + t * 4 * step;
+    Dtype* C = cell + t * step;
+    Dtype* h = top_data + t * step;
+    for (int n = 0; n < N_; ++n) {
+      const Dtype cont_t = cont[t * N_ + n];
+      const Dtype* hidden_x = hidden_gates + n * 4 * H;
+      const Dtype* static_x = static_input_ ? static_gates + n * 4 * H : NULL;
+      for (int j = 0; j < 4 * H; ++j) {
+        X[j] = hidden_x[j] + X[j];
+        if (static_input_) {
+          X[j] += static_x[j];
+        }
+      }
+      for (int d = 0; d < H; ++d) {
+        const Dtype i = sigmoid(X[d]);
+        const Dtype f = (cont_t == 0) ? 0 :
+            (cont_t * sigmoid(X[1 * H + d]));
+        const Dtype o = sigmoid(X[2 * H + d]);
+        const Dtype g = tanh(X[3 * H + d]);
+        const Dtype c = f * c_prev[n * H + d] + i * g;
+        X[d] = i;
+        X[1 * H + d] = f;
+        X[2 * H + d] = o;
+        X[3 * H + d] = g;
+        C[d] = c;
+        h[d] = o * tanh(c);
+      }
+      X += 4 * H;
+      C += H;
+      h += H;
+    }
+  }
+
+  const Dtype* h_last = top_data + (T_ - 1) * step;
+  const Dtype* c_last = cell + (T_ - 1) * step;
+  if (expose_hidden_) {
+    caffe_copy(step, h_last, top[1]->mutable_cpu_data());
+    caffe_copy(step, c_last, top[2]->mutable_cpu_data());
+  } else {
+    caffe_copy(step, h_last, h_T_.mutable_cpu_data());
+    caffe_copy(step, c_last, c_T_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void FusedLSTMLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!propagate_down[1]) << "Cannot backpropagate to sequence indicators.";
+  const int H = hidden_dim_;
+  const int step = N_ * H;
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* gates = gates_.cpu_data();
+  const Dtype* cell = cell_.cpu_data();
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* W_hc = this->blobs_[2 + static_input_]->cpu_data();
+  Dtype* gates_diff = gates_.mutable_cpu_diff();
+  // The gradients w.r.t. h_{t-1} and c_{t-1}, coming back from timestep t.
+  // At the last timestep they come from the exposed final state, if any.
+  Dtype* h_diff = h_0_.mutable_cpu_diff();
+  Dtype* c_diff = c_0_.mutable_cpu_diff();
+  Dtype* h_conted_diff = h_conted_.mutable_cpu_diff();
+  if (expose_hidden_) {
+    caffe_copy(step, top[1]->cpu_diff(), h_diff);
+    caffe_copy(step, top[2]->cpu_diff(), c_diff);
+  } else {
+    caffe_set(step, Dtype(0), h_diff);
+    caffe_set(step, Dtype(0), c_diff);
+  }
+
+  for (int t = T_ - 1; t >= 0; --t) {
+    const Dtype* X = gates + t * 4 * step;
+    const Dtype* C = cell + t * step;
+    const Dtype* C_prev = t ? cell + (t - 1) * step : c_0_.cpu_data();
+    const Dtype* H_diff = top_diff + t * step;
+    Dtype* X_diff = gates_diff + t * 4 * step;
+    for (int n = 0; n < N_; ++n) {
+      for (int d = 0; d < H; ++d) {
+        const Dtype i = X[d];
+        const Dtype f = X[1 * H + d];
+        const Dtype o = X[2 * H + d];
+        const Dtype g = X[3 * H + d];
+        const Dtype tanh_c = tanh(C[d]);
+        const Dtype h_term_diff = H_diff[d] + h_diff[n * H + d];
+        const Dtype c_term_diff =
+            c_diff[n * H + d] + h_term_diff * o * (1 - tanh_c * tanh_c);
+        c_diff[n * H + d] = c_term_diff * f;
+        X_diff[d] = c_term_diff * g * i * (1 - i);
+        X_diff[1 * H + d] = c_term_diff * C_prev[d] * f * (1 - f);
+        X_diff[2 * H + d] = h_term_diff * tanh_c * o * (1 - o);
+        X_diff[3 * H + d] = c_term_diff * i * (1 - g * g);
+      }
+      X += 4 * H;
+      C += H;
+      C_prev += H;
+      H_diff += H;
+      X_diff += 4 * H;
+    }
+    Dtype* h_conted_diff_t = h_conted_diff + t * step;
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N_, H, 4 * H,
+        (Dtype)1., gates_diff + t * 4 * step, W_hc, (Dtype)0.,
+        h_conted_diff_t);
+    for (int n = 0; n < N_; ++n) {
+      caffe_cpu_scale(H, cont[t * N_ + n], h_conted_diff_t + n * H,
+          h_diff + n * H);
+    }
+  }
+
+  // The parameter gradients of all the timesteps at once.
+  if (this->param_propagate_down_[0]) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 4 * H, input_dim_,
+        T_ * N_, (Dtype)1., gates_diff, bottom[0]->cpu_data(), (Dtype)1.,
+        this->blobs_[0]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down_[1]) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, T_ * N_, 4 * H, (Dtype)1., gates_diff,
+        bias_multiplier_.cpu_data(), (Dtype)1.,
+        this->blobs_[1]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down_[2 + static_input_]) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 4 * H, H, T_ * N_,
+        (Dtype)1., gates_diff, h_conted_.cpu_data(), (Dtype)1.,
+        this->blobs_[2 + static_input_]->mutable_cpu_diff());
+  }
+  if (propagate_down[0]) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T_ * N_, input_dim_,
+        4 * H, (Dtype)1., gates_diff, this->blobs_[0]->cpu_data(), (Dtype)0.,
+        bottom[0]->mutable_cpu_diff());
+  }
+  if (static_input_ &&
+      (this->param_propagate_down_[2] || propagate_down[2])) {
+    // The static input feeds every timestep: sum its gate gradients first.
+    Dtype* static_diff = static_gates_.mutable_cpu_diff();
+    caffe_copy(4 * step, gates_diff, static_diff);
+    for (int t = 1; t < T_; ++t) {
+      caffe_axpy(4 * step, Dtype(1), gates_diff + t * 4 * step, static_diff);
+    }
+    if (this->param_propagate_down_[2]) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 4 * H, static_dim_, N_,
+          (Dtype)1., static_diff, bottom[2]->cpu_data(), (Dtype)1.,
+          this->blobs_[2]->mutable_cpu_diff());
+    }
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N_, static_dim_,
+          4 * H, (Dtype)1., static_diff, this->blobs_[2]->cpu_data(),
+          (Dtype)0., bottom[2]->mutable_cpu_diff());
+    }
+  }
+  if (expose_hidden_) {
+    const int bottom_offset = 2 + static_input_;
+    if (propagate_down[bottom_offset]) {
+      caffe_copy(step, h_diff, bottom[bottom_offset]->mutable_cpu_diff());
+    }
+    if (propagate_down[bottom_offset + 1]) {
+      caffe_copy(step, c_diff, bottom[bottom_offset + 1]->mutable_cpu_diff());
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FusedLSTMLayer);
+
+}  // namespace caffe
@@ -1,3 +1,7 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
@@ -79,9 +83,27 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
+  fixed_shape_ = new_height > 0 && new_width > 0;
+
+  int threads = this->layer_param_.image_data_param().threads();
+  if (threads == 0) {
+    threads = std::max(1u, boost::thread::hardware_concurrency());
+  }
+  pool_.reset(new ThreadPool(threads));
+  for (int i = 0; i < threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(this->transform_param_, this->phase_)));
+    item_data_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  decode_time_.resize(threads);
+  trans_time_.resize(threads);
+  seed_rng_.reset(new Caffe::RNG(caffe_rng_rand()));
+
   // Reshape prefetch_data and top[0] according to the batch_size.
   const int batch_size = this->layer_param_.image_data_param().batch_size();
   CHECK_GT(batch_size, 0) << "Positive batch size required";
+  items_.resize(batch_size);
+  seeds_.resize(batch_size);
   top_shape[0] = batch_size;
   for (int i = 0; i < this->prefetch_.size(); ++i) {
     this->prefetch_[i]->data_.Reshape(top_shape);
@@ -90,7 +112,7 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
   LOG(INFO) << "output data size: " << top[0]->num() << ","
       << top[0]->channels() << "," << top[0]->height() << ","
-      << top[0]->width();
+      << top[0]->width() << ", " << threads << " threads";
   // label
   vector<int> label_shape(1, batch_size);
   top[1]->Reshape(label_shape);
@@ -111,50 +133,20 @@ template <typename Dtype>
 void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
   batch_timer.Start();
-  double read_time = 0;
-  double trans_time = 0;
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
   ImageDataParameter image_data_param = this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
-  string root_folder = image_data_param.root_folder();
 
-  // Reshape according to the first image of each batch
-  // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-  // Use data_transformer to infer the expected blob shape from a cv_img.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
-  this->transformed_data_.Reshape(top_shape);
-  // Reshape batch according to the batch_size.
-  top_shape[0] = batch_size;
-  batch->data_.Reshape(top_shape);
-
-  Dtype* prefetch_data = batch->data_.mutable_cpu_data();
-  Dtype* prefetch_label = batch->label_.mutable_cpu_data();
-
-  // datum scales
+  // Pick the images, and draw the seed of each one.
+  caffe::rng_t* seed_rng = static_cast<caffe::rng_t*>(seed_rng_->generator());
   const int lines_size = lines_.size();
+  Dtype* prefetch_label = batch->label_.mutable_cpu_data();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a blob
-    timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply transformations (mirror, crop...) to the image
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
-    trans_time += timer.MicroSeconds();
-
+    items_[item_id] = lines_[lines_id_];
+    seeds_[item_id] = (*seed_rng)();
     prefetch_label[item_id] = lines_[lines_id_].second;
     // go to the next iter
     lines_id_++;
@@ -162,17 +154,92 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       // We have reached the end. Restart from the first.
       DLOG(INFO) << "Restarting data prefetching from start.";
       lines_id_ = 0;
-      if (this->layer_param_.image_data_param().shuffle()) {
+      if (image_data_param.shuffle()) {
         ShuffleImages();
       }
     }
   }
+
+  double first_time = 0;
+  if (!fixed_shape_) {
+    // Reshape according to the first image of each batch
+    // on single input batches allows for inputs of varying dimension.
+    timer.Start();
+    first_image_ = ReadImageToCVMat(
+        image_data_param.root_folder() + items_[0].first,
+        image_data_param.new_height(), image_data_param.new_width(),
+        image_data_param.is_color());
+    CHECK(first_image_.data) << "Could not load " << items_[0].first;
+    first_time = timer.MicroSeconds();
+    // Use data_transformer to infer the expected blob shape from a cv_img.
+    vector<int> top_shape =
+        this->data_transformer_->InferBlobShape(first_image_);
+    this->transformed_data_.Reshape(top_shape);
+    // Reshape batch according to the batch_size.
+    top_shape[0] = batch_size;
+    batch->data_.Reshape(top_shape);
+  }
+
+  // Decode and transform the images in parallel. Allocate the batch here, the
+  // workers only write to their slots.
+  std::fill(decode_time_.begin(), decode_time_.end(), 0);
+  std::fill(trans_time_.begin(), trans_time_.end(), 0);
+  timer.Start();
+  Dtype* prefetch_data = batch->data_.mutable_cpu_data();
+  pool_->Run(batch_size, boost::bind(&ImageDataLayer<Dtype>::LoadItem,
+                                     this, prefetch_data, _1, _2));
+  const double load_time = timer.MicroSeconds();
+  first_image_.release();
+
   batch_timer.Stop();
+  // The decode and transform times are summed over the threads.
+  double decode_time = first_time;
+  double trans_time = 0;
+  for (int i = 0; i < pool_->size(); ++i) {
+    decode_time += decode_time_[i];
+    trans_time += trans_time_[i];
+  }
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+  DLOG(INFO) << "     Load time: " << load_time / 1000 << " ms, "
+      << pool_->size() << " threads.";
+  DLOG(INFO) << "   Decode time: " << decode_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// This function is called on the workers of pool_
+template <typename Dtype>
+void ImageDataLayer<Dtype>::LoadItem(Dtype* top_data, int item_id,
+                                     int worker) {
+  CPUTimer timer;
+  timer.Start();
+  cv::Mat cv_img;
+  if (item_id == 0 && !fixed_shape_) {
+    cv_img = first_image_;
+  } else {
+    const ImageDataParameter& image_data_param =
+        this->layer_param_.image_data_param();
+    cv_img = ReadImageToCVMat(
+        image_data_param.root_folder() + items_[item_id].first,
+        image_data_param.new_height(), image_data_param.new_width(),
+        image_data_param.is_color());
+    CHECK(cv_img.data) << "Could not load " << items_[item_id].first;
+  }
+  decode_time_[worker] += timer.MicroSeconds();
+
+  // Draw all random numbers of the image from its own seed.
+  timer.Start();
+  Caffe::RNG item_rng(seeds_[item_id]);
+  Caffe::rng_stream() = item_rng;
+  DataTransformer<Dtype>* transformer = transformers_[worker].get();
+  transformer->InitRand();
+  // Apply transformations (mirror, crop...) to the image
+  Blob<Dtype>* item_data = item_data_[worker].get();
+  item_data->Reshape(this->transformed_data_.shape());
+  item_data->set_cpu_data(top_data + item_id * item_data->count());
+  transformer->Transform(cv_img, item_data);
+  trans_time_[worker] += timer.MicroSeconds();
+}
+
 INSTANTIATE_CLASS(ImageDataLayer);
 REGISTER_LAYER_CLASS(ImageData);
 
@@ -9,6 +9,9 @@ namespace caffe {
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  CHECK(!fused_activation_.enabled()) << "Layer "
+      << this->layer_param_.name() << " has an activation fused on the CPU; "
+      << "build the net in GPU mode to run it on the GPU.";
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   const Dtype* weight = this->blobs_[0]->gpu_data();
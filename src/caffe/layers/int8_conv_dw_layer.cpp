@@ -0,0 +1,90 @@
+#include <vector>
+
+#include "caffe/layers/int8_conv_dw_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(bottom, top);
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  CHECK_LE(param.bw_layer_in(), 8) << "The INT8 engine needs 8 bit inputs.";
+  CHECK_LE(param.bw_params(), 8) << "The INT8 engine needs 8 bit weights.";
+  QuantizationScaleIn(param, 0);
+  QuantizationScaleParams(param, 0);
+}
+
+template <typename Dtype>
+void Int8ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const float weight_scale = QuantizationScaleParams(param, 0);
+  if (!weights_quantized_ || this->phase_ == TRAIN) {
+    weights_.resize(this->blobs_[0]->count());
+    caffe_cpu_quantize(this->blobs_[0]->count(), this->blobs_[0]->cpu_data(),
+        weight_scale, QuantizedRange(param.bw_params(), false), &weights_[0]);
+    weights_quantized_ = true;
+  }
+  const QuantizedRange in_range(param.bw_layer_in(),
+                                QuantizedInputIsUnsigned(param));
+  const int offset = in_range.min < 0 ? 128 : 0;
+  const float in_scale = QuantizationScaleIn(param, 0);
+  const Dtype dequantize = Dtype(1) / (in_scale * weight_scale);
+  const int height = bottom[0]->height();
+  const int width = bottom[0]->width();
+  const int top_height = top[0]->height();
+  const int top_width = top[0]->width();
+  const int kernel_h = this->kernel_h_;
+  const int kernel_w = this->kernel_w_;
+  const Dtype* bias = this->layer_param_.convolution_param().bias_term() ?
+      this->blobs_[1]->cpu_data() : NULL;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  plane_.resize(height * width);
+  for (int n = 0; n < bottom[0]->num(); ++n) {
+    for (int c = 0; c < bottom[0]->channels(); ++c) {
+      caffe_cpu_quantize(height * width, bottom_data, in_scale, in_range,
+          offset, &plane_[0]);
+      const int8_t* weight = &weights_[c * kernel_h * kernel_w];
+      const Dtype b = bias ? bias[c] : Dtype(0);
+      for (int h = 0; h < top_height; ++h) {
+        for (int w = 0; w < top_width; ++w) {
+          int32_t sum = 0;
+          for (int kh = 0; kh < kernel_h; ++kh) {
+            const int h_in = h * static_cast<int>(this->stride_h_)
+                - static_cast<int>(this->pad_h_)
+                + kh * static_cast<int>(this->dilation_h_);
+            if (h_in < 0 || h_in >= height) {
+              continue;
+            }
+            for (int kw = 0; kw < kernel_w; ++kw) {
+              const int w_in = w * static_cast<int>(this->stride_w_)
+                  - static_cast<int>(this->pad_w_)
+                  + kw * static_cast<int>(this->dilation_w_);
+              if (w_in >= 0 && w_in < width) {
+                sum += weight[kh * kernel_w + kw]
+                    * (plane_[h_in * width + w_in] - offset);
+              }
+            }
+          }
+          *top_data++ = sum * dequantize + b;
+        }
+      }
+      this->fused_activation_.Forward_cpu(top_height * top_width,
+          top_data - top_height * top_width);
+      bottom_data += height * width;
+    }
+  }
+  if (QuantizesOutput(param)) {
+    caffe_cpu_fake_quantize(top[0]->count(), top[0]->cpu_data(),
+        QuantizationScaleOut(param, 0),
+        QuantizedRange(param.bw_layer_out(), false),
+        top[0]->mutable_cpu_data());
+  }
+}
+
+INSTANTIATE_CLASS(Int8ConvolutionDepthwiseLayer);
+
+}  // namespace caffe
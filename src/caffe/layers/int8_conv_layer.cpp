@@ -0,0 +1,140 @@
+#include <vector>
+
+#include "caffe/layers/int8_conv_layer.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::LayerSetUp(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  CHECK_LE(param.bw_layer_in(), 8) << "The INT8 engine needs 8 bit inputs.";
+  CHECK_LE(param.bw_params(), 8) << "The INT8 engine needs 8 bit weights.";
+  for (int i = 0; i < bottom.size(); ++i) {
+    QuantizationScaleIn(param, i);
+  }
+  QuantizationScaleParams(param, 0);
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int kernel_dim = this->blobs_[0]->count(1);
+  vector<int> col_shape(2);
+  col_shape[0] = kernel_dim * this->group_;
+  col_shape[1] = this->out_spatial_dim_;
+  col_data_.Reshape(col_shape);
+  col_quantized_.resize(GemmU8S8Stride(kernel_dim) * this->out_spatial_dim_);
+  products_.resize(this->num_output_ / this->group_ * this->out_spatial_dim_);
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::im2col(const Dtype* data,
+      Dtype* col_buff) {
+  if (!this->force_nd_im2col_ && this->num_spatial_axes_ == 2) {
+    im2col_cpu(data, this->channels_,
+        this->conv_input_shape_.cpu_data()[1],
+        this->conv_input_shape_.cpu_data()[2],
+        this->kernel_shape_.cpu_data()[0], this->kernel_shape_.cpu_data()[1],
+        this->pad_.cpu_data()[0], this->pad_.cpu_data()[1],
+        this->stride_.cpu_data()[0], this->stride_.cpu_data()[1],
+        this->dilation_.cpu_data()[0], this->dilation_.cpu_data()[1],
+        col_buff);
+  } else {
+    im2col_nd_cpu(data, this->num_spatial_axes_,
+        this->conv_input_shape_.cpu_data(), this->col_buffer_shape_.data(),
+        this->kernel_shape_.cpu_data(), this->pad_.cpu_data(),
+        this->stride_.cpu_data(), this->dilation_.cpu_data(), col_buff);
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::QuantizeWeights() {
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  const int kernel_dim = weights.count(1);
+  vector<int8_t> quantized(weights.count());
+  caffe_cpu_quantize(weights.count(), weights.cpu_data(),
+      QuantizationScaleParams(param, 0),
+      QuantizedRange(param.bw_params(), false), &quantized[0]);
+  weight_sums_.assign(weights.num(), 0);
+  for (int i = 0; i < weights.count(); ++i) {
+    weight_sums_[i / kernel_dim] += quantized[i];
+  }
+  const int group_outputs = this->num_output_ / this->group_;
+  const int packed_size = GemmU8S8PackedSize(group_outputs, kernel_dim);
+  weights_.resize(this->group_ * packed_size);
+  for (int g = 0; g < this->group_; ++g) {
+    caffe_cpu_pack_s8(group_outputs, kernel_dim,
+        &quantized[g * group_outputs * kernel_dim], &weights_[g * packed_size]);
+  }
+  weights_quantized_ = true;
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!weights_quantized_ || this->phase_ == TRAIN) {
+    QuantizeWeights();
+  }
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const QuantizedRange in_range(param.bw_layer_in(),
+                                QuantizedInputIsUnsigned(param));
+  // Signed inputs are stored with an offset in the unsigned GEMM operand,
+  // and the offset times the sum of the weights taken back from the products.
+  const int offset = in_range.min < 0 ? 128 : 0;
+  const float weight_scale = QuantizationScaleParams(param, 0);
+  const int kernel_dim = this->blobs_[0]->count(1);
+  const int spatial_dim = this->out_spatial_dim_;
+  const int group_outputs = this->num_output_ / this->group_;
+  const int packed_size = GemmU8S8PackedSize(group_outputs, kernel_dim);
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  for (int i = 0; i < bottom.size(); ++i) {
+    const float in_scale = QuantizationScaleIn(param, i);
+    const Dtype dequantize = Dtype(1) / (in_scale * weight_scale);
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      const Dtype* col = bottom_data + n * this->bottom_dim_;
+      if (!this->is_1x1_) {
+        im2col(col, col_data_.mutable_cpu_data());
+        col = col_data_.cpu_data();
+      }
+      for (int g = 0; g < this->group_; ++g) {
+        // The columns are quantized transposed, one row per output
+        // position, and the products come out the same way.
+        caffe_cpu_quantize_transposed(kernel_dim, spatial_dim,
+            col + g * kernel_dim * spatial_dim, in_scale, in_range, offset,
+            GemmU8S8Stride(kernel_dim), &col_quantized_[0]);
+        caffe_cpu_gemm_u8s8(group_outputs, spatial_dim, kernel_dim,
+            &weights_[g * packed_size], &col_quantized_[0], &products_[0]);
+        for (int o = 0; o < group_outputs; ++o) {
+          const int output = g * group_outputs + o;
+          const int32_t correction = offset * weight_sums_[output];
+          const Dtype b = bias ? bias[output] : Dtype(0);
+          const int32_t* product = &products_[o];
+          Dtype* out = top_data + n * this->top_dim_ + output * spatial_dim;
+          for (int s = 0; s < spatial_dim; ++s) {
+            out[s] = (product[s * group_outputs] - correction) * dequantize
+                + b;
+          }
+          this->fused_activation_.Forward_cpu(spatial_dim, out);
+        }
+      }
+    }
+    if (QuantizesOutput(param)) {
+      caffe_cpu_fake_quantize(top[i]->count(), top_data,
+          QuantizationScaleOut(param, i),
+          QuantizedRange(param.bw_layer_out(), false), top_data);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(Int8ConvolutionLayer);
+
+}  // namespace caffe
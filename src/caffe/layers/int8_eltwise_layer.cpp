@@ -0,0 +1,54 @@
+#include <vector>
+
+#include "caffe/layers/int8_eltwise_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8EltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  EltwiseLayer<Dtype>::LayerSetUp(bottom, top);
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  CHECK_LE(param.bw_layer_in(), 8) << "The INT8 engine needs 8 bit inputs.";
+  quantized_.clear();
+  quantized_vec_.clear();
+  for (int i = 0; i < bottom.size(); ++i) {
+    QuantizationScaleIn(param, i);
+    quantized_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    quantized_vec_.push_back(quantized_.back().get());
+  }
+}
+
+template <typename Dtype>
+void Int8EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  for (int i = 0; i < bottom.size(); ++i) {
+    quantized_[i]->ReshapeLike(*bottom[i]);
+  }
+  EltwiseLayer<Dtype>::Reshape(quantized_vec_, top);
+}
+
+template <typename Dtype>
+void Int8EltwiseLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const QuantizedRange in_range(param.bw_layer_in(),
+                                QuantizedInputIsUnsigned(param));
+  for (int i = 0; i < bottom.size(); ++i) {
+    caffe_cpu_fake_quantize(bottom[i]->count(), bottom[i]->cpu_data(),
+        QuantizationScaleIn(param, i), in_range,
+        quantized_[i]->mutable_cpu_data());
+  }
+  EltwiseLayer<Dtype>::Forward_cpu(quantized_vec_, top);
+  if (QuantizesOutput(param)) {
+    caffe_cpu_fake_quantize(top[0]->count(), top[0]->cpu_data(),
+        QuantizationScaleOut(param, 0),
+        QuantizedRange(param.bw_layer_out(), false),
+        top[0]->mutable_cpu_data());
+  }
+}
+
+INSTANTIATE_CLASS(Int8EltwiseLayer);
+
+}  // namespace caffe
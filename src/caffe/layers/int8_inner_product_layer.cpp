@@ -0,0 +1,92 @@
+#include <vector>
+
+#include "caffe/layers/int8_inner_product_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::LayerSetUp(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::LayerSetUp(bottom, top);
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  CHECK_LE(param.bw_layer_in(), 8) << "The INT8 engine needs 8 bit inputs.";
+  CHECK_LE(param.bw_params(), 8) << "The INT8 engine needs 8 bit weights.";
+  QuantizationScaleIn(param, 0);
+  QuantizationScaleParams(param, 0);
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::QuantizeWeights() {
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const int N = this->N_;
+  const int K = this->K_;
+  vector<int8_t> quantized(N * K);
+  caffe_cpu_quantize(N * K, this->blobs_[0]->cpu_data(),
+      QuantizationScaleParams(param, 0),
+      QuantizedRange(param.bw_params(), false), &quantized[0]);
+  if (this->transpose_) {
+    // The GEMM takes the weights as N_ x K_.
+    const vector<int8_t> transposed(quantized);
+    for (int k = 0; k < K; ++k) {
+      for (int n = 0; n < N; ++n) {
+        quantized[n * K + k] = transposed[k * N + n];
+      }
+    }
+  }
+  weight_sums_.assign(N, 0);
+  for (int i = 0; i < N * K; ++i) {
+    weight_sums_[i / K] += quantized[i];
+  }
+  weights_.resize(GemmU8S8PackedSize(N, K));
+  caffe_cpu_pack_s8(N, K, &quantized[0], &weights_[0]);
+  weights_quantized_ = true;
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!weights_quantized_ || this->phase_ == TRAIN) {
+    QuantizeWeights();
+  }
+  const QuantizationParameter& param = this->layer_param_.quantization_param();
+  const QuantizedRange in_range(param.bw_layer_in(),
+                                QuantizedInputIsUnsigned(param));
+  const int offset = in_range.min < 0 ? 128 : 0;
+  const float in_scale = QuantizationScaleIn(param, 0);
+  const Dtype dequantize =
+      Dtype(1) / (in_scale * QuantizationScaleParams(param, 0));
+  const int M = this->M_;
+  const int N = this->N_;
+  const int K = this->K_;
+  const int stride = GemmU8S8Stride(K);
+  bottom_quantized_.resize(M * stride);
+  products_.resize(M * N);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  for (int m = 0; m < M; ++m) {
+    caffe_cpu_quantize(K, bottom_data + m * K, in_scale, in_range, offset,
+        &bottom_quantized_[m * stride]);
+  }
+  // The products come out M_ x N_, as the top.
+  caffe_cpu_gemm_u8s8(N, M, K, &weights_[0], &bottom_quantized_[0],
+      &products_[0]);
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int m = 0; m < M; ++m) {
+    for (int n = 0; n < N; ++n) {
+      const Dtype b = bias ? bias[n] : Dtype(0);
+      top_data[m * N + n] =
+          (products_[m * N + n] - offset * weight_sums_[n]) * dequantize + b;
+    }
+  }
+  this->fused_activation_.Forward_cpu(M * N, top_data);
+  if (QuantizesOutput(param)) {
+    caffe_cpu_fake_quantize(top[0]->count(), top_data,
+        QuantizationScaleOut(param, 0),
+        QuantizedRange(param.bw_layer_out(), false), top_data);
+  }
+}
+
+INSTANTIATE_CLASS(Int8InnerProductLayer);
+
+}  // namespace caffe
@@ -0,0 +1,949 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "caffe/layers/multibox_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Whether an unmatched prior (or any prior for HARD_EXAMPLE) can be mined.
+static inline bool IsEligibleForMining(const MiningType mining_type,
+    const int match_idx, const float match_overlap, const float neg_overlap) {
+  if (mining_type == MultiBoxLossParameter_MiningType_MAX_NEGATIVE) {
+    return match_idx == -1 && match_overlap < neg_overlap;
+  } else if (mining_type == MultiBoxLossParameter_MiningType_HARD_EXAMPLE) {
+    return true;
+  } else {
+    return false;
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::LayerSetUp(bottom, top);
+  if (this->layer_param_.propagate_down_size() == 0) {
+    this->layer_param_.add_propagate_down(true);
+    this->layer_param_.add_propagate_down(true);
+    this->layer_param_.add_propagate_down(false);
+    this->layer_param_.add_propagate_down(false);
+  }
+  multibox_loss_param_ = this->layer_param_.multibox_loss_param();
+
+  // Get other parameters.
+  CHECK(multibox_loss_param_.has_num_classes()) << "Must provide num_classes.";
+  num_classes_ = multibox_loss_param_.num_classes();
+  CHECK_GE(num_classes_, 1) << "num_classes should not be less than 1.";
+  share_location_ = multibox_loss_param_.share_location();
+  loc_classes_ = share_location_ ? 1 : num_classes_;
+  background_label_id_ = multibox_loss_param_.background_label_id();
+  use_difficult_gt_ = multibox_loss_param_.use_difficult_gt();
+  mining_type_ = multibox_loss_param_.mining_type();
+  if (multibox_loss_param_.has_do_neg_mining()) {
+    LOG(WARNING) << "do_neg_mining is deprecated, use mining_type instead.";
+    CHECK_EQ(multibox_loss_param_.do_neg_mining(),
+             mining_type_ != MultiBoxLossParameter_MiningType_NONE);
+  }
+  do_neg_mining_ = mining_type_ != MultiBoxLossParameter_MiningType_NONE;
+  if (mining_type_ == MultiBoxLossParameter_MiningType_HARD_EXAMPLE) {
+    CHECK_GT(multibox_loss_param_.sample_size(), 0);
+  }
+  if (multibox_loss_param_.map_object_to_agnostic()) {
+    if (background_label_id_ >= 0) {
+      CHECK_EQ(num_classes_, 2);
+    } else {
+      CHECK_EQ(num_classes_, 1);
+    }
+  }
+
+  if (!this->layer_param_.loss_param().has_normalization() &&
+      this->layer_param_.loss_param().has_normalize()) {
+    normalization_ = this->layer_param_.loss_param().normalize() ?
+                     LossParameter_NormalizationMode_VALID :
+                     LossParameter_NormalizationMode_BATCH_SIZE;
+  } else {
+    normalization_ = this->layer_param_.loss_param().normalization();
+  }
+
+  vector<int> loss_shape(1, 1);
+  // Set up localization loss layer.
+  loc_weight_ = multibox_loss_param_.loc_weight();
+  loc_loss_type_ = multibox_loss_param_.loc_loss_type();
+  // fake shape.
+  vector<int> loc_shape(1, 1);
+  loc_shape.push_back(4);
+  loc_pred_.Reshape(loc_shape);
+  loc_gt_.Reshape(loc_shape);
+  loc_bottom_vec_.push_back(&loc_pred_);
+  loc_bottom_vec_.push_back(&loc_gt_);
+  loc_loss_.Reshape(loss_shape);
+  loc_top_vec_.push_back(&loc_loss_);
+  LayerParameter loc_param;
+  if (loc_loss_type_ == MultiBoxLossParameter_LocLossType_L2) {
+    loc_param.set_name(this->layer_param_.name() + "_l2_loc");
+    loc_param.set_type("EuclideanLoss");
+  } else if (loc_loss_type_ == MultiBoxLossParameter_LocLossType_SMOOTH_L1) {
+    loc_param.set_name(this->layer_param_.name() + "_smooth_L1_loc");
+    loc_param.set_type("SmoothL1Loss");
+  } else {
+    LOG(FATAL) << "Unknown localization loss type.";
+  }
+  loc_param.add_loss_weight(loc_weight_);
+  loc_loss_layer_ = LayerRegistry<Dtype>::CreateLayer(loc_param);
+  loc_loss_layer_->SetUp(loc_bottom_vec_, loc_top_vec_);
+
+  // Set up confidence loss layer.
+  conf_loss_type_ = multibox_loss_param_.conf_loss_type();
+  conf_bottom_vec_.push_back(&conf_pred_);
+  conf_bottom_vec_.push_back(&conf_gt_);
+  conf_loss_.Reshape(loss_shape);
+  conf_top_vec_.push_back(&conf_loss_);
+  LayerParameter conf_param;
+  conf_param.add_loss_weight(Dtype(1.));
+  conf_param.mutable_loss_param()->set_normalization(
+      LossParameter_NormalizationMode_NONE);
+  // Fake reshape.
+  vector<int> conf_shape(1, 1);
+  if (conf_loss_type_ == MultiBoxLossParameter_ConfLossType_SOFTMAX) {
+    CHECK_GE(background_label_id_, 0)
+        << "background_label_id should be within [0, num_classes) for Softmax.";
+    CHECK_LT(background_label_id_, num_classes_)
+        << "background_label_id should be within [0, num_classes) for Softmax.";
+    conf_param.set_name(this->layer_param_.name() + "_softmax_conf");
+    conf_param.set_type("SoftmaxWithLoss");
+    conf_param.mutable_softmax_param()->set_axis(1);
+    conf_gt_.Reshape(conf_shape);
+    conf_shape.push_back(num_classes_);
+    conf_pred_.Reshape(conf_shape);
+  } else if (conf_loss_type_ == MultiBoxLossParameter_ConfLossType_LOGISTIC) {
+    conf_param.set_name(this->layer_param_.name() + "_logistic_conf");
+    conf_param.set_type("SigmoidCrossEntropyLoss");
+    conf_shape.push_back(num_classes_);
+    conf_gt_.Reshape(conf_shape);
+    conf_pred_.Reshape(conf_shape);
+  } else {
+    LOG(FATAL) << "Unknown confidence loss type.";
+  }
+  conf_loss_layer_ = LayerRegistry<Dtype>::CreateLayer(conf_param);
+  conf_loss_layer_->SetUp(conf_bottom_vec_, conf_top_vec_);
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::Reshape(bottom, top);
+  num_ = bottom[0]->num();
+  num_priors_ = bottom[2]->height() / 4;
+  num_gt_ = bottom[3]->height();
+  CHECK_EQ(bottom[0]->num(), bottom[1]->num());
+  CHECK_EQ(num_priors_ * loc_classes_ * 4, bottom[0]->channels())
+      << "Number of priors must match number of location predictions.";
+  CHECK_EQ(num_priors_ * num_classes_, bottom[1]->channels())
+      << "Number of priors must match number of confidence predictions.";
+
+  // The buffers keep their capacity, only the first batches allocate.
+  prior_bboxes_.resize(num_priors_);
+  prior_variances_.resize(num_priors_, vector<float>(4));
+  gt_bboxes_.resize(num_gt_);
+  gt_offset_.resize(num_ + 1);
+  match_indices_.resize(num_ * loc_classes_ * num_priors_);
+  match_overlaps_.resize(num_ * loc_classes_ * num_priors_);
+  overlaps_.resize(num_priors_ * num_gt_);
+  gt_pool_.resize(2 * num_gt_);
+  mining_loss_.resize(num_ * num_priors_);
+  mining_pairs_.resize(num_ * num_priors_);
+  mining_selected_.resize(num_ * num_priors_);
+  neg_indices_.resize(num_);
+  loc_offset_.resize(num_ + 1);
+  conf_offset_.resize(num_ + 1);
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::GetLocPrediction(int i, int c, int j,
+    const Dtype* loc_data, NormalizedBBox* bbox) const {
+  const Dtype* loc = loc_data + ((i * num_priors_ + j) * loc_classes_ + c) * 4;
+  bbox->Clear();
+  bbox->set_xmin(loc[0]);
+  bbox->set_ymin(loc[1]);
+  bbox->set_xmax(loc[2]);
+  bbox->set_ymax(loc[3]);
+}
+
+template <typename Dtype>
+Dtype MultiBoxLossLayer<Dtype>::ConfLoss(const Dtype* conf, int label) const {
+  Dtype loss = 0;
+  if (conf_loss_type_ == MultiBoxLossParameter_ConfLossType_SOFTMAX) {
+    CHECK_GE(label, 0);
+    CHECK_LT(label, num_classes_);
+    // Compute softmax probability.
+    // We need to subtract the max to avoid numerical issues.
+    Dtype maxval = conf[0];
+    for (int c = 1; c < num_classes_; ++c) {
+      maxval = std::max<Dtype>(conf[c], maxval);
+    }
+    Dtype sum = 0.;
+    for (int c = 0; c < num_classes_; ++c) {
+      sum += std::exp(conf[c] - maxval);
+    }
+    Dtype prob = std::exp(conf[label] - maxval) / sum;
+    loss = -log(std::max(prob, Dtype(FLT_MIN)));
+  } else {
+    for (int c = 0; c < num_classes_; ++c) {
+      const int target = c == label;
+      const Dtype input = conf[c];
+      loss -= input * (target - (input >= 0)) -
+          log(1 + exp(input - 2 * input * (input >= 0)));
+    }
+  }
+  return loss;
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::MatchLabel(int i, int label,
+    const Dtype* loc_data, int* match_index, float* match_overlap) {
+  std::fill(match_index, match_index + num_priors_, -1);
+  std::fill(match_overlap, match_overlap + num_priors_, 0.f);
+  const NormalizedBBox* gt_bboxes = &gt_bboxes_[gt_offset_[i]];
+  const int num_image_gt = gt_offset_[i + 1] - gt_offset_[i];
+  // Ground truth with the desired label (-1 for all), and the ones still to
+  // match by the bipartite matching.
+  int* gt_indices = &gt_pool_[2 * gt_offset_[i]];
+  int* gt_pool = gt_indices + num_image_gt;
+  int num_gt = 0;
+  for (int g = 0; g < num_image_gt; ++g) {
+    if (label == -1 || gt_bboxes[g].label() == label) {
+      gt_pool[num_gt] = num_gt;
+      gt_indices[num_gt++] = g;
+    }
+  }
+  if (num_gt == 0) {
+    return;
+  }
+
+  // Store the overlap between predictions and ground truth, positive when
+  // above 1e-6.
+  const bool use_prior_for_matching =
+      multibox_loss_param_.use_prior_for_matching();
+  const bool ignore_cross_boundary_bbox =
+      multibox_loss_param_.ignore_cross_boundary_bbox();
+  float* overlaps = &overlaps_[num_priors_ * gt_offset_[i]];
+  NormalizedBBox loc_bbox, decode_bbox;
+  for (int p = 0; p < num_priors_; ++p) {
+    const NormalizedBBox* bbox = &prior_bboxes_[p];
+    if (!use_prior_for_matching) {
+      // Decode the prediction into bbox first.
+      GetLocPrediction(i, share_location_ ? 0 : label, p, loc_data, &loc_bbox);
+      decode_bbox.Clear();
+      DecodeBBox(prior_bboxes_[p], prior_variances_[p],
+                 multibox_loss_param_.code_type(),
+                 multibox_loss_param_.encode_variance_in_target(), false,
+                 loc_bbox, &decode_bbox);
+      bbox = &decode_bbox;
+    }
+    float* overlap = overlaps + p * num_gt;
+    if (ignore_cross_boundary_bbox && IsCrossBoundaryBBox(*bbox)) {
+      match_index[p] = -2;
+      std::fill(overlap, overlap + num_gt, 0.f);
+      continue;
+    }
+    for (int k = 0; k < num_gt; ++k) {
+      overlap[k] = JaccardOverlap(*bbox, gt_bboxes[gt_indices[k]]);
+      if (overlap[k] > 1e-6) {
+        match_overlap[p] = std::max(match_overlap[p], overlap[k]);
+      }
+    }
+  }
+
+  // Bipartite matching: match the most overlapped pair of unmatched
+  // prediction and ground truth until no positive overlap is left.
+  int pool_size = num_gt;
+  while (pool_size > 0) {
+    int max_idx = -1;
+    int max_pool_idx = -1;
+    float max_overlap = -1;
+    for (int p = 0; p < num_priors_; ++p) {
+      if (match_index[p] != -1) {
+        // The prediction already has matched ground truth or is ignored.
+        continue;
+      }
+      const float* overlap = overlaps + p * num_gt;
+      for (int q = 0; q < pool_size; ++q) {
+        const float o = overlap[gt_pool[q]];
+        if (o > 1e-6 && o > max_overlap) {
+          max_idx = p;
+          max_pool_idx = q;
+          max_overlap = o;
+        }
+      }
+    }
+    if (max_idx == -1) {
+      // Cannot find good match.
+      break;
+    }
+    match_index[max_idx] = gt_indices[gt_pool[max_pool_idx]];
+    match_overlap[max_idx] = max_overlap;
+    // Erase the ground truth, keeping the order of the pool.
+    std::copy(gt_pool + max_pool_idx + 1, gt_pool + pool_size,
+              gt_pool + max_pool_idx);
+    --pool_size;
+  }
+
+  switch (multibox_loss_param_.match_type()) {
+    case MultiBoxLossParameter_MatchType_BIPARTITE:
+      // Already done.
+      break;
+    case MultiBoxLossParameter_MatchType_PER_PREDICTION: {
+      // Get most overlaped for the rest prediction bboxes.
+      const float overlap_threshold = multibox_loss_param_.overlap_threshold();
+      for (int p = 0; p < num_priors_; ++p) {
+        if (match_index[p] != -1) {
+          continue;
+        }
+        const float* overlap = overlaps + p * num_gt;
+        int max_gt_idx = -1;
+        float max_overlap = -1;
+        for (int k = 0; k < num_gt; ++k) {
+          if (overlap[k] > 1e-6 && overlap[k] >= overlap_threshold &&
+              overlap[k] > max_overlap) {
+            max_gt_idx = k;
+            max_overlap = overlap[k];
+          }
+        }
+        if (max_gt_idx != -1) {
+          match_index[p] = gt_indices[max_gt_idx];
+          match_overlap[p] = max_overlap;
+        }
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown matching type.";
+      break;
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::MatchImage(int i, const Dtype* loc_data) {
+  if (gt_offset_[i + 1] == gt_offset_[i]) {
+    // There is no gt for current image. All predictions are negative.
+    std::fill(match_indices(i, 0),
+              match_indices(i, 0) + loc_classes_ * num_priors_, -1);
+    std::fill(match_overlaps(i, 0),
+              match_overlaps(i, 0) + loc_classes_ * num_priors_, 0.f);
+    return;
+  }
+  if (!multibox_loss_param_.use_prior_for_matching()) {
+    // Match the decoded predictions of each class with its ground truth.
+    for (int c = 0; c < loc_classes_; ++c) {
+      if (is_loc_class(c)) {
+        MatchLabel(i, share_location_ ? -1 : c, loc_data, match_indices(i, c),
+                   match_overlaps(i, c));
+      }
+    }
+    return;
+  }
+  // Use prior bboxes to match against all ground truth, in the first location
+  // class.
+  int first = 0;
+  while (first < loc_classes_ && !is_loc_class(first)) {
+    ++first;
+  }
+  if (first == loc_classes_) {
+    return;
+  }
+  int* prior_match_index = match_indices(i, first);
+  const float* prior_match_overlap = match_overlaps(i, first);
+  MatchLabel(i, -1, loc_data, prior_match_index, match_overlaps(i, first));
+  if (share_location_) {
+    return;
+  }
+  // Distribute the matching results to the class of their ground truth,
+  // the first class last as it holds the results.
+  const NormalizedBBox* gt_bboxes = &gt_bboxes_[gt_offset_[i]];
+  for (int c = loc_classes_ - 1; c >= first; --c) {
+    if (!is_loc_class(c)) {
+      continue;
+    }
+    int* match_index = match_indices(i, c);
+    for (int m = 0; m < num_priors_; ++m) {
+      const int gt_idx = prior_match_index[m];
+      match_index[m] = gt_idx > -1 && gt_bboxes[gt_idx].label() == c ?
+          gt_idx : -1;
+    }
+    if (c != first) {
+      std::copy(prior_match_overlap, prior_match_overlap + num_priors_,
+                match_overlaps(i, c));
+    }
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::EncodeMatch(int i, int c, int j,
+    const Dtype* loc_data, Dtype* loc_pred, Dtype* loc_gt) {
+  const CodeType code_type = multibox_loss_param_.code_type();
+  const bool encode_variance_in_target =
+      multibox_loss_param_.encode_variance_in_target();
+  const vector<float>& prior_variance = prior_variances_[j];
+  // Store encoded ground truth.
+  const NormalizedBBox& gt_bbox =
+      gt_bboxes_[gt_offset_[i] + match_indices(i, c)[j]];
+  NormalizedBBox gt_encode;
+  EncodeBBox(prior_bboxes_[j], prior_variance, code_type,
+             encode_variance_in_target, gt_bbox, &gt_encode);
+  loc_gt[0] = gt_encode.xmin();
+  loc_gt[1] = gt_encode.ymin();
+  loc_gt[2] = gt_encode.xmax();
+  loc_gt[3] = gt_encode.ymax();
+  // Store location prediction.
+  NormalizedBBox pred;
+  GetLocPrediction(i, c, j, loc_data, &pred);
+  if (multibox_loss_param_.bp_inside()) {
+    NormalizedBBox match_bbox = prior_bboxes_[j];
+    if (!multibox_loss_param_.use_prior_for_matching()) {
+      match_bbox.Clear();
+      DecodeBBox(prior_bboxes_[j], prior_variance, code_type,
+                 encode_variance_in_target, false, pred, &match_bbox);
+    }
+    // When a dimension of match_bbox is outside of image region, use
+    // gt_encode to simulate zero gradient.
+    loc_pred[0] = (match_bbox.xmin() < 0 || match_bbox.xmin() > 1) ?
+        gt_encode.xmin() : pred.xmin();
+    loc_pred[1] = (match_bbox.ymin() < 0 || match_bbox.ymin() > 1) ?
+        gt_encode.ymin() : pred.ymin();
+    loc_pred[2] = (match_bbox.xmax() < 0 || match_bbox.xmax() > 1) ?
+        gt_encode.xmax() : pred.xmax();
+    loc_pred[3] = (match_bbox.ymax() < 0 || match_bbox.ymax() > 1) ?
+        gt_encode.ymax() : pred.ymax();
+  } else {
+    loc_pred[0] = pred.xmin();
+    loc_pred[1] = pred.ymin();
+    loc_pred[2] = pred.xmax();
+    loc_pred[3] = pred.ymax();
+  }
+  if (encode_variance_in_target) {
+    for (int k = 0; k < 4; ++k) {
+      CHECK_GT(prior_variance[k], 0);
+      loc_pred[k] /= prior_variance[k];
+      loc_gt[k] /= prior_variance[k];
+    }
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::MineImage(int i, const Dtype* loc_data,
+    const Dtype* conf_data) {
+  int num_matches = 0;
+  for (int c = 0; c < loc_classes_; ++c) {
+    if (is_loc_class(c)) {
+      const int* match_index = match_indices(i, c);
+      for (int m = 0; m < num_priors_; ++m) {
+        num_matches += match_index[m] > -1;
+      }
+    }
+  }
+  vector<int>& neg_indices = neg_indices_[i];
+  neg_indices.clear();
+  if (!do_neg_mining_ || gt_offset_[i + 1] == gt_offset_[i]) {
+    loc_offset_[i + 1] = num_matches;
+    conf_offset_[i + 1] = num_matches;
+    return;
+  }
+  const float neg_overlap = multibox_loss_param_.neg_overlap();
+  const bool hard_example =
+      mining_type_ == MultiBoxLossParameter_MiningType_HARD_EXAMPLE;
+  const NormalizedBBox* gt_bboxes = &gt_bboxes_[gt_offset_[i]];
+
+  // Compute the loss of the priors eligible in some class: the confidence
+  // loss for the label of their match, plus the localization loss of the
+  // match for hard examples.
+  const Dtype* image_conf_data = conf_data + i * num_priors_ * num_classes_;
+  float* loss = &mining_loss_[i * num_priors_];
+  for (int m = 0; m < num_priors_; ++m) {
+    bool eligible = false;
+    int label = background_label_id_;
+    for (int c = loc_classes_ - 1; c >= 0; --c) {
+      if (is_loc_class(c)) {
+        const int gt_idx = match_indices(i, c)[m];
+        eligible |= IsEligibleForMining(mining_type_, gt_idx,
+                                        match_overlaps(i, c)[m], neg_overlap);
+        if (gt_idx > -1) {
+          // The label of the first class matching the prior.
+          label = gt_bboxes[gt_idx].label();
+        }
+      }
+    }
+    if (!eligible) {
+      continue;
+    }
+    loss[m] = ConfLoss(image_conf_data + m * num_classes_, label);
+    if (hard_example) {
+      float loc_loss = 0;
+      for (int c = 0; c < loc_classes_; ++c) {
+        if (!is_loc_class(c) || match_indices(i, c)[m] <= -1) {
+          continue;
+        }
+        Dtype loc_pred[4], loc_gt[4];
+        EncodeMatch(i, c, m, loc_data, loc_pred, loc_gt);
+        loc_loss = 0;
+        for (int k = 0; k < 4; ++k) {
+          const Dtype val = loc_pred[k] - loc_gt[k];
+          if (loc_loss_type_ == MultiBoxLossParameter_LocLossType_SMOOTH_L1 &&
+              std::fabs(val) >= 1.) {
+            loc_loss += std::fabs(val) - 0.5;
+          } else {
+            loc_loss += 0.5 * val * val;
+          }
+        }
+      }
+      loss[m] += loc_loss;
+    }
+  }
+
+  // Pick negatives or hard examples of each class based on loss.
+  const MultiBoxLossParameter& param = multibox_loss_param_;
+  const bool do_nms = param.has_nms_param() &&
+      param.nms_param().nms_threshold() > 0;
+  pair<float, int>* loss_indices = &mining_pairs_[i * num_priors_];
+  char* selected = &mining_selected_[i * num_priors_];
+  std::fill(selected, selected + num_priors_, 0);
+  for (int c = 0; c < loc_classes_; ++c) {
+    if (!is_loc_class(c)) {
+      continue;
+    }
+    int* match_index = match_indices(i, c);
+    const float* match_overlap = match_overlaps(i, c);
+    int num_eligible = 0;
+    int num_pos = 0;
+    for (int m = 0; m < num_priors_; ++m) {
+      if (IsEligibleForMining(mining_type_, match_index[m], match_overlap[m],
+                              neg_overlap)) {
+        loss_indices[num_eligible++] = std::make_pair(loss[m], m);
+      }
+      num_pos += match_index[m] > -1;
+    }
+    int num_sel = num_eligible;
+    if (hard_example) {
+      num_sel = std::min(static_cast<int>(param.sample_size()), num_sel);
+    } else {
+      num_sel = std::min(static_cast<int>(num_pos * param.neg_pos_ratio()),
+                         num_sel);
+    }
+    if (do_nms) {
+      // Do nms before selecting samples.
+      vector<float> sel_loss(num_eligible);
+      vector<NormalizedBBox> sel_bboxes(num_eligible);
+      NormalizedBBox loc_bbox;
+      for (int n = 0; n < num_eligible; ++n) {
+        const int m = loss_indices[n].second;
+        sel_loss[n] = loss_indices[n].first;
+        if (param.use_prior_for_nms()) {
+          sel_bboxes[n] = prior_bboxes_[m];
+        } else {
+          GetLocPrediction(i, c, m, loc_data, &loc_bbox);
+          DecodeBBox(prior_bboxes_[m], prior_variances_[m], param.code_type(),
+                     param.encode_variance_in_target(), false, loc_bbox,
+                     &sel_bboxes[n]);
+        }
+      }
+      vector<int> nms_indices;
+      ApplyNMS(sel_bboxes, sel_loss, param.nms_param().nms_threshold(),
+               param.nms_param().top_k(), &nms_indices);
+      if (nms_indices.size() < num_sel) {
+        LOG(INFO) << "not enough sample after nms: " << nms_indices.size();
+      }
+      // Pick top example indices after nms.
+      num_sel = std::min(static_cast<int>(nms_indices.size()), num_sel);
+      for (int n = 0; n < num_sel; ++n) {
+        selected[loss_indices[nms_indices[n]].second] = 1;
+      }
+    } else {
+      // Pick top example indices based on loss.
+      std::partial_sort(loss_indices, loss_indices + num_sel,
+                        loss_indices + num_eligible, SortScorePairDescend<int>);
+      for (int n = 0; n < num_sel; ++n) {
+        selected[loss_indices[n].second] = 1;
+      }
+    }
+    // Update the match_indices and select neg_indices.
+    for (int m = 0; m < num_priors_; ++m) {
+      if (match_index[m] > -1) {
+        if (hard_example && !selected[m]) {
+          match_index[m] = -1;
+          --num_matches;
+        }
+      } else if (match_index[m] == -1 && selected[m]) {
+        neg_indices.push_back(m);
+      }
+    }
+  }
+  loc_offset_[i + 1] = num_matches;
+  conf_offset_[i + 1] = num_matches + neg_indices.size();
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::EncodeImage(int i, const Dtype* loc_data,
+    const Dtype* conf_data, Dtype* loc_pred_data, Dtype* loc_gt_data,
+    Dtype* conf_pred_data, Dtype* conf_gt_data) {
+  if (loc_pred_data) {
+    int count = loc_offset_[i];
+    for (int c = 0; c < loc_classes_; ++c) {
+      if (!is_loc_class(c)) {
+        continue;
+      }
+      const int* match_index = match_indices(i, c);
+      for (int j = 0; j < num_priors_; ++j) {
+        if (match_index[j] > -1) {
+          EncodeMatch(i, c, j, loc_data, loc_pred_data + count * 4,
+                      loc_gt_data + count * 4);
+          ++count;
+        }
+      }
+    }
+  }
+  if (!conf_gt_data) {
+    return;
+  }
+  const bool softmax =
+      conf_loss_type_ == MultiBoxLossParameter_ConfLossType_SOFTMAX;
+  const bool map_object_to_agnostic =
+      multibox_loss_param_.map_object_to_agnostic();
+  const NormalizedBBox* gt_bboxes = &gt_bboxes_[gt_offset_[i]];
+  const Dtype* image_conf_data = conf_data + i * num_priors_ * num_classes_;
+  // Without mining, conf_pred_ holds all the priors and the labels are at
+  // their index.
+  int count = do_neg_mining_ ? conf_offset_[i] : i * num_priors_;
+  // Save matched (positive) bboxes scores and labels.
+  for (int c = 0; c < loc_classes_; ++c) {
+    if (!is_loc_class(c)) {
+      continue;
+    }
+    const int* match_index = match_indices(i, c);
+    for (int j = 0; j < num_priors_; ++j) {
+      if (match_index[j] <= -1) {
+        continue;
+      }
+      const int gt_label = map_object_to_agnostic ?
+          background_label_id_ + 1 : gt_bboxes[match_index[j]].label();
+      const int idx = do_neg_mining_ ? count++ : count + j;
+      if (softmax) {
+        conf_gt_data[idx] = gt_label;
+      } else {
+        conf_gt_data[idx * num_classes_ + gt_label] = 1;
+      }
+      if (do_neg_mining_) {
+        // Copy scores for matched bboxes.
+        caffe_copy<Dtype>(num_classes_, image_conf_data + j * num_classes_,
+            conf_pred_data + idx * num_classes_);
+      }
+    }
+  }
+  // Save negative bboxes scores and labels.
+  const vector<int>& neg_indices = neg_indices_[i];
+  for (int n = 0; n < neg_indices.size(); ++n) {
+    const int j = neg_indices[n];
+    caffe_copy<Dtype>(num_classes_, image_conf_data + j * num_classes_,
+        conf_pred_data + count * num_classes_);
+    if (softmax) {
+      conf_gt_data[count] = background_label_id_;
+    } else if (background_label_id_ >= 0 &&
+               background_label_id_ < num_classes_) {
+      conf_gt_data[count * num_classes_ + background_label_id_] = 1;
+    }
+    ++count;
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const Dtype* loc_data = bottom[0]->cpu_data();
+  const Dtype* conf_data = bottom[1]->cpu_data();
+  const Dtype* prior_data = bottom[2]->cpu_data();
+  const Dtype* gt_data = bottom[3]->cpu_data();
+
+  // Retrieve all prior bboxes. It is same within a batch since we assume all
+  // images in a batch are of same dimension.
+  GetPriorBBoxes(prior_data, num_priors_, &prior_bboxes_, &prior_variances_);
+
+  // Retrieve all ground truth, grouped by image keeping their order: count
+  // them, then place them using conf_offset_ as insertion cursors.
+  std::fill(gt_offset_.begin(), gt_offset_.end(), 0);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int g = 0; g < num_gt_; ++g) {
+      const Dtype* gt = gt_data + g * 8;
+      const int item_id = gt[0];
+      if (item_id == -1) {
+        continue;
+      }
+      CHECK_GE(item_id, 0);
+      CHECK_LT(item_id, num_);
+      const int label = gt[1];
+      CHECK_NE(background_label_id_, label)
+          << "Found background label in the dataset.";
+      const bool difficult = static_cast<bool>(gt[7]);
+      if (!use_difficult_gt_ && difficult) {
+        // Skip reading difficult ground truth.
+        continue;
+      }
+      if (pass == 0) {
+        ++gt_offset_[item_id + 1];
+        continue;
+      }
+      NormalizedBBox& bbox = gt_bboxes_[conf_offset_[item_id]++];
+      bbox.Clear();
+      bbox.set_label(label);
+      bbox.set_xmin(gt[3]);
+      bbox.set_ymin(gt[4]);
+      bbox.set_xmax(gt[5]);
+      bbox.set_ymax(gt[6]);
+      bbox.set_difficult(difficult);
+      bbox.set_size(BBoxSize(bbox));
+    }
+    if (pass == 0) {
+      std::partial_sum(gt_offset_.begin(), gt_offset_.end(),
+                       gt_offset_.begin());
+      std::copy(gt_offset_.begin(), gt_offset_.end(), conf_offset_.begin());
+    }
+  }
+
+  // Find the matches and mine the hard examples of each image.
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int i = 0; i < num_; ++i) {
+    MatchImage(i, loc_data);
+    MineImage(i, loc_data, conf_data);
+  }
+  loc_offset_[0] = 0;
+  conf_offset_[0] = 0;
+  std::partial_sum(loc_offset_.begin(), loc_offset_.end(),
+                   loc_offset_.begin());
+  std::partial_sum(conf_offset_.begin(), conf_offset_.end(),
+                   conf_offset_.begin());
+  num_matches_ = loc_offset_[num_];
+  num_conf_ = do_neg_mining_ ? conf_offset_[num_] : num_ * num_priors_;
+
+  // Form data to compute loc loss and confidence loss.
+  Dtype* loc_pred_data = NULL;
+  Dtype* loc_gt_data = NULL;
+  if (num_matches_ >= 1) {
+    vector<int> loc_shape(2);
+    loc_shape[0] = 1;
+    loc_shape[1] = num_matches_ * 4;
+    loc_pred_.Reshape(loc_shape);
+    loc_gt_.Reshape(loc_shape);
+    loc_pred_data = loc_pred_.mutable_cpu_data();
+    loc_gt_data = loc_gt_.mutable_cpu_data();
+  }
+  Dtype* conf_pred_data = NULL;
+  Dtype* conf_gt_data = NULL;
+  if (num_conf_ >= 1) {
+    vector<int> conf_shape;
+    if (conf_loss_type_ == MultiBoxLossParameter_ConfLossType_SOFTMAX) {
+      conf_shape.push_back(num_conf_);
+      conf_gt_.Reshape(conf_shape);
+      conf_shape.push_back(num_classes_);
+      conf_pred_.Reshape(conf_shape);
+    } else {
+      conf_shape.push_back(1);
+      conf_shape.push_back(num_conf_);
+      conf_shape.push_back(num_classes_);
+      conf_gt_.Reshape(conf_shape);
+      conf_pred_.Reshape(conf_shape);
+    }
+    if (do_neg_mining_) {
+      conf_pred_data = conf_pred_.mutable_cpu_data();
+    } else {
+      // Consider all scores.
+      CHECK_EQ(conf_pred_.count(), bottom[1]->count());
+      conf_pred_.ShareData(*(bottom[1]));
+    }
+    conf_gt_data = conf_gt_.mutable_cpu_data();
+    caffe_set(conf_gt_.count(),
+        conf_loss_type_ == MultiBoxLossParameter_ConfLossType_SOFTMAX ?
+        Dtype(background_label_id_) : Dtype(0), conf_gt_data);
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int i = 0; i < num_; ++i) {
+    EncodeImage(i, loc_data, conf_data, loc_pred_data, loc_gt_data,
+                conf_pred_data, conf_gt_data);
+  }
+
+  if (num_matches_ >= 1) {
+    loc_loss_layer_->Reshape(loc_bottom_vec_, loc_top_vec_);
+    loc_loss_layer_->Forward(loc_bottom_vec_, loc_top_vec_);
+  } else {
+    loc_loss_.mutable_cpu_data()[0] = 0;
+  }
+  if (num_conf_ >= 1) {
+    conf_loss_layer_->Reshape(conf_bottom_vec_, conf_top_vec_);
+    conf_loss_layer_->Forward(conf_bottom_vec_, conf_top_vec_);
+  } else {
+    conf_loss_.mutable_cpu_data()[0] = 0;
+  }
+
+  top[0]->mutable_cpu_data()[0] = 0;
+  const Dtype normalizer = get_normalizer(normalization_, num_matches_);
+  if (this->layer_param_.propagate_down(0)) {
+    top[0]->mutable_cpu_data()[0] +=
+        loc_weight_ * loc_loss_.cpu_data()[0] / normalizer;
+  }
+  if (this->layer_param_.propagate_down(1)) {
+    top[0]->mutable_cpu_data()[0] += conf_loss_.cpu_data()[0] / normalizer;
+  }
+}
+
+template <typename Dtype>
+void MultiBoxLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[2]) {
+    LOG(FATAL) << this->type()
+        << " Layer cannot backpropagate to prior inputs.";
+  }
+  if (propagate_down[3]) {
+    LOG(FATAL) << this->type()
+        << " Layer cannot backpropagate to label inputs.";
+  }
+  const Dtype normalizer = get_normalizer(normalization_, num_matches_);
+  const Dtype loss_weight = top[0]->cpu_diff()[0] / normalizer;
+
+  // Back propagate on location prediction.
+  if (propagate_down[0]) {
+    Dtype* loc_bottom_diff = bottom[0]->mutable_cpu_diff();
+    caffe_set(bottom[0]->count(), Dtype(0), loc_bottom_diff);
+    if (num_matches_ >= 1) {
+      vector<bool> loc_propagate_down;
+      // Only back propagate on prediction, not ground truth.
+      loc_propagate_down.push_back(true);
+      loc_propagate_down.push_back(false);
+      loc_loss_layer_->Backward(loc_top_vec_, loc_propagate_down,
+                                loc_bottom_vec_);
+      // Scale gradient.
+      caffe_scal(loc_pred_.count(), loss_weight, loc_pred_.mutable_cpu_diff());
+      // Copy gradient back to bottom[0].
+      const Dtype* loc_pred_diff = loc_pred_.cpu_diff();
+#ifdef _OPENMP
+      #pragma omp parallel for
+#endif
+      for (int i = 0; i < num_; ++i) {
+        Dtype* image_diff =
+            loc_bottom_diff + i * num_priors_ * loc_classes_ * 4;
+        int count = loc_offset_[i];
+        for (int c = 0; c < loc_classes_; ++c) {
+          if (!is_loc_class(c)) {
+            continue;
+          }
+          const int* match_index = match_indices(i, c);
+          for (int j = 0; j < num_priors_; ++j) {
+            if (match_index[j] <= -1) {
+              continue;
+            }
+            // Copy the diff to the right place.
+            caffe_copy<Dtype>(4, loc_pred_diff + count * 4,
+                              image_diff + (j * loc_classes_ + c) * 4);
+            ++count;
+          }
+        }
+      }
+    }
+  }
+
+  // Back propagate on confidence prediction.
+  if (propagate_down[1]) {
+    Dtype* conf_bottom_diff = bottom[1]->mutable_cpu_diff();
+    if (num_conf_ >= 1) {
+      vector<bool> conf_propagate_down;
+      // Only back propagate on prediction, not ground truth.
+      conf_propagate_down.push_back(true);
+      conf_propagate_down.push_back(false);
+      conf_loss_layer_->Backward(conf_top_vec_, conf_propagate_down,
+                                 conf_bottom_vec_);
+      // Scale gradient.
+      caffe_scal(conf_pred_.count(), loss_weight,
+                 conf_pred_.mutable_cpu_diff());
+    }
+    if (num_conf_ >= 1 && !do_neg_mining_) {
+      // The diff is computed for all the priors.
+      caffe_copy(bottom[1]->count(), conf_pred_.cpu_diff(), conf_bottom_diff);
+    } else {
+      caffe_set(bottom[1]->count(), Dtype(0), conf_bottom_diff);
+    }
+    if (num_conf_ >= 1 && do_neg_mining_) {
+      // Accumulate the diff of the matched and the negative priors. Without
+      // share_location, a prior matched in a class can also be mined as a
+      // negative of another class and appear several times in conf_pred_.
+      const Dtype* conf_pred_diff = conf_pred_.cpu_diff();
+#ifdef _OPENMP
+      #pragma omp parallel for
+#endif
+      for (int i = 0; i < num_; ++i) {
+        Dtype* image_diff = conf_bottom_diff + i * num_priors_ * num_classes_;
+        int count = conf_offset_[i];
+        for (int c = 0; c < loc_classes_; ++c) {
+          if (!is_loc_class(c)) {
+            continue;
+          }
+          const int* match_index = match_indices(i, c);
+          for (int j = 0; j < num_priors_; ++j) {
+            if (match_index[j] <= -1) {
+              continue;
+            }
+            caffe_axpy<Dtype>(num_classes_, Dtype(1),
+                              conf_pred_diff + count * num_classes_,
+                              image_diff + j * num_classes_);
+            ++count;
+          }
+        }
+        const vector<int>& neg_indices = neg_indices_[i];
+        for (int n = 0; n < neg_indices.size(); ++n) {
+          const int j = neg_indices[n];
+          caffe_axpy<Dtype>(num_classes_, Dtype(1),
+                            conf_pred_diff + count * num_classes_,
+                            image_diff + j * num_classes_);
+          ++count;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+Dtype MultiBoxLossLayer<Dtype>::get_normalizer(
+    LossParameter_NormalizationMode normalization_mode, int valid_count) {
+  Dtype normalizer;
+  switch (normalization_mode) {
+    case LossParameter_NormalizationMode_FULL:
+      normalizer = Dtype(num_ * num_priors_);
+      break;
+    case LossParameter_NormalizationMode_VALID:
+      if (valid_count == -1) {
+        normalizer = Dtype(num_ * num_priors_);
+      } else {
+        normalizer = Dtype(valid_count);
+      }
+      break;
+    case LossParameter_NormalizationMode_BATCH_SIZE:
+      normalizer = Dtype(num_);
+      break;
+    case LossParameter_NormalizationMode_NONE:
+      normalizer = Dtype(1);
+      break;
+    default:
+      LOG(FATAL) << "Unknown normalization mode: "
+          << LossParameter_NormalizationMode_Name(normalization_mode);
+  }
+  // Some images may have no ground truth. The max prevents NaNs in that case.
+  return std::max(Dtype(1.0), normalizer);
+}
+
+INSTANTIATE_CLASS(MultiBoxLossLayer);
+REGISTER_LAYER_CLASS(MultiBoxLoss);
+
+}  // namespace caffe
@@ -132,6 +132,11 @@ void PermuteLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       new_steps_.mutable_cpu_data()[i] = top[0]->count(i + 1);
     }
   }
+  if (!need_permute_) {
+    // Share the data at Reshape, like Flatten, so that the Net sees the top
+    // aliasing the bottom before any forward pass.
+    top[0]->ShareData(*bottom[0]);
+  }
 }
 
 template <typename Dtype>
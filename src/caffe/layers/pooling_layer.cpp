@@ -5,11 +5,196 @@
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_POOLING_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 namespace caffe {
 
 using std::min;
 using std::max;
 
+namespace {
+
+struct PoolingGeometry {
+  int height, width;
+  int pooled_height, pooled_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+};
+
+// Max over the window of top pixel (ph, pw), clipped to the bottom. The index
+// of the first maximum goes to argmax, or stays -1 if the window is empty.
+template <typename Dtype>
+inline Dtype MaxPoolPixel(const PoolingGeometry& g, const Dtype* bottom,
+    const int ph, const int pw, int* argmax) {
+  int hstart = ph * g.stride_h - g.pad_h;
+  int wstart = pw * g.stride_w - g.pad_w;
+  const int hend = min(hstart + g.kernel_h, g.height);
+  const int wend = min(wstart + g.kernel_w, g.width);
+  hstart = max(hstart, 0);
+  wstart = max(wstart, 0);
+  Dtype value = -FLT_MAX;
+  *argmax = -1;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      const int index = h * g.width + w;
+      if (bottom[index] > value) {
+        value = bottom[index];
+        *argmax = index;
+      }
+    }
+  }
+  return value;
+}
+
+// MAX pooling of one channel that also writes the argmax of each output.
+template <typename Dtype, typename Mask>
+void MaxPoolPlane(const PoolingGeometry& g, const Dtype* bottom, Dtype* top,
+    Mask* mask) {
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    for (int pw = 0; pw < g.pooled_width; ++pw) {
+      int argmax;
+      *top++ = MaxPoolPixel(g, bottom, ph, pw, &argmax);
+      *mask++ = static_cast<Mask>(argmax);
+    }
+  }
+}
+
+// MAX pooling gradient of one channel, finding the argmax of each output.
+template <typename Dtype>
+void MaxPoolBackwardPlane(const PoolingGeometry& g, const Dtype* bottom,
+    const Dtype* top_diff, Dtype* bottom_diff) {
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    for (int pw = 0; pw < g.pooled_width; ++pw) {
+      int argmax;
+      MaxPoolPixel(g, bottom, ph, pw, &argmax);
+      bottom_diff[argmax] += *top_diff++;
+    }
+  }
+}
+
+#ifdef CAFFE_POOLING_X86_KERNELS
+// Computes top[w] for w in [w_begin, w_end) of a KxK, stride 2 MAX pooling,
+// where every window lies inside the bottom. bottom points at the first of
+// the K bottom rows. Returns the first column left for the scalar loop.
+template <int K>
+__attribute__((target("avx2")))
+int MaxPoolRowAVX2(const float* bottom, const int width, const int pad_w,
+    const int w_begin, const int w_end, float* top) {
+  // With a 3 wide window each step loads one column past the last one.
+  const int vec_end = K == 2 ? w_end : w_end - 1;
+  int w = w_begin;
+  for (; w + 8 <= vec_end; w += 8) {
+    // The lanes are in the order of _mm256_shuffle_ps until the permute.
+    __m256 acc = _mm256_set1_ps(-FLT_MAX);
+    for (int kh = 0; kh < K; ++kh) {
+      const float* row = bottom + kh * width + 2 * w - pad_w;
+      const __m256 a = _mm256_loadu_ps(row);
+      const __m256 b = _mm256_loadu_ps(row + 8);
+      acc = _mm256_max_ps(acc,
+          _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      acc = _mm256_max_ps(acc,
+          _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+      if (K == 3) {
+        acc = _mm256_max_ps(acc, _mm256_shuffle_ps(_mm256_loadu_ps(row + 2),
+            _mm256_loadu_ps(row + 10), _MM_SHUFFLE(2, 0, 2, 0)));
+      }
+    }
+    _mm256_storeu_ps(top + w, _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(acc), _MM_SHUFFLE(3, 1, 2, 0))));
+  }
+  return w;
+}
+
+bool HasAVX2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif  // CAFFE_POOLING_X86_KERNELS
+
+template <int K>
+int MaxPoolRowSIMD(const float* bottom, const int width, const int pad_w,
+    const int w_begin, const int w_end, float* top) {
+#ifdef CAFFE_POOLING_X86_KERNELS
+  if (HasAVX2()) {
+    return MaxPoolRowAVX2<K>(bottom, width, pad_w, w_begin, w_end, top);
+  }
+#endif
+  return w_begin;
+}
+
+template <int K>
+int MaxPoolRowSIMD(const double* bottom, const int width, const int pad_w,
+    const int w_begin, const int w_end, double* top) {
+  return w_begin;
+}
+
+// KxK, stride 2 MAX pooling of one channel without argmax. The windows that
+// cross the border are clipped; the interior of each row goes through the
+// SIMD kernels, then an unrolled scalar loop.
+template <typename Dtype, int K>
+void MaxPoolPlane(const PoolingGeometry& g, const Dtype* bottom, Dtype* top) {
+  const int S = 2;
+  const int w_begin = min(g.pooled_width, (g.pad_w + S - 1) / S);
+  const int w_end = max(w_begin, g.width + g.pad_w < K ? 0 :
+      min(g.pooled_width, (g.width + g.pad_w - K) / S + 1));
+  int argmax;
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    Dtype* top_row = top + ph * g.pooled_width;
+    const int h_in = ph * S - g.pad_h;
+    if (h_in < 0 || h_in + K > g.height) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        top_row[pw] = MaxPoolPixel(g, bottom, ph, pw, &argmax);
+      }
+      continue;
+    }
+    for (int pw = 0; pw < w_begin; ++pw) {
+      top_row[pw] = MaxPoolPixel(g, bottom, ph, pw, &argmax);
+    }
+    const Dtype* bottom_rows = bottom + h_in * g.width;
+    int pw = MaxPoolRowSIMD<K>(bottom_rows, g.width, g.pad_w, w_begin, w_end,
+        top_row);
+    for (; pw < w_end; ++pw) {
+      const Dtype* window = bottom_rows + pw * S - g.pad_w;
+      Dtype value = -FLT_MAX;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          if (window[kh * g.width + kw] > value) {
+            value = window[kh * g.width + kw];
+          }
+        }
+      }
+      top_row[pw] = value;
+    }
+    for (pw = w_end; pw < g.pooled_width; ++pw) {
+      top_row[pw] = MaxPoolPixel(g, bottom, ph, pw, &argmax);
+    }
+  }
+}
+
+// MAX pooling of one channel without argmax, for the TEST phase.
+template <typename Dtype>
+void MaxPoolPlane(const PoolingGeometry& g, const Dtype* bottom, Dtype* top) {
+  if (g.kernel_h == g.kernel_w && g.stride_h == 2 && g.stride_w == 2) {
+    if (g.kernel_h == 2) {
+      return MaxPoolPlane<Dtype, 2>(g, bottom, top);
+    } else if (g.kernel_h == 3) {
+      return MaxPoolPlane<Dtype, 3>(g, bottom, top);
+    }
+  }
+  int argmax;
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    for (int pw = 0; pw < g.pooled_width; ++pw) {
+      *top++ = MaxPoolPixel(g, bottom, ph, pw, &argmax);
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -165,54 +350,36 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
-  case PoolingParameter_PoolMethod_MAX:
-    // Initialize
+  case PoolingParameter_PoolMethod_MAX: {
+    const PoolingGeometry geometry = {height_, width_, pooled_height_,
+        pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+        pad_w_};
+    const int num_planes = bottom[0]->num() * channels_;
+    const int bottom_dim = height_ * width_;
+    const int top_dim = pooled_height_ * pooled_width_;
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
+    } else if (this->phase_ != TEST) {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
     }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
+    // The TEST phase writes no argmax: Backward finds it again if needed.
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int nc = 0; nc < num_planes; ++nc) {
+      if (use_top_mask) {
+        MaxPoolPlane(geometry, bottom_data + nc * bottom_dim,
+            top_data + nc * top_dim, top_mask + nc * top_dim);
+      } else if (mask) {
+        MaxPoolPlane(geometry, bottom_data + nc * bottom_dim,
+            top_data + nc * top_dim, mask + nc * top_dim);
+      } else {
+        MaxPoolPlane(geometry, bottom_data + nc * bottom_dim,
+            top_data + nc * top_dim);
       }
     }
     break;
+  }
   case PoolingParameter_PoolMethod_AVE:
     for (int i = 0; i < top_count; ++i) {
       top_data[i] = 0;
@@ -275,8 +442,25 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
-    } else {
+    } else if (this->phase_ != TEST) {
       mask = max_idx_.cpu_data();
+    } else {
+      // The TEST phase wrote no argmax, find it again.
+      const PoolingGeometry geometry = {height_, width_, pooled_height_,
+          pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+          pad_w_};
+      const Dtype* bottom_data = bottom[0]->cpu_data();
+      const int num_planes = top[0]->num() * channels_;
+      const int bottom_dim = height_ * width_;
+      const int top_dim = pooled_height_ * pooled_width_;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (int nc = 0; nc < num_planes; ++nc) {
+        MaxPoolBackwardPlane(geometry, bottom_data + nc * bottom_dim,
+            top_diff + nc * top_dim, bottom_diff + nc * bottom_dim);
+      }
+      break;
     }
     for (int n = 0; n < top[0]->num(); ++n) {
       for (int c = 0; c < channels_; ++c) {
@@ -335,7 +519,6 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
-
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
 #endif
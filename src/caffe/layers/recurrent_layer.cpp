@@ -229,6 +229,9 @@ void RecurrentLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     const int top_offset = output_blobs_.size();
     for (int i = top_offset, j = 0; i < top.size(); ++i, ++j) {
       top[i]->ReshapeLike(*recur_output_blobs_[j]);
+      // Shared here rather than in Forward, so that the Net sees the hidden
+      // tops aliasing the unrolled net before any forward pass.
+      top[i]->ShareData(*recur_output_blobs_[j]);
     }
   }
 }
@@ -242,6 +245,15 @@ void RecurrentLayer<Dtype>::Reset() {
   }
 }
 
+template <typename Dtype>
+vector<Blob<Dtype>*> RecurrentLayer<Dtype>::RecurrentState() {
+  // The recurrent outputs are copied to the inputs at the start of Forward.
+  if (expose_hidden_) {
+    return vector<Blob<Dtype>*>();
+  }
+  return recur_output_blobs_;
+}
+
 template <typename Dtype>
 void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -265,13 +277,6 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 
   unrolled_net_->ForwardTo(last_layer_index_);
-
-  if (expose_hidden_) {
-    const int top_offset = output_blobs_.size();
-    for (int i = top_offset, j = 0; i < top.size(); ++i, ++j) {
-      top[i]->ShareData(*recur_output_blobs_[j]);
-    }
-  }
 }
 
 template <typename Dtype>
@@ -30,13 +30,6 @@ void RecurrentLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   }
 
   unrolled_net_->ForwardTo(last_layer_index_);
-
-  if (expose_hidden_) {
-    const int top_offset = output_blobs_.size();
-    for (int i = top_offset, j = 0; i < top.size(); ++i, ++j) {
-      top[i]->ShareData(*recur_output_blobs_[j]);
-    }
-  }
 }
 
 INSTANTIATE_LAYER_GPU_FORWARD(RecurrentLayer);
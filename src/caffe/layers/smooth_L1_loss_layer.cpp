@@ -0,0 +1,91 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/smooth_L1_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void SmoothL1LossLayer<Dtype>::LayerSetUp(
+  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::LayerSetUp(bottom, top);
+  const Dtype sigma = this->layer_param_.smooth_l1_loss_param().sigma();
+  sigma2_ = sigma * sigma;
+  has_weights_ = (bottom.size() >= 3);
+  if (has_weights_) {
+    CHECK_EQ(bottom.size(), 4) << "If weights are used, must specify both "
+        "inside and outside weights";
+  }
+}
+
+template <typename Dtype>
+void SmoothL1LossLayer<Dtype>::Reshape(
+  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::Reshape(bottom, top);
+  CHECK_EQ(bottom[0]->count(1), bottom[1]->count(1))
+      << "Inputs must have the same dimension.";
+  if (has_weights_) {
+    CHECK_EQ(bottom[0]->count(), bottom[2]->count())
+        << "Inside weights must have the shape of the predictions.";
+    CHECK_EQ(bottom[0]->count(), bottom[3]->count())
+        << "Outside weights must have the shape of the predictions.";
+  }
+  diff_.ReshapeLike(*bottom[0]);
+}
+
+template <typename Dtype>
+void SmoothL1LossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int count = bottom[0]->count();
+  Dtype* diff = diff_.mutable_cpu_data();
+  caffe_sub(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), diff);
+  if (has_weights_) {
+    caffe_mul(count, bottom[2]->cpu_data(), diff, diff);
+  }
+  const Dtype* out_weights = has_weights_ ? bottom[3]->cpu_data() : NULL;
+  Dtype loss = 0;
+  for (int i = 0; i < count; ++i) {
+    const Dtype abs_val = std::fabs(diff[i]);
+    const Dtype error = abs_val < 1. / sigma2_ ?
+        0.5 * diff[i] * diff[i] * sigma2_ : abs_val - 0.5 / sigma2_;
+    loss += out_weights ? out_weights[i] * error : error;
+  }
+  top[0]->mutable_cpu_data()[0] = loss / bottom[0]->num();
+}
+
+template <typename Dtype>
+void SmoothL1LossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  for (int i = 2; i < bottom.size(); ++i) {
+    if (propagate_down[i]) {
+      LOG(FATAL) << this->type()
+                 << " Layer cannot backpropagate to weight inputs.";
+    }
+  }
+  const int count = diff_.count();
+  const Dtype* diff = diff_.cpu_data();
+  const Dtype* in_weights = has_weights_ ? bottom[2]->cpu_data() : NULL;
+  const Dtype* out_weights = has_weights_ ? bottom[3]->cpu_data() : NULL;
+  for (int i = 0; i < 2; ++i) {
+    if (propagate_down[i]) {
+      const Dtype sign = (i == 0) ? 1 : -1;
+      const Dtype alpha = sign * top[0]->cpu_diff()[0] / bottom[i]->num();
+      Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+      for (int j = 0; j < count; ++j) {
+        // f'(x) = sigma^2 x inside of the quadratic region, sign(x) outside.
+        Dtype grad = std::fabs(diff[j]) < 1. / sigma2_ ?
+            sigma2_ * diff[j] : Dtype((Dtype(0) < diff[j]) - (diff[j] < 0));
+        if (has_weights_) {
+          grad *= in_weights[j] * out_weights[j];
+        }
+        bottom_diff[j] = alpha * grad;
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SmoothL1LossLayer);
+REGISTER_LAYER_CLASS(SmoothL1Loss);
+
+}  // namespace caffe
@@ -19,6 +19,9 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         "allow in-place computation.";
     top[i]->ReshapeLike(*bottom[0]);
     CHECK_EQ(count_, top[i]->count());
+    // Share the data already, so that the Net sees the aliasing before the
+    // first forward pass.
+    top[i]->ShareData(*bottom[0]);
   }
 }
 
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// The bytes of transformed input and products in flight for a block of tiles.
+static const int kBlockBytes = 256 * 1024;
+// The fewest tiles in a block, whatever the channels: the products of
+// narrower blocks are too small for the GEMM to run at speed, which costs
+// more than the transforms falling out of L2. A batch with fewer tiles than
+// kMinTiles in all is convolved by im2col instead.
+static const int kMinBlockTiles = 64;
+static const int kMinTiles = 32;
+
+// The filter transforms G of F(2x2, 3x3) and F(4x4, 3x3), row major. The
+// input (B^T) and output (A^T) transforms are unrolled below.
+static const double kG2[4 * 3] = {
+  1, 0, 0,
+  0.5, 0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0, 0, 1};
+static const double kG4[6 * 3] = {
+  1. / 4, 0, 0,
+  -1. / 6, -1. / 6, -1. / 6,
+  -1. / 6, 1. / 6, -1. / 6,
+  1. / 24, 1. / 12, 1. / 6,
+  1. / 24, -1. / 12, 1. / 6,
+  0, 0, 1};
+
+// U = G g G^T, for the alpha x 3 matrix G and 3 x 3 filter g.
+template <typename Dtype>
+static void winograd_filter_transform(const double* G, int alpha,
+    const Dtype* g, Dtype* U) {
+  Dtype Gg[6 * 3];
+  for (int i = 0; i < alpha; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      Gg[i * 3 + j] = G[i * 3] * g[j] + G[i * 3 + 1] * g[3 + j]
+          + G[i * 3 + 2] * g[6 + j];
+    }
+  }
+  for (int i = 0; i < alpha; ++i) {
+    for (int j = 0; j < alpha; ++j) {
+      U[i * alpha + j] = Gg[i * 3] * G[j * 3] + Gg[i * 3 + 1] * G[j * 3 + 1]
+          + Gg[i * 3 + 2] * G[j * 3 + 2];
+    }
+  }
+}
+
+// r = B^T d for a vector d of tile + 2 values, stride apart.
+template <typename Dtype>
+static inline void winograd_input_1d(int tile, const Dtype* d, int stride,
+    Dtype* r, int r_stride) {
+  const Dtype d0 = d[0], d1 = d[stride], d2 = d[2 * stride],
+      d3 = d[3 * stride];
+  if (tile == 2) {
+    r[0] = d0 - d2;
+    r[r_stride] = d1 + d2;
+    r[2 * r_stride] = d2 - d1;
+    r[3 * r_stride] = d1 - d3;
+    return;
+  }
+  const Dtype d4 = d[4 * stride], d5 = d[5 * stride];
+  r[0] = 4 * d0 - 5 * d2 + d4;
+  r[r_stride] = d3 + d4 - 4 * (d1 + d2);
+  r[2 * r_stride] = d4 - d3 + 4 * (d1 - d2);
+  r[3 * r_stride] = d4 - d2 + 2 * (d3 - d1);
+  r[4 * r_stride] = d4 - d2 + 2 * (d1 - d3);
+  r[5 * r_stride] = 4 * d1 - 5 * d3 + d5;
+}
+
+// y = A^T m for a vector m of tile + 2 values, stride apart.
+template <typename Dtype>
+static inline void winograd_output_1d(int tile, const Dtype* m, int stride,
+    Dtype* y, int y_stride) {
+  const Dtype m0 = m[0], m1 = m[stride], m2 = m[2 * stride],
+      m3 = m[3 * stride];
+  if (tile == 2) {
+    y[0] = m0 + m1 + m2;
+    y[y_stride] = m1 - m2 - m3;
+    return;
+  }
+  const Dtype m4 = m[4 * stride], m5 = m[5 * stride];
+  const Dtype sum12 = m1 + m2, diff12 = m1 - m2;
+  const Dtype sum34 = m3 + m4, diff34 = m3 - m4;
+  y[0] = m0 + sum12 + sum34;
+  y[y_stride] = diff12 + 2 * diff34;
+  y[2 * y_stride] = sum12 + 4 * sum34;
+  y[3 * y_stride] = diff12 + 8 * diff34 + m5;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::LayerSetUp(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  tile_ = conv_param.winograd_tile();
+  CHECK(tile_ == 2 || tile_ == 4)
+      << "Winograd convolution takes winograd_tile 2 or 4.";
+  alpha_ = tile_ + 2;
+  winograd_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  for (int i = 0; winograd_ && i < 2; ++i) {
+    winograd_ = this->kernel_shape_.cpu_data()[i] == 3
+        && this->stride_.cpu_data()[i] == 1
+        && this->dilation_.cpu_data()[i] == 1;
+  }
+  if (!winograd_) {
+    LOG(INFO) << "Layer " << this->layer_param_.name() << " is not a 3x3 "
+        << "convolution of stride 1; it will not use the Winograd engine.";
+  }
+  weights_transformed_ = false;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_winograd_ = false;
+  if (!winograd_) {
+    return;
+  }
+  const int group_channels = this->channels_ / this->group_;
+  const int group_outputs = this->num_output_ / this->group_;
+  tiles_w_ = (this->output_shape_[1] + tile_ - 1) / tile_;
+  tiles_ = (this->output_shape_[0] + tile_ - 1) / tile_ * tiles_w_;
+  const int total_tiles = this->num_ * tiles_;
+  if (total_tiles < kMinTiles) {
+    return;
+  }
+  use_winograd_ = true;
+  const int tile_bytes = alpha_ * alpha_ * (group_channels + group_outputs)
+      * sizeof(Dtype);
+  block_tiles_ = std::min(total_tiles,
+      std::max(kMinBlockTiles, kBlockBytes / tile_bytes));
+  vector<int> shape(4);
+  shape[0] = this->group_;
+  shape[1] = alpha_ * alpha_;
+  shape[2] = group_outputs;
+  shape[3] = group_channels;
+  transformed_weights_.Reshape(shape);
+  shape.resize(3);
+  shape[0] = alpha_ * alpha_;
+  shape[1] = group_channels;
+  shape[2] = block_tiles_;
+  transformed_input_.Reshape(shape);
+  shape[1] = group_outputs;
+  products_.Reshape(shape);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformWeights() {
+  const double* G = tile_ == 2 ? kG2 : kG4;
+  const int elements = alpha_ * alpha_;
+  const int group_outputs = this->num_output_ / this->group_;
+  const int group_channels = this->channels_ / this->group_;
+  const Dtype* weights = this->blobs_[0]->cpu_data();
+  Dtype* transformed = transformed_weights_.mutable_cpu_data();
+  Dtype U[6 * 6];
+  for (int g = 0; g < this->group_; ++g) {
+    for (int k = 0; k < group_outputs; ++k) {
+      for (int c = 0; c < group_channels; ++c) {
+        winograd_filter_transform(G, alpha_, weights, U);
+        weights += 9;
+        for (int e = 0; e < elements; ++e) {
+          transformed[(e * group_outputs + k) * group_channels + c] = U[e];
+        }
+      }
+    }
+    transformed += elements * group_outputs * group_channels;
+  }
+  weights_transformed_ = true;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  if (!weights_transformed_ || this->phase_ == TRAIN) {
+    TransformWeights();
+  }
+  const int elements = alpha_ * alpha_;
+  const int group_outputs = this->num_output_ / this->group_;
+  const int group_channels = this->channels_ / this->group_;
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int top_height = this->output_shape_[0];
+  const int top_width = this->output_shape_[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int total_tiles = this->num_ * tiles_;
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* V = transformed_input_.mutable_cpu_data();
+  Dtype* M = products_.mutable_cpu_data();
+  Dtype d[6 * 6], temp[6 * 6], v[6 * 6], y[4 * 4];
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int g = 0; g < this->group_; ++g) {
+      const Dtype* U = transformed_weights_.cpu_data()
+          + g * elements * group_outputs * group_channels;
+      for (int t0 = 0; t0 < total_tiles; t0 += block_tiles_) {
+        const int block = std::min(block_tiles_, total_tiles - t0);
+        // Input transform: V[e][c][t] of the alpha x alpha input tiles.
+        for (int t = 0; t < block; ++t) {
+          const int n = (t0 + t) / tiles_;
+          const int h0 = (t0 + t) % tiles_ / tiles_w_ * tile_ - pad_h;
+          const int w0 = (t0 + t) % tiles_ % tiles_w_ * tile_ - pad_w;
+          const bool inside = h0 >= 0 && h0 + alpha_ <= height
+              && w0 >= 0 && w0 + alpha_ <= width;
+          for (int c = 0; c < group_channels; ++c) {
+            const Dtype* plane = bottom_data + n * this->bottom_dim_
+                + (g * group_channels + c) * height * width;
+            // Tiles overlapping the padding are gathered with zeros first.
+            const Dtype* tile_data = d;
+            int tile_stride = alpha_;
+            if (inside) {
+              tile_data = plane + h0 * width + w0;
+              tile_stride = width;
+            } else {
+              for (int h = 0; h < alpha_; ++h) {
+                for (int w = 0; w < alpha_; ++w) {
+                  d[h * alpha_ + w] = h0 + h >= 0 && h0 + h < height
+                      && w0 + w >= 0 && w0 + w < width ?
+                      plane[(h0 + h) * width + w0 + w] : Dtype(0);
+                }
+              }
+            }
+            for (int w = 0; w < alpha_; ++w) {
+              winograd_input_1d(tile_, tile_data + w, tile_stride,
+                  temp + w, alpha_);
+            }
+            for (int h = 0; h < alpha_; ++h) {
+              winograd_input_1d(tile_, temp + h * alpha_, 1, v + h * alpha_, 1);
+            }
+            for (int e = 0; e < elements; ++e) {
+              V[(e * group_channels + c) * block + t] = v[e];
+            }
+          }
+        }
+        // One product per transform element over the tiles of the block.
+        for (int e = 0; e < elements; ++e) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_outputs,
+              block, group_channels, (Dtype)1.,
+              U + e * group_outputs * group_channels,
+              V + e * group_channels * block, (Dtype)0.,
+              M + e * group_outputs * block);
+        }
+        // Output transform of the products to m x m tiles, plus the bias and
+        // any fused activation.
+        for (int t = 0; t < block; ++t) {
+          const int n = (t0 + t) / tiles_;
+          const int h0 = (t0 + t) % tiles_ / tiles_w_ * tile_;
+          const int w0 = (t0 + t) % tiles_ % tiles_w_ * tile_;
+          const int rows = std::min(tile_, top_height - h0);
+          const int cols = std::min(tile_, top_width - w0);
+          for (int k = 0; k < group_outputs; ++k) {
+            const int output = g * group_outputs + k;
+            for (int e = 0; e < elements; ++e) {
+              v[e] = M[(e * group_outputs + k) * block + t];
+            }
+            for (int w = 0; w < alpha_; ++w) {
+              winograd_output_1d(tile_, v + w, alpha_, temp + w, alpha_);
+            }
+            for (int h = 0; h < tile_; ++h) {
+              winograd_output_1d(tile_, temp + h * alpha_, 1, y + h * tile_, 1);
+            }
+            const Dtype b = bias ? bias[output] : Dtype(0);
+            Dtype* out = top_data + n * this->top_dim_
+                + (output * top_height + h0) * top_width + w0;
+            for (int h = 0; h < rows; ++h) {
+              for (int w = 0; w < cols; ++w) {
+                out[h * top_width + w] =
+                    this->fused_activation_(y[h * tile_ + w] + b);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
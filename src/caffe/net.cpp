@@ -14,9 +14,12 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/compile_net.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_plan.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -50,6 +53,13 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  if (phase_ == TEST && (filtered_param.compile_net_state().bn_scale_merge()
+      || filtered_param.compile_net_state().fuse_activations())) {
+    NetParameter compiled_param;
+    CompileNet(filtered_param, &compiled_param);
+    filtered_param.Swap(&compiled_param);
+  }
+  compile_net_state_ = filtered_param.compile_net_state();
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -73,6 +83,10 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     if (!param.layer(layer_id).has_phase()) {
       param.mutable_layer(layer_id)->set_phase(phase_);
     }
+    // Inherit engine from net if unset.
+    if (!param.engine().empty() && param.layer(layer_id).engine().empty()) {
+      param.mutable_layer(layer_id)->set_engine(param.engine());
+    }
     // Setup layer.
     const LayerParameter& layer_param = param.layer(layer_id);
     if (layer_param.propagate_down_size() > 0) {
@@ -258,9 +272,261 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   }
   ShareWeights();
   debug_info_ = param.debug_info();
+  layer_folded_.assign(layers_.size(), false);
+  folded_bottom_shapes_.assign(layers_.size(), vector<vector<int> >());
+  if (phase_ == TEST && param.fold_constant_layers()) {
+    FoldConstantLayers();
+  }
+  plan_activation_memory_ = false;
+  if (phase_ == TEST && param.plan_activation_memory()) {
+    plan_activation_memory_ = std::find(layer_need_backward_.begin(),
+        layer_need_backward_.end(), true) == layer_need_backward_.end();
+    LOG_IF(WARNING, !plan_activation_memory_ && Caffe::root_solver())
+        << "Not planning the activation memory of a net with backward.";
+  }
+  if (plan_activation_memory_) {
+    PlanActivationMemory();
+  }
+  check_no_diff_ = phase_ == TEST && param.check_no_diff();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::FoldConstantLayers() {
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (!layers_[layer_id]->OutputDependsOnlyOnShapes()) {
+      continue;
+    }
+    // The bottom shapes are known after SetUp, so the outputs can be
+    // computed right away.
+    layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    layer_folded_[layer_id] = true;
+    vector<vector<int> >& shapes = folded_bottom_shapes_[layer_id];
+    shapes.clear();
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      shapes.push_back(bottom_vecs_[layer_id][bottom_id]->shape());
+    }
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Folded constant layer " << layer_names_[layer_id];
+  }
+}
+
+template <typename Dtype>
+bool Net<Dtype>::FoldedLayerUpToDate(const int layer_id) {
+  if (!layer_folded_[layer_id]) {
+    return false;
+  }
+  const vector<vector<int> >& shapes = folded_bottom_shapes_[layer_id];
+  bool up_to_date = true;
+  for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+       ++bottom_id) {
+    if (bottom_vecs_[layer_id][bottom_id]->shape() != shapes[bottom_id]) {
+      up_to_date = false;
+      break;
+    }
+  }
+  if (!up_to_date) {
+    // Recompute with the new shapes on this forward and remember them.
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      folded_bottom_shapes_[layer_id][bottom_id] =
+          bottom_vecs_[layer_id][bottom_id]->shape();
+    }
+  }
+  return up_to_date;
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanActivationMemory() {
+  // Blobs sharing their memory, e.g. through Split, Flatten or in-place
+  // layers, form a group living from the first write to the last read of
+  // any of them. Layers alias their tops with their bottoms in Reshape, so
+  // the groups are known before the first forward pass.
+  map<SyncedMemory*, int> group_ids;
+  vector<SyncedMemory*> groups;
+  vector<int> blob_groups(blobs_.size(), -1);
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    SyncedMemory* memory = blobs_[blob_id]->data().get();
+    if (memory == NULL || memory->size() == 0) {
+      continue;
+    }
+    map<SyncedMemory*, int>::iterator it = group_ids.find(memory);
+    if (it == group_ids.end()) {
+      it = group_ids.insert(std::make_pair(memory, groups.size())).first;
+      groups.push_back(memory);
+    }
+    blob_groups[blob_id] = it->second;
+  }
+  vector<int> first(groups.size(), layers_.size());
+  vector<int> last(groups.size(), -1);
+  vector<bool> kept(groups.size(), false);
+  // The inputs and outputs of the net, the tops of data layers and those of
+  // constant layers keep their memory. Folded layers are skipped by later
+  // forward passes; constant outputs are small, so they are kept whether
+  // folded or not.
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    const int group = blob_groups[net_input_blob_indices_[i]];
+    if (group >= 0) { kept[group] = true; }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    const int group = blob_groups[net_output_blob_indices_[i]];
+    if (group >= 0) { kept[group] = true; }
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const bool keep_tops = bottom_vecs_[layer_id].empty() ||
+        layer_folded_[layer_id] ||
+        layers_[layer_id]->OutputDependsOnlyOnShapes();
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = blob_groups[top_id_vecs_[layer_id][i]];
+      if (group < 0) { continue; }
+      kept[group] = kept[group] || keep_tops;
+      first[group] = std::min(first[group], layer_id);
+      last[group] = std::max(last[group], layer_id);
+    }
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int group = blob_groups[bottom_id_vecs_[layer_id][i]];
+      if (group < 0) { continue; }
+      first[group] = std::min(first[group], layer_id);
+      last[group] = std::max(last[group], layer_id);
+    }
+  }
+  vector<int> planned;
+  vector<size_t> sizes;
+  vector<int> planned_first, planned_last;
+  size_t unplanned_size = 0;
+  for (int group = 0; group < groups.size(); ++group) {
+    if (kept[group] || last[group] < 0) {
+      continue;
+    }
+    planned.push_back(group);
+    sizes.push_back(groups[group]->size());
+    planned_first.push_back(first[group]);
+    planned_last.push_back(last[group]);
+    unplanned_size += groups[group]->size();
+  }
+  vector<size_t> offsets;
+  const size_t arena_size = PlanMemory(sizes, planned_first, planned_last,
+      64, &offsets);
+  // The new arena is only allocated once the old one is released.
+  activation_arena_.reset(new SyncedMemory(arena_size));
+  const bool gpu = Caffe::mode() == Caffe::GPU;
+  char* arena = static_cast<char*>(gpu ?
+      activation_arena_->mutable_gpu_data() :
+      activation_arena_->mutable_cpu_data());
+  for (int i = 0; i < planned.size(); ++i) {
+    if (gpu) {
+      groups[planned[i]]->set_gpu_data(arena + offsets[i]);
+    } else {
+      groups[planned[i]]->set_cpu_data(arena + offsets[i]);
+    }
+  }
+  vector<bool> is_planned(groups.size(), false);
+  for (int i = 0; i < planned.size(); ++i) {
+    is_planned[planned[i]] = true;
+  }
+  planned_blobs_.clear();
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const int group = blob_groups[blob_id];
+    if (group >= 0 && is_planned[group]) {
+      planned_blobs_.push_back(
+          std::make_pair(blobs_[blob_id].get(), groups[group]));
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Planned the memory of " << planned_blobs_.size()
+      << " intermediate blobs: " << arena_size << " bytes instead of "
+      << unplanned_size;
+}
+
+template <typename Dtype>
+bool Net<Dtype>::ActivationMemoryPlanUpToDate() const {
+  // Blobs reshaped beyond their capacity get memory of their own.
+  for (int i = 0; i < planned_blobs_.size(); ++i) {
+    if (planned_blobs_[i].first->data().get() != planned_blobs_[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::DiffsAllocated(const int layer_id,
+    vector<bool>* allocated) const {
+  allocated->clear();
+  for (int i = 0; i < bottom_vecs_[layer_id].size(); ++i) {
+    allocated->push_back(bottom_vecs_[layer_id][i]->diff_allocated());
+  }
+  for (int i = 0; i < top_vecs_[layer_id].size(); ++i) {
+    allocated->push_back(top_vecs_[layer_id][i]->diff_allocated());
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& params = layers_[layer_id]->blobs();
+  for (int i = 0; i < params.size(); ++i) {
+    allocated->push_back(params[i]->diff_allocated());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckNoNewDiff(const int layer_id) const {
+  vector<bool> allocated;
+  DiffsAllocated(layer_id, &allocated);
+  const int num_bottom = bottom_vecs_[layer_id].size();
+  const int num_top = top_vecs_[layer_id].size();
+  for (int i = 0; i < allocated.size(); ++i) {
+    if (!allocated[i] || diffs_allocated_[i]) { continue; }
+    if (i < num_bottom) {
+      LOG(FATAL) << "Layer " << layer_names_[layer_id]
+          << " allocated the diff of bottom "
+          << blob_names_[bottom_id_vecs_[layer_id][i]] << " in forward.";
+    } else if (i < num_bottom + num_top) {
+      LOG(FATAL) << "Layer " << layer_names_[layer_id]
+          << " allocated the diff of top "
+          << blob_names_[top_id_vecs_[layer_id][i - num_bottom]]
+          << " in forward.";
+    } else {
+      LOG(FATAL) << "Layer " << layer_names_[layer_id]
+          << " allocated the diff of param " << i - num_bottom - num_top
+          << " in forward.";
+    }
+  }
+}
+
+template <typename Dtype>
+size_t Net<Dtype>::ResidentBytes(bool log_blobs) const {
+  set<const SyncedMemory*> counted;
+  size_t total = 0;
+  if (activation_arena_) {
+    total += activation_arena_->cpu_bytes() + activation_arena_->gpu_bytes();
+  }
+  const int num_blobs = blobs_.size() + params_.size();
+  for (int i = 0; i < num_blobs; ++i) {
+    const Blob<Dtype>* blob = i < blobs_.size() ? blobs_[i].get() :
+        params_[i - blobs_.size()].get();
+    size_t bytes[2] = {0, 0};
+    const SyncedMemory* memory[2] = {blob->data().get(),
+        blob->diff_allocated() ? blob->diff().get() : NULL};
+    for (int m = 0; m < 2; ++m) {
+      if (memory[m] && counted.insert(memory[m]).second) {
+        bytes[m] = memory[m]->cpu_bytes() + memory[m]->gpu_bytes();
+      }
+    }
+    total += bytes[0] + bytes[1];
+    if (log_blobs) {
+      ostringstream name;
+      if (i < blobs_.size()) {
+        name << "Blob " << blob_names_[i];
+      } else {
+        const int param_id = i - blobs_.size();
+        name << "Layer " << layer_names_[param_layer_indices_[param_id].first]
+            << " param " << param_display_names_[param_id];
+      }
+      LOG(INFO) << name.str() << " data: " << bytes[0] << " bytes, diff: "
+          << bytes[1] << " bytes";
+    }
+  }
+  return total;
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -527,13 +793,21 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
-    loss += layer_loss;
+    if (check_no_diff_) { DiffsAllocated(i, &diffs_allocated_); }
+    if (!FoldedLayerUpToDate(i)) {
+      Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+      loss += layer_loss;
+    }
+    if (check_no_diff_) { CheckNoNewDiff(i); }
     if (debug_info_) { ForwardDebugInfo(i); }
     for (int c = 0; c < after_forward_.size(); ++c) {
       after_forward_[c]->run(i);
     }
   }
+  if (plan_activation_memory_ && end == layers_.size() - 1 &&
+      !ActivationMemoryPlanUpToDate()) {
+    PlanActivationMemory();
+  }
   return loss;
 }
 
@@ -569,6 +843,65 @@ const vector<Blob<Dtype>*>& Net<Dtype>::Forward(
   return Forward(loss);
 }
 
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Net<Dtype>::ForwardStreams(
+    const vector<int>& stream_ids, Dtype* loss) {
+  const int num = stream_ids.size();
+  CHECK_EQ(num, set<int>(stream_ids.begin(), stream_ids.end()).size())
+      << "A stream can only take one slot of the batch.";
+  // Reshape first, so that the states loaded stay in place during Forward.
+  Reshape();
+  vector<Blob<Dtype>*> state;
+  for (int i = 0; i < layers_.size(); ++i) {
+    const vector<Blob<Dtype>*> layer_state = layers_[i]->RecurrentState();
+    for (int j = 0; j < layer_state.size(); ++j) {
+      CHECK_EQ(num, layer_state[j]->shape(1)) << "Layer " << layer_names_[i]
+          << " has a batch of " << layer_state[j]->shape(1)
+          << " streams, for " << num << " stream IDs.";
+      state.push_back(layer_state[j]);
+    }
+  }
+  // The state of a stream is the slices of its slot, one per blob and index
+  // of axis 0, in that order.
+  int state_dim = 0;
+  for (int j = 0; j < state.size(); ++j) {
+    state_dim += state[j]->shape(0) * state[j]->count(2);
+  }
+  for (int n = 0; n < num; ++n) {
+    typename map<int, vector<Dtype> >::const_iterator it =
+        stream_states_.find(stream_ids[n]);
+    const Dtype* saved = (it == stream_states_.end()) ? NULL : &it->second[0];
+    for (int j = 0; j < state.size(); ++j) {
+      const int inner = state[j]->count(2);
+      Dtype* data = state[j]->mutable_cpu_data();
+      for (int outer = 0; outer < state[j]->shape(0); ++outer) {
+        Dtype* slot = data + (outer * num + n) * inner;
+        if (saved) {
+          caffe_copy(inner, saved, slot);
+          saved += inner;
+        } else {
+          caffe_set(inner, Dtype(0), slot);
+        }
+      }
+    }
+  }
+  Forward(loss);
+  for (int n = 0; n < num && state_dim > 0; ++n) {
+    vector<Dtype>& saved_state = stream_states_[stream_ids[n]];
+    saved_state.resize(state_dim);
+    Dtype* saved = &saved_state[0];
+    for (int j = 0; j < state.size(); ++j) {
+      const int inner = state[j]->count(2);
+      const Dtype* data = state[j]->cpu_data();
+      for (int outer = 0; outer < state[j]->shape(0); ++outer) {
+        caffe_copy(inner, data + (outer * num + n) * inner, saved);
+        saved += inner;
+      }
+    }
+  }
+  return net_output_blobs_;
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
@@ -588,6 +921,17 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::remove_callback(Callback* value) {
+  vector<Callback*>* lists[] = {
+    &before_forward_, &after_forward_, &before_backward_, &after_backward_
+  };
+  for (int i = 0; i < 4; ++i) {
+    lists[i]->erase(std::remove(lists[i]->begin(), lists[i]->end(), value),
+        lists[i]->end());
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ForwardDebugInfo(const int layer_id) {
   for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -669,6 +1013,23 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
 
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
+  // Replicas of a compiled net fold the same layers, so their folded
+  // weights can be shared; a net cannot mix folded and unfolded weights.
+  const CompileNetState& other_state = other->compile_net_state();
+  CHECK_EQ(compile_net_state_.fold_size(), other_state.fold_size())
+      << "Cannot share weights between nets whose layers were folded "
+      << "differently.";
+  for (int i = 0; i < compile_net_state_.fold_size(); ++i) {
+    const CompileNetFold& fold = compile_net_state_.fold(i);
+    const CompileNetFold& other_fold = other_state.fold(i);
+    CHECK(fold.target() == other_fold.target()
+          && fold.layer().name() == other_fold.layer().name())
+        << "Cannot share weights between nets whose layers were folded "
+        << "differently: fold " << i << " folds " << fold.layer().name()
+        << " into " << fold.target() << " in one and "
+        << other_fold.layer().name() << " into " << other_fold.target()
+        << " in the other.";
+  }
   int num_source_layers = other->layers().size();
   for (int i = 0; i < num_source_layers; ++i) {
     Layer<Dtype>* source_layer = other->layers()[i].get();
@@ -696,6 +1057,7 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
           << target_blobs[j]->shape_string();
       target_blobs[j]->ShareData(*source_blob);
     }
+    layers_[target_layer_id]->ParamsChanged();
   }
 }
 
@@ -737,10 +1099,40 @@ void Net<Dtype>::Reshape() {
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
+  CopyTrainedLayers(param, NULL);
+}
+
+// Points the parameters of float nets into the mapped weights, and copies
+// them for the other types.
+static void SetMappedData(float* data, Blob<float>* blob) {
+  blob->set_cpu_data(data);
+}
+
+static void SetMappedData(float* data, Blob<double>* blob) {
+  std::copy(data, data + blob->count(), blob->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayers(const NetParameter& param,
+    const MappedWeights* mapped) {
+  // Layers folded by CompileNet are applied to their targets once all the
+  // layers have been copied.
+  map<string, int> fold_index;
+  set<string> fold_targets;
+  for (int i = 0; i < compile_net_state_.fold_size(); ++i) {
+    fold_index[compile_net_state_.fold(i).layer().name()] = i;
+    fold_targets.insert(compile_net_state_.fold(i).target());
+  }
+  vector<int> fold_source_ids(compile_net_state_.fold_size(), -1);
+  set<string> copied_layers;
   int num_source_layers = param.layer_size();
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
     const string& source_layer_name = source_layer.name();
+    if (fold_index.count(source_layer_name)) {
+      fold_source_ids[fold_index[source_layer_name]] = i;
+      continue;
+    }
     int target_layer_id = 0;
     while (target_layer_id != layer_names_.size() &&
         layer_names_[target_layer_id] != source_layer_name) {
@@ -753,13 +1145,26 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
-    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
-        << "Incompatible number of blobs for layer " << source_layer_name;
-    for (int j = 0; j < target_blobs.size(); ++j) {
+    // A fold target may have been given a bias the source does not have.
+    const bool bias_added = fold_targets.count(source_layer_name)
+        && target_blobs.size() == source_layer.blobs_size() + 1;
+    if (bias_added) {
+      caffe_set(target_blobs.back()->count(), Dtype(0),
+          target_blobs.back()->mutable_cpu_data());
+    } else {
+      CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+          << "Incompatible number of blobs for layer " << source_layer_name;
+    }
+    copied_layers.insert(source_layer_name);
+    for (int j = 0; j < source_layer.blobs_size(); ++j) {
       if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
         Blob<Dtype> source_blob;
         const bool kReshape = true;
-        source_blob.FromProto(source_layer.blobs(j), kReshape);
+        if (mapped) {
+          source_blob.Reshape(mapped->shape(i, j));
+        } else {
+          source_blob.FromProto(source_layer.blobs(j), kReshape);
+        }
         LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
             << source_layer_name << "'; shape mismatch.  Source param shape is "
             << source_blob.shape_string() << "; target param shape is "
@@ -767,15 +1172,49 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
             << "To learn this layer's parameters from scratch rather than "
             << "copying from a saved net, rename the layer.";
       }
-      const bool kReshape = false;
-      target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+      if (mapped) {
+        SetMappedData(mapped->data(i, j), target_blobs[j].get());
+      } else {
+        const bool kReshape = false;
+        target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+      }
+    }
+  }
+  for (int i = 0; i < compile_net_state_.fold_size(); ++i) {
+    const CompileNetFold& fold = compile_net_state_.fold(i);
+    // Weights already folded, or not copied, are left as they are.
+    if (fold_source_ids[i] < 0 || !copied_layers.count(fold.target())) {
+      LOG(INFO) << "Ignoring folded layer " << fold.layer().name();
+      continue;
+    }
+    LayerParameter folded(fold.layer());
+    folded.mutable_blobs()->CopyFrom(param.layer(fold_source_ids[i]).blobs());
+    for (int j = 0; mapped && j < folded.blobs_size(); ++j) {
+      mapped->ToProto(fold_source_ids[i], j, folded.mutable_blobs(j));
     }
+    FoldLayerIntoParams(folded,
+        layers_[layer_names_index_[fold.target()]]->blobs());
+  }
+  for (set<string>::const_iterator it = copied_layers.begin();
+       it != copied_layers.end(); ++it) {
+    layers_[layer_names_index_[*it]]->ParamsChanged();
   }
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string& trained_filename) {
-  CopyTrainedLayersFromBinaryProto(trained_filename);
+  if (MappedWeights::IsMappedWeights(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename);
+  } else {
+    CopyTrainedLayersFromBinaryProto(trained_filename);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string& trained_filename) {
+  shared_ptr<MappedWeights> mapped(new MappedWeights(trained_filename));
+  CopyTrainedLayers(mapped->index(), mapped.get());
+  mapped_weights_.push_back(mapped);
 }
 
 template <typename Dtype>
@@ -789,6 +1228,8 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
 #ifdef USE_HDF5
+  CHECK_EQ(compile_net_state_.fold_size(), 0)
+      << "Folded layers can only be copied from a binary proto.";
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -832,6 +1273,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
           target_blobs[j].get());
     }
     H5Gclose(layer_hid);
+    layers_[target_layer_id]->ParamsChanged();
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
@@ -1,8 +1,9 @@
 #ifdef USE_NCCL
-
 #include <cuda_runtime.h>
+#endif
 #include <glog/logging.h>
 #include <stdio.h>
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -72,6 +73,168 @@ Params<Dtype>::Params(shared_ptr<Solver<Dtype> > root_solver)
     diff_() {
 }
 
+template<typename Dtype>
+CPUParams<Dtype>::CPUParams(shared_ptr<Solver<Dtype> > root_solver)
+  : Params<Dtype>(root_solver) {
+  CaffeMallocHost(reinterpret_cast<void**>(&data_), size_ * sizeof(Dtype),
+                  &data_use_cuda_);
+  // Copy blob values
+  const vector<Blob<Dtype>*>& net =
+    root_solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, copy);
+
+  CaffeMallocHost(reinterpret_cast<void**>(&diff_), size_ * sizeof(Dtype),
+                  &diff_use_cuda_);
+  caffe_set(size_, Dtype(0), diff_);
+}
+
+template<typename Dtype>
+CPUParams<Dtype>::~CPUParams() {
+  CaffeFreeHost(data_, data_use_cuda_);
+  CaffeFreeHost(diff_, diff_use_cuda_);
+}
+
+template<typename Dtype>
+void CPUParams<Dtype>::Configure(Solver<Dtype>* solver) const {
+  const vector<Blob<Dtype>*>& net =
+    solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, replace_cpu);
+  apply_buffers(net, diff_, size_, replace_cpu_diff);
+}
+
+template<typename Dtype>
+CPUSync<Dtype>::CPUSync(shared_ptr<Solver<Dtype> > solver)
+  : CPUParams<Dtype>(solver), solver_(solver),
+    rank_(Caffe::solver_rank()), syncs_(), barrier_() {
+  this->Configure(solver.get());
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::set_group(vector<CPUSync<Dtype>*>* syncs,
+                               boost::barrier* barrier) {
+  syncs_ = syncs;
+  barrier_ = barrier;
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::Broadcast() {
+  barrier_->wait();
+  if (rank_ != 0) {
+    caffe_copy(size_, (*syncs_)[0]->data_, data_);
+  }
+  barrier_->wait();
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_gradients_ready() {
+  const int count = syncs_->size();
+  // Wait for all gradients
+  barrier_->wait();
+  // Reduce the chunk of this rank: it is the only one reading or writing
+  // that range of every buffer until the next barrier.
+  const size_t chunk = (size_ + count - 1) / count;
+  const size_t begin = std::min(size_, rank_ * chunk);
+  const int size = std::min(size_, begin + chunk) - begin;
+  Dtype* reduced = diff_ + begin;
+  for (int i = 0; i < count; ++i) {
+    if (i != rank_) {
+      caffe_axpy(size, Dtype(1), (*syncs_)[i]->diff_ + begin, reduced);
+    }
+  }
+  caffe_scal(size, Dtype(1) / count, reduced);
+  for (int i = 0; i < count; ++i) {
+    if (i != rank_) {
+      caffe_copy(size, reduced, (*syncs_)[i]->diff_ + begin);
+    }
+  }
+  // Wait for all chunks before the update overwrites diffs
+  barrier_->wait();
+}
+
+template<typename Dtype>
+class CPUWorker : public InternalThread {
+ public:
+  explicit CPUWorker(shared_ptr<Solver<Dtype> > rank0,
+                     boost::barrier* barrier, boost::mutex* init_mutex,
+                     vector<CPUSync<Dtype>*>* syncs, const char* restore)
+    : rank0_(rank0), barrier_(barrier), init_mutex_(init_mutex),
+      syncs_(syncs), restore_(restore) {
+  }
+  virtual ~CPUWorker() {}
+
+ protected:
+  void InternalThreadEntry() {
+    // Create solver and install callbacks
+    SolverParameter param(rank0_->param());
+    param.set_type(rank0_->type());
+    shared_ptr<Solver<Dtype> > s;
+    {
+      // Data sources such as HDF5 are not safe to open concurrently.
+      boost::mutex::scoped_lock lock(*init_mutex_);
+      s.reset(SolverRegistry<Dtype>::CreateSolver(param));
+      CHECK_EQ(s->type(), rank0_->type());
+      if (restore_) {
+        s->Restore(restore_);
+      }
+    }
+    CPUSync<Dtype> sync(s);
+    sync.set_group(syncs_, barrier_);
+    s->add_callback(&sync);
+    (*syncs_)[Caffe::solver_rank()] = &sync;
+    // Wait for other threads
+    barrier_->wait();
+    // Broadcast rank 0 state
+    sync.Broadcast();
+    // Solve
+    s->Step(param.max_iter() - s->iter());
+    barrier_->wait();
+  }
+
+  shared_ptr<Solver<Dtype> > rank0_;
+  boost::barrier* barrier_;
+  boost::mutex* init_mutex_;
+  vector<CPUSync<Dtype>*>* syncs_;
+  const char* restore_;
+};
+
+template<typename Dtype>
+void CPUSync<Dtype>::Run(int threads, const char* restore) {
+  CHECK_EQ(Caffe::solver_count(), threads);
+  boost::barrier barrier(threads);
+  boost::mutex init_mutex;
+  vector<CPUSync<Dtype>*> syncs(threads);
+  // Create workers
+  vector<shared_ptr<CPUWorker<Dtype> > > workers(threads);
+  for (int i = 1; i < threads; ++i) {
+    Caffe::set_solver_rank(i);
+    CPUWorker<Dtype>* w = new CPUWorker<Dtype>(solver_, &barrier,
+                                               &init_mutex, &syncs, restore);
+    w->StartInternalThread();
+    workers[i].reset(w);
+  }
+  Caffe::set_solver_rank(0);
+  set_group(&syncs, &barrier);
+  solver_->add_callback(this);
+  syncs[0] = this;
+  // Wait for workers
+  barrier.wait();
+  // Run first solver on current thread
+  Broadcast();
+  solver_->Solve();
+  barrier.wait();
+  // Wait for shutdown
+  for (int i = 1; i < threads; ++i) {
+    workers[i]->StopInternalThread();
+  }
+}
+
+INSTANTIATE_CLASS(Params);
+INSTANTIATE_CLASS(CPUParams);
+INSTANTIATE_CLASS(CPUWorker);
+INSTANTIATE_CLASS(CPUSync);
+
+#ifdef USE_NCCL
+
 template<typename Dtype>
 GPUParams<Dtype>::GPUParams(shared_ptr<Solver<Dtype> > root_solver, int device)
   : Params<Dtype>(root_solver) {
@@ -361,11 +524,10 @@ void NCCL<Dtype>::Run(const vector<int>& gpus, const char* restore) {
   }
 }
 
-INSTANTIATE_CLASS(Params);
 INSTANTIATE_CLASS(GPUParams);
 INSTANTIATE_CLASS(Worker);
 INSTANTIATE_CLASS(NCCL);
 
-}  // namespace caffe
-
 #endif  // USE_NCCL
+
+}  // namespace caffe
@@ -0,0 +1,184 @@
+#ifdef USE_OPENCV
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/annotated_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+template <typename TypeParam>
+class AnnotatedDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  AnnotatedDataLayerTest()
+      : backend_(DataParameter_DB_LMDB),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()),
+        num_(5) {}
+  virtual void SetUp() {
+    filename_.reset(new string());
+    MakeTempDir(filename_.get());
+    *filename_ += "/db";
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+  }
+
+  // Fill the DB with num_ 3x4x5 images, each with all pixels equal to its
+  // index i and with i boxes of label i.
+  void Fill(DataParameter_DB backend) {
+    backend_ = backend;
+    LOG(INFO) << "Using temporary dataset " << *filename_;
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(*filename_, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < num_; ++i) {
+      AnnotatedDatum anno_datum;
+      anno_datum.set_type(AnnotatedDatum_AnnotationType_BBOX);
+      Datum* datum = anno_datum.mutable_datum();
+      datum->set_label(i);
+      datum->set_channels(3);
+      datum->set_height(4);
+      datum->set_width(5);
+      datum->mutable_data()->assign(60, static_cast<char>(i));
+      if (i > 0) {
+        AnnotationGroup* anno_group = anno_datum.add_annotation_group();
+        anno_group->set_group_label(i);
+        for (int a = 0; a < i; ++a) {
+          Annotation* anno = anno_group->add_annotation();
+          anno->set_instance_id(a);
+          NormalizedBBox* bbox = anno->mutable_bbox();
+          bbox->set_xmin(0.1 * a);
+          bbox->set_ymin(0.1 * a);
+          bbox->set_xmax(0.1 * a + 0.4);
+          bbox->set_ymax(0.1 * a + 0.5);
+        }
+      }
+      stringstream ss;
+      ss << i;
+      string out;
+      CHECK(anno_datum.SerializeToString(&out));
+      txn->Put(ss.str(), out);
+    }
+    txn->Commit();
+    db->Close();
+  }
+
+  LayerParameter Param(int threads) {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(num_);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    param.mutable_annotated_data_param()->set_threads(threads);
+    return param;
+  }
+
+  void TestRead() {
+    const Dtype scale = 3;
+    LayerParameter param = Param(2);
+    param.mutable_transform_param()->set_scale(scale);
+
+    AnnotatedDataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(blob_top_data_->num(), num_);
+    EXPECT_EQ(blob_top_data_->channels(), 3);
+    EXPECT_EQ(blob_top_data_->height(), 4);
+    EXPECT_EQ(blob_top_data_->width(), 5);
+
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < num_; ++i) {
+        for (int j = 0; j < 60; ++j) {
+          EXPECT_EQ(scale * i, blob_top_data_->cpu_data()[i * 60 + j])
+              << "debug: iter " << iter << " i " << i << " j " << j;
+        }
+      }
+      // 0 + 1 + 2 + 3 + 4 boxes.
+      EXPECT_EQ(blob_top_label_->height(), 10);
+      EXPECT_EQ(blob_top_label_->width(), 8);
+      const Dtype* label = blob_top_label_->cpu_data();
+      for (int i = 1; i < num_; ++i) {
+        for (int a = 0; a < i; ++a, label += 8) {
+          EXPECT_EQ(i, label[0]);
+          EXPECT_EQ(i, label[1]);
+          EXPECT_EQ(a, label[2]);
+          EXPECT_NEAR(0.1 * a, label[3], 1e-6);
+          EXPECT_NEAR(0.1 * a, label[4], 1e-6);
+          EXPECT_NEAR(0.1 * a + 0.4, label[5], 1e-6);
+          EXPECT_NEAR(0.1 * a + 0.5, label[6], 1e-6);
+          EXPECT_EQ(0, label[7]);
+        }
+      }
+    }
+  }
+
+  // Random crops and mirrors do not depend on the number of threads.
+  void TestThreadsInvariance() {
+    vector<vector<Dtype> > outputs;
+    for (int threads = 1; threads <= 3; threads += 2) {
+      Caffe::set_random_seed(1701);
+      LayerParameter param = Param(threads);
+      TransformationParameter* transform_param =
+          param.mutable_transform_param();
+      transform_param->set_crop_size(3);
+      transform_param->set_mirror(true);
+      AnnotatedDataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      vector<Dtype> output;
+      for (int iter = 0; iter < 3; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        output.insert(output.end(), blob_top_label_->cpu_data(),
+            blob_top_label_->cpu_data() + blob_top_label_->count());
+      }
+      outputs.push_back(output);
+    }
+    ASSERT_EQ(outputs[0].size(), outputs[1].size());
+    for (int i = 0; i < outputs[0].size(); ++i) {
+      EXPECT_EQ(outputs[0][i], outputs[1][i]) << "debug: i " << i;
+    }
+  }
+
+  virtual ~AnnotatedDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  DataParameter_DB backend_;
+  shared_ptr<string> filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  const int num_;
+};
+
+TYPED_TEST_CASE(AnnotatedDataLayerTest, TestDtypesAndDevices);
+
+#ifdef USE_LMDB
+TYPED_TEST(AnnotatedDataLayerTest, TestReadLMDB) {
+  this->Fill(DataParameter_DB_LMDB);
+  this->TestRead();
+}
+
+TYPED_TEST(AnnotatedDataLayerTest, TestThreadsInvarianceLMDB) {
+  this->Fill(DataParameter_DB_LMDB);
+  this->TestThreadsInvariance();
+}
+#endif  // USE_LMDB
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/bbox_util.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class CPUBBoxUtilTest : public ::testing::Test {
+ protected:
+  CPUBBoxUtilTest() : num_(1000) {
+    Caffe::set_random_seed(1701);
+    FillUniform(num_, 0.f, 0.8f, &xmin_);
+    FillUniform(num_, 0.f, 0.8f, &ymin_);
+    FillUniform(num_, 0.f, 1.f, &scores_);
+    vector<float> w, h;
+    FillUniform(num_, 0.01f, 0.2f, &w);
+    FillUniform(num_, 0.01f, 0.2f, &h);
+    for (int i = 0; i < num_; ++i) {
+      NormalizedBBox bbox;
+      bbox.set_xmin(xmin_[i]);
+      bbox.set_ymin(ymin_[i]);
+      bbox.set_xmax(xmin_[i] + w[i]);
+      bbox.set_ymax(ymin_[i] + h[i]);
+      bboxes_.push_back(bbox);
+    }
+  }
+
+  void FillUniform(const int n, const float a, const float b,
+                   vector<float>* r) {
+    r->resize(n);
+    caffe_rng_uniform(n, a, b, &(*r)[0]);
+  }
+
+  // Reference greedy nms with a fixed threshold.
+  void ReferenceNMS(const float threshold, const float score_threshold,
+                    vector<int>* indices) {
+    vector<pair<float, int> > score_index;
+    for (int i = 0; i < num_; ++i) {
+      if (scores_[i] > score_threshold) {
+        score_index.push_back(std::make_pair(scores_[i], i));
+      }
+    }
+    std::stable_sort(score_index.begin(), score_index.end(),
+                     SortScorePairDescend<int>);
+    indices->clear();
+    for (int i = 0; i < score_index.size(); ++i) {
+      const int idx = score_index[i].second;
+      bool keep = true;
+      for (int k = 0; k < indices->size() && keep; ++k) {
+        keep = JaccardOverlap(bboxes_[idx], bboxes_[(*indices)[k]]) <=
+            threshold;
+      }
+      if (keep) {
+        indices->push_back(idx);
+      }
+    }
+  }
+
+  int num_;
+  vector<float> xmin_, ymin_, scores_;
+  vector<NormalizedBBox> bboxes_;
+};
+
+TEST_F(CPUBBoxUtilTest, TestApplyNMSFast) {
+  vector<int> expected, indices;
+  ReferenceNMS(0.45, 0.1, &expected);
+  ApplyNMSFast(bboxes_, scores_, 0.1, 0.45, 1., -1, &indices);
+  ASSERT_GT(expected.size(), 0);
+  EXPECT_EQ(expected, indices);
+}
+
+TEST_F(CPUBBoxUtilTest, TestApplyNMSFastRaw) {
+  vector<float> raw;
+  for (int i = 0; i < num_; ++i) {
+    raw.push_back(bboxes_[i].xmin());
+    raw.push_back(bboxes_[i].ymin());
+    raw.push_back(bboxes_[i].xmax());
+    raw.push_back(bboxes_[i].ymax());
+  }
+  vector<int> expected, indices;
+  ReferenceNMS(0.3, 0.2, &expected);
+  ApplyNMSFast(&raw[0], &scores_[0], num_, 0.2, 0.3, 1., -1, &indices);
+  EXPECT_EQ(expected, indices);
+}
+
+TEST_F(CPUBBoxUtilTest, TestApplyNMSFlatKernels) {
+  // Odd sizes exercise the unaligned heads and masked tails of each kernel.
+  const int sizes[] = {1, 7, 17, 63, 65, 1000};
+  vector<NMSKernel> kernels;
+  kernels.push_back(NMS_KERNEL_SCALAR);
+  if (GetNMSKernel() >= NMS_KERNEL_AVX2) {
+    kernels.push_back(NMS_KERNEL_AVX2);
+  }
+  if (GetNMSKernel() >= NMS_KERNEL_AVX512) {
+    kernels.push_back(NMS_KERNEL_AVX512);
+  }
+  vector<float> xmax, ymax, size;
+  for (int i = 0; i < num_; ++i) {
+    xmax.push_back(bboxes_[i].xmax());
+    ymax.push_back(bboxes_[i].ymax());
+    size.push_back(BBoxSize(bboxes_[i]));
+  }
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    // Positions are already in score order, so nms on the first n bboxes
+    // must match the reference run with equal scores.
+    vector<int> expected;
+    for (int i = 0; i < sizes[s]; ++i) {
+      bool keep = true;
+      for (int k = 0; k < expected.size() && keep; ++k) {
+        keep = JaccardOverlap(bboxes_[i], bboxes_[expected[k]]) <= 0.5;
+      }
+      if (keep) {
+        expected.push_back(i);
+      }
+    }
+    for (int k = 0; k < kernels.size(); ++k) {
+      vector<int> indices;
+      ApplyNMSFlat(&xmin_[0], &ymin_[0], &xmax[0], &ymax[0], &size[0],
+                   sizes[s], 0.5, &indices, kernels[k]);
+      EXPECT_EQ(expected, indices) << "kernel " << kernels[k]
+          << ", num " << sizes[s];
+    }
+  }
+}
+
+}  // namespace caffe
@@ -59,6 +59,29 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestLazyDiff) {
+  Blob<TypeParam>* blob = this->blob_preshaped_;
+  EXPECT_FALSE(blob->diff_allocated());
+  // Reading the data or the norms of the diff allocates no diff.
+  blob->mutable_cpu_data();
+  EXPECT_EQ(0, blob->asum_diff());
+  EXPECT_EQ(0, blob->sumsq_diff());
+  EXPECT_FALSE(blob->diff_allocated());
+  // A blob sharing the diff before its allocation sees the same memory.
+  Blob<TypeParam> other(2, 3, 4, 5);
+  other.ShareDiff(*blob);
+  EXPECT_FALSE(blob->diff_allocated());
+  other.mutable_cpu_diff()[0] = 1;
+  EXPECT_TRUE(blob->diff_allocated());
+  EXPECT_EQ(1, blob->cpu_diff()[0]);
+  // Growing the blob drops its diff until it is used again.
+  blob->Reshape(3, 3, 4, 5);
+  EXPECT_FALSE(blob->diff_allocated());
+  EXPECT_TRUE(blob->cpu_diff());
+  EXPECT_TRUE(blob->diff_allocated());
+  EXPECT_EQ(3 * 3 * 4 * 5 * sizeof(TypeParam), blob->diff()->size());
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
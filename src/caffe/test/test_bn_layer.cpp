@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/bn_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BNLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  BNLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 5, 7)),
+        blob_top_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~BNLayerTest() { delete blob_bottom_; delete blob_top_; }
+
+  // Forwards an INFERENCE mode layer and checks top = bottom * slope + bias.
+  void CheckInference(const bool relu) {
+    LayerParameter layer_param;
+    BNParameter* bn_param = layer_param.mutable_bn_param();
+    bn_param->set_bn_mode(BNParameter_BNMode_INFERENCE);
+    bn_param->mutable_scale_filler()->set_type("gaussian");
+    bn_param->mutable_shift_filler()->set_type("gaussian");
+    layer_param.mutable_batch_norm_param()->set_relu(relu);
+    BNLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* slope = layer.blobs()[0]->cpu_data();
+    const Dtype* bias = layer.blobs()[1]->cpu_data();
+    for (int n = 0; n < blob_bottom_->num(); ++n) {
+      for (int c = 0; c < blob_bottom_->channels(); ++c) {
+        for (int h = 0; h < blob_bottom_->height(); ++h) {
+          for (int w = 0; w < blob_bottom_->width(); ++w) {
+            Dtype expected = blob_bottom_->data_at(n, c, h, w) * slope[c]
+                + bias[c];
+            if (relu) {
+              expected = std::max(expected, Dtype(0));
+            }
+            EXPECT_NEAR(blob_top_->data_at(n, c, h, w), expected, 1e-5);
+          }
+        }
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BNLayerTest, TestDtypes);
+
+TYPED_TEST(BNLayerTest, TestForwardInference) {
+  this->CheckInference(false);
+}
+
+TYPED_TEST(BNLayerTest, TestForwardInferenceReLU) {
+  this->CheckInference(true);
+}
+
+TYPED_TEST(BNLayerTest, TestForwardInferenceInPlace) {
+  LayerParameter layer_param;
+  BNParameter* bn_param = layer_param.mutable_bn_param();
+  bn_param->set_bn_mode(BNParameter_BNMode_INFERENCE);
+  bn_param->mutable_scale_filler()->set_type("gaussian");
+  bn_param->mutable_shift_filler()->set_type("gaussian");
+  BNLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Running in place gives the same result.
+  layer.Forward(this->blob_bottom_vec_, this->blob_bottom_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i],
+        this->blob_bottom_->cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
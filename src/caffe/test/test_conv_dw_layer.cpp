@@ -0,0 +1,161 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_dw_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+// Reference depthwise convolution, bounds checked on every tap.
+template <typename Dtype>
+void caffe_conv_dw(const Blob<Dtype>* in, const ConvolutionParameter& param,
+    const vector<shared_ptr<Blob<Dtype> > >& weights, Blob<Dtype>* out) {
+  const int kernel_h = param.has_kernel_h() ? param.kernel_h() :
+      param.kernel_size(0);
+  const int kernel_w = param.has_kernel_w() ? param.kernel_w() :
+      param.kernel_size(param.kernel_size_size() - 1);
+  const int stride = param.stride_size() ? param.stride(0) : 1;
+  const int pad = param.pad_size() ? param.pad(0) : 0;
+  const int dilation = param.dilation_size() ? param.dilation(0) : 1;
+  const Dtype* weight = weights[0]->cpu_data();
+  Dtype* out_data = out->mutable_cpu_data();
+  for (int n = 0; n < out->num(); ++n) {
+    for (int c = 0; c < out->channels(); ++c) {
+      for (int h = 0; h < out->height(); ++h) {
+        for (int w = 0; w < out->width(); ++w) {
+          Dtype value = param.bias_term() ? weights[1]->cpu_data()[c] : 0;
+          for (int kh = 0; kh < kernel_h; ++kh) {
+            for (int kw = 0; kw < kernel_w; ++kw) {
+              const int h_in = h * stride - pad + kh * dilation;
+              const int w_in = w * stride - pad + kw * dilation;
+              if (h_in >= 0 && h_in < in->height()
+                  && w_in >= 0 && w_in < in->width()) {
+                value += weight[(c * kernel_h + kh) * kernel_w + kw]
+                    * in->data_at(n, c, h_in, w_in);
+              }
+            }
+          }
+          out_data[out->offset(n, c, h, w)] = value;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class ConvolutionDepthwiseLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ConvolutionDepthwiseLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ConvolutionDepthwiseLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Runs the layer on a random input and compares with caffe_conv_dw.
+  void CheckForward(const int height, const int width, const int kernel,
+      const int stride, const int pad, const int dilation = 1) {
+    blob_bottom_->Reshape(2, 3, height, width);
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    LayerParameter layer_param;
+    ConvolutionParameter* conv_param =
+        layer_param.mutable_convolution_param();
+    conv_param->add_kernel_size(kernel);
+    conv_param->add_stride(stride);
+    conv_param->add_pad(pad);
+    conv_param->add_dilation(dilation);
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionDepthwiseLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected(blob_top_->shape());
+    caffe_conv_dw(blob_bottom_, *conv_param, layer.blobs(), &expected);
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(blob_top_->cpu_data()[i], expected.cpu_data()[i], 1e-4)
+          << "kernel " << kernel << ", stride " << stride << ", pad " << pad
+          << ", input " << height << "x" << width;
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ConvolutionDepthwiseLayerTest, TestDtypes);
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestSetUp) {
+  this->blob_bottom_->Reshape(2, 3, 6, 5);
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_stride(2);
+  conv_param->add_pad(1);
+  ConvolutionDepthwiseLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), 2);
+  EXPECT_EQ(this->blob_top_->channels(), 3);
+  EXPECT_EQ(this->blob_top_->height(), 3);
+  EXPECT_EQ(this->blob_top_->width(), 3);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestForwardSpecialized) {
+  // Widths cover rows shorter than one vector, full vectors and tails.
+  const int widths[] = {3, 7, 19, 40, 53};
+  for (int i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+    for (int kernel = 3; kernel <= 5; kernel += 2) {
+      for (int stride = 1; stride <= 2; ++stride) {
+        for (int pad = 0; pad <= kernel / 2; ++pad) {
+          if (widths[i] + 2 * pad < kernel) {
+            continue;
+          }
+          this->CheckForward(9, widths[i], kernel, stride, pad);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestForwardGeneric) {
+  this->CheckForward(11, 13, 2, 1, 0);
+  this->CheckForward(11, 13, 7, 3, 3);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestForwardDilated) {
+  this->CheckForward(12, 21, 3, 1, 2, 2);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestGradient) {
+  this->blob_bottom_->Reshape(2, 3, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_stride(2);
+  conv_param->add_pad(1);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionDepthwiseLayer<TypeParam> layer(layer_param);
+  GradientChecker<TypeParam> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
@@ -495,6 +495,46 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestBatchedConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Three images, two to a gemm, so that the last batch is partial.
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[0] = 3;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const int kernel_size[] = {3, 3, 1};
+  const int group[] = {1, 3, 1};
+  const int num_output[] = {4, 6, 5};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_size[c]);
+    convolution_param->add_stride(kernel_size[c] == 1 ? 1 : 2);
+    convolution_param->set_num_output(num_output[c]);
+    convolution_param->set_group(group[c]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    const int kernel_dim = 3 * kernel_size[c] * kernel_size[c];
+    const int spatial_dim = kernel_size[c] == 1 ? 6 * 4 : 2 * 1;
+    convolution_param->set_col_buffer_budget(
+        2 * (kernel_dim + num_output[c]) * spatial_dim * sizeof(Dtype));
+    shared_ptr<Layer<Dtype> > layer(
+        new ConvolutionLayer<Dtype>(layer_param));
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -113,6 +113,8 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(batch_size);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    // Each solver process reads the records of its rank.
+    Caffe::set_multiprocess(true);
     Caffe::set_solver_count(8);
     for (int dev = 0; dev < Caffe::solver_count(); ++dev) {
       Caffe::set_solver_rank(dev);
@@ -129,6 +131,44 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
     Caffe::set_solver_count(1);
     Caffe::set_solver_rank(0);
+    Caffe::set_multiprocess(false);
+  }
+
+  // Readers of the same source share its reading thread, which deals them
+  // the records strictly round-robin.
+  void TestSharedSource() {
+    LayerParameter param;
+    param.set_name("data");
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    const int batch_size = 5;
+    data_param->set_batch_size(batch_size);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    Blob<Dtype> other_data;
+    Blob<Dtype> other_label;
+    vector<Blob<Dtype>*> other_top_vec;
+    other_top_vec.push_back(&other_data);
+    other_top_vec.push_back(&other_label);
+    // The reading thread waits for the layers of both solvers.
+    Caffe::set_solver_count(2);
+    DataLayer<Dtype> layer(param);
+    DataLayer<Dtype> other(param);
+    Caffe::set_solver_count(1);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    other.SetUp(blob_bottom_vec_, other_top_vec);
+    // Read many more records than the buffers of the readers.
+    const int num_iter = 10 * data_param->prefetch();
+    int record = 0;
+    for (int iter = 0; iter < num_iter; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      other.Forward(blob_bottom_vec_, other_top_vec);
+      for (int i = 0; i < batch_size; ++i) {
+        EXPECT_EQ(record % 5, blob_top_label_->cpu_data()[i]);
+        EXPECT_EQ((record + 1) % 5, other_label.cpu_data()[i]);
+        record += 2;
+      }
+    }
   }
 
   void TestReshape(DataParameter_DB backend) {
@@ -387,6 +427,11 @@ TYPED_TEST(DataLayerTest, TestSkipLevelDB) {
   this->TestSkip();
 }
 
+TYPED_TEST(DataLayerTest, TestSharedSourceLevelDB) {
+  this->Fill(false, DataParameter_DB_LEVELDB);
+  this->TestSharedSource();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
@@ -432,6 +477,11 @@ TYPED_TEST(DataLayerTest, TestSkipLMDB) {
   this->TestSkip();
 }
 
+TYPED_TEST(DataLayerTest, TestSharedSourceLMDB) {
+  this->Fill(false, DataParameter_DB_LMDB);
+  this->TestSharedSource();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLMDB) {
   this->TestReshape(DataParameter_DB_LMDB);
 }
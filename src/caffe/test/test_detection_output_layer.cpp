@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
 #include <iterator>
+#include <map>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -373,4 +374,127 @@ TYPED_TEST(DetectionOutputLayerTest, TestForwardNoShareLocationNeg0TopK) {
   this->CheckEqual(*(this->blob_top_), 2, "1 1 0.6 0.40 0.40 0.70 0.70");
 }
 
+TYPED_TEST(DetectionOutputLayerTest, TestForwardReference) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Random predictions of 64 priors, checked against the detections of the
+  // LabelBBox based bbox_util functions.
+  const int num = 2;
+  const int num_priors = 64;
+  const int num_classes = 4;
+  FillerParameter filler_param;
+  filler_param.set_min(0.05);
+  filler_param.set_max(0.95);
+  UniformFiller<Dtype> uniform_filler(filler_param);
+  filler_param.set_std(0.5);
+  GaussianFiller<Dtype> gaussian_filler(filler_param);
+  this->blob_bottom_prior_->Reshape(1, 2, num_priors * 4, 1);
+  uniform_filler.Fill(this->blob_bottom_prior_);
+  Dtype* prior_data = this->blob_bottom_prior_->mutable_cpu_data();
+  for (int p = 0; p < num_priors; ++p) {
+    Dtype* prior = prior_data + p * 4;
+    prior[2] = std::min(prior[0] + Dtype(0.3) * prior[2], Dtype(1));
+    prior[3] = std::min(prior[1] + Dtype(0.3) * prior[3], Dtype(1));
+    Dtype* variance = prior_data + (num_priors + p) * 4;
+    variance[0] = variance[1] = 0.1;
+    variance[2] = variance[3] = 0.2;
+  }
+  this->blob_bottom_conf_->Reshape(num, num_priors * num_classes, 1, 1);
+  filler_param.set_min(0);
+  filler_param.set_max(1);
+  UniformFiller<Dtype>(filler_param).Fill(this->blob_bottom_conf_);
+  for (int s = 0; s < 2; ++s) {
+    for (int e = 0; e < 2; ++e) {
+      const bool share_location = s;
+      const int num_loc_classes = share_location ? 1 : num_classes;
+      this->blob_bottom_loc_->Reshape(num, num_priors * num_loc_classes * 4,
+                                      1, 1);
+      gaussian_filler.Fill(this->blob_bottom_loc_);
+      LayerParameter layer_param;
+      DetectionOutputParameter* detection_output_param =
+          layer_param.mutable_detection_output_param();
+      detection_output_param->set_num_classes(num_classes);
+      detection_output_param->set_share_location(share_location);
+      detection_output_param->set_background_label_id(0);
+      detection_output_param->set_code_type(
+          PriorBoxParameter_CodeType_CENTER_SIZE);
+      detection_output_param->set_confidence_threshold(0.3);
+      detection_output_param->set_keep_top_k(40);
+      NonMaximumSuppressionParameter* nms_param =
+          detection_output_param->mutable_nms_param();
+      nms_param->set_nms_threshold(0.45);
+      nms_param->set_top_k(30);
+      nms_param->set_eta(e ? 0.9 : 1);
+      DetectionOutputLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+      vector<LabelBBox> all_loc_preds;
+      GetLocPredictions(this->blob_bottom_loc_->cpu_data(), num, num_priors,
+                        num_loc_classes, share_location, &all_loc_preds);
+      vector<map<int, vector<float> > > all_conf_scores;
+      GetConfidenceScores(this->blob_bottom_conf_->cpu_data(), num,
+                          num_priors, num_classes, &all_conf_scores);
+      vector<NormalizedBBox> prior_bboxes(num_priors);
+      vector<vector<float> > prior_variances(num_priors);
+      GetPriorBBoxes(prior_data, num_priors, &prior_bboxes, &prior_variances);
+      vector<LabelBBox> all_decode_bboxes;
+      DecodeBBoxesAll(all_loc_preds, prior_bboxes, prior_variances, num,
+                      share_location, num_loc_classes, 0,
+                      PriorBoxParameter_CodeType_CENTER_SIZE, false, false,
+                      &all_decode_bboxes);
+      vector<vector<Dtype> > expected;
+      for (int i = 0; i < num; ++i) {
+        vector<pair<float, pair<int, int> > > score_index_pairs;
+        for (int c = 1; c < num_classes; ++c) {
+          const vector<float>& scores = all_conf_scores[i][c];
+          vector<int> indices;
+          ApplyNMSFast(all_decode_bboxes[i][share_location ? -1 : c], scores,
+                       0.3, 0.45, e ? 0.9 : 1, 30, &indices);
+          for (int j = 0; j < indices.size(); ++j) {
+            score_index_pairs.push_back(std::make_pair(scores[indices[j]],
+                std::make_pair(c, indices[j])));
+          }
+        }
+        std::stable_sort(score_index_pairs.begin(), score_index_pairs.end(),
+                         SortScorePairDescend<pair<int, int> >);
+        if (score_index_pairs.size() > 40) {
+          score_index_pairs.resize(40);
+        }
+        map<int, vector<int> > kept;
+        for (int j = 0; j < score_index_pairs.size(); ++j) {
+          kept[score_index_pairs[j].second.first].push_back(
+              score_index_pairs[j].second.second);
+        }
+        for (map<int, vector<int> >::iterator it = kept.begin();
+             it != kept.end(); ++it) {
+          const int c = it->first;
+          const vector<NormalizedBBox>& bboxes =
+              all_decode_bboxes[i][share_location ? -1 : c];
+          for (int j = 0; j < it->second.size(); ++j) {
+            const int idx = it->second[j];
+            vector<Dtype> det(7);
+            det[0] = i;
+            det[1] = c;
+            det[2] = all_conf_scores[i][c][idx];
+            det[3] = bboxes[idx].xmin();
+            det[4] = bboxes[idx].ymin();
+            det[5] = bboxes[idx].xmax();
+            det[6] = bboxes[idx].ymax();
+            expected.push_back(det);
+          }
+        }
+      }
+      ASSERT_GT(expected.size(), 10);
+      ASSERT_EQ(expected.size(), this->blob_top_->height());
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      for (int n = 0; n < expected.size(); ++n) {
+        for (int k = 0; k < 7; ++k) {
+          EXPECT_EQ(expected[n][k], top_data[n * 7 + k])
+              << "share_location " << s << " eta " << e << " row " << n;
+        }
+      }
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,148 @@
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  HostAllocatorTest() : cache_limit_(HostAllocator::cache_limit()) {}
+  virtual ~HostAllocatorTest() {
+    HostAllocator::set_cache_limit(cache_limit_);
+  }
+
+  const size_t cache_limit_;
+};
+
+TEST_F(HostAllocatorTest, TestSizeClass) {
+  EXPECT_EQ(CAFFE_HOST_ALIGNMENT, HostAllocator::SizeClass(0));
+  EXPECT_EQ(CAFFE_HOST_ALIGNMENT, HostAllocator::SizeClass(1));
+  EXPECT_EQ(640, HostAllocator::SizeClass(600));
+  EXPECT_EQ(1024, HostAllocator::SizeClass(1000));
+  EXPECT_EQ(1024, HostAllocator::SizeClass(1024));
+  EXPECT_EQ(1280, HostAllocator::SizeClass(1025));
+  size_t previous = 0;
+  for (size_t size = 1; size < 100000; size += 7) {
+    const size_t size_class = HostAllocator::SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_GE(size_class, previous);
+    EXPECT_EQ(0, size_class % CAFFE_HOST_ALIGNMENT);
+    // At most a quarter of the block is wasted, past the smallest classes.
+    if (size > 4 * CAFFE_HOST_ALIGNMENT) {
+      EXPECT_LE(size_class, size + size / 4) << size;
+    }
+    previous = size_class;
+  }
+}
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  vector<void*> blocks;
+  for (size_t size = 1; size < 10000; size = size * 3 + 1) {
+    void* ptr = HostAllocator::Allocate(size);
+    EXPECT_EQ(0, reinterpret_cast<size_t>(ptr) % CAFFE_HOST_ALIGNMENT);
+    blocks.push_back(ptr);
+  }
+  for (int i = 0; i < blocks.size(); ++i) {
+    HostAllocator::Free(blocks[i]);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  // Earlier tests may have filled the cache up to its limit.
+  HostAllocator::Trim();
+  const HostAllocator::Stats start = HostAllocator::GetStats();
+  void* ptr = HostAllocator::Allocate(1000);
+  HostAllocator::Stats stats = HostAllocator::GetStats();
+  EXPECT_EQ(start.allocations + 1, stats.allocations);
+  EXPECT_EQ(start.bytes_in_use + 1024, stats.bytes_in_use);
+  HostAllocator::Free(ptr);
+  stats = HostAllocator::GetStats();
+  EXPECT_EQ(start.bytes_in_use, stats.bytes_in_use);
+  EXPECT_GE(stats.bytes_cached, 1024);
+  // Any size of the same class gets the block back.
+  void* same = HostAllocator::Allocate(900);
+  EXPECT_EQ(ptr, same);
+  stats = HostAllocator::GetStats();
+  EXPECT_EQ(start.allocations + 2, stats.allocations);
+  EXPECT_EQ(start.cache_hits + 1, stats.cache_hits);
+  HostAllocator::Free(same);
+}
+
+TEST_F(HostAllocatorTest, TestCacheLimit) {
+  HostAllocator::Trim();
+  HostAllocator::set_cache_limit(0);
+  const HostAllocator::Stats start = HostAllocator::GetStats();
+  EXPECT_EQ(0, start.bytes_cached);
+  for (int i = 0; i < 3; ++i) {
+    HostAllocator::Free(HostAllocator::Allocate(1000));
+  }
+  const HostAllocator::Stats stats = HostAllocator::GetStats();
+  EXPECT_EQ(start.allocations + 3, stats.allocations);
+  EXPECT_EQ(start.cache_hits, stats.cache_hits);
+  EXPECT_EQ(0, stats.bytes_cached);
+}
+
+// Allocates blocks of various sizes and frees half of them.
+static void AllocateAndFree(vector<void*>* kept) {
+  for (int i = 0; i < 100; ++i) {
+    void* ptr = HostAllocator::Allocate(100 * (i + 1));
+    if (i % 2) {
+      HostAllocator::Free(ptr);
+    } else {
+      kept->push_back(ptr);
+    }
+  }
+}
+
+TEST_F(HostAllocatorTest, TestThreads) {
+  const HostAllocator::Stats start = HostAllocator::GetStats();
+  const int num_threads = 4;
+  const int num_rounds = 3;
+  for (int round = 0; round < num_rounds; ++round) {
+    vector<vector<void*> > kept(num_threads);
+    vector<shared_ptr<boost::thread> > threads;
+    for (int i = 0; i < num_threads; ++i) {
+      threads.push_back(shared_ptr<boost::thread>(
+          new boost::thread(AllocateAndFree, &kept[i])));
+    }
+    for (int i = 0; i < num_threads; ++i) {
+      threads[i]->join();
+    }
+    // Blocks freed by another thread than the one that allocated them.
+    for (int i = 0; i < num_threads; ++i) {
+      for (int j = 0; j < kept[i].size(); ++j) {
+        HostAllocator::Free(kept[i][j]);
+      }
+    }
+  }
+  const HostAllocator::Stats stats = HostAllocator::GetStats();
+  EXPECT_EQ(start.allocations + num_rounds * num_threads * 100,
+      stats.allocations);
+  EXPECT_EQ(start.bytes_in_use, stats.bytes_in_use);
+  // The later threads reuse the blocks of the threads that exited.
+  EXPECT_GT(stats.cache_hits, start.cache_hits);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  Caffe::set_mode(Caffe::CPU);
+  const HostAllocator::Stats start = HostAllocator::GetStats();
+  {
+    SyncedMemory mem(1000);
+    EXPECT_EQ(start.bytes_in_use, HostAllocator::GetStats().bytes_in_use);
+    const void* data = mem.cpu_data();
+    EXPECT_EQ(0, reinterpret_cast<size_t>(data) % CAFFE_HOST_ALIGNMENT);
+    EXPECT_EQ(start.bytes_in_use + 1024,
+        HostAllocator::GetStats().bytes_in_use);
+  }
+  EXPECT_EQ(start.bytes_in_use, HostAllocator::GetStats().bytes_in_use);
+}
+
+}  // namespace caffe
@@ -215,5 +215,40 @@ TYPED_TEST(ImageDataLayerTest, TestSpace) {
   EXPECT_EQ(this->blob_top_label_->cpu_data()[0], 1);
 }
 
+TYPED_TEST(ImageDataLayerTest, TestThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(5);
+  image_data_param->set_source(this->filename_.c_str());
+  image_data_param->set_shuffle(false);
+  TransformationParameter* transform_param = param.mutable_transform_param();
+  transform_param->set_crop_size(64);
+  transform_param->set_mirror(true);
+  // The random crops and mirrors do not depend on the number of threads.
+  vector<vector<Dtype> > batches;
+  const int num_threads[] = {1, 3};
+  for (int t = 0; t < 2; ++t) {
+    Caffe::set_random_seed(this->seed_);
+    image_data_param->set_threads(num_threads[t]);
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(i, this->blob_top_label_->cpu_data()[i]);
+      }
+      const Dtype* data = this->blob_top_data_->cpu_data();
+      vector<Dtype> batch(data, data + this->blob_top_data_->count());
+      if (t == 0) {
+        batches.push_back(batch);
+      } else {
+        EXPECT_TRUE(batch == batches[iter]) << "iter " << iter;
+      }
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
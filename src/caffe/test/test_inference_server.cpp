@@ -0,0 +1,156 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_server.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceServerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  InferenceServerTest() : seed_(1701) {}
+
+  virtual void SetUp() {
+    const string& proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'ip' "
+        "  top: 'ip' "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    // Train the net by filling its weights, and save them.
+    Caffe::set_random_seed(seed_);
+    reference_.reset(new Net<Dtype>(param_));
+    NetParameter trained;
+    reference_->ToProto(&trained);
+    MakeTempFilename(&weights_);
+    WriteProtoToBinaryFile(trained, weights_);
+  }
+
+  shared_ptr<Blob<Dtype> > MakeInput() {
+    vector<int> shape(2);
+    shape[0] = 2;
+    shape[1] = 5;
+    shared_ptr<Blob<Dtype> > input(new Blob<Dtype>(shape));
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(input.get());
+    return input;
+  }
+
+  int seed_;
+  NetParameter param_;
+  string weights_;
+  shared_ptr<Net<Dtype> > reference_;
+};
+
+TYPED_TEST_CASE(InferenceServerTest, TestDtypes);
+
+TYPED_TEST(InferenceServerTest, TestSharedWeights) {
+  InferenceServer<TypeParam> server(this->param_, this->weights_, 3);
+  const vector<shared_ptr<Net<TypeParam> > >& nets = server.nets();
+  ASSERT_EQ(3, nets.size());
+  for (int i = 0; i < nets.size(); ++i) {
+    const vector<Blob<TypeParam>*>& params = nets[i]->learnable_params();
+    ASSERT_EQ(2, params.size());
+    for (int j = 0; j < params.size(); ++j) {
+      EXPECT_EQ(nets[0]->learnable_params()[j]->cpu_data(),
+                params[j]->cpu_data());
+    }
+    // The activations are not shared.
+    if (i > 0) {
+      EXPECT_NE(nets[0]->blob_by_name("ip")->cpu_data(),
+                nets[i]->blob_by_name("ip")->cpu_data());
+    }
+  }
+}
+
+TYPED_TEST(InferenceServerTest, TestConcurrentRequests) {
+  const int num_requests = 20;
+  vector<shared_ptr<InferenceRequest<TypeParam> > > requests;
+  {
+    InferenceServer<TypeParam> server(this->param_, this->weights_, 3);
+    for (int i = 0; i < num_requests; ++i) {
+      vector<shared_ptr<Blob<TypeParam> > > inputs(1, this->MakeInput());
+      requests.push_back(server.Submit(inputs));
+    }
+    for (int i = 0; i < num_requests; ++i) {
+      requests[i]->Wait();
+      EXPECT_TRUE(requests[i]->done());
+    }
+    InferenceStats stats = server.stats();
+    EXPECT_EQ(num_requests, stats.requests);
+    EXPECT_EQ(0, stats.queue_depth);
+    EXPECT_GE(stats.max_latency_ms, stats.mean_latency_ms);
+    EXPECT_GE(stats.mean_latency_ms, stats.mean_queue_ms);
+  }
+  // Each request matches a forward pass of the reference net.
+  Blob<TypeParam>* input = this->reference_->input_blobs()[0];
+  for (int i = 0; i < num_requests; ++i) {
+    input->CopyFrom(*requests[i]->inputs()[0]);
+    const vector<Blob<TypeParam>*>& expected = this->reference_->Forward();
+    const vector<shared_ptr<Blob<TypeParam> > >& outputs =
+        requests[i]->outputs();
+    ASSERT_EQ(1, outputs.size());
+    ASSERT_TRUE(expected[0]->shape() == outputs[0]->shape());
+    for (int j = 0; j < outputs[0]->count(); ++j) {
+      EXPECT_EQ(expected[0]->cpu_data()[j], outputs[0]->cpu_data()[j]);
+    }
+    EXPECT_GE(requests[i]->latency_ms(), requests[i]->run_ms());
+    EXPECT_GE(requests[i]->queue_ms(), 0);
+  }
+}
+
+TYPED_TEST(InferenceServerTest, TestRunPinned) {
+  InferenceServer<TypeParam> server(this->param_, this->weights_, 2, 0);
+  vector<shared_ptr<Blob<TypeParam> > > inputs(1, this->MakeInput());
+  shared_ptr<InferenceRequest<TypeParam> > request = server.Run(inputs);
+  EXPECT_TRUE(request->done());
+  ASSERT_EQ(1, request->outputs().size());
+  EXPECT_EQ(6, request->outputs()[0]->count());
+  EXPECT_EQ(1, server.stats().requests);
+}
+
+TYPED_TEST(InferenceServerTest, TestThreadsPerReplica) {
+  InferenceServer<TypeParam> server(this->param_, this->weights_, 2, -1, 1);
+  vector<shared_ptr<Blob<TypeParam> > > inputs(1, this->MakeInput());
+  shared_ptr<InferenceRequest<TypeParam> > request = server.Run(inputs);
+  this->reference_->input_blobs()[0]->CopyFrom(*inputs[0]);
+  const Blob<TypeParam>& expected = *this->reference_->Forward()[0];
+  ASSERT_EQ(1, request->outputs().size());
+  ASSERT_EQ(expected.count(), request->outputs()[0]->count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], request->outputs()[0]->cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
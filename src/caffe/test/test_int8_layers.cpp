@@ -0,0 +1,425 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/concat_layer.hpp"
+#include "caffe/layers/conv_dw_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/eltwise_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/int8_conv_layer.hpp"
+#include "caffe/layers/int8_inner_product_layer.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(Int8GemmTest, TestGemmU8S8) {
+  // Odd sizes, so that the partial blocks, the remaining rows and the
+  // padding of K all run.
+  const int M = 37, N = 13, K = 75;
+  const int stride = GemmU8S8Stride(K);
+  vector<int8_t> A(M * K);
+  vector<uint8_t> B(N * stride);
+  for (int i = 0; i < M * K; ++i) {
+    A[i] = static_cast<int8_t>((i * 37) % 256 - 128);
+  }
+  for (int n = 0; n < N; ++n) {
+    for (int k = 0; k < K; ++k) {
+      B[n * stride + k] = static_cast<uint8_t>(((n * K + k) * 91) % 256);
+    }
+  }
+  vector<int8_t> packed(GemmU8S8PackedSize(M, K));
+  caffe_cpu_pack_s8(M, K, &A[0], &packed[0]);
+  vector<int32_t> C(N * M);
+  caffe_cpu_gemm_u8s8(M, N, K, &packed[0], &B[0], &C[0]);
+  for (int n = 0; n < N; ++n) {
+    for (int m = 0; m < M; ++m) {
+      int32_t expected = 0;
+      for (int k = 0; k < K; ++k) {
+        expected += A[m * K + k] * B[n * stride + k];
+      }
+      EXPECT_EQ(expected, C[n * M + m]);
+    }
+  }
+}
+
+TEST(Int8GemmTest, TestQuantizeTransposed) {
+  const int rows = 5, cols = 35, ldq = 8;
+  vector<float> x(rows * cols);
+  for (int i = 0; i < rows * cols; ++i) {
+    x[i] = (i % 17) - 8.3f;
+  }
+  const QuantizedRange range(8, false);
+  vector<uint8_t> q(cols * ldq);
+  caffe_cpu_quantize_transposed(rows, cols, &x[0], 2.f, range, 128, ldq,
+                                &q[0]);
+  vector<uint8_t> expected(cols);
+  for (int i = 0; i < rows; ++i) {
+    caffe_cpu_quantize(cols, &x[i * cols], 2.f, range, 128, &expected[0]);
+    for (int j = 0; j < cols; ++j) {
+      EXPECT_EQ(expected[j], q[j * ldq + i]);
+    }
+  }
+}
+
+template <typename Dtype>
+class Int8LayersTest : public CPUDeviceTest<Dtype> {
+ protected:
+  Int8LayersTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 6, 5)),
+        blob_bottom_b_(new Blob<Dtype>(2, 4, 6, 5)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_ref_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    filler_param.set_std(2);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    filler.Fill(blob_bottom_b_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_ref_vec_.push_back(blob_top_ref_);
+  }
+  virtual ~Int8LayersTest() {
+    delete blob_bottom_;
+    delete blob_bottom_b_;
+    delete blob_top_;
+    delete blob_top_ref_;
+  }
+
+  // Signed 8 bit inputs and weights, with scales 2^4 and 2^6.
+  void SetQuantization(LayerParameter* layer_param) {
+    QuantizationParameter* param = layer_param->mutable_quantization_param();
+    param->set_bw_layer_in(8);
+    param->set_bw_params(8);
+    param->add_fl_layer_in(4);
+    param->add_fl_layer_in(4);
+    param->add_fl_params(6);
+    param->set_is_negative_input(true);
+    layer_param->set_engine("INT8");
+  }
+
+  // Rounds the blob to the grid of scale.
+  void FakeQuantize(Blob<Dtype>* blob, float scale, int bw, bool is_unsigned) {
+    caffe_cpu_fake_quantize(blob->count(), blob->cpu_data(), scale,
+        QuantizedRange(bw, is_unsigned), blob->mutable_cpu_data());
+  }
+
+  // Runs the float layer on the quantized bottoms and weights of the INT8
+  // layer, and compares their outputs.
+  void CheckForward(Layer<Dtype>* layer, Layer<Dtype>* reference,
+      bool has_weights) {
+    const QuantizationParameter& param =
+        layer->layer_param().quantization_param();
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    reference->SetUp(blob_bottom_vec_, blob_top_ref_vec_);
+    if (has_weights) {
+      for (int i = 0; i < layer->blobs().size(); ++i) {
+        reference->blobs()[i]->CopyFrom(*layer->blobs()[i]);
+      }
+      FakeQuantize(reference->blobs()[0].get(),
+          QuantizationScaleParams(param, 0), param.bw_params(), false);
+    }
+    for (int i = 0; i < blob_bottom_vec_.size(); ++i) {
+      FakeQuantize(blob_bottom_vec_[i], QuantizationScaleIn(param, i),
+          param.bw_layer_in(), QuantizedInputIsUnsigned(param));
+    }
+    reference->Forward(blob_bottom_vec_, blob_top_ref_vec_);
+    ASSERT_EQ(blob_top_->count(), blob_top_ref_->count());
+    const Dtype* data = blob_top_->cpu_data();
+    const Dtype* ref_data = blob_top_ref_->cpu_data();
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      if (QuantizesOutput(param)) {
+        // On the output grid, at most a step away from the real output.
+        const float scale = QuantizationScaleOut(param, 0);
+        EXPECT_NEAR(data[i] * scale, std::floor(data[i] * scale + 0.5), 1e-3);
+        EXPECT_NEAR(data[i], ref_data[i], 1.0001 / scale);
+      } else {
+        EXPECT_NEAR(data[i], ref_data[i], 1e-4);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_bottom_b_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_ref_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> blob_top_ref_vec_;
+};
+
+TYPED_TEST_CASE(Int8LayersTest, TestDtypes);
+
+TYPED_TEST(Int8LayersTest, TestCreateLayer) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("InnerProduct");
+  layer_param.mutable_inner_product_param()->set_num_output(3);
+  this->SetQuantization(&layer_param);
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<Int8InnerProductLayer<Dtype>*>(layer.get()));
+  // Without the engine, or without quantization_param, the layer is float.
+  layer_param.clear_engine();
+  layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_FALSE(dynamic_cast<Int8InnerProductLayer<Dtype>*>(layer.get()));
+  layer_param.set_engine("INT8");
+  layer_param.clear_quantization_param();
+  layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_FALSE(dynamic_cast<Int8InnerProductLayer<Dtype>*>(layer.get()));
+}
+
+TYPED_TEST(Int8LayersTest, TestNetEngine) {
+  typedef TypeParam Dtype;
+  const string proto =
+      "engine: 'INT8' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 4 dim: 6 dim: 5 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 3 kernel_size: 3 } "
+      "  quantization_param { bw_layer_in: 8 bw_params: 8 "
+      "    fl_layer_in: 4 fl_params: 6 } } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+      "  inner_product_param { num_output: 3 } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  EXPECT_TRUE(dynamic_cast<Int8ConvolutionLayer<Dtype>*>(
+      net.layer_by_name("conv").get()));
+  EXPECT_FALSE(dynamic_cast<Int8InnerProductLayer<Dtype>*>(
+      net.layer_by_name("ip").get()));
+}
+
+// A net of the INT8 layers that quantize their weights.
+static NetParameter Int8NetParam(Phase phase) {
+  const string proto =
+      "engine: 'INT8' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 4 dim: 6 dim: 5 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } "
+      "  quantization_param { bw_layer_in: 8 bw_params: 8 "
+      "    fl_layer_in: 4 fl_params: 6 } } "
+      "layer { name: 'dw' type: 'ConvolutionDepthwise' bottom: 'conv' "
+      "  top: 'dw' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 stride: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } "
+      "  quantization_param { bw_layer_in: 8 bw_params: 8 "
+      "    fl_layer_in: 4 fl_params: 6 } } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'dw' top: 'ip' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.3 } } "
+      "  quantization_param { bw_layer_in: 8 bw_params: 8 "
+      "    fl_layer_in: 4 fl_params: 6 } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(phase);
+  return param;
+}
+
+TYPED_TEST(Int8LayersTest, TestSharedWeightsChanged) {
+  typedef TypeParam Dtype;
+  // As a Solver test net: the weights are shared from the training net
+  // before each test, after it updated them in place.
+  const NetParameter param = Int8NetParam(TEST);
+  Net<Dtype> test_net(param);
+  Net<Dtype> train_net(param);
+  test_net.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+  test_net.Forward();
+  for (int update = 0; update < 2; ++update) {
+    if (update > 0) {
+      for (int i = 0; i < train_net.learnable_params().size(); ++i) {
+        Blob<Dtype>* blob = train_net.learnable_params()[i];
+        caffe_scal(blob->count(), Dtype(-0.5), blob->mutable_cpu_data());
+      }
+    }
+    test_net.ShareTrainedLayersWith(&train_net);
+    const Blob<Dtype>& output = *test_net.Forward()[0];
+    // A new net quantizes the current weights.
+    NetParameter trained;
+    train_net.ToProto(&trained);
+    Net<Dtype> reference(param);
+    reference.CopyTrainedLayersFrom(trained);
+    reference.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+    const Blob<Dtype>& expected = *reference.Forward()[0];
+    ASSERT_EQ(expected.count(), output.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(Int8LayersTest, TestTrainWeightsUpdated) {
+  typedef TypeParam Dtype;
+  // The solver updates the weights of a training net in place, without
+  // telling its layers.
+  Net<Dtype> train_net(Int8NetParam(TRAIN));
+  train_net.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+  for (int update = 0; update < 2; ++update) {
+    if (update > 0) {
+      for (int i = 0; i < train_net.learnable_params().size(); ++i) {
+        Blob<Dtype>* blob = train_net.learnable_params()[i];
+        caffe_scal(blob->count(), Dtype(-0.5), blob->mutable_cpu_data());
+      }
+    }
+    const Blob<Dtype>& output = *train_net.Forward()[0];
+    NetParameter trained;
+    train_net.ToProto(&trained);
+    Net<Dtype> reference(Int8NetParam(TEST));
+    reference.CopyTrainedLayersFrom(trained);
+    reference.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+    const Blob<Dtype>& expected = *reference.Forward()[0];
+    ASSERT_EQ(expected.count(), output.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(Int8LayersTest, TestConvolution) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_stride(2);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(6);
+  conv_param->set_group(2);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_weight_filler()->set_std(0.5);
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->SetQuantization(&layer_param);
+  layer_param.set_type("Convolution");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  ConvolutionLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, true);
+}
+
+TYPED_TEST(Int8LayersTest, TestConvolution1x1UnsignedOutput) {
+  typedef TypeParam Dtype;
+  caffe_abs(this->blob_bottom_->count(), this->blob_bottom_->cpu_data(),
+            this->blob_bottom_->mutable_cpu_data());
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(1);
+  conv_param->set_num_output(5);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_weight_filler()->set_std(0.5);
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->SetQuantization(&layer_param);
+  QuantizationParameter* param = layer_param.mutable_quantization_param();
+  param->set_is_negative_input(false);
+  param->clear_fl_layer_in();
+  param->add_scale_in(40);
+  param->set_bw_layer_out(8);
+  param->add_fl_layer_out(2);
+  shared_ptr<Layer<Dtype> > layer(new Int8ConvolutionLayer<Dtype>(layer_param));
+  ConvolutionLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, true);
+}
+
+TYPED_TEST(Int8LayersTest, TestConvolutionDepthwise) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_stride(1);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(4);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_weight_filler()->set_std(0.5);
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->SetQuantization(&layer_param);
+  layer_param.set_type("ConvolutionDepthwise");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  ConvolutionDepthwiseLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, true);
+}
+
+TYPED_TEST(Int8LayersTest, TestInnerProduct) {
+  typedef TypeParam Dtype;
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    InnerProductParameter* ip_param =
+        layer_param.mutable_inner_product_param();
+    ip_param->set_num_output(10);
+    ip_param->set_transpose(transpose);
+    ip_param->mutable_weight_filler()->set_type("gaussian");
+    ip_param->mutable_weight_filler()->set_std(0.3);
+    ip_param->mutable_bias_filler()->set_type("gaussian");
+    this->SetQuantization(&layer_param);
+    layer_param.set_type("InnerProduct");
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    InnerProductLayer<Dtype> reference(layer_param);
+    this->CheckForward(layer.get(), &reference, true);
+  }
+}
+
+TYPED_TEST(Int8LayersTest, TestPoolingAve) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+  this->SetQuantization(&layer_param);
+  layer_param.mutable_quantization_param()->set_bw_layer_out(8);
+  layer_param.mutable_quantization_param()->add_fl_layer_out(4);
+  layer_param.set_type("Pooling");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  PoolingLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, false);
+}
+
+TYPED_TEST(Int8LayersTest, TestEltwiseSum) {
+  typedef TypeParam Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_b_);
+  LayerParameter layer_param;
+  layer_param.mutable_eltwise_param()->set_operation(
+      EltwiseParameter_EltwiseOp_SUM);
+  this->SetQuantization(&layer_param);
+  layer_param.mutable_quantization_param()->set_fl_layer_in(1, 3);
+  layer_param.set_type("Eltwise");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EltwiseLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, false);
+}
+
+TYPED_TEST(Int8LayersTest, TestConcat) {
+  typedef TypeParam Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_b_);
+  LayerParameter layer_param;
+  this->SetQuantization(&layer_param);
+  layer_param.mutable_quantization_param()->set_fl_layer_in(1, 3);
+  layer_param.mutable_quantization_param()->set_bw_layer_out(8);
+  layer_param.mutable_quantization_param()->add_fl_layer_out(3);
+  layer_param.set_type("Concat");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  ConcatLayer<Dtype> reference(layer_param);
+  this->CheckForward(layer.get(), &reference, false);
+}
+
+}  // namespace caffe
@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/fused_lstm_layer.hpp"
 #include "caffe/layers/lstm_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -284,5 +286,132 @@ TYPED_TEST(LSTMLayerTest, TestGradientNonZeroContBufferSize2WithStaticInput) {
       this->blob_top_vec_, 2);
 }
 
+TYPED_TEST(LSTMLayerTest, TestFusedEngine) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->layer_param_.set_type("LSTM");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(this->layer_param_);
+  EXPECT_TRUE(dynamic_cast<LSTMLayer<Dtype>*>(layer.get()) != NULL);
+  this->layer_param_.mutable_recurrent_param()->set_engine(
+      RecurrentParameter_Engine_FUSED);
+  layer = LayerRegistry<Dtype>::CreateLayer(this->layer_param_);
+  EXPECT_TRUE(dynamic_cast<FusedLSTMLayer<Dtype>*>(layer.get()) != NULL);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumTimesteps = 4;
+  const int num = 3;
+  const Dtype kEpsilon = 1e-6;
+  for (int with_static = 0; with_static < 2; ++with_static) {
+    this->ReshapeBlobs(kNumTimesteps, num);
+    if (with_static) {
+      FillerParameter filler_param;
+      UniformFiller<Dtype> filler(filler_param);
+      filler.Fill(&this->blob_bottom_static_);
+      this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+    }
+    // Both engines draw the same parameters from the same seed.
+    Caffe::set_random_seed(1701);
+    LSTMLayer<Dtype> unrolled(this->layer_param_);
+    unrolled.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Caffe::set_random_seed(1701);
+    Blob<Dtype> fused_top;
+    vector<Blob<Dtype>*> fused_top_vec(1, &fused_top);
+    FusedLSTMLayer<Dtype> fused(this->layer_param_);
+    fused.SetUp(this->blob_bottom_vec_, fused_top_vec);
+    ASSERT_EQ(unrolled.blobs().size(), fused.blobs().size());
+    for (int i = 0; i < fused.blobs().size(); ++i) {
+      ASSERT_TRUE(unrolled.blobs()[i]->shape() == fused.blobs()[i]->shape());
+      for (int j = 0; j < fused.blobs()[i]->count(); ++j) {
+        EXPECT_EQ(unrolled.blobs()[i]->cpu_data()[j],
+                  fused.blobs()[i]->cpu_data()[j]);
+      }
+    }
+    // Run several batches, so that the state carried over between them and
+    // the sequences starting mid-batch are covered.
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> sequence_filler(filler_param);
+    for (int batch = 0; batch < 3; ++batch) {
+      sequence_filler.Fill(&this->blob_bottom_);
+      Dtype* cont = this->blob_bottom_cont_.mutable_cpu_data();
+      for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+        cont[i] = (i + batch) % 5 != 0;
+      }
+      unrolled.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      fused.Forward(this->blob_bottom_vec_, fused_top_vec);
+      ASSERT_TRUE(this->blob_top_.shape() == fused_top.shape());
+      for (int i = 0; i < fused_top.count(); ++i) {
+        EXPECT_NEAR(this->blob_top_.cpu_data()[i], fused_top.cpu_data()[i],
+                    kEpsilon) << "batch = " << batch << "; i = " << i;
+      }
+    }
+    if (with_static) {
+      this->blob_bottom_vec_.pop_back();
+    }
+  }
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  FusedLSTMLayer<Dtype> layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedGradientNonZeroContBufferSize2) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(2, 2);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  FusedLSTMLayer<Dtype> layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i > 2;
+  }
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 2);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedGradientExposeHidden) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(2, 2);
+  this->layer_param_.mutable_recurrent_param()->set_expose_hidden(true);
+  vector<int> state_shape(3);
+  state_shape[0] = 1;
+  state_shape[1] = 2;
+  state_shape[2] = this->num_output_;
+  Blob<Dtype> h_0(state_shape);
+  Blob<Dtype> c_0(state_shape);
+  Blob<Dtype> h_T;
+  Blob<Dtype> c_T;
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_);
+  filler.Fill(&h_0);
+  filler.Fill(&c_0);
+  this->blob_bottom_vec_.push_back(&h_0);
+  this->blob_bottom_vec_.push_back(&c_0);
+  this->blob_top_vec_.push_back(&h_T);
+  this->blob_top_vec_.push_back(&c_T);
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i > 0;
+  }
+  FusedLSTMLayer<Dtype> layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 3);
+}
 
 }  // namespace caffe
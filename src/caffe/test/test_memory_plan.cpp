@@ -0,0 +1,92 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/memory_plan.hpp"
+#include "caffe/util/rng.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MemoryPlanTest : public ::testing::Test {
+ protected:
+  void Add(size_t size, int first, int last) {
+    sizes_.push_back(size);
+    first_.push_back(first);
+    last_.push_back(last);
+  }
+
+  size_t Plan(size_t alignment) {
+    const size_t arena =
+        PlanMemory(sizes_, first_, last_, alignment, &offsets_);
+    EXPECT_EQ(sizes_.size(), offsets_.size());
+    for (int i = 0; i < sizes_.size(); ++i) {
+      EXPECT_EQ(0, offsets_[i] % alignment);
+      EXPECT_LE(offsets_[i] + sizes_[i], arena);
+      for (int j = 0; j < i; ++j) {
+        const bool alive_together =
+            first_[i] <= last_[j] && first_[j] <= last_[i];
+        const bool overlap = offsets_[i] < offsets_[j] + sizes_[j] &&
+            offsets_[j] < offsets_[i] + sizes_[i];
+        EXPECT_FALSE(alive_together && overlap) << i << " and " << j;
+      }
+    }
+    return arena;
+  }
+
+  vector<size_t> sizes_;
+  vector<int> first_;
+  vector<int> last_;
+  vector<size_t> offsets_;
+};
+
+TEST_F(MemoryPlanTest, TestEmpty) {
+  EXPECT_EQ(0, this->Plan(1));
+}
+
+TEST_F(MemoryPlanTest, TestChain) {
+  // A chain of layers only needs two buffers alive at once.
+  for (int i = 0; i < 10; ++i) {
+    this->Add(100, i, i + 1);
+  }
+  EXPECT_EQ(200, this->Plan(1));
+}
+
+TEST_F(MemoryPlanTest, TestAllAlive) {
+  this->Add(10, 0, 5);
+  this->Add(20, 1, 4);
+  this->Add(30, 2, 3);
+  EXPECT_EQ(60, this->Plan(1));
+  // The largest buffer comes first.
+  EXPECT_EQ(0, this->offsets_[2]);
+}
+
+TEST_F(MemoryPlanTest, TestGap) {
+  // The small buffer fits in the hole left by a dead one.
+  this->Add(100, 0, 1);
+  this->Add(100, 0, 3);
+  this->Add(50, 2, 3);
+  EXPECT_EQ(200, this->Plan(1));
+}
+
+TEST_F(MemoryPlanTest, TestAlignment) {
+  this->Add(10, 0, 1);
+  this->Add(10, 1, 2);
+  EXPECT_EQ(128, this->Plan(64));
+  EXPECT_EQ(0, this->offsets_[0]);
+  EXPECT_EQ(64, this->offsets_[1]);
+}
+
+TEST_F(MemoryPlanTest, TestRandom) {
+  Caffe::set_random_seed(1701);
+  caffe::rng_t* rng = caffe_rng();
+  for (int i = 0; i < 200; ++i) {
+    const int first = (*rng)() % 50;
+    this->Add(1 + (*rng)() % 1000, first, first + (*rng)() % 10);
+  }
+  this->Plan(16);
+}
+
+}  // namespace caffe
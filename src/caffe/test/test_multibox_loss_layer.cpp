@@ -0,0 +1,289 @@
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/multibox_loss_layer.hpp"
+#include "caffe/util/bbox_util.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+static const float kGroundTruth[][8] = {
+  // item_id, label, instance_id, xmin, ymin, xmax, ymax, difficult
+  {0, 1, 0, 0.1, 0.1, 0.4, 0.45, 0},
+  {1, 2, 0, 0.3, 0.2, 0.7, 0.6, 0},
+  {0, 2, 1, 0.5, 0.5, 0.9, 0.85, 0},
+  {1, 1, 1, 0.0, 0.6, 0.3, 0.95, 1},
+  {-1, -1, -1, -1, -1, -1, -1, -1},
+  {0, 1, 2, 0.55, 0.1, 0.95, 0.3, 0},
+};
+
+template <typename TypeParam>
+class MultiBoxLossLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  MultiBoxLossLayerTest()
+      : num_(3),
+        num_classes_(3),
+        grid_(3),
+        num_priors_(grid_ * grid_ * 2),
+        blob_bottom_loc_(new Blob<Dtype>()),
+        blob_bottom_conf_(new Blob<Dtype>()),
+        blob_bottom_prior_(new Blob<Dtype>(1, 2, num_priors_ * 4, 1)),
+        blob_bottom_gt_(new Blob<Dtype>(1, 1, 6, 8)),
+        blob_top_loss_(new Blob<Dtype>()) {
+    // Priors of two sizes centered on a grid, with variances.
+    Dtype* prior_data = blob_bottom_prior_->mutable_cpu_data();
+    Dtype* var_data = prior_data + num_priors_ * 4;
+    for (int h = 0; h < grid_; ++h) {
+      for (int w = 0; w < grid_; ++w) {
+        for (int s = 0; s < 2; ++s) {
+          const Dtype size = s ? 0.5 : 0.3;
+          const Dtype cx = (w + 0.5) / grid_;
+          const Dtype cy = (h + 0.5) / grid_;
+          prior_data[0] = cx - size / 2;
+          prior_data[1] = cy - size / 2;
+          prior_data[2] = cx + size / 2;
+          prior_data[3] = cy + size / 2;
+          prior_data += 4;
+          var_data[0] = 0.1;
+          var_data[1] = 0.1;
+          var_data[2] = 0.2;
+          var_data[3] = 0.2;
+          var_data += 4;
+        }
+      }
+    }
+    // The ground truth of image 0 and 1 is interleaved, image 2 has none.
+    Dtype* gt_data = blob_bottom_gt_->mutable_cpu_data();
+    for (int i = 0; i < blob_bottom_gt_->count(); ++i) {
+      gt_data[i] = kGroundTruth[i / 8][i % 8];
+    }
+    blob_bottom_vec_.push_back(blob_bottom_loc_);
+    blob_bottom_vec_.push_back(blob_bottom_conf_);
+    blob_bottom_vec_.push_back(blob_bottom_prior_);
+    blob_bottom_vec_.push_back(blob_bottom_gt_);
+    blob_top_vec_.push_back(blob_top_loss_);
+  }
+  virtual ~MultiBoxLossLayerTest() {
+    delete blob_bottom_loc_;
+    delete blob_bottom_conf_;
+    delete blob_bottom_prior_;
+    delete blob_bottom_gt_;
+    delete blob_top_loss_;
+  }
+
+  void FillPredictions(const bool share_location) {
+    const int loc_classes = share_location ? 1 : num_classes_;
+    blob_bottom_loc_->Reshape(num_, num_priors_ * loc_classes * 4, 1, 1);
+    blob_bottom_conf_->Reshape(num_, num_priors_ * num_classes_, 1, 1);
+    FillerParameter filler_param;
+    filler_param.set_std(0.5);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_loc_);
+    filler.Fill(blob_bottom_conf_);
+  }
+
+  LayerParameter MakeParam(const bool share_location,
+      const MultiBoxLossParameter_LocLossType loc_loss_type,
+      const MultiBoxLossParameter_ConfLossType conf_loss_type,
+      const MultiBoxLossParameter_MiningType mining_type,
+      const bool use_prior_for_matching) {
+    LayerParameter layer_param;
+    MultiBoxLossParameter* param = layer_param.mutable_multibox_loss_param();
+    param->set_num_classes(num_classes_);
+    param->set_share_location(share_location);
+    param->set_loc_loss_type(loc_loss_type);
+    param->set_conf_loss_type(conf_loss_type);
+    param->set_mining_type(mining_type);
+    param->set_use_prior_for_matching(use_prior_for_matching);
+    param->set_overlap_threshold(0.3);
+    param->set_neg_overlap(0.3);
+    param->set_neg_pos_ratio(2);
+    param->set_sample_size(6);
+    param->set_use_difficult_gt(false);
+    return layer_param;
+  }
+
+  // The loss computed by the batch level matching and mining of bbox_util,
+  // for the SOFTMAX confidence loss.
+  Dtype ReferenceLoss(const MultiBoxLossParameter& param) {
+    const int loc_classes = param.share_location() ? 1 : num_classes_;
+    vector<NormalizedBBox> prior_bboxes(num_priors_);
+    vector<vector<float> > prior_variances(num_priors_, vector<float>(4));
+    GetPriorBBoxes(blob_bottom_prior_->cpu_data(), num_priors_,
+                   &prior_bboxes, &prior_variances);
+    map<int, vector<NormalizedBBox> > all_gt_bboxes;
+    GetGroundTruth(blob_bottom_gt_->cpu_data(), blob_bottom_gt_->height(),
+                   param.background_label_id(), param.use_difficult_gt(),
+                   &all_gt_bboxes);
+    vector<LabelBBox> all_loc_preds;
+    GetLocPredictions(blob_bottom_loc_->cpu_data(), num_, num_priors_,
+                      loc_classes, param.share_location(), &all_loc_preds);
+    vector<map<int, vector<float> > > all_match_overlaps;
+    vector<map<int, vector<int> > > all_match_indices;
+    FindMatches(all_loc_preds, all_gt_bboxes, prior_bboxes, prior_variances,
+                param, &all_match_overlaps, &all_match_indices);
+    int num_matches = 0;
+    int num_negs = 0;
+    vector<vector<int> > all_neg_indices;
+    MineHardExamples(*blob_bottom_conf_, all_loc_preds, all_gt_bboxes,
+                     prior_bboxes, prior_variances, all_match_overlaps, param,
+                     &num_matches, &num_negs, &all_match_indices,
+                     &all_neg_indices);
+
+    Dtype loc_loss = 0;
+    if (num_matches > 0) {
+      vector<Dtype> loc_pred(num_matches * 4);
+      vector<Dtype> loc_gt(num_matches * 4);
+      EncodeLocPrediction(all_loc_preds, all_gt_bboxes, all_match_indices,
+                          prior_bboxes, prior_variances, param, &loc_pred[0],
+                          &loc_gt[0]);
+      for (int k = 0; k < num_matches * 4; ++k) {
+        const Dtype diff = loc_pred[k] - loc_gt[k];
+        if (param.loc_loss_type() ==
+            MultiBoxLossParameter_LocLossType_SMOOTH_L1) {
+          loc_loss += std::fabs(diff) < 1 ?
+              0.5 * diff * diff : std::fabs(diff) - 0.5;
+        } else {
+          loc_loss += 0.5 * diff * diff;
+        }
+      }
+    }
+    const bool mining =
+        param.mining_type() != MultiBoxLossParameter_MiningType_NONE;
+    const int num_conf = mining ? num_matches + num_negs : num_ * num_priors_;
+    vector<Dtype> conf_pred(num_conf * num_classes_);
+    vector<Dtype> conf_gt(num_conf, param.background_label_id());
+    if (!mining) {
+      caffe_copy(blob_bottom_conf_->count(), blob_bottom_conf_->cpu_data(),
+                 &conf_pred[0]);
+    }
+    EncodeConfPrediction(blob_bottom_conf_->cpu_data(), num_, num_priors_,
+                         param, all_match_indices, all_neg_indices,
+                         all_gt_bboxes, &conf_pred[0], &conf_gt[0]);
+    Dtype conf_loss = 0;
+    for (int n = 0; n < num_conf; ++n) {
+      const Dtype* conf = &conf_pred[n * num_classes_];
+      Dtype sum = 0;
+      for (int c = 0; c < num_classes_; ++c) {
+        sum += std::exp(conf[c]);
+      }
+      conf_loss -= std::log(std::exp(conf[static_cast<int>(conf_gt[n])]) /
+                            sum);
+    }
+    const Dtype normalizer = std::max(num_matches, 1);
+    return (param.loc_weight() * loc_loss + conf_loss) / normalizer;
+  }
+
+  int num_;
+  int num_classes_;
+  int grid_;
+  int num_priors_;
+  Blob<Dtype>* const blob_bottom_loc_;
+  Blob<Dtype>* const blob_bottom_conf_;
+  Blob<Dtype>* const blob_bottom_prior_;
+  Blob<Dtype>* const blob_bottom_gt_;
+  Blob<Dtype>* const blob_top_loss_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(MultiBoxLossLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(MultiBoxLossLayerTest, TestSetUp) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->FillPredictions(true);
+  LayerParameter layer_param = this->MakeParam(true,
+      MultiBoxLossParameter_LocLossType_SMOOTH_L1,
+      MultiBoxLossParameter_ConfLossType_SOFTMAX,
+      MultiBoxLossParameter_MiningType_MAX_NEGATIVE, true);
+  MultiBoxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_loss_->num_axes(), 0);
+}
+
+TYPED_TEST(MultiBoxLossLayerTest, TestForwardReference) {
+  typedef typename TypeParam::Dtype Dtype;
+  const MultiBoxLossParameter_MiningType kMiningTypes[] = {
+    MultiBoxLossParameter_MiningType_NONE,
+    MultiBoxLossParameter_MiningType_MAX_NEGATIVE,
+    MultiBoxLossParameter_MiningType_HARD_EXAMPLE,
+  };
+  for (int s = 0; s < 2; ++s) {
+    for (int l = 0; l < 2; ++l) {
+      for (int m = 0; m < 3; ++m) {
+        for (int p = 0; p < 2; ++p) {
+          this->FillPredictions(s);
+          LayerParameter layer_param = this->MakeParam(s,
+              l ? MultiBoxLossParameter_LocLossType_L2 :
+                  MultiBoxLossParameter_LocLossType_SMOOTH_L1,
+              MultiBoxLossParameter_ConfLossType_SOFTMAX, kMiningTypes[m], p);
+          MultiBoxLossLayer<Dtype> layer(layer_param);
+          layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+          // Twice, the second forward reusing the buffers of the first.
+          for (int iter = 0; iter < 2; ++iter) {
+            const Dtype loss =
+                layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+            const Dtype expected =
+                this->ReferenceLoss(layer_param.multibox_loss_param());
+            EXPECT_GT(expected, 0);
+            EXPECT_NEAR(expected, loss, 1e-4 * expected)
+                << "share_location " << s << " loc_loss_type " << l
+                << " mining_type " << m << " use_prior_for_matching " << p;
+            this->FillPredictions(s);
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(MultiBoxLossLayerTest, TestLocGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  for (int s = 0; s < 2; ++s) {
+    for (int l = 0; l < 2; ++l) {
+      this->FillPredictions(s);
+      LayerParameter layer_param = this->MakeParam(s,
+          l ? MultiBoxLossParameter_LocLossType_L2 :
+              MultiBoxLossParameter_LocLossType_SMOOTH_L1,
+          MultiBoxLossParameter_ConfLossType_SOFTMAX,
+          MultiBoxLossParameter_MiningType_MAX_NEGATIVE, true);
+      MultiBoxLossLayer<Dtype> layer(layer_param);
+      GradientChecker<Dtype> checker(1e-2, 1e-3);
+      checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+          this->blob_top_vec_, 0);
+    }
+  }
+}
+
+TYPED_TEST(MultiBoxLossLayerTest, TestConfGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  for (int s = 0; s < 2; ++s) {
+    for (int c = 0; c < 2; ++c) {
+      for (int m = 0; m < 2; ++m) {
+        this->FillPredictions(s);
+        LayerParameter layer_param = this->MakeParam(s,
+            MultiBoxLossParameter_LocLossType_SMOOTH_L1,
+            c ? MultiBoxLossParameter_ConfLossType_LOGISTIC :
+                MultiBoxLossParameter_ConfLossType_SOFTMAX,
+            m ? MultiBoxLossParameter_MiningType_MAX_NEGATIVE :
+                MultiBoxLossParameter_MiningType_NONE, true);
+        MultiBoxLossLayer<Dtype> layer(layer_param);
+        GradientChecker<Dtype> checker(1e-2, 1e-3);
+        checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+            this->blob_top_vec_, 1);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -10,6 +10,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -2446,6 +2447,860 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestFoldConstantLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'FoldNetwork' "
+      "fold_constant_layers: true "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'feat' "
+      "  top: 'data' "
+      "  input_param { "
+      "    shape { dim: 1 dim: 2 dim: 4 dim: 4 } "
+      "    shape { dim: 1 dim: 3 dim: 32 dim: 32 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'priorbox' "
+      "  type: 'PriorBox' "
+      "  bottom: 'feat' "
+      "  bottom: 'data' "
+      "  top: 'priors' "
+      "  prior_box_param { min_size: 8 max_size: 16 aspect_ratio: 2 } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Blob<Dtype> > priors = this->net_->blob_by_name("priors");
+  // The priors are computed at Init.
+  EXPECT_EQ(priors->count(), 2 * 4 * 4 * 4 * 4);
+  EXPECT_NE(priors->asum_data(), Dtype(0));
+  // They are not recomputed while the input shapes stay the same.
+  caffe_set(priors->count(), Dtype(0), priors->mutable_cpu_data());
+  this->net_->Forward();
+  EXPECT_EQ(priors->asum_data(), Dtype(0));
+  // A new geometry recomputes them.
+  this->net_->blob_by_name("feat")->Reshape(1, 2, 2, 2);
+  this->net_->Forward();
+  EXPECT_EQ(priors->count(), 2 * 2 * 2 * 4 * 4);
+  EXPECT_NE(priors->asum_data(), Dtype(0));
+}
+
+TYPED_TEST(NetTest, TestCompileNetFoldBNScale) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'FoldBNScaleNetwork' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 bias_term: false "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'scale1' "
+      "  type: 'Scale' "
+      "  bottom: 'conv1' "
+      "  top: 'scale1' "
+      "  scale_param { "
+      "    bias_term: true "
+      "    filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'scale1' "
+      "  top: 'scale1' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'scale1' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ipbn' "
+      "  type: 'BN' "
+      "  bottom: 'ip' "
+      "  top: 'ipbn' "
+      "  bn_param { "
+      "    slope_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 2 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn2' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv2' "
+      "  top: 'bn2' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv2' "
+      "  top: 'relu2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  // Give the normalization layers nontrivial statistics.
+  const char* bn_names[] = {"bn1", "bn2"};
+  for (int i = 0; i < 2; ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        this->net_->layer_by_name(bn_names[i])->blobs();
+    caffe_rng_uniform(blobs[0]->count(), Dtype(-1), Dtype(1),
+        blobs[0]->mutable_cpu_data());
+    caffe_rng_uniform(blobs[1]->count(), Dtype(0.5), Dtype(2),
+        blobs[1]->mutable_cpu_data());
+    blobs[2]->mutable_cpu_data()[0] = 2;
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& ipbn_blobs =
+      this->net_->layer_by_name("ipbn")->blobs();
+  caffe_rng_uniform(ipbn_blobs[2]->count(), Dtype(-1), Dtype(1),
+      ipbn_blobs[2]->mutable_cpu_data());
+  caffe_rng_uniform(ipbn_blobs[3]->count(), Dtype(0.5), Dtype(2),
+      ipbn_blobs[3]->mutable_cpu_data());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> data(2, 3, 6, 6);
+  filler.Fill(&data);
+  this->net_->input_blobs()[0]->CopyFrom(data);
+  this->net_->Forward();
+  Blob<Dtype> ipbn, bn2;
+  ipbn.CopyFrom(*this->net_->blob_by_name("ipbn"), false, true);
+  bn2.CopyFrom(*this->net_->blob_by_name("bn2"), false, true);
+  NetParameter trained;
+  this->net_->ToProto(&trained);
+
+  this->InitNetFromProtoString(proto +
+      "compile_net_state { bn_scale_merge: true } ");
+  const CompileNetState& state = this->net_->compile_net_state();
+  EXPECT_TRUE(state.bn_scale_remove());
+  ASSERT_EQ(3, state.fold_size());
+  EXPECT_EQ("bn1", state.fold(0).layer().name());
+  EXPECT_EQ("conv1", state.fold(0).target());
+  EXPECT_EQ("scale1", state.fold(1).layer().name());
+  EXPECT_EQ("conv1", state.fold(1).target());
+  EXPECT_EQ("ipbn", state.fold(2).layer().name());
+  EXPECT_EQ("ip", state.fold(2).target());
+  // bn2 is kept since relu2 also reads conv2.
+  ASSERT_EQ(1, state.kept_bn_layers_size());
+  EXPECT_EQ("bn2", state.kept_bn_layers(0));
+  EXPECT_FALSE(this->net_->has_layer("bn1"));
+  EXPECT_FALSE(this->net_->has_layer("scale1"));
+  EXPECT_FALSE(this->net_->has_layer("ipbn"));
+  EXPECT_FALSE(this->net_->has_blob("conv1"));
+  EXPECT_EQ(2, this->net_->layer_by_name("conv1")->blobs().size());
+
+  this->net_->CopyTrainedLayersFrom(trained);
+  this->net_->input_blobs()[0]->CopyFrom(data);
+  this->net_->Forward();
+  const Blob<Dtype>* folded_ipbn = this->net_->blob_by_name("ipbn").get();
+  ASSERT_EQ(ipbn.count(), folded_ipbn->count());
+  for (int i = 0; i < ipbn.count(); ++i) {
+    EXPECT_NEAR(ipbn.cpu_data()[i], folded_ipbn->cpu_data()[i], 1e-4);
+  }
+  const Blob<Dtype>* kept_bn2 = this->net_->blob_by_name("bn2").get();
+  for (int i = 0; i < bn2.count(); ++i) {
+    EXPECT_NEAR(bn2.cpu_data()[i], kept_bn2->cpu_data()[i], 1e-4);
+  }
+
+  // The folded weights load into the compiled net as they are.
+  NetParameter folded;
+  this->net_->ToProto(&folded);
+  this->net_->CopyTrainedLayersFrom(folded);
+  this->net_->Forward();
+  for (int i = 0; i < ipbn.count(); ++i) {
+    EXPECT_NEAR(ipbn.cpu_data()[i], folded_ipbn->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestCompileNetFuseActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'FuseActivationsNetwork' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 4 dim: 6 dim: 6 } } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 bias_term: false "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bias1' "
+      "  type: 'Bias' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  bias_param { filler { type: 'gaussian' } } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  relu_param { negative_slope: 0.1 } "
+      "} "
+      "layer { "
+      "  name: 'dw' "
+      "  type: 'ConvolutionDepthwise' "
+      "  bottom: 'conv1' "
+      "  top: 'dw' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 stride: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu6' "
+      "  type: 'ReLU6' "
+      "  bottom: 'dw' "
+      "  top: 'dw6' "
+      "} "
+      "layer { "
+      "  name: 'res' "
+      "  type: 'Eltwise' "
+      "  bottom: 'data' "
+      "  bottom: 'dw6' "
+      "  top: 'res' "
+      "} "
+      "layer { "
+      "  name: 'swish' "
+      "  type: 'Swish' "
+      "  bottom: 'res' "
+      "  top: 'res' "
+      "  swish_param { beta: 1.5 } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'res' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'mish' "
+      "  type: 'Mish' "
+      "  bottom: 'ip' "
+      "  top: 'mish' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> data(2, 4, 6, 6);
+  filler.Fill(&data);
+  this->net_->input_blobs()[0]->CopyFrom(data);
+  this->net_->Forward();
+  const char* blob_names[] = {"conv1", "dw6", "res", "mish"};
+  vector<shared_ptr<Blob<Dtype> > > expected(4);
+  for (int i = 0; i < 4; ++i) {
+    expected[i].reset(new Blob<Dtype>());
+    expected[i]->CopyFrom(*this->net_->blob_by_name(blob_names[i]), false,
+                          true);
+  }
+  NetParameter trained;
+  this->net_->ToProto(&trained);
+
+  this->InitNetFromProtoString(proto + "compile_net_state { "
+      "bn_scale_merge: true fuse_activations: true } ");
+  const CompileNetState& state = this->net_->compile_net_state();
+  ASSERT_EQ(1, state.fold_size());
+  EXPECT_EQ("bias1", state.fold(0).layer().name());
+  EXPECT_EQ("conv1", state.fold(0).target());
+  if (Caffe::mode() == Caffe::CPU) {
+    const char* fused[] = {"relu1", "relu6", "swish", "mish"};
+    const char* targets[] = {"conv1", "dw", "res", "ip"};
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_FALSE(this->net_->has_layer(fused[i]));
+      EXPECT_EQ(fused[i], this->net_->layer_by_name(targets[i])
+          ->layer_param().fused_activation().name());
+    }
+    EXPECT_FALSE(this->net_->has_blob("dw"));
+    EXPECT_FALSE(this->net_->has_blob("ip"));
+  }
+
+  this->net_->CopyTrainedLayersFrom(trained);
+  this->net_->input_blobs()[0]->CopyFrom(data);
+  this->net_->Forward();
+  for (int i = 0; i < 4; ++i) {
+    const Blob<Dtype>* blob = this->net_->blob_by_name(blob_names[i]).get();
+    ASSERT_EQ(expected[i]->count(), blob->count());
+    for (int j = 0; j < blob->count(); ++j) {
+      EXPECT_NEAR(expected[i]->cpu_data()[j], blob->cpu_data()[j], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestPlanActivationMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'PlannedNetwork' "
+      "fold_constant_layers: true "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'priorbox' "
+      "  type: 'PriorBox' "
+      "  bottom: 'conv1' "
+      "  bottom: 'data' "
+      "  top: 'priors' "
+      "  prior_box_param { min_size: 2 max_size: 4 aspect_ratio: 2 } "
+      "} "
+      "layer { "
+      "  name: 'power' "
+      "  type: 'Power' "
+      "  bottom: 'priors' "
+      "  top: 'scaled_priors' "
+      "  power_param { scale: 2 } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv3' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv2' "
+      "  top: 'conv3' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'conv2' "
+      "  bottom: 'conv3' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'permute' "
+      "  type: 'Permute' "
+      "  bottom: 'sum' "
+      "  top: 'permuted' "
+      "  permute_param { order: 0 order: 1 order: 2 order: 3 } "
+      "} "
+      "layer { "
+      "  name: 'flatten' "
+      "  type: 'Flatten' "
+      "  bottom: 'permuted' "
+      "  top: 'flat' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'flat' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> reference(param);
+  NetParameter trained;
+  reference.ToProto(&trained);
+  EXPECT_EQ(0, reference.activation_arena_size());
+  param.set_plan_activation_memory(true);
+  Net<Dtype> planned(param);
+  planned.CopyTrainedLayersFrom(trained);
+  // conv1 and sum can share their memory, but conv2 and conv3 cannot
+  // share theirs with any other intermediate blob.
+  const size_t blob_size = 2 * 4 * 8 * 8 * sizeof(Dtype);
+  EXPECT_GE(planned.activation_arena_size(), 3 * blob_size);
+  EXPECT_LT(planned.activation_arena_size(), 4 * blob_size);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  const char* outputs[] = {"ip", "scaled_priors"};
+  for (int iter = 0; iter < 3; ++iter) {
+    // A larger batch on the last pass outgrows the plan.
+    const int num = iter < 2 ? 2 : 3;
+    Blob<Dtype> data(num, 3, 8, 8);
+    filler.Fill(&data);
+    reference.input_blobs()[0]->CopyFrom(data, false, true);
+    planned.input_blobs()[0]->CopyFrom(data, false, true);
+    reference.Forward();
+    planned.Forward();
+    for (int i = 0; i < 2; ++i) {
+      const Blob<Dtype>& expected = *reference.blob_by_name(outputs[i]);
+      const Blob<Dtype>& actual = *planned.blob_by_name(outputs[i]);
+      ASSERT_EQ(expected.shape(), actual.shape());
+      for (int j = 0; j < expected.count(); ++j) {
+        EXPECT_EQ(expected.cpu_data()[j], actual.cpu_data()[j])
+            << outputs[i] << " " << j << " at pass " << iter;
+      }
+    }
+  }
+  EXPECT_GE(planned.activation_arena_size(), 3 * blob_size * 3 / 2);
+  // Nets with backward keep their memory.
+  param.set_force_backward(true);
+  Net<Dtype> backward(param);
+  EXPECT_EQ(0, backward.activation_arena_size());
+}
+
+TYPED_TEST(NetTest, TestPlanActivationMemoryUnfoldedPriors) {
+  typedef typename TypeParam::Dtype Dtype;
+  // An SSD head without constant folding: PriorBox runs on every pass, after
+  // conv1 is dead, so the planner could give its top the memory of conv1.
+  const string& proto =
+      "name: 'PlannedDetectionNetwork' "
+      "plan_activation_memory: true "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 1 dim: 3 dim: 8 dim: 8 } } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 16 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'feat' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'priorbox' "
+      "  type: 'PriorBox' "
+      "  bottom: 'feat' "
+      "  bottom: 'data' "
+      "  top: 'priors' "
+      "  prior_box_param { "
+      "    min_size: 2 max_size: 4 aspect_ratio: 2 variance: 0.1 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'loc' "
+      "  type: 'Convolution' "
+      "  bottom: 'feat' "
+      "  top: 'loc' "
+      "  convolution_param { "
+      "    num_output: 16 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'loc_perm' "
+      "  type: 'Permute' "
+      "  bottom: 'loc' "
+      "  top: 'loc_perm' "
+      "  permute_param { order: 0 order: 2 order: 3 order: 1 } "
+      "} "
+      "layer { "
+      "  name: 'loc_flat' "
+      "  type: 'Flatten' "
+      "  bottom: 'loc_perm' "
+      "  top: 'loc_flat' "
+      "} "
+      "layer { "
+      "  name: 'conf' "
+      "  type: 'Convolution' "
+      "  bottom: 'feat' "
+      "  top: 'conf' "
+      "  convolution_param { "
+      "    num_output: 8 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conf_perm' "
+      "  type: 'Permute' "
+      "  bottom: 'conf' "
+      "  top: 'conf_perm' "
+      "  permute_param { order: 0 order: 2 order: 3 order: 1 } "
+      "} "
+      "layer { "
+      "  name: 'conf_flat' "
+      "  type: 'Flatten' "
+      "  bottom: 'conf_perm' "
+      "  top: 'conf_flat' "
+      "} "
+      "layer { "
+      "  name: 'conf_prob' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'conf_flat' "
+      "  top: 'conf_prob' "
+      "} "
+      "layer { "
+      "  name: 'detection' "
+      "  type: 'DetectionOutput' "
+      "  bottom: 'loc_flat' "
+      "  bottom: 'conf_prob' "
+      "  bottom: 'priors' "
+      "  top: 'detections' "
+      "  detection_output_param { "
+      "    num_classes: 2 share_location: true background_label_id: 0 "
+      "    nms_param { nms_threshold: 0.45 top_k: 50 } "
+      "    code_type: CENTER_SIZE keep_top_k: 20 confidence_threshold: 0.5 "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> planned(param);
+  EXPECT_GT(planned.activation_arena_size(), 0);
+  NetParameter trained;
+  planned.ToProto(&trained);
+  param.set_plan_activation_memory(false);
+  Net<Dtype> reference(param);
+  reference.CopyTrainedLayersFrom(trained);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int iter = 0; iter < 2; ++iter) {
+    Blob<Dtype> data(1, 3, 8, 8);
+    filler.Fill(&data);
+    reference.input_blobs()[0]->CopyFrom(data);
+    planned.input_blobs()[0]->CopyFrom(data);
+    reference.Forward();
+    planned.Forward();
+    const char* blobs[] = {"priors", "detections"};
+    for (int i = 0; i < 2; ++i) {
+      const Blob<Dtype>& expected = *reference.blob_by_name(blobs[i]);
+      const Blob<Dtype>& actual = *planned.blob_by_name(blobs[i]);
+      ASSERT_EQ(expected.shape(), actual.shape())
+          << blobs[i] << " at pass " << iter;
+      for (int j = 0; j < expected.count(); ++j) {
+        EXPECT_EQ(expected.cpu_data()[j], actual.cpu_data()[j])
+            << blobs[i] << " " << j << " at pass " << iter;
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestCheckNoDiff) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'InferenceNetwork' "
+      "check_no_diff: true "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv' "
+      "  top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'pool' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'prob' "
+      "  type: 'Softmax' "
+      "  bottom: 'ip' "
+      "  top: 'prob' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.input_blobs()[0]);
+  // The check fails the forward pass if any layer allocates a diff.
+  net.Forward();
+  net.Forward();
+  size_t data_bytes = 0;
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_FALSE(net.blobs()[i]->diff_allocated()) << net.blob_names()[i];
+    data_bytes += net.blobs()[i]->count() * sizeof(Dtype);
+  }
+  for (int i = 0; i < net.params().size(); ++i) {
+    EXPECT_FALSE(net.params()[i]->diff_allocated());
+    data_bytes += net.params()[i]->count() * sizeof(Dtype);
+  }
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_EQ(data_bytes, net.ResidentBytes(true));
+  } else {
+    EXPECT_GE(net.ResidentBytes(true), data_bytes);
+  }
+  // Diffs count once they are used.
+  const size_t before = net.ResidentBytes();
+  Blob<Dtype>* weights = net.params()[0].get();
+  weights->mutable_cpu_diff();
+  EXPECT_EQ(before + weights->count() * sizeof(Dtype), net.ResidentBytes());
+}
+
+TYPED_TEST(NetTest, TestCopyTrainedLayersFromMapped) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'MappedNetwork' "
+      "layer { "
+      "  name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 } } "
+      "} "
+      "layer { "
+      "  name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' "
+      "  param { name: 'shared' } "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'gaussian' std: 1 } } "
+      "} "
+      "layer { "
+      "  name: 'ip2' type: 'InnerProduct' bottom: 'ip1' top: 'ip2' "
+      "  param { name: 'shared' } "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'gaussian' std: 1 } } "
+      "} ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> data(this->net_->input_blobs()[0]->shape());
+  filler.Fill(&data);
+  this->net_->input_blobs()[0]->CopyFrom(data);
+  this->net_->Forward();
+  Blob<Dtype> reference;
+  reference.CopyFrom(*this->net_->blob_by_name("ip2"), false, true);
+  NetParameter trained;
+  this->net_->ToProto(&trained);
+  string filename;
+  MakeTempFilename(&filename);
+  MappedWeights::Write(trained, filename);
+  EXPECT_TRUE(MappedWeights::IsMappedWeights(filename));
+
+  // The weights are stored as float.
+  const Dtype kErrorBound = sizeof(Dtype) == sizeof(float) ? 0 : 1e-5;
+  for (int copy = 0; copy < 2; ++copy) {
+    this->InitNetFromProtoString(proto);
+    this->net_->CopyTrainedLayersFrom(filename);
+    Blob<Dtype>* ip1_weights = this->net_->layer_by_name("ip1")->blobs()[0]
+        .get();
+    Blob<Dtype>* ip2_weights = this->net_->layer_by_name("ip2")->blobs()[0]
+        .get();
+    EXPECT_EQ(ip1_weights->cpu_data(), ip2_weights->cpu_data());
+    this->net_->input_blobs()[0]->CopyFrom(data);
+    this->net_->Forward();
+    const Blob<Dtype>* ip2 = this->net_->blob_by_name("ip2").get();
+    for (int i = 0; i < reference.count(); ++i) {
+      EXPECT_NEAR(reference.cpu_data()[i], ip2->cpu_data()[i], kErrorBound);
+    }
+    // Writing to the parameters leaves the file unchanged for the next copy.
+    caffe_set(ip1_weights->count(), Dtype(0), ip1_weights->mutable_cpu_data());
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardStreams) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumSteps = 3;
+  const int kNumStreams = 2;
+  const int kInputDim = 3;
+  const char* engines[] = { "UNROLLED", "FUSED" };
+  for (int e = 0; e < 2; ++e) {
+    const string proto =
+        "name: 'StreamingNetwork' "
+        "state: { phase: TEST } "
+        "layer { "
+        "  name: 'input' "
+        "  type: 'Input' "
+        "  top: 'x' "
+        "  top: 'cont' "
+        "  input_param { "
+        "    shape { dim: 1 dim: 1 dim: 3 } "
+        "    shape { dim: 1 dim: 1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'lstm' "
+        "  type: 'LSTM' "
+        "  bottom: 'x' "
+        "  bottom: 'cont' "
+        "  top: 'h' "
+        "  recurrent_param { "
+        "    num_output: 4 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "    engine: " + string(engines[e]) + " "
+        "  } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    Net<Dtype> net(param);
+    Blob<Dtype>* x = net.input_blobs()[0];
+    Blob<Dtype>* cont = net.input_blobs()[1];
+    Blob<Dtype>* h = net.output_blobs()[0];
+    Blob<Dtype> inputs(kNumSteps, kNumStreams, kInputDim, 1);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&inputs);
+    // Run each stream alone, one step at a time.
+    vector<int> shape(3, 1);
+    shape[2] = kInputDim;
+    x->Reshape(shape);
+    shape.resize(2);
+    cont->Reshape(shape);
+    cont->mutable_cpu_data()[0] = 1;
+    vector<vector<Dtype> > alone(kNumSteps * kNumStreams);
+    for (int s = 0; s < kNumStreams; ++s) {
+      for (int t = 0; t < kNumSteps; ++t) {
+        caffe_copy(kInputDim, inputs.cpu_data() + inputs.offset(t, s),
+            x->mutable_cpu_data());
+        net.ForwardStreams(vector<int>(1, s));
+        alone[t * kNumStreams + s].assign(h->cpu_data(),
+            h->cpu_data() + h->count());
+      }
+    }
+    EXPECT_EQ(kNumStreams, net.num_streams());
+    net.EndAllStreams();
+    EXPECT_EQ(0, net.num_streams());
+    // Batch the streams, in swapped slots every other step.
+    shape[1] = kNumStreams;
+    cont->Reshape(shape);
+    caffe_set(kNumStreams, Dtype(1), cont->mutable_cpu_data());
+    shape.push_back(kInputDim);
+    x->Reshape(shape);
+    for (int t = 0; t < kNumSteps; ++t) {
+      vector<int> stream_ids;
+      for (int n = 0; n < kNumStreams; ++n) {
+        const int s = (t % 2) ? kNumStreams - 1 - n : n;
+        stream_ids.push_back(s);
+        caffe_copy(kInputDim, inputs.cpu_data() + inputs.offset(t, s),
+            x->mutable_cpu_data() + n * kInputDim);
+      }
+      net.ForwardStreams(stream_ids);
+      for (int n = 0; n < kNumStreams; ++n) {
+        const vector<Dtype>& expected = alone[t * kNumStreams + stream_ids[n]];
+        for (int i = 0; i < expected.size(); ++i) {
+          EXPECT_NEAR(expected[i], h->cpu_data()[n * expected.size() + i],
+              1e-5) << engines[e] << " t = " << t << "; n = " << n;
+        }
+      }
+    }
+    // An ended stream starts over.
+    net.EndStream(0);
+    EXPECT_EQ(kNumStreams - 1, net.num_streams());
+    for (int n = 0; n < kNumStreams; ++n) {
+      caffe_copy(kInputDim, inputs.cpu_data() + inputs.offset(0, 0),
+          x->mutable_cpu_data() + n * kInputDim);
+    }
+    vector<int> stream_ids(1, 0);
+    stream_ids.push_back(kNumStreams);
+    net.ForwardStreams(stream_ids);
+    for (int n = 0; n < kNumStreams; ++n) {
+      const vector<Dtype>& expected = alone[0];
+      for (int i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(expected[i], h->cpu_data()[n * expected.size() + i],
+            1e-5) << engines[e] << " n = " << n;
+      }
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetProfilerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void SetUp() {
+    const string proto =
+        "name: 'ProfiledNet' "
+        "layer { name: 'input' type: 'Input' top: 'data' top: 'target' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "                shape { dim: 2 dim: 5 } } } "
+        "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { num_output: 4 kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+        "layer { name: 'pool' type: 'Pooling' bottom: 'conv' top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'pool' top: 'ip' "
+        "  inner_product_param { num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'loss' type: 'EuclideanLoss' bottom: 'ip' "
+        "  bottom: 'target' top: 'loss' } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  int LayerId(const string& name) {
+    const vector<string>& names = net_->layer_names();
+    return std::find(names.begin(), names.end(), name) - names.begin();
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetProfilerTest, TestCounts) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get());
+  const int iterations = 5;
+  for (int i = 0; i < iterations; ++i) {
+    this->net_->Forward();
+    this->net_->Backward();
+  }
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    for (int pass = 0; pass < 2; ++pass) {
+      const typename NetProfiler<Dtype>::Pass p =
+          static_cast<typename NetProfiler<Dtype>::Pass>(pass);
+      const typename NetProfiler<Dtype>::Stats& stats = profiler.stats(i, p);
+      EXPECT_EQ(iterations, stats.count);
+      EXPECT_EQ(iterations, stats.samples.size());
+      EXPECT_LE(stats.min_us, stats.max_us);
+      EXPECT_LE(stats.min_us, profiler.Percentile(i, p, 50));
+      EXPECT_LE(profiler.Percentile(i, p, 50), profiler.Percentile(i, p, 99));
+      EXPECT_LE(profiler.Percentile(i, p, 99), stats.max_us);
+    }
+  }
+  // A forward only run, as in inference.
+  profiler.Reset();
+  this->net_->Forward();
+  EXPECT_EQ(1, profiler.stats(0, NetProfiler<Dtype>::FORWARD).count);
+  EXPECT_EQ(0, profiler.stats(0, NetProfiler<Dtype>::BACKWARD).count);
+}
+
+TYPED_TEST(NetProfilerTest, TestEstimates) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get());
+  this->net_->Forward();
+  this->net_->Backward();
+  const typename NetProfiler<Dtype>::Pass forward =
+      NetProfiler<Dtype>::FORWARD;
+  const typename NetProfiler<Dtype>::Pass backward =
+      NetProfiler<Dtype>::BACKWARD;
+  // conv: 2 x 4 x 6 x 6 outputs of 3 x 3 x 3 multiply-adds.
+  const int conv = this->LayerId("conv");
+  EXPECT_EQ(2 * 288 * 27, profiler.stats(conv, forward).flops);
+  EXPECT_EQ(2 * 2 * 288 * 27, profiler.stats(conv, backward).flops);
+  EXPECT_EQ((384 + 288 + 108 + 4) * sizeof(Dtype),
+      profiler.stats(conv, forward).bytes);
+  // relu is in-place.
+  const int relu = this->LayerId("relu");
+  EXPECT_EQ(288, profiler.stats(relu, forward).flops);
+  EXPECT_EQ(288 * sizeof(Dtype), profiler.stats(relu, forward).bytes);
+  // pool: 2 x 4 x 3 x 3 outputs of 2 x 2 windows.
+  const int pool = this->LayerId("pool");
+  EXPECT_EQ(72 * 4, profiler.stats(pool, forward).flops);
+  // ip: 2 rows times 5 x 36 weights.
+  const int ip = this->LayerId("ip");
+  EXPECT_EQ(2 * 2 * 180, profiler.stats(ip, forward).flops);
+  // The input does not need backward.
+  const int input = this->LayerId("input");
+  EXPECT_EQ(0, profiler.stats(input, backward).flops);
+  EXPECT_EQ(0, profiler.stats(input, backward).bytes);
+}
+
+TYPED_TEST(NetProfilerTest, TestJSON) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get());
+  this->net_->Forward();
+  const string json = profiler.ToJSON();
+  EXPECT_NE(string::npos, json.find("\"net\": \"ProfiledNet\""));
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    EXPECT_NE(string::npos,
+        json.find("{\"name\": \"" + this->net_->layer_names()[i] + "\", "
+                  "\"type\": \"" + this->net_->layers()[i]->type() + "\""));
+  }
+  EXPECT_NE(string::npos, json.find("\"p99_ms\": "));
+  string filename;
+  MakeTempFilename(&filename);
+  profiler.WriteJSON(filename);
+  std::ifstream file(filename.c_str());
+  std::stringstream contents;
+  contents << file.rdbuf();
+  EXPECT_EQ(json, contents.str());
+}
+
+TYPED_TEST(NetProfilerTest, TestChromeTrace) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int max_trace_events = 8;
+  NetProfiler<Dtype> profiler(this->net_.get(), 10, max_trace_events);
+  this->net_->Forward();
+  this->net_->Backward();
+  string filename;
+  MakeTempFilename(&filename);
+  profiler.WriteChromeTrace(filename);
+  std::ifstream file(filename.c_str());
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const string trace = contents.str();
+  EXPECT_EQ(0, trace.find("{\"traceEvents\": ["));
+  int events = 0;
+  for (size_t pos = trace.find("\"ph\": \"X\""); pos != string::npos;
+       pos = trace.find("\"ph\": \"X\"", pos + 1)) {
+    ++events;
+  }
+  EXPECT_EQ(max_trace_events, events);
+  EXPECT_NE(string::npos,
+      trace.find("\"name\": \"conv\", \"cat\": \"forward\""));
+  EXPECT_NE(string::npos,
+      trace.find("\"name\": \"loss\", \"cat\": \"backward\""));
+}
+
+TYPED_TEST(NetProfilerTest, TestDetach) {
+  typedef typename TypeParam::Dtype Dtype;
+  {
+    NetProfiler<Dtype> profiler(this->net_.get());
+    EXPECT_EQ(1, this->net_->before_forward().size());
+    EXPECT_EQ(1, this->net_->after_forward().size());
+    EXPECT_EQ(1, this->net_->before_backward().size());
+    EXPECT_EQ(1, this->net_->after_backward().size());
+  }
+  EXPECT_EQ(0, this->net_->before_forward().size());
+  EXPECT_EQ(0, this->net_->after_forward().size());
+  EXPECT_EQ(0, this->net_->before_backward().size());
+  EXPECT_EQ(0, this->net_->after_backward().size());
+  this->net_->Forward();
+  this->net_->Backward();
+}
+
+}  // namespace caffe
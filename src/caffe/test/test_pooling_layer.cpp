@@ -540,6 +540,60 @@ TYPED_TEST(PoolingLayerTest, TestGradientMaxTopMask) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The TEST phase skips the argmax and has kernels for 2x2 and 3x3 windows
+  // with stride 2; it must match the TRAIN phase.
+  const int configs[][4] = {  // kernel, stride, pad, ceil
+      {2, 2, 0, 0}, {2, 2, 0, 1}, {2, 2, 1, 1}, {3, 2, 0, 0}, {3, 2, 0, 1},
+      {3, 2, 1, 0}, {3, 2, 1, 1}, {3, 1, 1, 0}};
+  this->blob_bottom_->Reshape(2, 3, 19, 37);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  Blob<Dtype> expected;
+  vector<Blob<Dtype>*> expected_vec(1, &expected);
+  for (int i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(configs[i][0]);
+    pooling_param->set_stride(configs[i][1]);
+    pooling_param->set_pad(configs[i][2]);
+    pooling_param->set_ceil_mode(configs[i][3]);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    PoolingLayer<Dtype> train_layer(layer_param);
+    train_layer.SetUp(this->blob_bottom_vec_, expected_vec);
+    train_layer.Forward(this->blob_bottom_vec_, expected_vec);
+    layer_param.set_phase(TEST);
+    PoolingLayer<Dtype> test_layer(layer_param);
+    test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(expected.shape(), this->blob_top_->shape());
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_EQ(expected.cpu_data()[j], this->blob_top_->cpu_data()[j])
+          << "config " << i << " at " << j;
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestGradientMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Backward finds the argmax the TEST phase did not write.
+  for (int kernel = 2; kernel <= 3; kernel++) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(kernel);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    PoolingLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-4, 1e-2);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestForwardAve) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
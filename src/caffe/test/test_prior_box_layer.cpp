@@ -44,6 +44,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/prior_box_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -596,4 +597,30 @@ TYPED_TEST(PriorBoxLayerTest, TestCPUFixStep) {
   }
 }
 
+TYPED_TEST(PriorBoxLayerTest, TestCPUGeometryChange) {
+  LayerParameter layer_param;
+  PriorBoxParameter* prior_box_param = layer_param.mutable_prior_box_param();
+  prior_box_param->add_min_size(this->min_size_);
+  prior_box_param->add_max_size(this->max_size_);
+  prior_box_param->add_aspect_ratio(2.);
+  PriorBoxLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Overwrite the priors; the next forward must rebuild them.
+  caffe_set(this->blob_top_->count(), TypeParam(-1),
+      this->blob_top_->mutable_cpu_data());
+  // Forward again on a new feature map size, and compare with a fresh layer.
+  this->blob_bottom_->Reshape(10, 10, 20, 5);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<TypeParam> expected;
+  vector<Blob<TypeParam>*> expected_vec(1, &expected);
+  PriorBoxLayer<TypeParam> fresh_layer(layer_param);
+  fresh_layer.SetUp(this->blob_bottom_vec_, expected_vec);
+  fresh_layer.Forward(this->blob_bottom_vec_, expected_vec);
+  ASSERT_EQ(this->blob_top_->count(), expected.count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], expected.cpu_data()[i]);
+  }
+}
+
 }  // namespace caffe
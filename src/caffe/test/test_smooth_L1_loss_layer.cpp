@@ -0,0 +1,147 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/smooth_L1_loss_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class SmoothL1LossLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  SmoothL1LossLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(10, 5, 1, 1)),
+        blob_bottom_label_(new Blob<Dtype>(10, 5, 1, 1)),
+        blob_bottom_inside_weights_(new Blob<Dtype>(10, 5, 1, 1)),
+        blob_bottom_outside_weights_(new Blob<Dtype>(10, 5, 1, 1)),
+        blob_top_loss_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_label_);
+    filler_param.set_min(0.5);
+    filler_param.set_max(1.5);
+    UniformFiller<Dtype> weight_filler(filler_param);
+    weight_filler.Fill(this->blob_bottom_inside_weights_);
+    weight_filler.Fill(this->blob_bottom_outside_weights_);
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_loss_);
+  }
+  virtual ~SmoothL1LossLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+    delete blob_bottom_inside_weights_;
+    delete blob_bottom_outside_weights_;
+    delete blob_top_loss_;
+  }
+
+  // Place the weighted differences on both sides of the kinks at +-1 / sigma^2
+  // but away from them, where the numerical gradient is not accurate.
+  void FillData(const Dtype sigma, const bool weighted) {
+    const int count = blob_bottom_data_->count();
+    vector<Dtype> x(count);
+    caffe_rng_uniform<Dtype>(count, 0.1, 0.9, &x[0]);
+    const Dtype* label = blob_bottom_label_->cpu_data();
+    const Dtype* inside = blob_bottom_inside_weights_->cpu_data();
+    Dtype* data = blob_bottom_data_->mutable_cpu_data();
+    for (int i = 0; i < count; ++i) {
+      Dtype diff = (i % 2 ? x[i] : 1.2 + 2 * x[i]) / sigma / sigma;
+      if (i % 3 == 0) {
+        diff = -diff;
+      }
+      data[i] = label[i] + (weighted ? diff / inside[i] : diff);
+    }
+  }
+
+  void UseWeights() {
+    blob_bottom_vec_.push_back(blob_bottom_inside_weights_);
+    blob_bottom_vec_.push_back(blob_bottom_outside_weights_);
+  }
+
+  void TestForward(const Dtype sigma, const bool weighted) {
+    FillData(sigma, weighted);
+    if (weighted) {
+      UseWeights();
+    }
+    LayerParameter layer_param;
+    layer_param.mutable_smooth_l1_loss_param()->set_sigma(sigma);
+    SmoothL1LossLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype loss =
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Dtype expected_loss = 0;
+    for (int i = 0; i < blob_bottom_data_->count(); ++i) {
+      Dtype diff = blob_bottom_data_->cpu_data()[i] -
+          blob_bottom_label_->cpu_data()[i];
+      if (weighted) {
+        diff *= blob_bottom_inside_weights_->cpu_data()[i];
+      }
+      const Dtype sigma2 = sigma * sigma;
+      Dtype error = std::fabs(diff) < 1 / sigma2 ?
+          0.5 * sigma2 * diff * diff : std::fabs(diff) - 0.5 / sigma2;
+      if (weighted) {
+        error *= blob_bottom_outside_weights_->cpu_data()[i];
+      }
+      expected_loss += error;
+    }
+    expected_loss /= blob_bottom_data_->num();
+    EXPECT_NEAR(expected_loss, loss, 1e-5);
+    // Make sure the loss is non-trivial.
+    EXPECT_GE(loss, 1e-1);
+  }
+
+  void TestGradient(const Dtype sigma, const bool weighted) {
+    FillData(sigma, weighted);
+    if (weighted) {
+      UseWeights();
+    }
+    LayerParameter layer_param;
+    const Dtype kLossWeight = 3.7;
+    layer_param.add_loss_weight(kLossWeight);
+    layer_param.mutable_smooth_l1_loss_param()->set_sigma(sigma);
+    SmoothL1LossLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    GradientChecker<Dtype> checker(1e-3, 1e-2, 1701);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_, 0);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_, 1);
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_bottom_inside_weights_;
+  Blob<Dtype>* const blob_bottom_outside_weights_;
+  Blob<Dtype>* const blob_top_loss_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(SmoothL1LossLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(SmoothL1LossLayerTest, TestForward) {
+  this->TestForward(1, false);
+}
+
+TYPED_TEST(SmoothL1LossLayerTest, TestForwardSigmaWeights) {
+  this->TestForward(3, true);
+}
+
+TYPED_TEST(SmoothL1LossLayerTest, TestGradient) {
+  this->TestGradient(1, false);
+}
+
+TYPED_TEST(SmoothL1LossLayerTest, TestGradientSigmaWeights) {
+  this->TestGradient(3, true);
+}
+
+}  // namespace caffe
@@ -0,0 +1,53 @@
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  void Record(int i, int worker) {
+    calls_[i] += 1;
+    workers_[i] = worker;
+  }
+
+  void TestRun(int size, int n) {
+    ThreadPool pool(size);
+    EXPECT_EQ(size, pool.size());
+    // Several runs on the same pool.
+    for (int run = 0; run < 3; ++run) {
+      calls_.assign(n, 0);
+      workers_.assign(n, -1);
+      pool.Run(n, boost::bind(&ThreadPoolTest::Record, this, _1, _2));
+      for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(1, calls_[i]) << "i " << i;
+        EXPECT_GE(workers_[i], 0);
+        EXPECT_LT(workers_[i], size);
+      }
+    }
+  }
+
+  vector<int> calls_;
+  vector<int> workers_;
+};
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  this->TestRun(1, 17);
+}
+
+TEST_F(ThreadPoolTest, TestMultipleThreads) {
+  this->TestRun(3, 100);
+}
+
+TEST_F(ThreadPoolTest, TestFewerItemsThanThreads) {
+  this->TestRun(4, 2);
+  this->TestRun(4, 0);
+}
+
+}  // namespace caffe
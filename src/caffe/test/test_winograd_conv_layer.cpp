@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class WinogradConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  WinogradConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 17, 19)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_ref_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_ref_vec_.push_back(blob_top_ref_);
+  }
+  virtual ~WinogradConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_ref_;
+  }
+
+  LayerParameter MakeParam(int tile, int pad, int stride, int group) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_pad(pad);
+    convolution_param->add_stride(stride);
+    convolution_param->set_num_output(6);
+    convolution_param->set_group(group);
+    convolution_param->set_winograd_tile(tile);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    return layer_param;
+  }
+
+  // Compares the outputs of layer and of the CAFFE engine with its weights.
+  void CheckForward(Layer<Dtype>* layer, const LayerParameter& layer_param) {
+    ConvolutionLayer<Dtype> reference(layer_param);
+    reference.SetUp(blob_bottom_vec_, blob_top_ref_vec_);
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      reference.blobs()[i]->CopyFrom(*layer->blobs()[i]);
+    }
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    reference.Forward(blob_bottom_vec_, blob_top_ref_vec_);
+    ASSERT_TRUE(blob_top_->shape() == blob_top_ref_->shape());
+    const Dtype* data = blob_top_->cpu_data();
+    const Dtype* ref_data = blob_top_ref_->cpu_data();
+    // The rounding of the transforms grows with the outputs.
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(data[i], ref_data[i],
+                  1e-4 * std::max(Dtype(1), std::fabs(ref_data[i])));
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_ref_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> blob_top_ref_vec_;
+};
+
+TYPED_TEST_CASE(WinogradConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForward) {
+  // Tiles of 2 and 4, with and without padding and groups; 17 x 19 inputs
+  // leave partial tiles on the bottom and right edges.
+  for (int tile = 2; tile <= 4; tile += 2) {
+    for (int pad = 0; pad <= 1; ++pad) {
+      for (int group = 1; group <= 2; ++group) {
+        LayerParameter layer_param = this->MakeParam(tile, pad, 1, group);
+        WinogradConvolutionLayer<TypeParam> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        this->CheckForward(&layer, layer_param);
+      }
+    }
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForwardManyChannels) {
+  // The blocks of tiles are held at their minimum size rather than the
+  // cache budget, and the last is partial.
+  this->blob_bottom_->Reshape(2, 32, 23, 25);
+  FillerParameter filler_param;
+  filler_param.set_std(0.1);
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  for (int tile = 2; tile <= 4; tile += 2) {
+    LayerParameter layer_param = this->MakeParam(tile, 1, 1, 1);
+    layer_param.mutable_convolution_param()->set_num_output(32);
+    WinogradConvolutionLayer<TypeParam> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    this->CheckForward(&layer, layer_param);
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForwardFewTiles) {
+  // Too few tiles for the Winograd path: the layer convolves as the CAFFE
+  // engine.
+  this->blob_bottom_->Reshape(1, 4, 7, 9);
+  LayerParameter layer_param = this->MakeParam(4, 1, 1, 1);
+  WinogradConvolutionLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckForward(&layer, layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForwardStrided) {
+  // Not a Winograd shape: the layer convolves as the CAFFE engine.
+  LayerParameter layer_param = this->MakeParam(4, 1, 2, 1);
+  WinogradConvolutionLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckForward(&layer, layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWeightsUpdated) {
+  // In the TRAIN phase the filters are transformed again on every pass.
+  LayerParameter layer_param = this->MakeParam(4, 1, 1, 1);
+  layer_param.set_phase(TRAIN);
+  WinogradConvolutionLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_scal(layer.blobs()[0]->count(), TypeParam(-2),
+      layer.blobs()[0]->mutable_cpu_data());
+  this->CheckForward(&layer, layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestSharedWeightsChanged) {
+  // As a Solver test net: the weights are shared from the training net
+  // before each test, after it updated them in place.
+  const string proto =
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 4 dim: 17 dim: 19 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 6 kernel_size: 3 pad: 1 "
+      "    engine: WINOGRAD "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<TypeParam> test_net(param);
+  param.mutable_state()->set_phase(TRAIN);
+  param.mutable_layer(1)->mutable_convolution_param()->clear_engine();
+  Net<TypeParam> train_net(param);
+  test_net.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+  train_net.input_blobs()[0]->CopyFrom(*this->blob_bottom_);
+  test_net.Forward();
+  for (int update = 0; update < 2; ++update) {
+    if (update > 0) {
+      for (int i = 0; i < train_net.learnable_params().size(); ++i) {
+        Blob<TypeParam>* blob = train_net.learnable_params()[i];
+        caffe_scal(blob->count(), TypeParam(-0.5), blob->mutable_cpu_data());
+      }
+    }
+    test_net.ShareTrainedLayersWith(&train_net);
+    const Blob<TypeParam>& output = *test_net.Forward()[0];
+    const Blob<TypeParam>& expected = *train_net.Forward()[0];
+    ASSERT_EQ(expected.count(), output.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], output.cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestFactory) {
+  LayerParameter layer_param = this->MakeParam(4, 1, 1, 1);
+  layer_param.set_type("Convolution");
+  layer_param.mutable_convolution_param()->set_engine(
+      ConvolutionParameter_Engine_WINOGRAD);
+  shared_ptr<Layer<TypeParam> > layer =
+      LayerRegistry<TypeParam>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<WinogradConvolutionLayer<TypeParam>*>(
+      layer.get()) != NULL);
+  // As the engine of the layer, e.g. inherited from the net.
+  layer_param.mutable_convolution_param()->clear_engine();
+  layer_param.set_engine("WINOGRAD");
+  layer = LayerRegistry<TypeParam>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<WinogradConvolutionLayer<TypeParam>*>(
+      layer.get()) != NULL);
+}
+
+}  // namespace caffe
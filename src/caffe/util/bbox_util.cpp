@@ -42,16 +42,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <map>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "boost/iterator/counting_iterator.hpp"
 
 #include "caffe/util/bbox_util.hpp"
-#ifdef ENABLE_NMS_OPTIMIZATION
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_NMS_X86_KERNELS
 #include <immintrin.h>
-#include "omp.h"
 #endif
+
 namespace caffe {
 
 bool SortBBoxAscend(const NormalizedBBox& bbox1, const NormalizedBBox& bbox2) {
@@ -85,438 +88,6 @@ template bool SortScorePairDescend(const pair<float, int>& pair1,
                                    const pair<float, int>& pair2);
 template bool SortScorePairDescend(const pair<float, pair<int, int> >& pair1,
                                    const pair<float, pair<int, int> >& pair2);
-#ifdef ENABLE_NMS_OPTIMIZATION
-#define DIVUP(m, n)((m) / (n) + ((m) % (n) > 0))
-
-typedef unsigned long long int uint64_t;
-
-static inline float max(float a, float b) { return (a) > (b) ? (a) : (b); }
-static inline float min(float a, float b) { return (a) < (b) ? (a) : (b); }
-
-#define MASK_ELEM(x, y) \
-  ((uint64_t*)((char*)mask_tbl + x * blocks * sizeof(uint64_t)) + y)
-
-void cpu_nms_avx512_parallize_inner(int* __restrict keep_out, 
-                                    int* __restrict num_out, 
-                                    const float* __restrict x1,
-                                    const float* __restrict y1,
-                                    const float* __restrict x2, 
-                                    const float* __restrict y2,
-                                    int64_t boxes_num, 
-                                    float thresh_f)
-{
-    const int blocks = DIVUP(boxes_num, 64);
-    uint64_t *mask_tbl = (uint64_t *)aligned_alloc(64, blocks * sizeof(uint64_t));
-    memset(mask_tbl, 0, sizeof(uint64_t) * blocks);
-
-    uint64_t i = 0, j = 0;
-    uint64_t num_to_keep = 0;
-
-    for (i = 0; i < boxes_num; i++) {
-
-        if (mask_tbl[i/64] & (1ull << (i % 64))) {
-            continue;
-        }
-
-        keep_out[num_to_keep++] = i;
-
-        __m512 x1_a = _mm512_set1_ps(x1[i]);
-        __m512 x2_a = _mm512_set1_ps(x2[i]);
-        __m512 y1_a = _mm512_set1_ps(y1[i]);
-        __m512 y2_a = _mm512_set1_ps(y2[i]);
-
-        __m512 zero = _mm512_setzero_ps();
-        __m512 Sa_w = _mm512_sub_ps(x2_a, x1_a);
-        __m512 Sa_h = _mm512_sub_ps(y2_a, y1_a);
-
-        __m512 Sa = _mm512_mul_ps(Sa_w, Sa_h);
-
-        __m512 thresh = _mm512_set1_ps(thresh_f);
-
-
-        for (j = i + 1; (j & 0xf) && (j < boxes_num); j ++) {
-
-            if (mask_tbl[j/64] & (1ull << (j % 64))) {
-                continue;
-            }
-
-            float xx1 = max(x1[i], x1[j]);
-            float yy1 = max(y1[i], y1[j]);
-            float xx2 = min(x2[i], x2[j]);
-            float yy2 = min(y2[i], y2[j]);
-
-            float w = max(0.0f, xx2 - xx1 );
-            float h = max(0.0f, yy2 - yy1 );
-
-            float interS = w * h;
-            float Sa = (x2[i] - x1[i] ) * (y2[i] - y1[i] );
-            float Sb = (x2[j] - x1[j] ) * (y2[j] - y1[j] );
-
-            if (interS > thresh_f * (Sa + Sb - interS)) {
-                mask_tbl[j/64] |= 1ull << (j % 64);
-            }
-        }
-
-        if (!(j & 0xf) && (j & 0x1f) && (j + 16 <= boxes_num)) {
-
-            __m512 x1_b = _mm512_load_ps(x1 + j);
-            __m512 y1_b = _mm512_load_ps(y1 + j);
-            __m512 x2_b = _mm512_load_ps(x2 + j);
-            __m512 y2_b = _mm512_load_ps(y2 + j);
-
-            __m512 xx1 = _mm512_max_ps(x1_a, x1_b);
-            __m512 yy1 = _mm512_max_ps(y1_a, y1_b);
-            __m512 xx2 = _mm512_min_ps(x2_a, x2_b);
-            __m512 yy2 = _mm512_min_ps(y2_a, y2_b);
-
-            __m512 w = _mm512_sub_ps(xx2, xx1);
-            __m512 h = _mm512_sub_ps(yy2, yy1);
-
-            w = _mm512_max_ps(w, zero);
-            h = _mm512_max_ps(h, zero);
-
-            __m512 interS = _mm512_mul_ps(w, h);
-
-            __m512 Sb_w = _mm512_sub_ps(x2_b, x1_b);
-            __m512 Sb_h = _mm512_sub_ps(y2_b, y1_b);
-     
-            __m512 Sb = _mm512_mul_ps(Sb_w, Sb_h);
-
-            __m512 ovr = _mm512_add_ps(Sa, Sb);
-            ovr = _mm512_sub_ps(ovr, interS);
-            ovr = _mm512_mul_ps(ovr, thresh);
-
-            __mmask16 gt = _mm512_cmp_ps_mask(interS, ovr, _CMP_GT_OS);
-
-            uint64_t mask = gt;
-
-            mask_tbl[j/64] |= (mask) << (j % 64);
-
-            j += 16;
-        }
-
-        if (!(j & 0x1f) && (j & 0x3f) && (j + 32 <= boxes_num)) {
-
-            __m512 x1_b0 = _mm512_load_ps(x1 + j);
-            __m512 y1_b0 = _mm512_load_ps(y1 + j);
-            __m512 x2_b0 = _mm512_load_ps(x2 + j);
-            __m512 y2_b0 = _mm512_load_ps(y2 + j);
-
-            __m512 x1_b1 = _mm512_load_ps(x1 + j + 16);
-            __m512 y1_b1 = _mm512_load_ps(y1 + j + 16);
-            __m512 x2_b1 = _mm512_load_ps(x2 + j + 16);
-            __m512 y2_b1 = _mm512_load_ps(y2 + j + 16);
-
-            __m512 xx1_0 = _mm512_max_ps(x1_a, x1_b0);
-            __m512 yy1_0 = _mm512_max_ps(y1_a, y1_b0);
-            __m512 xx2_0 = _mm512_min_ps(x2_a, x2_b0);
-            __m512 yy2_0 = _mm512_min_ps(y2_a, y2_b0);
-
-            __m512 xx1_1 = _mm512_max_ps(x1_a, x1_b1);
-            __m512 yy1_1 = _mm512_max_ps(y1_a, y1_b1);
-            __m512 xx2_1 = _mm512_min_ps(x2_a, x2_b1);
-            __m512 yy2_1 = _mm512_min_ps(y2_a, y2_b1);
-
-            __m512 w0 = _mm512_sub_ps(xx2_0, xx1_0);
-            __m512 h0 = _mm512_sub_ps(yy2_0, yy1_0);
-            __m512 w1 = _mm512_sub_ps(xx2_1, xx1_1);
-            __m512 h1 = _mm512_sub_ps(yy2_1, yy1_1);
-
-            w0 = _mm512_max_ps(w0, zero);
-            h0 = _mm512_max_ps(h0, zero);
-            w1 = _mm512_max_ps(w1, zero);
-            h1 = _mm512_max_ps(h1, zero);
-
-            __m512 interS_0 = _mm512_mul_ps(w0, h0);
-            __m512 interS_1 = _mm512_mul_ps(w1, h1);
-
-            __m512 Sb_w0 = _mm512_sub_ps(x2_b0, x1_b0);
-            __m512 Sb_h0 = _mm512_sub_ps(y2_b0, y1_b0);
-            __m512 Sb_w1 = _mm512_sub_ps(x2_b1, x1_b1);
-            __m512 Sb_h1 = _mm512_sub_ps(y2_b1, y1_b1);
-
-            __m512 ovr0 = _mm512_fmadd_ps(Sb_w0, Sb_h0, Sa);
-            __m512 ovr1 = _mm512_fmadd_ps(Sb_w1, Sb_h1, Sa);
-
-            ovr0 = _mm512_sub_ps(ovr0, interS_0);
-            ovr1 = _mm512_sub_ps(ovr1, interS_1);
-
-            ovr0 = _mm512_mul_ps(ovr0, thresh);
-            ovr1 = _mm512_mul_ps(ovr1, thresh);
-
-            __mmask16 gt0 = _mm512_cmp_ps_mask(interS_0, ovr0, _CMP_GT_OS);
-            __mmask16 gt1 = _mm512_cmp_ps_mask(interS_1, ovr1, _CMP_GT_OS);
-
-            uint64_t mask = (gt0) | ((uint64_t)gt1 << 16);
-
-            mask_tbl[j/64] |= (mask) << (j % 64);
-
-            j += 32;
-        }
-        //#pragma omp parallel for
-        for (; (j + 64) <= boxes_num; j += 64) {
-
-            __m512 x1_b0 = _mm512_load_ps(x1 + j);
-            __m512 y1_b0 = _mm512_load_ps(y1 + j);
-            __m512 x2_b0 = _mm512_load_ps(x2 + j);
-            __m512 y2_b0 = _mm512_load_ps(y2 + j);
-
-            __m512 x1_b1 = _mm512_load_ps(x1 + j + 16);
-            __m512 y1_b1 = _mm512_load_ps(y1 + j + 16);
-            __m512 x2_b1 = _mm512_load_ps(x2 + j + 16);
-            __m512 y2_b1 = _mm512_load_ps(y2 + j + 16);
-
-            __m512 x1_b2 = _mm512_load_ps(x1 + j + 32);
-            __m512 y1_b2 = _mm512_load_ps(y1 + j + 32);
-            __m512 x2_b2 = _mm512_load_ps(x2 + j + 32);
-            __m512 y2_b2 = _mm512_load_ps(y2 + j + 32);
-
-            __m512 x1_b3 = _mm512_load_ps(x1 + j + 48);
-            __m512 y1_b3 = _mm512_load_ps(y1 + j + 48);
-            __m512 x2_b3 = _mm512_load_ps(x2 + j + 48);
-            __m512 y2_b3 = _mm512_load_ps(y2 + j + 48);
-
-            __m512 xx1_0 = _mm512_max_ps(x1_a, x1_b0);
-            __m512 yy1_0 = _mm512_max_ps(y1_a, y1_b0);
-            __m512 xx2_0 = _mm512_min_ps(x2_a, x2_b0);
-            __m512 yy2_0 = _mm512_min_ps(y2_a, y2_b0);
-
-            __m512 xx1_1 = _mm512_max_ps(x1_a, x1_b1);
-            __m512 yy1_1 = _mm512_max_ps(y1_a, y1_b1);
-            __m512 xx2_1 = _mm512_min_ps(x2_a, x2_b1);
-            __m512 yy2_1 = _mm512_min_ps(y2_a, y2_b1);
-
-            __m512 Sb_w0 = _mm512_sub_ps(x2_b0, x1_b0);
-            __m512 Sb_h0 = _mm512_sub_ps(y2_b0, y1_b0);
-            __m512 Sb_w1 = _mm512_sub_ps(x2_b1, x1_b1);
-            __m512 Sb_h1 = _mm512_sub_ps(y2_b1, y1_b1);
-            __m512 Sb_w2 = _mm512_sub_ps(x2_b2, x1_b2);
-            __m512 Sb_h2 = _mm512_sub_ps(y2_b2, y1_b2);
-            __m512 Sb_w3 = _mm512_sub_ps(x2_b3, x1_b3);
-            __m512 Sb_h3 = _mm512_sub_ps(y2_b3, y1_b3);
-
-            __m512 xx1_2 = _mm512_max_ps(x1_a, x1_b2);
-            __m512 yy1_2 = _mm512_max_ps(y1_a, y1_b2);
-            __m512 xx2_2 = _mm512_min_ps(x2_a, x2_b2);
-            __m512 yy2_2 = _mm512_min_ps(y2_a, y2_b2);
-
-            __m512 xx1_3 = _mm512_max_ps(x1_a, x1_b3);
-            __m512 yy1_3 = _mm512_max_ps(y1_a, y1_b3);
-            __m512 xx2_3 = _mm512_min_ps(x2_a, x2_b3);
-            __m512 yy2_3 = _mm512_min_ps(y2_a, y2_b3);
-
-            __m512 w0 = _mm512_sub_ps(xx2_0, xx1_0);
-            __m512 h0 = _mm512_sub_ps(yy2_0, yy1_0);
-            __m512 w1 = _mm512_sub_ps(xx2_1, xx1_1);
-            __m512 h1 = _mm512_sub_ps(yy2_1, yy1_1);
-            __m512 w2 = _mm512_sub_ps(xx2_2, xx1_2);
-            __m512 h2 = _mm512_sub_ps(yy2_2, yy1_2);
-            __m512 w3 = _mm512_sub_ps(xx2_3, xx1_3);
-            __m512 h3 = _mm512_sub_ps(yy2_3, yy1_3);
-
-            w0 = _mm512_max_ps(w0, zero);
-            h0 = _mm512_max_ps(h0, zero);
-            w1 = _mm512_max_ps(w1, zero);
-            h1 = _mm512_max_ps(h1, zero);
-            w2 = _mm512_max_ps(w2, zero);
-            h2 = _mm512_max_ps(h2, zero);
-            w3 = _mm512_max_ps(w3, zero);
-            h3 = _mm512_max_ps(h3, zero);
-
-            __m512 interS_0 = _mm512_mul_ps(w0, h0);
-            __m512 interS_1 = _mm512_mul_ps(w1, h1);
-            __m512 interS_2 = _mm512_mul_ps(w2, h2);
-            __m512 interS_3 = _mm512_mul_ps(w3, h3);
-
-            __m512 ovr0 = _mm512_fmadd_ps(Sb_w0, Sb_h0, Sa);
-            __m512 ovr1 = _mm512_fmadd_ps(Sb_w1, Sb_h1, Sa);
-            __m512 ovr2 = _mm512_fmadd_ps(Sb_w2, Sb_h2, Sa);
-            __m512 ovr3 = _mm512_fmadd_ps(Sb_w3, Sb_h3, Sa);
-
-            ovr0 = _mm512_sub_ps(ovr0, interS_0);
-            ovr1 = _mm512_sub_ps(ovr1, interS_1);
-            ovr2 = _mm512_sub_ps(ovr2, interS_2);
-            ovr3 = _mm512_sub_ps(ovr3, interS_3);
-
-            ovr0 = _mm512_mul_ps(ovr0, thresh);
-            ovr1 = _mm512_mul_ps(ovr1, thresh);
-            ovr2 = _mm512_mul_ps(ovr2, thresh);
-            ovr3 = _mm512_mul_ps(ovr3, thresh);
-
-            __mmask16 gt0 = _mm512_cmp_ps_mask(interS_0, ovr0, _CMP_GT_OS);
-            __mmask16 gt1 = _mm512_cmp_ps_mask(interS_1, ovr1, _CMP_GT_OS);
-            __mmask16 gt2 = _mm512_cmp_ps_mask(interS_2, ovr2, _CMP_GT_OS);
-            __mmask16 gt3 = _mm512_cmp_ps_mask(interS_3, ovr3, _CMP_GT_OS);
-
-            uint64_t mask = ((uint64_t)(gt0)) | (((uint64_t)gt1) << 16) | (((uint64_t)gt2) << 32) | (((uint64_t)gt3) << 48);
-
-            mask_tbl[j / 64] |= mask;
-        }
-
-        if ((j + 32) <= boxes_num) {
-
-            __m512 x1_b0 = _mm512_load_ps(x1 + j);
-            __m512 y1_b0 = _mm512_load_ps(y1 + j);
-            __m512 x2_b0 = _mm512_load_ps(x2 + j);
-            __m512 y2_b0 = _mm512_load_ps(y2 + j);
-
-            __m512 x1_b1 = _mm512_load_ps(x1 + j + 16);
-            __m512 y1_b1 = _mm512_load_ps(y1 + j + 16);
-            __m512 x2_b1 = _mm512_load_ps(x2 + j + 16);
-            __m512 y2_b1 = _mm512_load_ps(y2 + j + 16);
-
-            __m512 xx1_0 = _mm512_max_ps(x1_a, x1_b0);
-            __m512 yy1_0 = _mm512_max_ps(y1_a, y1_b0);
-            __m512 xx2_0 = _mm512_min_ps(x2_a, x2_b0);
-            __m512 yy2_0 = _mm512_min_ps(y2_a, y2_b0);
-
-            __m512 xx1_1 = _mm512_max_ps(x1_a, x1_b1);
-            __m512 yy1_1 = _mm512_max_ps(y1_a, y1_b1);
-            __m512 xx2_1 = _mm512_min_ps(x2_a, x2_b1);
-            __m512 yy2_1 = _mm512_min_ps(y2_a, y2_b1);
-
-            __m512 w0 = _mm512_sub_ps(xx2_0, xx1_0);
-            __m512 h0 = _mm512_sub_ps(yy2_0, yy1_0);
-            __m512 w1 = _mm512_sub_ps(xx2_1, xx1_1);
-            __m512 h1 = _mm512_sub_ps(yy2_1, yy1_1);
-
-            w0 = _mm512_max_ps(w0, zero);
-            h0 = _mm512_max_ps(h0, zero);
-            w1 = _mm512_max_ps(w1, zero);
-            h1 = _mm512_max_ps(h1, zero);
-
-            __m512 interS_0 = _mm512_mul_ps(w0, h0);
-            __m512 interS_1 = _mm512_mul_ps(w1, h1);
-
-            __m512 Sb_w0 = _mm512_sub_ps(x2_b0, x1_b0);
-            __m512 Sb_h0 = _mm512_sub_ps(y2_b0, y1_b0);
-            __m512 Sb_w1 = _mm512_sub_ps(x2_b1, x1_b1);
-            __m512 Sb_h1 = _mm512_sub_ps(y2_b1, y1_b1);
-
-            __m512 Sb0 = _mm512_mul_ps(Sb_w0, Sb_h0);
-            __m512 Sb1 = _mm512_mul_ps(Sb_w1, Sb_h1);
-
-            __m512 ovr0 = _mm512_add_ps(Sa, Sb0);
-            __m512 ovr1 = _mm512_add_ps(Sa, Sb1);
-
-            ovr0 = _mm512_sub_ps(ovr0, interS_0);
-            ovr1 = _mm512_sub_ps(ovr1, interS_1);
-
-            ovr0 = _mm512_mul_ps(ovr0, thresh);
-            ovr1 = _mm512_mul_ps(ovr1, thresh);
-
-            __mmask16 gt0 = _mm512_cmp_ps_mask(interS_0, ovr0, _CMP_GT_OS);
-            __mmask16 gt1 = _mm512_cmp_ps_mask(interS_1, ovr1, _CMP_GT_OS);
-
-            uint64_t mask = (gt0) | ((uint64_t)gt1 << 16);
-
-            mask_tbl[(j +  0) / 64] |= (mask) << (j % 64);
-            mask_tbl[(j + 32) / 64] |= (mask) >> (64-(j % 64));
-
-            j += 32;
-        }
-
-        if ((j + 16) <= boxes_num) {
-
-            __m512 x1_b = _mm512_load_ps(x1 + j);
-            __m512 y1_b = _mm512_load_ps(y1 + j);
-            __m512 x2_b = _mm512_load_ps(x2 + j);
-            __m512 y2_b = _mm512_load_ps(y2 + j);
-
-            __m512 xx1 = _mm512_max_ps(x1_a, x1_b);
-            __m512 yy1 = _mm512_max_ps(y1_a, y1_b);
-            __m512 xx2 = _mm512_min_ps(x2_a, x2_b);
-            __m512 yy2 = _mm512_min_ps(y2_a, y2_b);
-
-            __m512 w = _mm512_sub_ps(xx2, xx1);
-            __m512 h = _mm512_sub_ps(yy2, yy1);
-
-            w = _mm512_max_ps(w, zero);
-            h = _mm512_max_ps(h, zero);
-
-            __m512 interS = _mm512_mul_ps(w, h);
-
-            __m512 Sb_w = _mm512_sub_ps(x2_b, x1_b);
-            __m512 Sb_h = _mm512_sub_ps(y2_b, y1_b);
-
-            __m512 Sb = _mm512_mul_ps(Sb_w, Sb_h);
-
-            __m512 ovr = _mm512_add_ps(Sa, Sb);
-            ovr = _mm512_sub_ps(ovr, interS);
-            ovr = _mm512_mul_ps(ovr, thresh);
-
-            __mmask16 gt = _mm512_cmp_ps_mask(interS, ovr, _CMP_GT_OS);
-
-            uint64_t mask = gt;
-
-            mask_tbl[(j +  0) / 64] |= (mask) << (j % 64);
-            mask_tbl[(j + 16) / 64] |= (mask) >> (64-(j % 64));
-
-            j += 16;
-        }
-
-        for (; j < boxes_num; j ++) {
-
-            if (mask_tbl[j/64] & (1ull << (j % 64))) {
-                continue;
-            }
-
-            float xx1 = max(x1[i], x1[j]);
-            float yy1 = max(y1[i], y1[j]);
-            float xx2 = min(x2[i], x2[j]);
-            float yy2 = min(y2[i], y2[j]);
-
-            float w = max(0.0f, xx2 - xx1 );
-            float h = max(0.0f, yy2 - yy1 );
-
-            float interS = w * h;
-            float Sa = (x2[i] - x1[i] ) * (y2[i] - y1[i] );
-            float Sb = (x2[j] - x1[j] ) * (y2[j] - y1[j] );
-
-            if (interS > thresh_f * (Sa + Sb - interS)) {
-                mask_tbl[j/64] |= 1ull << (j % 64);
-            }
-        }
-    }
-
-    free(mask_tbl);
-
-    *num_out = num_to_keep;
-}
-
-void cpu_nms_avx512_caffe(int* __restrict keep_out, int* __restrict num_out,
-                          const vector<NormalizedBBox>& bboxes,
-                          vector<pair<float, int> >& score_index_vec,
-                          float thresh) {
-  uint64_t boxes_num = score_index_vec.size();
-  float* x1 = (float*)aligned_alloc(64, boxes_num * sizeof(float));
-  float* y1 = (float*)aligned_alloc(64, boxes_num * sizeof(float));
-  float* x2 = (float*)aligned_alloc(64, boxes_num * sizeof(float));
-  float* y2 = (float*)aligned_alloc(64, boxes_num * sizeof(float));
-
-  uint64_t i = 0;
-
-#pragma omp parallel for
-  for (i = 0; i < boxes_num; ++i) {
-    x1[i] = bboxes[score_index_vec[i].second].xmin();
-    y1[i] = bboxes[score_index_vec[i].second].ymin();
-    x2[i] = bboxes[score_index_vec[i].second].xmax();
-    y2[i] = bboxes[score_index_vec[i].second].ymax();
-  }
-
-  cpu_nms_avx512_parallize_inner(keep_out, num_out, x1, y1, x2, y2, boxes_num,
-                                   thresh);
-#pragma omp parallel for
-  for (int i = 0; i < *num_out; i++) {
-    keep_out[i] = score_index_vec[keep_out[i]].second;
-  }
-  free(x1);
-  free(x2);
-  free(y1);
-  free(y2);
-}
-#endif
-
 NormalizedBBox UnitBBox() {
   NormalizedBBox unit_bbox;
   unit_bbox.set_xmin(0.);
@@ -1000,6 +571,88 @@ void DecodeBBox(
   }
 }
 
+template <typename Dtype>
+void DecodeBBox(const Dtype* prior_bbox, const Dtype* prior_variance,
+    const CodeType code_type, const bool variance_encoded_in_target,
+    const Dtype* bbox, float* decode_bbox) {
+  const float prior_xmin = prior_bbox[0];
+  const float prior_ymin = prior_bbox[1];
+  const float prior_xmax = prior_bbox[2];
+  const float prior_ymax = prior_bbox[3];
+  float var[4] = {1.f, 1.f, 1.f, 1.f};
+  if (!variance_encoded_in_target) {
+    for (int k = 0; k < 4; ++k) {
+      var[k] = prior_variance[k];
+    }
+  }
+  const float xmin = bbox[0];
+  const float ymin = bbox[1];
+  const float xmax = bbox[2];
+  const float ymax = bbox[3];
+  if (code_type == PriorBoxParameter_CodeType_CORNER) {
+    if (variance_encoded_in_target) {
+      decode_bbox[0] = prior_xmin + xmin;
+      decode_bbox[1] = prior_ymin + ymin;
+      decode_bbox[2] = prior_xmax + xmax;
+      decode_bbox[3] = prior_ymax + ymax;
+    } else {
+      decode_bbox[0] = prior_xmin + var[0] * xmin;
+      decode_bbox[1] = prior_ymin + var[1] * ymin;
+      decode_bbox[2] = prior_xmax + var[2] * xmax;
+      decode_bbox[3] = prior_ymax + var[3] * ymax;
+    }
+  } else if (code_type == PriorBoxParameter_CodeType_CENTER_SIZE) {
+    const float prior_width = prior_xmax - prior_xmin;
+    CHECK_GT(prior_width, 0);
+    const float prior_height = prior_ymax - prior_ymin;
+    CHECK_GT(prior_height, 0);
+    const float prior_center_x = (prior_xmin + prior_xmax) / 2.;
+    const float prior_center_y = (prior_ymin + prior_ymax) / 2.;
+    float center_x, center_y, width, height;
+    if (variance_encoded_in_target) {
+      center_x = xmin * prior_width + prior_center_x;
+      center_y = ymin * prior_height + prior_center_y;
+      width = exp(xmax) * prior_width;
+      height = exp(ymax) * prior_height;
+    } else {
+      center_x = var[0] * xmin * prior_width + prior_center_x;
+      center_y = var[1] * ymin * prior_height + prior_center_y;
+      width = exp(var[2] * xmax) * prior_width;
+      height = exp(var[3] * ymax) * prior_height;
+    }
+    decode_bbox[0] = center_x - width / 2.;
+    decode_bbox[1] = center_y - height / 2.;
+    decode_bbox[2] = center_x + width / 2.;
+    decode_bbox[3] = center_y + height / 2.;
+  } else if (code_type == PriorBoxParameter_CodeType_CORNER_SIZE) {
+    const float prior_width = prior_xmax - prior_xmin;
+    CHECK_GT(prior_width, 0);
+    const float prior_height = prior_ymax - prior_ymin;
+    CHECK_GT(prior_height, 0);
+    if (variance_encoded_in_target) {
+      decode_bbox[0] = prior_xmin + xmin * prior_width;
+      decode_bbox[1] = prior_ymin + ymin * prior_height;
+      decode_bbox[2] = prior_xmax + xmax * prior_width;
+      decode_bbox[3] = prior_ymax + ymax * prior_height;
+    } else {
+      decode_bbox[0] = prior_xmin + var[0] * xmin * prior_width;
+      decode_bbox[1] = prior_ymin + var[1] * ymin * prior_height;
+      decode_bbox[2] = prior_xmax + var[2] * xmax * prior_width;
+      decode_bbox[3] = prior_ymax + var[3] * ymax * prior_height;
+    }
+  } else {
+    LOG(FATAL) << "Unknown LocLossType.";
+  }
+}
+
+template void DecodeBBox(const float* prior_bbox, const float* prior_variance,
+    const CodeType code_type, const bool variance_encoded_in_target,
+    const float* bbox, float* decode_bbox);
+template void DecodeBBox(const double* prior_bbox,
+    const double* prior_variance, const CodeType code_type,
+    const bool variance_encoded_in_target, const double* bbox,
+    float* decode_bbox);
+
 void DecodeBBoxes(const vector<NormalizedBBox>& prior_bboxes,
                   const vector<vector<float> >& prior_variances,
                   const CodeType code_type,
@@ -2266,12 +1919,10 @@ void GetTopKScoreIndex(const vector<float>& scores, const vector<int>& indices,
 void GetMaxScoreIndex(const vector<float>& scores, const float threshold,
       const int top_k, vector<pair<float, int> >* score_index_vec) {
   // Generate index score pairs.
-#ifdef _OPENMP
-  #pragma omp parallel for
-#endif
+  score_index_vec->clear();
   for (int i = 0; i < scores.size(); ++i) {
     if (scores[i] > threshold) {
-      score_index_vec->at(i) = std::make_pair(scores[i], i);
+      score_index_vec->push_back(std::make_pair(scores[i], i));
     }
   }
 
@@ -2424,6 +2075,173 @@ inline int clamp(const int v, const int a, const int b) {
   return v < a ? a : v > b ? b : v;
 }
 
+// Set the suppression bit of every bbox in [begin, num) whose overlap with
+// the kept bbox i is larger than threshold. Bits in mask are indexed by the
+// position of the bbox, 64 bboxes per word.
+static void SuppressOverlapsScalar(const float* xmin, const float* ymin,
+      const float* xmax, const float* ymax, const float* size, const int i,
+      const int begin, const int num, const float threshold, uint64_t* mask) {
+  for (int j = begin; j < num; ++j) {
+    if (mask[j >> 6] & (1ULL << (j & 63))) {
+      continue;
+    }
+    const float w = std::min(xmax[i], xmax[j]) - std::max(xmin[i], xmin[j]);
+    const float h = std::min(ymax[i], ymax[j]) - std::max(ymin[i], ymin[j]);
+    if (w > 0 && h > 0) {
+      const float inter = w * h;
+      if (inter / (size[i] + size[j] - inter) > threshold) {
+        mask[j >> 6] |= 1ULL << (j & 63);
+      }
+    }
+  }
+}
+
+#ifdef CAFFE_NMS_X86_KERNELS
+// 8 bboxes per step. The first step is aligned down to a multiple of 8 so that
+// a step never straddles two mask words; lanes before begin are masked out.
+__attribute__((target("avx2")))
+static void SuppressOverlapsAVX2(const float* xmin, const float* ymin,
+      const float* xmax, const float* ymax, const float* size, const int i,
+      const int begin, const int num, const float threshold, uint64_t* mask) {
+  const __m256 xmin_i = _mm256_set1_ps(xmin[i]);
+  const __m256 ymin_i = _mm256_set1_ps(ymin[i]);
+  const __m256 xmax_i = _mm256_set1_ps(xmax[i]);
+  const __m256 ymax_i = _mm256_set1_ps(ymax[i]);
+  const __m256 size_i = _mm256_set1_ps(size[i]);
+  const __m256 thresh = _mm256_set1_ps(threshold);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  for (int j = begin & ~7; j < num; j += 8) {
+    int valid = 0xff;
+    if (j < begin) {
+      valid &= 0xff << (begin - j);
+    }
+    const uint64_t done = (mask[j >> 6] >> (j & 63)) & 0xff;
+    if ((valid & ~done) == 0) {
+      continue;
+    }
+    __m256 xmin_j, ymin_j, xmax_j, ymax_j, size_j;
+    if (j + 8 <= num) {
+      xmin_j = _mm256_loadu_ps(xmin + j);
+      ymin_j = _mm256_loadu_ps(ymin + j);
+      xmax_j = _mm256_loadu_ps(xmax + j);
+      ymax_j = _mm256_loadu_ps(ymax + j);
+      size_j = _mm256_loadu_ps(size + j);
+    } else {
+      const __m256i load = _mm256_cmpgt_epi32(_mm256_set1_epi32(num - j), lane);
+      xmin_j = _mm256_maskload_ps(xmin + j, load);
+      ymin_j = _mm256_maskload_ps(ymin + j, load);
+      xmax_j = _mm256_maskload_ps(xmax + j, load);
+      ymax_j = _mm256_maskload_ps(ymax + j, load);
+      size_j = _mm256_maskload_ps(size + j, load);
+      valid &= (1 << (num - j)) - 1;
+    }
+    const __m256 w = _mm256_sub_ps(_mm256_min_ps(xmax_i, xmax_j),
+                                   _mm256_max_ps(xmin_i, xmin_j));
+    const __m256 h = _mm256_sub_ps(_mm256_min_ps(ymax_i, ymax_j),
+                                   _mm256_max_ps(ymin_i, ymin_j));
+    const __m256 inter = _mm256_mul_ps(w, h);
+    const __m256 overlap = _mm256_div_ps(inter,
+        _mm256_sub_ps(_mm256_add_ps(size_i, size_j), inter));
+    const __m256 suppress = _mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ),
+                      _mm256_cmp_ps(h, zero, _CMP_GT_OQ)),
+        _mm256_cmp_ps(overlap, thresh, _CMP_GT_OQ));
+    const uint64_t bits = _mm256_movemask_ps(suppress) & valid;
+    mask[j >> 6] |= bits << (j & 63);
+  }
+}
+
+// Same as SuppressOverlapsAVX2 with 16 bboxes per step.
+__attribute__((target("avx512f")))
+static void SuppressOverlapsAVX512(const float* xmin, const float* ymin,
+      const float* xmax, const float* ymax, const float* size, const int i,
+      const int begin, const int num, const float threshold, uint64_t* mask) {
+  const __m512 xmin_i = _mm512_set1_ps(xmin[i]);
+  const __m512 ymin_i = _mm512_set1_ps(ymin[i]);
+  const __m512 xmax_i = _mm512_set1_ps(xmax[i]);
+  const __m512 ymax_i = _mm512_set1_ps(ymax[i]);
+  const __m512 size_i = _mm512_set1_ps(size[i]);
+  const __m512 thresh = _mm512_set1_ps(threshold);
+  const __m512 zero = _mm512_setzero_ps();
+  for (int j = begin & ~15; j < num; j += 16) {
+    __mmask16 valid = 0xffff;
+    if (j < begin) {
+      valid &= 0xffff << (begin - j);
+    }
+    if (j + 16 > num) {
+      valid &= (1 << (num - j)) - 1;
+    }
+    const __mmask16 done = (mask[j >> 6] >> (j & 63)) & 0xffff;
+    if ((valid & ~done) == 0) {
+      continue;
+    }
+    const __m512 xmin_j = _mm512_maskz_loadu_ps(valid, xmin + j);
+    const __m512 ymin_j = _mm512_maskz_loadu_ps(valid, ymin + j);
+    const __m512 xmax_j = _mm512_maskz_loadu_ps(valid, xmax + j);
+    const __m512 ymax_j = _mm512_maskz_loadu_ps(valid, ymax + j);
+    const __m512 size_j = _mm512_maskz_loadu_ps(valid, size + j);
+    const __m512 w = _mm512_sub_ps(_mm512_min_ps(xmax_i, xmax_j),
+                                   _mm512_max_ps(xmin_i, xmin_j));
+    const __m512 h = _mm512_sub_ps(_mm512_min_ps(ymax_i, ymax_j),
+                                   _mm512_max_ps(ymin_i, ymin_j));
+    const __m512 inter = _mm512_mul_ps(w, h);
+    const __m512 overlap = _mm512_div_ps(inter,
+        _mm512_sub_ps(_mm512_add_ps(size_i, size_j), inter));
+    __mmask16 suppress = _mm512_mask_cmp_ps_mask(valid, w, zero, _CMP_GT_OQ);
+    suppress = _mm512_mask_cmp_ps_mask(suppress, h, zero, _CMP_GT_OQ);
+    suppress = _mm512_mask_cmp_ps_mask(suppress, overlap, thresh, _CMP_GT_OQ);
+    mask[j >> 6] |= static_cast<uint64_t>(suppress) << (j & 63);
+  }
+}
+#endif  // CAFFE_NMS_X86_KERNELS
+
+NMSKernel GetNMSKernel() {
+#ifdef CAFFE_NMS_X86_KERNELS
+  static const NMSKernel kernel =
+      __builtin_cpu_supports("avx512f") ? NMS_KERNEL_AVX512 :
+      __builtin_cpu_supports("avx2") ? NMS_KERNEL_AVX2 : NMS_KERNEL_SCALAR;
+  return kernel;
+#else
+  return NMS_KERNEL_SCALAR;
+#endif
+}
+
+void ApplyNMSFlat(const float* xmin, const float* ymin, const float* xmax,
+      const float* ymax, const float* size, const int num,
+      const float nms_threshold, vector<int>* indices, NMSKernel kernel) {
+  typedef void (*SuppressFn)(const float*, const float*, const float*,
+      const float*, const float*, const int, const int, const int, const float,
+      uint64_t*);
+  if (kernel == NMS_KERNEL_AUTO) {
+    kernel = GetNMSKernel();
+  }
+  SuppressFn suppress = SuppressOverlapsScalar;
+#ifdef CAFFE_NMS_X86_KERNELS
+  if (kernel == NMS_KERNEL_AVX512) {
+    CHECK(__builtin_cpu_supports("avx512f")) << "AVX-512 is not supported.";
+    suppress = SuppressOverlapsAVX512;
+  } else if (kernel == NMS_KERNEL_AVX2) {
+    CHECK(__builtin_cpu_supports("avx2")) << "AVX2 is not supported.";
+    suppress = SuppressOverlapsAVX2;
+  }
+#else
+  CHECK_EQ(kernel, NMS_KERNEL_SCALAR) << "Only the scalar kernel is built.";
+#endif
+  indices->clear();
+  vector<uint64_t> mask((num + 63) / 64, 0);
+  for (int i = 0; i < num; ++i) {
+    if (mask[i >> 6] & (1ULL << (i & 63))) {
+      continue;
+    }
+    indices->push_back(i);
+    if (i + 1 < num) {
+      suppress(xmin, ymin, xmax, ymax, size, i, i + 1, num, nms_threshold,
+               &mask[0]);
+    }
+  }
+}
+
 void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
                   const vector<float>& scores, const float score_threshold,
                   const float nms_threshold, const float eta, const int top_k,
@@ -2432,45 +2250,57 @@ void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
   CHECK_EQ(bboxes.size(), scores.size())
       << "bboxes and scores have different size.";
   // Get top_k scores (with corresponding indices).
-  vector<pair<float, int> > score_index_vec(scores.size());
+  vector<pair<float, int> > score_index_vec;
   GetMaxScoreIndex(scores, score_threshold, top_k, &score_index_vec);
   // Do nms.
   float adaptive_threshold = nms_threshold;
   indices->clear();
-#ifdef ENABLE_NMS_OPTIMIZATION
-  if (_may_i_use_cpu_feature(_FEATURE_AVX512CD | _FEATURE_AVX512F)) {
-    if (score_index_vec.size() == 0) return;
-    indices->resize(score_index_vec.size());
-    int* p = (int*)malloc(sizeof(int) * score_index_vec.size());
-    int num_out = 0;
-    cpu_nms_avx512_caffe(p, &num_out, bboxes, score_index_vec, nms_threshold);
-    indices->assign(p, p + num_out);
-    free(p);
-  } else {
-#endif
-    while (score_index_vec.size() != 0) {
-      const int idx = score_index_vec.front().second;
-      bool keep = true;
-      for (int k = 0; k < indices->size(); ++k) {
-        if (keep) {
-          const int kept_idx = (*indices)[k];
-          float overlap = JaccardOverlap(bboxes[idx], bboxes[kept_idx]);
-          keep = overlap <= adaptive_threshold;
-        } else {
-          break;
-        }
-      }
+  if (score_index_vec.empty()) {
+    return;
+  }
+  if (eta >= 1) {
+    // The threshold is fixed, so the bitmask kernels give the same result.
+    const int num = score_index_vec.size();
+    vector<float> flat(5 * num);
+    float* xmin = &flat[0];
+    float* ymin = xmin + num;
+    float* xmax = ymin + num;
+    float* ymax = xmax + num;
+    float* size = ymax + num;
+    for (int i = 0; i < num; ++i) {
+      const NormalizedBBox& bbox = bboxes[score_index_vec[i].second];
+      xmin[i] = bbox.xmin();
+      ymin[i] = bbox.ymin();
+      xmax[i] = bbox.xmax();
+      ymax[i] = bbox.ymax();
+      size[i] = BBoxSize(bbox);
+    }
+    ApplyNMSFlat(xmin, ymin, xmax, ymax, size, num, nms_threshold, indices);
+    for (int k = 0; k < indices->size(); ++k) {
+      (*indices)[k] = score_index_vec[(*indices)[k]].second;
+    }
+    return;
+  }
+  while (score_index_vec.size() != 0) {
+    const int idx = score_index_vec.front().second;
+    bool keep = true;
+    for (int k = 0; k < indices->size(); ++k) {
       if (keep) {
-        indices->push_back(idx);
-      }
-      score_index_vec.erase(score_index_vec.begin());
-      if (keep && eta < 1 && adaptive_threshold > 0.5) {
-        adaptive_threshold *= eta;
+        const int kept_idx = (*indices)[k];
+        float overlap = JaccardOverlap(bboxes[idx], bboxes[kept_idx]);
+        keep = overlap <= adaptive_threshold;
+      } else {
+        break;
       }
     }
-#ifdef ENABLE_NMS_OPTIMIZATION
+    if (keep) {
+      indices->push_back(idx);
+    }
+    score_index_vec.erase(score_index_vec.begin());
+    if (keep && eta < 1 && adaptive_threshold > 0.5) {
+      adaptive_threshold *= eta;
+    }
   }
-#endif
 }
 
 template <typename Dtype>
@@ -2484,6 +2314,32 @@ void ApplyNMSFast(const Dtype* bboxes, const Dtype* scores, const int num,
   // Do nms.
   float adaptive_threshold = nms_threshold;
   indices->clear();
+  if (score_index_vec.empty()) {
+    return;
+  }
+  if (eta >= 1 && std::is_same<Dtype, float>::value) {
+    const int num_sel = score_index_vec.size();
+    vector<float> flat(5 * num_sel);
+    float* xmin = &flat[0];
+    float* ymin = xmin + num_sel;
+    float* xmax = ymin + num_sel;
+    float* ymax = xmax + num_sel;
+    float* size = ymax + num_sel;
+    for (int i = 0; i < num_sel; ++i) {
+      const Dtype* bbox = bboxes + score_index_vec[i].second * 4;
+      xmin[i] = bbox[0];
+      ymin[i] = bbox[1];
+      xmax[i] = bbox[2];
+      ymax[i] = bbox[3];
+      size[i] = BBoxSize(bbox);
+    }
+    ApplyNMSFlat(xmin, ymin, xmax, ymax, size, num_sel, nms_threshold,
+                 indices);
+    for (int k = 0; k < indices->size(); ++k) {
+      (*indices)[k] = score_index_vec[(*indices)[k]].second;
+    }
+    return;
+  }
   while (score_index_vec.size() != 0) {
     const int idx = score_index_vec.front().second;
     bool keep = true;
@@ -1,6 +1,8 @@
 #include <boost/thread.hpp>
 #include <string>
 
+#include "caffe/data_reader.hpp"
+#include "caffe/inference_server.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/util/blocking_queue.hpp"
@@ -87,5 +89,9 @@ size_t BlockingQueue<T>::size() const {
 
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
+template class BlockingQueue<string*>;
+template class BlockingQueue<shared_ptr<DataReader::Queue> >;
+template class BlockingQueue<shared_ptr<InferenceRequest<float> > >;
+template class BlockingQueue<shared_ptr<InferenceRequest<double> > >;
 
 }  // namespace caffe
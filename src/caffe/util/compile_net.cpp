@@ -0,0 +1,303 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/compile_net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Layers with one weight row and one bias per output channel.
+bool IsFoldTarget(const LayerParameter& layer_param) {
+  if (layer_param.top_size() != 1) {
+    return false;
+  }
+  // Shared weights cannot be rewritten for a single layer.
+  for (int i = 0; i < layer_param.param_size(); ++i) {
+    if (layer_param.param(i).name() != "") {
+      return false;
+    }
+  }
+  const string& type = layer_param.type();
+  if (type == "Convolution" || type == "ConvolutionDepthwise") {
+    return layer_param.convolution_param().axis() == 1;
+  }
+  if (type == "InnerProduct") {
+    return !layer_param.inner_product_param().transpose()
+        && layer_param.inner_product_param().axis() == 1;
+  }
+  return false;
+}
+
+// Layers computing a per-channel affine transform in TEST phase.
+bool IsFoldable(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  const BatchNormParameter& batch_norm_param =
+      layer_param.batch_norm_param();
+  if (type == "BatchNorm") {
+    return (!batch_norm_param.has_use_global_stats()
+        || batch_norm_param.use_global_stats()) && !batch_norm_param.relu();
+  }
+  if (type == "BN") {
+    return !batch_norm_param.relu();
+  }
+  if (type == "Scale") {
+    return layer_param.scale_param().axis() == 1
+        && layer_param.scale_param().num_axes() == 1;
+  }
+  if (type == "Bias") {
+    return layer_param.bias_param().axis() == 1
+        && layer_param.bias_param().num_axes() == 1;
+  }
+  return false;
+}
+
+// Layers whose CPU forward pass applies a fused activation to their output.
+bool IsActivationTarget(const LayerParameter& layer_param) {
+  if (layer_param.top_size() != 1 || layer_param.has_fused_activation()) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  if (type == "Convolution" || type == "ConvolutionDepthwise"
+      || type == "InnerProduct") {
+    return true;
+  }
+  return type == "Eltwise" && layer_param.eltwise_param().operation()
+      == EltwiseParameter_EltwiseOp_SUM;
+}
+
+bool IsFusableActivation(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  return type == "ReLU" || type == "ReLU6" || type == "Mish"
+      || type == "Swish";
+}
+
+bool UsesBlob(const LayerParameter& layer_param, const string& blob_name) {
+  for (int i = 0; i < layer_param.bottom_size(); ++i) {
+    if (layer_param.bottom(i) == blob_name) {
+      return true;
+    }
+  }
+  for (int i = 0; i < layer_param.top_size(); ++i) {
+    if (layer_param.top(i) == blob_name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The layer after layer last that next uses blob_name, if it reads it as its
+// only bottom and either works in place or is the last to use it; else -1.
+int SoleNextReader(const vector<LayerParameter>& layers, int last,
+    const string& blob_name) {
+  int next = last + 1;
+  while (next < layers.size() && !UsesBlob(layers[next], blob_name)) {
+    ++next;
+  }
+  if (next == layers.size() || layers[next].bottom_size() != 1
+      || layers[next].top_size() != 1 || layers[next].bottom(0) != blob_name) {
+    return -1;
+  }
+  if (layers[next].top(0) != blob_name) {
+    for (int j = next + 1; j < layers.size(); ++j) {
+      if (UsesBlob(layers[j], blob_name)) {
+        return -1;
+      }
+    }
+  }
+  return next;
+}
+
+void FoldLayers(vector<LayerParameter>* layers_in_out,
+    CompileNetState* state) {
+  vector<LayerParameter>& layers = *layers_in_out;
+  vector<bool> removed(layers.size(), false);
+  for (int i = 0; i < layers.size(); ++i) {
+    if (!IsFoldTarget(layers[i])) {
+      continue;
+    }
+    string blob_name = layers[i].top(0);
+    int last = i;
+    while (true) {
+      // The first layer touching the output after the last fold must be the
+      // next one to fold.
+      const int next = SoleNextReader(layers, last, blob_name);
+      if (next < 0 || !IsFoldable(layers[next])) {
+        break;
+      }
+      LOG_IF(INFO, Caffe::root_solver()) << "Folding layer "
+          << layers[next].name() << " into " << layers[i].name();
+      CompileNetFold* fold = state->add_fold();
+      fold->set_target(layers[i].name());
+      fold->mutable_layer()->CopyFrom(layers[next]);
+      removed[next] = true;
+      blob_name = layers[next].top(0);
+      last = next;
+    }
+    if (last != i) {
+      layers[i].set_top(0, blob_name);
+      if (layers[i].type() == "InnerProduct") {
+        layers[i].mutable_inner_product_param()->set_bias_term(true);
+      } else {
+        layers[i].mutable_convolution_param()->set_bias_term(true);
+      }
+    }
+  }
+  vector<LayerParameter> kept;
+  for (int i = 0; i < layers.size(); ++i) {
+    if (!removed[i]) {
+      kept.push_back(layers[i]);
+    }
+  }
+  layers.swap(kept);
+}
+
+void FuseActivations(vector<LayerParameter>* layers) {
+  vector<bool> removed(layers->size(), false);
+  for (int i = 0; i < layers->size(); ++i) {
+    LayerParameter& target = (*layers)[i];
+    if (!IsActivationTarget(target)) {
+      continue;
+    }
+    const int next = SoleNextReader(*layers, i, target.top(0));
+    if (next < 0 || !IsFusableActivation((*layers)[next])) {
+      continue;
+    }
+    const LayerParameter& activation = (*layers)[next];
+    LOG_IF(INFO, Caffe::root_solver()) << "Fusing layer "
+        << activation.name() << " into " << target.name();
+    target.mutable_fused_activation()->CopyFrom(activation);
+    target.set_top(0, activation.top(0));
+    removed[next] = true;
+  }
+  vector<LayerParameter> fused;
+  for (int i = 0; i < layers->size(); ++i) {
+    if (!removed[i]) {
+      fused.push_back((*layers)[i]);
+    }
+  }
+  layers->swap(fused);
+}
+
+}  // namespace
+
+void CompileNet(const NetParameter& param, NetParameter* param_compiled) {
+  param_compiled->CopyFrom(param);
+  param_compiled->clear_layer();
+  CompileNetState* state = param_compiled->mutable_compile_net_state();
+  state->clear_kept_bn_layers();
+  state->clear_fold();
+  vector<LayerParameter> layers(param.layer().begin(), param.layer().end());
+  if (state->bn_scale_merge()) {
+    FoldLayers(&layers, state);
+  }
+  // The GPU forward passes do not apply fused activations.
+  if (state->fuse_activations() && Caffe::mode() == Caffe::CPU) {
+    FuseActivations(&layers);
+  }
+  for (int i = 0; i < layers.size(); ++i) {
+    if (layers[i].type() == "BatchNorm" || layers[i].type() == "BN") {
+      state->add_kept_bn_layers(layers[i].name());
+    }
+    param_compiled->add_layer()->CopyFrom(layers[i]);
+  }
+  state->set_bn_scale_remove(state->fold_size() > 0);
+}
+
+template <typename Dtype>
+void FoldLayerIntoParams(const LayerParameter& folded,
+    const vector<shared_ptr<Blob<Dtype> > >& target_blobs) {
+  CHECK_EQ(target_blobs.size(), 2)
+      << "Layer " << folded.name() << " needs a target with weights and bias";
+  const int channels = target_blobs[1]->count();
+  vector<shared_ptr<Blob<Dtype> > > blobs(folded.blobs_size());
+  for (int i = 0; i < blobs.size(); ++i) {
+    blobs[i].reset(new Blob<Dtype>());
+    blobs[i]->FromProto(folded.blobs(i));
+  }
+  // The folded layer computes scale * x + shift per channel.
+  vector<Dtype> scale(channels), shift(channels, Dtype(0));
+  const string& type = folded.type();
+  if (type == "BatchNorm") {
+    CHECK_EQ(blobs.size(), 3) << "Incompatible number of blobs for layer "
+        << folded.name();
+    const Dtype moving_average = blobs[2]->cpu_data()[0];
+    const Dtype scale_factor = moving_average == 0 ? 0 : 1 / moving_average;
+    const Dtype eps = folded.batch_norm_param().eps();
+    CHECK_EQ(blobs[0]->count(), channels);
+    CHECK_EQ(blobs[1]->count(), channels);
+    for (int c = 0; c < channels; ++c) {
+      const Dtype mean = blobs[0]->cpu_data()[c] * scale_factor;
+      const Dtype variance = blobs[1]->cpu_data()[c] * scale_factor;
+      scale[c] = 1 / std::sqrt(variance + eps);
+      shift[c] = -mean * scale[c];
+    }
+  } else if (type == "BN") {
+    const bool inference =
+        folded.bn_param().bn_mode() == BNParameter_BNMode_INFERENCE;
+    CHECK_EQ(blobs.size(), inference ? 2 : 4)
+        << "Incompatible number of blobs for layer " << folded.name();
+    for (int i = 0; i < blobs.size(); ++i) {
+      CHECK_EQ(blobs[i]->count(), channels);
+    }
+    const Dtype eps = folded.bn_param().eps();
+    for (int c = 0; c < channels; ++c) {
+      const Dtype slope = blobs[0]->cpu_data()[c];
+      const Dtype bias = blobs[1]->cpu_data()[c];
+      if (inference) {
+        scale[c] = slope;
+        shift[c] = bias;
+      } else {
+        const Dtype inv_std = 1 / std::sqrt(blobs[3]->cpu_data()[c] + eps);
+        scale[c] = slope * inv_std;
+        shift[c] = bias - blobs[2]->cpu_data()[c] * scale[c];
+      }
+    }
+  } else if (type == "Scale") {
+    CHECK_GE(blobs.size(), 1) << "Incompatible number of blobs for layer "
+        << folded.name();
+    for (int i = 0; i < blobs.size(); ++i) {
+      CHECK_EQ(blobs[i]->count(), channels);
+    }
+    for (int c = 0; c < channels; ++c) {
+      scale[c] = blobs[0]->cpu_data()[c];
+      if (blobs.size() > 1) {
+        shift[c] = blobs[1]->cpu_data()[c];
+      }
+    }
+  } else if (type == "Bias") {
+    CHECK_EQ(blobs.size(), 1) << "Incompatible number of blobs for layer "
+        << folded.name();
+    CHECK_EQ(blobs[0]->count(), channels);
+    for (int c = 0; c < channels; ++c) {
+      scale[c] = 1;
+      shift[c] = blobs[0]->cpu_data()[c];
+    }
+  } else {
+    LOG(FATAL) << "Cannot fold layer " << folded.name() << " of type "
+        << type;
+  }
+  const int dim = target_blobs[0]->count() / channels;
+  Dtype* weight = target_blobs[0]->mutable_cpu_data();
+  Dtype* bias = target_blobs[1]->mutable_cpu_data();
+  for (int c = 0; c < channels; ++c) {
+    caffe_scal(dim, scale[c], weight + c * dim);
+    bias[c] = bias[c] * scale[c] + shift[c];
+  }
+}
+
+template void FoldLayerIntoParams<float>(const LayerParameter& folded,
+    const vector<shared_ptr<Blob<float> > >& target_blobs);
+template void FoldLayerIntoParams<double>(const LayerParameter& folded,
+    const vector<shared_ptr<Blob<double> > >& target_blobs);
+
+}  // namespace caffe
@@ -54,6 +54,22 @@ void LMDBTransaction::Put(const string& key, const string& value) {
 }
 
 void LMDBTransaction::Commit() {
+  // Grow the map up front rather than filling it and starting over.
+  size_t bytes = 0;
+  for (int i = 0; i < keys.size(); i++) {
+    bytes += keys[i].size() + values[i].size();
+  }
+  ReserveMapSize(bytes);
+  // The serialized records stay in keys and values until they are committed,
+  // so a full map only costs writing them again.
+  while (!TryCommit()) {
+    DoubleMapSize();
+  }
+  keys.clear();
+  values.clear();
+}
+
+bool LMDBTransaction::TryCommit() {
   MDB_dbi mdb_dbi;
   MDB_val mdb_key, mdb_data;
   MDB_txn *mdb_txn;
@@ -71,12 +87,9 @@ void LMDBTransaction::Commit() {
     // Add data to the transaction
     int put_rc = mdb_put(mdb_txn, mdb_dbi, &mdb_key, &mdb_data, 0);
     if (put_rc == MDB_MAP_FULL) {
-      // Out of memory - double the map size and retry
       mdb_txn_abort(mdb_txn);
       mdb_dbi_close(mdb_env_, mdb_dbi);
-      DoubleMapSize();
-      Commit();
-      return;
+      return false;
     }
     // May have failed for some other reason
     MDB_CHECK(put_rc);
@@ -84,20 +97,32 @@ void LMDBTransaction::Commit() {
 
   // Commit the transaction
   int commit_rc = mdb_txn_commit(mdb_txn);
+  mdb_dbi_close(mdb_env_, mdb_dbi);
   if (commit_rc == MDB_MAP_FULL) {
-    // Out of memory - double the map size and retry
-    mdb_dbi_close(mdb_env_, mdb_dbi);
-    DoubleMapSize();
-    Commit();
-    return;
+    return false;
   }
   // May have failed for some other reason
   MDB_CHECK(commit_rc);
+  return true;
+}
 
-  // Cleanup after successful commit
-  mdb_dbi_close(mdb_env_, mdb_dbi);
-  keys.clear();
-  values.clear();
+void LMDBTransaction::ReserveMapSize(size_t bytes) {
+  struct MDB_envinfo info;
+  struct MDB_stat stat;
+  MDB_CHECK(mdb_env_info(mdb_env_, &info));
+  MDB_CHECK(mdb_env_stat(mdb_env_, &stat));
+  // Pages are not full, large values take whole overflow pages, and the
+  // pages a write transaction copies are only reclaimed once it commits.
+  const size_t used = (info.me_last_pgno + 1) * stat.ms_psize;
+  const size_t needed = used + 2 * bytes + stat.ms_psize * keys.size();
+  size_t new_size = info.me_mapsize;
+  while (new_size < needed) {
+    new_size *= 2;
+  }
+  if (new_size != info.me_mapsize) {
+    DLOG(INFO) << "Growing LMDB map size to " << (new_size>>20) << "MB ...";
+    MDB_CHECK(mdb_env_set_mapsize(mdb_env_, new_size));
+  }
 }
 
 void LMDBTransaction::DoubleMapSize() {
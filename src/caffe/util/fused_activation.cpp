@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <string>
+
+#include "caffe/util/fused_activation.hpp"
+
+namespace caffe {
+
+FusedActivation::FusedActivation(const LayerParameter& layer_param)
+    : type_(NONE), negative_slope_(0), beta_(1) {
+  if (!layer_param.has_fused_activation()) {
+    return;
+  }
+  const LayerParameter& activation = layer_param.fused_activation();
+  const string& type = activation.type();
+  if (type == "ReLU") {
+    type_ = RELU;
+    negative_slope_ = activation.relu_param().negative_slope();
+  } else if (type == "ReLU6") {
+    type_ = RELU6;
+    negative_slope_ = activation.relu6_param().negative_slope();
+  } else if (type == "Mish") {
+    type_ = MISH;
+  } else if (type == "Swish") {
+    type_ = SWISH;
+    beta_ = activation.swish_param().beta();
+  } else {
+    LOG(FATAL) << "Layer " << layer_param.name() << " cannot fuse the "
+        << type << " layer " << activation.name();
+  }
+}
+
+template <typename Dtype>
+void FusedActivation::Forward_cpu(const int n, Dtype* data) const {
+  switch (type_) {
+  case NONE:
+    break;
+  case RELU:
+    // The common case, kept apart so that it vectorizes.
+    for (int i = 0; i < n; ++i) {
+      data[i] = std::max(data[i], Dtype(0))
+          + negative_slope_ * std::min(data[i], Dtype(0));
+    }
+    break;
+  default:
+    for (int i = 0; i < n; ++i) {
+      data[i] = (*this)(data[i]);
+    }
+  }
+}
+
+template void FusedActivation::Forward_cpu<float>(const int n,
+    float* data) const;
+template void FusedActivation::Forward_cpu<double>(const int n,
+    double* data) const;
+
+}  // namespace caffe
@@ -0,0 +1,291 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+
+#ifdef USE_MKL
+  #include "mkl.h"
+#endif
+#ifdef __linux__
+  #include <sys/mman.h>
+#endif
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+static const size_t kHugePageSize = 2 << 20;
+
+static size_t cache_limit_ = 32 << 20;
+static bool huge_pages_ = false;
+
+// Each block starts with its header, padded to the alignment, so that Free
+// only needs the pointer.
+struct BlockHeader {
+  size_t size_class;
+};
+typedef char HeaderFitsInAlignment[
+    sizeof(BlockHeader) <= CAFFE_HOST_ALIGNMENT ? 1 : -1];
+
+static void* SystemAllocate(size_t bytes, bool huge) {
+  const size_t alignment = huge ? kHugePageSize : CAFFE_HOST_ALIGNMENT;
+  void* block = NULL;
+#ifdef USE_MKL
+  block = mkl_malloc(bytes, alignment);
+#else
+  if (posix_memalign(&block, alignment, bytes) != 0) {
+    block = NULL;
+  }
+#endif
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (block && huge) {
+    madvise(block, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  return block;
+}
+
+static void SystemFree(void* block) {
+#ifdef USE_MKL
+  mkl_free(block);
+#else
+  free(block);
+#endif
+}
+
+// Free blocks by size class.
+class FreeBlocks {
+ public:
+  FreeBlocks() : bytes_(0) {}
+
+  void* Pop(size_t size_class) {
+    std::map<size_t, vector<void*> >::iterator it = lists_.find(size_class);
+    if (it == lists_.end() || it->second.empty()) {
+      return NULL;
+    }
+    void* block = it->second.back();
+    it->second.pop_back();
+    bytes_ -= size_class;
+    return block;
+  }
+  // Keeps the block unless it would make the list exceed limit bytes.
+  bool Push(void* block, size_t size_class, size_t limit) {
+    if (bytes_ + size_class > limit) {
+      return false;
+    }
+    lists_[size_class].push_back(block);
+    bytes_ += size_class;
+    return true;
+  }
+  // Moves as many blocks as the limit allows to other and frees the rest.
+  void MoveTo(FreeBlocks* other, size_t limit) {
+    std::map<size_t, vector<void*> >::iterator it;
+    for (it = lists_.begin(); it != lists_.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        if (!other->Push(it->second[i], it->first, limit)) {
+          SystemFree(it->second[i]);
+        }
+      }
+    }
+    lists_.clear();
+    bytes_ = 0;
+  }
+  void Release() {
+    FreeBlocks none;
+    MoveTo(&none, 0);
+  }
+  size_t bytes() const { return bytes_; }
+
+ private:
+  std::map<size_t, vector<void*> > lists_;
+  size_t bytes_;
+};
+
+struct Counters {
+  Counters() : allocations(0), cache_hits(0), bytes_in_use(0) {}
+  uint64_t allocations;
+  uint64_t cache_hits;
+  int64_t bytes_in_use;
+};
+
+class ThreadCache;
+
+// The pool shared by the threads. It also keeps the counters of the threads
+// that exited. It is never destroyed, so that blocks can be freed while
+// static objects are destroyed.
+struct SharedPool {
+  boost::mutex mutex;
+  FreeBlocks blocks;
+  Counters counters;
+  std::set<ThreadCache*> caches;
+};
+
+static SharedPool& shared_pool() {
+  static SharedPool* pool = new SharedPool();
+  return *pool;
+}
+
+// The free lists and counters of a thread. The mutex is only contended while
+// the counters are summed by GetStats.
+class ThreadCache {
+ public:
+  ThreadCache() {
+    SharedPool& pool = shared_pool();
+    boost::mutex::scoped_lock lock(pool.mutex);
+    pool.caches.insert(this);
+  }
+  ~ThreadCache() {
+    SharedPool& pool = shared_pool();
+    boost::mutex::scoped_lock lock(pool.mutex);
+    pool.caches.erase(this);
+    blocks.MoveTo(&pool.blocks, cache_limit_);
+    pool.counters.allocations += counters.allocations;
+    pool.counters.cache_hits += counters.cache_hits;
+    pool.counters.bytes_in_use += counters.bytes_in_use;
+  }
+
+  boost::mutex mutex;
+  FreeBlocks blocks;
+  Counters counters;
+};
+
+static ThreadCache& thread_cache() {
+  static boost::thread_specific_ptr<ThreadCache>* caches =
+      new boost::thread_specific_ptr<ThreadCache>();
+  if (!caches->get()) {
+    caches->reset(new ThreadCache());
+  }
+  return *caches->get();
+}
+
+size_t HostAllocator::SizeClass(size_t size) {
+  if (size <= CAFFE_HOST_ALIGNMENT) {
+    return CAFFE_HOST_ALIGNMENT;
+  }
+  // With size in (2^k, 2^(k+1)], the classes are 2^k plus multiples of 2^k/4,
+  // and of the alignment.
+  int k = 0;
+  while ((size - 1) >> (k + 1)) {
+    ++k;
+  }
+  const size_t step = std::max<size_t>((static_cast<size_t>(1) << k) / 4,
+      CAFFE_HOST_ALIGNMENT);
+  return (size + step - 1) / step * step;
+}
+
+void* HostAllocator::Allocate(size_t size) {
+  const size_t size_class = SizeClass(size);
+  ThreadCache& cache = thread_cache();
+  void* block;
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    block = cache.blocks.Pop(size_class);
+    if (block) {
+      ++cache.counters.allocations;
+      ++cache.counters.cache_hits;
+      cache.counters.bytes_in_use += size_class;
+      return static_cast<char*>(block) + CAFFE_HOST_ALIGNMENT;
+    }
+  }
+  {
+    SharedPool& pool = shared_pool();
+    boost::mutex::scoped_lock lock(pool.mutex);
+    block = pool.blocks.Pop(size_class);
+  }
+  const bool cache_hit = block != NULL;
+  if (!block) {
+    const bool huge = huge_pages_ && size_class >= kHugePageSize;
+    block = SystemAllocate(CAFFE_HOST_ALIGNMENT + size_class, huge);
+    if (!block) {
+      // Give the cached memory back to the system and try again.
+      Trim();
+      block = SystemAllocate(CAFFE_HOST_ALIGNMENT + size_class, huge);
+      if (!block) {
+        return NULL;
+      }
+    }
+    static_cast<BlockHeader*>(block)->size_class = size_class;
+  }
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    ++cache.counters.allocations;
+    cache.counters.cache_hits += cache_hit;
+    cache.counters.bytes_in_use += size_class;
+  }
+  return static_cast<char*>(block) + CAFFE_HOST_ALIGNMENT;
+}
+
+void HostAllocator::Free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  void* block = static_cast<char*>(ptr) - CAFFE_HOST_ALIGNMENT;
+  const size_t size_class = static_cast<BlockHeader*>(block)->size_class;
+  ThreadCache& cache = thread_cache();
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    cache.counters.bytes_in_use -= size_class;
+    if (cache.blocks.Push(block, size_class, cache_limit_)) {
+      return;
+    }
+  }
+  {
+    SharedPool& pool = shared_pool();
+    boost::mutex::scoped_lock lock(pool.mutex);
+    if (pool.blocks.Push(block, size_class, cache_limit_)) {
+      return;
+    }
+  }
+  SystemFree(block);
+}
+
+HostAllocator::Stats HostAllocator::GetStats() {
+  SharedPool& pool = shared_pool();
+  boost::mutex::scoped_lock lock(pool.mutex);
+  Stats stats;
+  stats.allocations = pool.counters.allocations;
+  stats.cache_hits = pool.counters.cache_hits;
+  stats.bytes_in_use = pool.counters.bytes_in_use;
+  stats.bytes_cached = pool.blocks.bytes();
+  std::set<ThreadCache*>::const_iterator it;
+  for (it = pool.caches.begin(); it != pool.caches.end(); ++it) {
+    boost::mutex::scoped_lock cache_lock((*it)->mutex);
+    stats.allocations += (*it)->counters.allocations;
+    stats.cache_hits += (*it)->counters.cache_hits;
+    stats.bytes_in_use += (*it)->counters.bytes_in_use;
+    stats.bytes_cached += (*it)->blocks.bytes();
+  }
+  return stats;
+}
+
+void HostAllocator::Trim() {
+  {
+    ThreadCache& cache = thread_cache();
+    boost::mutex::scoped_lock lock(cache.mutex);
+    cache.blocks.Release();
+  }
+  SharedPool& pool = shared_pool();
+  boost::mutex::scoped_lock lock(pool.mutex);
+  pool.blocks.Release();
+}
+
+void HostAllocator::set_cache_limit(size_t bytes) {
+  cache_limit_ = bytes;
+}
+
+size_t HostAllocator::cache_limit() {
+  return cache_limit_;
+}
+
+void HostAllocator::set_huge_pages(bool huge_pages) {
+  huge_pages_ = huge_pages;
+}
+
+bool HostAllocator::huge_pages() {
+  return huge_pages_;
+}
+
+}  // namespace caffe
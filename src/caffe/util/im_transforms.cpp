@@ -0,0 +1,242 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/im_transforms.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+static int GetInterpMode(const ResizeParameter_Interp_mode interp_mode) {
+  switch (interp_mode) {
+    case ResizeParameter_Interp_mode_AREA:
+      return cv::INTER_AREA;
+    case ResizeParameter_Interp_mode_NEAREST:
+      return cv::INTER_NEAREST;
+    case ResizeParameter_Interp_mode_CUBIC:
+      return cv::INTER_CUBIC;
+    case ResizeParameter_Interp_mode_LANCZOS4:
+      return cv::INTER_LANCZOS4;
+    case ResizeParameter_Interp_mode_LINEAR:
+    default:
+      return cv::INTER_LINEAR;
+  }
+}
+
+static int GetBorderMode(const ResizeParameter_Pad_mode pad_mode) {
+  switch (pad_mode) {
+    case ResizeParameter_Pad_mode_MIRRORED:
+      return cv::BORDER_REFLECT101;
+    case ResizeParameter_Pad_mode_REPEAT_NEAREST:
+      return cv::BORDER_REPLICATE;
+    case ResizeParameter_Pad_mode_CONSTANT:
+    default:
+      return cv::BORDER_CONSTANT;
+  }
+}
+
+void UpdateBBoxByResizePolicy(const ResizeParameter& param,
+                              const int old_width, const int old_height,
+                              NormalizedBBox* bbox) {
+  if (param.resize_mode() !=
+      ResizeParameter_Resize_mode_FIT_LARGE_SIZE_AND_PAD) {
+    // A warp keeps normalized coordinates.
+    return;
+  }
+  const float new_height = param.height();
+  const float new_width = param.width();
+  const float aspect = static_cast<float>(old_width) / old_height;
+  // Same padding as OutputBBox, which maps the detections back.
+  if (aspect > new_width / new_height) {
+    const float padding = (new_height - new_width / aspect) / 2 / new_height;
+    bbox->set_ymin(padding + bbox->ymin() * (1 - 2 * padding));
+    bbox->set_ymax(padding + bbox->ymax() * (1 - 2 * padding));
+  } else {
+    const float padding = (new_width - new_height * aspect) / 2 / new_width;
+    bbox->set_xmin(padding + bbox->xmin() * (1 - 2 * padding));
+    bbox->set_xmax(padding + bbox->xmax() * (1 - 2 * padding));
+  }
+}
+
+cv::Mat ApplyResize(const cv::Mat& in_img, const ResizeParameter& param) {
+  const int new_height = param.height();
+  const int new_width = param.width();
+  CHECK_GT(new_height, 0);
+  CHECK_GT(new_width, 0);
+  int interp_mode = cv::INTER_LINEAR;
+  if (param.interp_mode_size() > 0) {
+    const int k = caffe_rng_rand() % param.interp_mode_size();
+    interp_mode = GetInterpMode(param.interp_mode(k));
+  }
+  cv::Mat out_img;
+  switch (param.resize_mode()) {
+    case ResizeParameter_Resize_mode_WARP:
+      cv::resize(in_img, out_img, cv::Size(new_width, new_height), 0, 0,
+                 interp_mode);
+      break;
+    case ResizeParameter_Resize_mode_FIT_LARGE_SIZE_AND_PAD: {
+      const float aspect = static_cast<float>(in_img.cols) / in_img.rows;
+      int height = new_height;
+      int width = new_width;
+      if (aspect > static_cast<float>(new_width) / new_height) {
+        height = std::max(1, static_cast<int>(round(new_width / aspect)));
+      } else {
+        width = std::max(1, static_cast<int>(round(new_height * aspect)));
+      }
+      cv::Mat scaled_img;
+      cv::resize(in_img, scaled_img, cv::Size(width, height), 0, 0,
+                 interp_mode);
+      cv::Scalar pad_value;
+      if (param.pad_value_size() == 1) {
+        pad_value = cv::Scalar::all(param.pad_value(0));
+      } else if (param.pad_value_size() > 1) {
+        CHECK_EQ(param.pad_value_size(), in_img.channels())
+            << "Specify either 1 pad_value or as many as channels.";
+        for (int c = 0; c < param.pad_value_size() && c < 4; ++c) {
+          pad_value[c] = param.pad_value(c);
+        }
+      }
+      const int top = (new_height - height) / 2;
+      const int left = (new_width - width) / 2;
+      cv::copyMakeBorder(scaled_img, out_img, top, new_height - height - top,
+                         left, new_width - width - left,
+                         GetBorderMode(param.pad_mode()), pad_value);
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unsupported resize mode: "
+                 << ResizeParameter_Resize_mode_Name(param.resize_mode());
+  }
+  return out_img;
+}
+
+cv::Mat ApplyDistort(const cv::Mat& in_img, const DistortionParameter& param) {
+  // Work on a copy, the adjustments below run in place.
+  cv::Mat out_img = in_img.clone();
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob > 0.5) {
+    // Do random brightness distortion.
+    RandomBrightness(out_img, &out_img, param.brightness_prob(),
+                     param.brightness_delta());
+    // Do random contrast distortion.
+    RandomContrast(out_img, &out_img, param.contrast_prob(),
+                   param.contrast_lower(), param.contrast_upper());
+    // Do random saturation distortion.
+    RandomSaturation(out_img, &out_img, param.saturation_prob(),
+                     param.saturation_lower(), param.saturation_upper());
+    // Do random hue distortion.
+    RandomHue(out_img, &out_img, param.hue_prob(), param.hue_delta());
+  } else {
+    // Do random brightness distortion.
+    RandomBrightness(out_img, &out_img, param.brightness_prob(),
+                     param.brightness_delta());
+    // Do random saturation distortion.
+    RandomSaturation(out_img, &out_img, param.saturation_prob(),
+                     param.saturation_lower(), param.saturation_upper());
+    // Do random hue distortion.
+    RandomHue(out_img, &out_img, param.hue_prob(), param.hue_delta());
+    // Do random contrast distortion.
+    RandomContrast(out_img, &out_img, param.contrast_prob(),
+                   param.contrast_lower(), param.contrast_upper());
+  }
+  // Do random reordering of the channels.
+  RandomOrderChannels(out_img, &out_img, param.random_order_prob());
+  return out_img;
+}
+
+void RandomBrightness(const cv::Mat& in_img, cv::Mat* out_img,
+    const float brightness_prob, const float brightness_delta) {
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob < brightness_prob) {
+    CHECK_GE(brightness_delta, 0) << "brightness_delta must be non-negative.";
+    float delta;
+    caffe_rng_uniform(1, -brightness_delta, brightness_delta, &delta);
+    in_img.convertTo(*out_img, -1, 1, delta);
+  } else {
+    *out_img = in_img;
+  }
+}
+
+void RandomContrast(const cv::Mat& in_img, cv::Mat* out_img,
+    const float contrast_prob, const float lower, const float upper) {
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob < contrast_prob) {
+    CHECK_GE(upper, lower) << "contrast upper must be >= lower.";
+    CHECK_GE(lower, 0) << "contrast lower must be non-negative.";
+    float delta;
+    caffe_rng_uniform(1, lower, upper, &delta);
+    in_img.convertTo(*out_img, -1, delta, 0);
+  } else {
+    *out_img = in_img;
+  }
+}
+
+void RandomSaturation(const cv::Mat& in_img, cv::Mat* out_img,
+    const float saturation_prob, const float lower, const float upper) {
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob < saturation_prob) {
+    CHECK_GE(upper, lower) << "saturation upper must be >= lower.";
+    CHECK_GE(lower, 0) << "saturation lower must be non-negative.";
+    CHECK_EQ(in_img.channels(), 3) << "Saturation needs a BGR image.";
+    float delta;
+    caffe_rng_uniform(1, lower, upper, &delta);
+    if (fabs(delta - 1.f) > 1e-3) {
+      cv::Mat hsv_img;
+      cv::cvtColor(in_img, hsv_img, CV_BGR2HSV);
+      vector<cv::Mat> channels;
+      cv::split(hsv_img, channels);
+      channels[1].convertTo(channels[1], -1, delta, 0);
+      cv::merge(channels, hsv_img);
+      cv::cvtColor(hsv_img, *out_img, CV_HSV2BGR);
+      return;
+    }
+  }
+  *out_img = in_img;
+}
+
+void RandomHue(const cv::Mat& in_img, cv::Mat* out_img,
+               const float hue_prob, const float hue_delta) {
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob < hue_prob) {
+    CHECK_GE(hue_delta, 0) << "hue_delta must be non-negative.";
+    CHECK_EQ(in_img.channels(), 3) << "Hue needs a BGR image.";
+    float delta;
+    caffe_rng_uniform(1, -hue_delta, hue_delta, &delta);
+    cv::Mat hsv_img;
+    cv::cvtColor(in_img, hsv_img, CV_BGR2HSV);
+    vector<cv::Mat> channels;
+    cv::split(hsv_img, channels);
+    channels[0].convertTo(channels[0], -1, 1, delta);
+    cv::merge(channels, hsv_img);
+    cv::cvtColor(hsv_img, *out_img, CV_HSV2BGR);
+  } else {
+    *out_img = in_img;
+  }
+}
+
+void RandomOrderChannels(const cv::Mat& in_img, cv::Mat* out_img,
+                         const float random_order_prob) {
+  float prob;
+  caffe_rng_uniform(1, 0.f, 1.f, &prob);
+  if (prob < random_order_prob) {
+    vector<cv::Mat> channels;
+    cv::split(in_img, channels);
+    shuffle(channels.begin(), channels.end());
+    cv::merge(channels, *out_img);
+  } else {
+    *out_img = in_img;
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
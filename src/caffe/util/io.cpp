@@ -127,30 +127,112 @@ static bool matchExt(const std::string & fn,
   return false;
 }
 
+// Stores cv_img, read from filename, in datum. With an encoding, the file
+// itself is stored when cv_img is the unchanged image in that encoding.
+static bool CVMatToEncodedDatum(const cv::Mat& cv_img, const string& filename,
+    const int label, const bool resized, const bool is_color,
+    const std::string & encoding, Datum* datum) {
+  if (encoding.size()) {
+    if ( (cv_img.channels() == 3) == is_color && !resized &&
+        matchExt(filename, encoding) )
+      return ReadFileToDatum(filename, label, datum);
+    std::vector<uchar> buf;
+    cv::imencode("."+encoding, cv_img, buf);
+    datum->set_data(std::string(reinterpret_cast<char*>(&buf[0]),
+                    buf.size()));
+    datum->set_label(label);
+    datum->set_encoded(true);
+    return true;
+  }
+  CVMatToDatum(cv_img, datum);
+  datum->set_label(label);
+  return true;
+}
+
 bool ReadImageToDatum(const string& filename, const int label,
     const int height, const int width, const bool is_color,
     const std::string & encoding, Datum* datum) {
   cv::Mat cv_img = ReadImageToCVMat(filename, height, width, is_color);
   if (cv_img.data) {
-    if (encoding.size()) {
-      if ( (cv_img.channels() == 3) == is_color && !height && !width &&
-          matchExt(filename, encoding) )
-        return ReadFileToDatum(filename, label, datum);
-      std::vector<uchar> buf;
-      cv::imencode("."+encoding, cv_img, buf);
-      datum->set_data(std::string(reinterpret_cast<char*>(&buf[0]),
-                      buf.size()));
-      datum->set_label(label);
-      datum->set_encoded(true);
-      return true;
-    }
-    CVMatToDatum(cv_img, datum);
-    datum->set_label(label);
-    return true;
+    return CVMatToEncodedDatum(cv_img, filename, label, height || width,
+                               is_color, encoding, datum);
   } else {
     return false;
   }
 }
+
+void GetImageSize(const string& filename, int* height, int* width) {
+  cv::Mat cv_img = cv::imread(filename);
+  if (!cv_img.data) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return;
+  }
+  *height = cv_img.rows;
+  *width = cv_img.cols;
+}
+
+bool ReadRichImageToAnnotatedDatum(const string& filename,
+    const string& labelfile, const int height, const int width,
+    const int min_dim, const int max_dim, const bool is_color,
+    const std::string& encoding, const AnnotatedDatum_AnnotationType type,
+    const string& labeltype, const std::map<string, int>& name_to_label,
+    AnnotatedDatum* anno_datum) {
+  // Decode the image once, the annotations are relative to its original size.
+  cv::Mat cv_img = ReadImageToCVMat(filename, is_color);
+  if (!cv_img.data) {
+    return false;
+  }
+  const int ori_height = cv_img.rows;
+  const int ori_width = cv_img.cols;
+  int new_height = height;
+  int new_width = width;
+  if (min_dim > 0 || max_dim > 0) {
+    // Keep the aspect ratio, with the short side at least min_dim and the
+    // long side at most max_dim.
+    float scale = 1;
+    if (min_dim > 0) {
+      scale = static_cast<float>(min_dim) / std::min(ori_height, ori_width);
+    }
+    if (max_dim > 0 && scale * std::max(ori_height, ori_width) > max_dim) {
+      scale = static_cast<float>(max_dim) / std::max(ori_height, ori_width);
+    }
+    new_height = static_cast<int>(ori_height * scale + 0.5);
+    new_width = static_cast<int>(ori_width * scale + 0.5);
+  }
+  const bool resized = new_height > 0 && new_width > 0;
+  if (resized) {
+    cv::Mat cv_resized;
+    cv::resize(cv_img, cv_resized, cv::Size(new_width, new_height));
+    cv_img = cv_resized;
+  }
+  if (!CVMatToEncodedDatum(cv_img, filename, -1, resized, is_color, encoding,
+                           anno_datum->mutable_datum())) {
+    return false;
+  }
+  anno_datum->clear_annotation_group();
+  if (!boost::filesystem::exists(labelfile)) {
+    return true;
+  }
+  switch (type) {
+    case AnnotatedDatum_AnnotationType_BBOX:
+      if (labeltype == "xml") {
+        return ReadXMLToAnnotatedDatum(labelfile, ori_height, ori_width,
+                                       name_to_label, anno_datum);
+      } else if (labeltype == "json") {
+        return ReadJSONToAnnotatedDatum(labelfile, ori_height, ori_width,
+                                        name_to_label, anno_datum);
+      } else if (labeltype == "txt") {
+        return ReadTxtToAnnotatedDatum(labelfile, ori_height, ori_width,
+                                       anno_datum);
+      } else {
+        LOG(FATAL) << "Unknown label file type " << labeltype;
+        return false;
+      }
+    default:
+      LOG(FATAL) << "Unknown annotation type.";
+      return false;
+  }
+}
 #endif  // USE_OPENCV
 
 bool ReadFileToDatum(const string& filename, const int label,
@@ -638,5 +720,27 @@ void CVMatToDatum(const cv::Mat& cv_img, Datum* datum) {
   }
   datum->set_data(buffer);
 }
+
+cv::Mat DatumToCVMat(const Datum& datum) {
+  CHECK(!datum.encoded()) << "Datum is encoded, see DecodeDatumToCVMat";
+  const int datum_channels = datum.channels();
+  const int datum_height = datum.height();
+  const int datum_width = datum.width();
+  const string& buffer = datum.data();
+  CHECK_EQ(buffer.size(), datum_channels * datum_height * datum_width)
+      << "Datum must hold uint8 data";
+  cv::Mat cv_img(datum_height, datum_width, CV_8UC(datum_channels));
+  for (int h = 0; h < datum_height; ++h) {
+    uchar* ptr = cv_img.ptr<uchar>(h);
+    int img_index = 0;
+    for (int w = 0; w < datum_width; ++w) {
+      for (int c = 0; c < datum_channels; ++c) {
+        int datum_index = (c * datum_height + h) * datum_width + w;
+        ptr[img_index++] = static_cast<uchar>(buffer[datum_index]);
+      }
+    }
+  }
+  return cv_img;
+}
 #endif  // USE_OPENCV
 }  // namespace caffe
@@ -0,0 +1,180 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+static const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'M', 'A', 'P'};
+static const uint32_t kVersion = 1;
+
+// The magic, the version, a reserved word and the size of the index.
+struct MappedHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t index_size;
+};
+
+static size_t Align(size_t offset) {
+  return (offset + CAFFE_HOST_ALIGNMENT - 1) / CAFFE_HOST_ALIGNMENT
+      * CAFFE_HOST_ALIGNMENT;
+}
+
+// The shape of a BlobProto, as Blob::FromProto reads it.
+static vector<int> ProtoShape(const BlobProto& proto) {
+  vector<int> shape;
+  if (proto.has_num() || proto.has_channels() ||
+      proto.has_height() || proto.has_width()) {
+    shape.push_back(proto.num());
+    shape.push_back(proto.channels());
+    shape.push_back(proto.height());
+    shape.push_back(proto.width());
+  } else {
+    for (int i = 0; i < proto.shape().dim_size(); ++i) {
+      shape.push_back(proto.shape().dim(i));
+    }
+  }
+  return shape;
+}
+
+static size_t ShapeCount(const vector<int>& shape) {
+  size_t count = 1;
+  for (int i = 0; i < shape.size(); ++i) {
+    count *= shape[i];
+  }
+  return count;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : addr_(NULL), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << filename;
+  size_ = st.st_size;
+  CHECK_GE(size_, sizeof(MappedHeader)) << "Truncated file " << filename;
+  // Private so that the nets can write to their parameters without changing
+  // the file; the pages stay shared until then.
+  addr_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(addr_ != MAP_FAILED) << "Cannot map " << filename;
+  const char* bytes = static_cast<const char*>(addr_);
+  const MappedHeader* header = reinterpret_cast<const MappedHeader*>(bytes);
+  CHECK_EQ(memcmp(header->magic, kMagic, sizeof(kMagic)), 0)
+      << filename << " is not a mapped weights file";
+  CHECK_EQ(header->version, kVersion) << "Unsupported version of " << filename;
+  CHECK_LE(sizeof(MappedHeader) + header->index_size, size_)
+      << "Truncated file " << filename;
+  CHECK(index_.ParseFromArray(bytes + sizeof(MappedHeader),
+                              header->index_size))
+      << "Cannot parse the index of " << filename;
+  size_t end = sizeof(MappedHeader) + header->index_size;
+  offsets_.resize(index_.layer_size());
+  shapes_.resize(index_.layer_size());
+  for (int i = 0; i < index_.layer_size(); ++i) {
+    const LayerParameter& layer = index_.layer(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      shapes_[i].push_back(ProtoShape(layer.blobs(j)));
+      offsets_[i].push_back(Align(end));
+      end = Align(end) + ShapeCount(shapes_[i][j]) * sizeof(float);
+    }
+  }
+  CHECK_LE(end, size_) << "Truncated file " << filename;
+}
+
+MappedWeights::~MappedWeights() {
+  munmap(addr_, size_);
+}
+
+float* MappedWeights::data(int i, int j) const {
+  return reinterpret_cast<float*>(static_cast<char*>(addr_) + offsets_[i][j]);
+}
+
+void MappedWeights::ToProto(int i, int j, BlobProto* proto) const {
+  proto->CopyFrom(index_.layer(i).blobs(j));
+  const float* blob_data = data(i, j);
+  const size_t count = ShapeCount(shapes_[i][j]);
+  for (size_t k = 0; k < count; ++k) {
+    proto->add_data(blob_data[k]);
+  }
+}
+
+bool MappedWeights::IsMappedWeights(const string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(magic)) &&
+      memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+void MappedWeights::Write(const NetParameter& param, const string& filename) {
+  NetParameter index;
+  index.set_name(param.name());
+  vector<const LayerParameter*> sources;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& source = param.layer(i);
+    if (!source.blobs_size()) {
+      continue;
+    }
+    sources.push_back(&source);
+    LayerParameter* layer = index.add_layer();
+    layer->set_name(source.name());
+    layer->set_type(source.type());
+    for (int j = 0; j < source.blobs_size(); ++j) {
+      BlobProto* blob = layer->add_blobs();
+      blob->CopyFrom(source.blobs(j));
+      blob->clear_data();
+      blob->clear_double_data();
+      blob->clear_diff();
+      blob->clear_double_diff();
+    }
+  }
+  string index_bytes;
+  CHECK(index.SerializeToString(&index_bytes));
+
+  std::ofstream file(filename.c_str(),
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+  CHECK(file) << "Cannot create " << filename;
+  MappedHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.reserved = 0;
+  header.index_size = index_bytes.size();
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(index_bytes.data(), index_bytes.size());
+  size_t offset = sizeof(header) + index_bytes.size();
+  const vector<char> padding(CAFFE_HOST_ALIGNMENT, 0);
+  vector<float> data;
+  for (int i = 0; i < index.layer_size(); ++i) {
+    for (int j = 0; j < sources[i]->blobs_size(); ++j) {
+      file.write(&padding[0], Align(offset) - offset);
+      offset = Align(offset);
+      const BlobProto& blob = sources[i]->blobs(j);
+      const size_t count = ShapeCount(ProtoShape(blob));
+      if (blob.double_data_size() > 0) {
+        CHECK_EQ(count, blob.double_data_size());
+        data.assign(blob.double_data().begin(), blob.double_data().end());
+      } else {
+        CHECK_EQ(count, blob.data_size());
+        data.assign(blob.data().begin(), blob.data().end());
+      }
+      if (count) {
+        file.write(reinterpret_cast<const char*>(&data[0]),
+                   count * sizeof(float));
+      }
+      offset += count * sizeof(float);
+    }
+  }
+  CHECK(file) << "Cannot write " << filename;
+}
+
+}  // namespace caffe
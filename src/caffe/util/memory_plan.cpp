@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/memory_plan.hpp"
+
+namespace caffe {
+
+// Larger buffers first, then earlier ones, for a deterministic plan.
+struct LargerBuffer {
+  explicit LargerBuffer(const vector<size_t>& sizes, const vector<int>& first)
+      : sizes_(sizes), first_(first) {}
+  bool operator()(int a, int b) const {
+    if (sizes_[a] != sizes_[b]) { return sizes_[a] > sizes_[b]; }
+    if (first_[a] != first_[b]) { return first_[a] < first_[b]; }
+    return a < b;
+  }
+  const vector<size_t>& sizes_;
+  const vector<int>& first_;
+};
+
+size_t PlanMemory(const vector<size_t>& sizes, const vector<int>& first,
+    const vector<int>& last, size_t alignment, vector<size_t>* offsets) {
+  const int num = sizes.size();
+  CHECK_EQ(num, first.size());
+  CHECK_EQ(num, last.size());
+  CHECK_GT(alignment, 0);
+  vector<int> order(num);
+  vector<size_t> aligned(num);
+  for (int i = 0; i < num; ++i) {
+    CHECK_LE(first[i], last[i]) << "Buffer " << i << " dies before it lives.";
+    order[i] = i;
+    aligned[i] = (sizes[i] + alignment - 1) / alignment * alignment;
+  }
+  std::sort(order.begin(), order.end(), LargerBuffer(sizes, first));
+  offsets->assign(num, 0);
+  size_t arena = 0;
+  vector<int> placed;
+  vector<pair<size_t, size_t> > taken;
+  for (int k = 0; k < num; ++k) {
+    const int i = order[k];
+    const size_t size = aligned[i];
+    // The ranges of the placed buffers alive with i, by offset.
+    taken.clear();
+    for (int p = 0; p < placed.size(); ++p) {
+      const int j = placed[p];
+      if (first[j] <= last[i] && first[i] <= last[j]) {
+        taken.push_back(std::make_pair((*offsets)[j],
+            (*offsets)[j] + aligned[j]));
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (int t = 0; t < taken.size(); ++t) {
+      if (taken[t].first >= offset + size) { break; }
+      offset = std::max(offset, taken[t].second);
+    }
+    (*offsets)[i] = offset;
+    arena = std::max(arena, offset + size);
+    placed.push_back(i);
+  }
+  return arena;
+}
+
+}  // namespace caffe
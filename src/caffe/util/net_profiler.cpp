@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/net_profiler.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(Net<Dtype>* net, int max_samples,
+    int max_trace_events)
+    : net_(net), max_samples_(max_samples),
+      max_trace_events_(max_trace_events) {
+  CHECK(net_);
+  CHECK_GT(max_samples_, 0);
+  CHECK_GE(max_trace_events_, 0);
+  Reset();
+  hooks_.push_back(shared_ptr<Hook>(new Hook(this, FORWARD, true)));
+  hooks_.push_back(shared_ptr<Hook>(new Hook(this, FORWARD, false)));
+  hooks_.push_back(shared_ptr<Hook>(new Hook(this, BACKWARD, true)));
+  hooks_.push_back(shared_ptr<Hook>(new Hook(this, BACKWARD, false)));
+  net_->add_before_forward(hooks_[0].get());
+  net_->add_after_forward(hooks_[1].get());
+  net_->add_before_backward(hooks_[2].get());
+  net_->add_after_backward(hooks_[3].get());
+}
+
+template <typename Dtype>
+NetProfiler<Dtype>::~NetProfiler() {
+  for (int i = 0; i < hooks_.size(); ++i) {
+    net_->remove_callback(hooks_[i].get());
+  }
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Reset() {
+  const int num_layers = net_->layers().size();
+  for (int pass = FORWARD; pass <= BACKWARD; ++pass) {
+    stats_[pass].clear();
+    stats_[pass].resize(num_layers);
+  }
+  trace_.clear();
+  epoch_ = boost::posix_time::microsec_clock::local_time();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Start(int layer, Pass pass) {
+  start_ = boost::posix_time::microsec_clock::local_time();
+  timer_.Start();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Stop(int layer, Pass pass) {
+  const double us = timer_.MicroSeconds();
+  Stats& stats = stats_[pass][layer];
+  if (stats.count == 0 || us < stats.min_us) { stats.min_us = us; }
+  if (stats.count == 0 || us > stats.max_us) { stats.max_us = us; }
+  ++stats.count;
+  stats.total_us += us;
+  stats.flops = EstimateFlops(layer, pass);
+  stats.bytes = EstimateBytes(layer, pass);
+  if (stats.samples.size() < max_samples_) {
+    stats.samples.push_back(us);
+  } else {
+    stats.samples[stats.next_sample] = us;
+    stats.next_sample = (stats.next_sample + 1) % max_samples_;
+  }
+  if (trace_.size() < max_trace_events_) {
+    TraceEvent event;
+    event.layer = layer;
+    event.pass = pass;
+    event.start_us = (start_ - epoch_).total_microseconds();
+    event.duration_us = us;
+    trace_.push_back(event);
+  }
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::Percentile(int layer, Pass pass, double p) const {
+  vector<float> samples = stats_[pass][layer].samples;
+  if (samples.empty()) { return 0; }
+  // Nearest rank.
+  int rank = static_cast<int>(std::ceil(p / 100 * samples.size())) - 1;
+  rank = std::min(std::max(rank, 0), static_cast<int>(samples.size()) - 1);
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  return samples[rank];
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::TotalMicroSeconds(Pass pass) const {
+  double total = 0;
+  for (int i = 0; i < stats_[pass].size(); ++i) {
+    total += stats_[pass][i].total_us;
+  }
+  return total;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::EstimateFlops(int layer, Pass pass) const {
+  Layer<Dtype>& l = *net_->layers()[layer];
+  const vector<Blob<Dtype>*>& bottom = net_->bottom_vecs()[layer];
+  const vector<Blob<Dtype>*>& top = net_->top_vecs()[layer];
+  const string type = l.type();
+  double top_count = 0;
+  for (int i = 0; i < top.size(); ++i) { top_count += top[i]->count(); }
+  double flops = top_count;
+  if ((type == "Convolution" || type == "Deconvolution") &&
+      l.blobs().size() > 0 && bottom.size() > 0) {
+    // A multiply-add per weight of a filter, for each output of the
+    // convolution: the top of Convolution and the bottom of Deconvolution.
+    const Blob<Dtype>& weight = *l.blobs()[0];
+    const double filter = weight.count() / weight.shape(0);
+    double outputs = 0;
+    const vector<Blob<Dtype>*>& out = type == "Convolution" ? top : bottom;
+    for (int i = 0; i < out.size(); ++i) { outputs += out[i]->count(); }
+    flops = 2 * outputs * filter;
+  } else if (type == "InnerProduct" && l.blobs().size() > 0 &&
+      top.size() > 0) {
+    const int num_output = l.layer_param().inner_product_param().num_output();
+    flops = 2 * (top[0]->count() / num_output) * l.blobs()[0]->count();
+  } else if (type == "Pooling" && bottom.size() > 0 && top.size() > 0) {
+    const PoolingParameter& param = l.layer_param().pooling_param();
+    double window;
+    if (param.global_pooling()) {
+      window = bottom[0]->count(2);
+    } else if (param.has_kernel_h()) {
+      window = param.kernel_h() * param.kernel_w();
+    } else {
+      window = param.kernel_size() * param.kernel_size();
+    }
+    flops = top[0]->count() * window;
+  }
+  // The backward of the layers with weights computes the gradients of both
+  // the bottom and the weights.
+  if (pass == BACKWARD) {
+    if (!net_->layer_need_backward()[layer]) { return 0; }
+    if (l.blobs().size() > 0) { flops *= 2; }
+  }
+  return flops;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::EstimateBytes(int layer, Pass pass) const {
+  Layer<Dtype>& l = *net_->layers()[layer];
+  const vector<Blob<Dtype>*>& bottom = net_->bottom_vecs()[layer];
+  const vector<Blob<Dtype>*>& top = net_->top_vecs()[layer];
+  double count = 0;
+  for (int i = 0; i < bottom.size(); ++i) { count += bottom[i]->count(); }
+  for (int i = 0; i < top.size(); ++i) {
+    // In-place layers move their data once.
+    if (std::find(bottom.begin(), bottom.end(), top[i]) == bottom.end()) {
+      count += top[i]->count();
+    }
+  }
+  for (int i = 0; i < l.blobs().size(); ++i) {
+    count += l.blobs()[i]->count();
+  }
+  // The backward reads the data and the diffs, and writes the diffs.
+  if (pass == BACKWARD) {
+    if (!net_->layer_need_backward()[layer]) { return 0; }
+    count *= 2;
+  }
+  return count * sizeof(Dtype);
+}
+
+// Escapes the characters of s that cannot appear in a JSON string.
+static string JSONString(const string& s) {
+  std::ostringstream os;
+  os << '"';
+  for (int i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (c < 0x20) {
+      os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+         << static_cast<int>(c) << std::dec;
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+  return os.str();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::StatsToJSON(int layer, Pass pass,
+    std::ostream* os) const {
+  const Stats& stats = stats_[pass][layer];
+  const double mean_us = stats.count ? stats.total_us / stats.count : 0;
+  *os << "{\"count\": " << stats.count
+      << ", \"total_ms\": " << stats.total_us / 1000
+      << ", \"mean_ms\": " << mean_us / 1000
+      << ", \"min_ms\": " << stats.min_us / 1000
+      << ", \"max_ms\": " << stats.max_us / 1000
+      << ", \"p50_ms\": " << Percentile(layer, pass, 50) / 1000
+      << ", \"p90_ms\": " << Percentile(layer, pass, 90) / 1000
+      << ", \"p99_ms\": " << Percentile(layer, pass, 99) / 1000
+      << ", \"flops\": " << stats.flops
+      << ", \"bytes\": " << stats.bytes
+      << ", \"gflops_per_s\": " << (mean_us ? stats.flops / mean_us / 1e3 : 0)
+      << ", \"gbytes_per_s\": " << (mean_us ? stats.bytes / mean_us / 1e3 : 0)
+      << "}";
+}
+
+template <typename Dtype>
+string NetProfiler<Dtype>::ToJSON() const {
+  std::ostringstream os;
+  os << std::setprecision(9);
+  os << "{\"net\": " << JSONString(net_->name())
+     << ", \"forward_ms\": " << TotalMicroSeconds(FORWARD) / 1000
+     << ", \"backward_ms\": " << TotalMicroSeconds(BACKWARD) / 1000
+     << ", \"layers\": [";
+  for (int i = 0; i < net_->layers().size(); ++i) {
+    os << (i ? ",\n  " : "\n  ")
+       << "{\"name\": " << JSONString(net_->layer_names()[i])
+       << ", \"type\": " << JSONString(net_->layers()[i]->type())
+       << ", \"forward\": ";
+    StatsToJSON(i, FORWARD, &os);
+    os << ", \"backward\": ";
+    StatsToJSON(i, BACKWARD, &os);
+    os << "}";
+  }
+  os << "\n]}\n";
+  return os.str();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteJSON(const string& filename) const {
+  std::ofstream file(filename.c_str());
+  CHECK(file) << "Failed to open " << filename;
+  file << ToJSON();
+  CHECK(file) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteChromeTrace(const string& filename) const {
+  std::ofstream file(filename.c_str());
+  CHECK(file) << "Failed to open " << filename;
+  file << std::setprecision(15) << "{\"traceEvents\": [";
+  for (int i = 0; i < trace_.size(); ++i) {
+    const TraceEvent& event = trace_[i];
+    file << (i ? ",\n  " : "\n  ")
+         << "{\"name\": " << JSONString(net_->layer_names()[event.layer])
+         << ", \"cat\": \""
+         << (event.pass == FORWARD ? "forward" : "backward")
+         << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0"
+         << ", \"ts\": " << event.start_us
+         << ", \"dur\": " << event.duration_us
+         << ", \"args\": {\"type\": "
+         << JSONString(net_->layers()[event.layer]->type()) << "}}";
+  }
+  file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  CHECK(file) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LogSummary() const {
+  LOG(INFO) << "Average time per layer: ";
+  for (int i = 0; i < net_->layers().size(); ++i) {
+    const string& name = net_->layer_names()[i];
+    for (int pass = FORWARD; pass <= BACKWARD; ++pass) {
+      const Stats& stats = stats_[pass][i];
+      if (stats.count == 0) { continue; }
+      LOG(INFO) << std::setfill(' ') << std::setw(10) << name
+          << (pass == FORWARD ? "\tforward: " : "\tbackward: ")
+          << stats.total_us / 1000 / stats.count << " ms (p50 "
+          << Percentile(i, static_cast<Pass>(pass), 50) / 1000 << ", p99 "
+          << Percentile(i, static_cast<Pass>(pass), 99) / 1000 << ", "
+          << stats.flops / 1e9 << " GFLOP, " << stats.bytes / (1 << 20)
+          << " MB).";
+    }
+  }
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
@@ -0,0 +1,434 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/util/quantize.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_INT8_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace caffe {
+
+static float QuantizationScale(
+    const google::protobuf::RepeatedField<float>& scale,
+    const google::protobuf::RepeatedField<int32_t>& fl, const int i,
+    const char* name) {
+  if (i < scale.size()) {
+    CHECK_GT(scale.Get(i), 0) << "Non positive " << name << " scale";
+    return scale.Get(i);
+  }
+  CHECK_LT(i, fl.size()) << "Missing " << name << " scale " << i;
+  return std::ldexp(1.f, fl.Get(i));
+}
+
+float QuantizationScaleIn(const QuantizationParameter& param, int i) {
+  return QuantizationScale(param.scale_in(), param.fl_layer_in(), i, "input");
+}
+
+float QuantizationScaleOut(const QuantizationParameter& param, int i) {
+  return QuantizationScale(param.scale_out(), param.fl_layer_out(), i,
+                           "output");
+}
+
+float QuantizationScaleParams(const QuantizationParameter& param, int i) {
+  return QuantizationScale(param.scale_params(), param.fl_params(), i,
+                           "parameter");
+}
+
+bool QuantizesOutput(const QuantizationParameter& param) {
+  return param.bw_layer_out() <= 8 &&
+      (param.scale_out_size() > 0 || param.fl_layer_out_size() > 0);
+}
+
+// Rounds half away from zero, after clamping so that the cast cannot
+// overflow.
+template <typename Dtype>
+static inline int QuantizeValue(const Dtype x, const float scale,
+    const QuantizedRange& range) {
+  Dtype r = x * scale;
+  r = r < range.min ? range.min : (r > range.max ? range.max : r);
+  return static_cast<int>(r + (r >= 0 ? Dtype(0.5) : Dtype(-0.5)));
+}
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, const int offset, uint8_t* q) {
+  for (int i = 0; i < n; ++i) {
+    q[i] = static_cast<uint8_t>(QuantizeValue(x[i], scale, range) + offset);
+  }
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float* x,
+    const float scale, const QuantizedRange& range, const int offset,
+    uint8_t* q);
+template void caffe_cpu_quantize<double>(const int n, const double* x,
+    const float scale, const QuantizedRange& range, const int offset,
+    uint8_t* q);
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, int8_t* q) {
+  for (int i = 0; i < n; ++i) {
+    q[i] = static_cast<int8_t>(QuantizeValue(x[i], scale, range));
+  }
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float* x,
+    const float scale, const QuantizedRange& range, int8_t* q);
+template void caffe_cpu_quantize<double>(const int n, const double* x,
+    const float scale, const QuantizedRange& range, int8_t* q);
+
+template <typename Dtype>
+void caffe_cpu_fake_quantize(const int n, const Dtype* x, const float scale,
+    const QuantizedRange& range, Dtype* y) {
+  const Dtype inv_scale = Dtype(1) / scale;
+  for (int i = 0; i < n; ++i) {
+    y[i] = QuantizeValue(x[i], scale, range) * inv_scale;
+  }
+}
+
+template void caffe_cpu_fake_quantize<float>(const int n, const float* x,
+    const float scale, const QuantizedRange& range, float* y);
+template void caffe_cpu_fake_quantize<double>(const int n, const double* x,
+    const float scale, const QuantizedRange& range, double* y);
+
+// Quantizes rows [i_begin, rows) of x transposed, by tiles, so that the
+// lines of x and q being read and written stay in the cache.
+template <typename Dtype>
+static void QuantizeTransposed(const int i_begin, const int rows,
+    const int cols, const Dtype* x, const float scale,
+    const QuantizedRange& range, const int offset, const int ldq,
+    uint8_t* q) {
+  const int kTile = 32;
+  for (int i0 = i_begin; i0 < rows; i0 += kTile) {
+    const int i1 = std::min(rows, i0 + kTile);
+    for (int j0 = 0; j0 < cols; j0 += kTile) {
+      const int j1 = std::min(cols, j0 + kTile);
+      for (int i = i0; i < i1; ++i) {
+        for (int j = j0; j < j1; ++j) {
+          q[j * ldq + i] = static_cast<uint8_t>(
+              QuantizeValue(x[i * cols + j], scale, range) + offset);
+        }
+      }
+    }
+  }
+}
+
+#ifdef CAFFE_INT8_X86_KERNELS
+// The vector kernels quantize 4 rows at a time, which gives the 4 bytes of
+// each column in a 32 bit lane, and store the lanes to the rows of q. They
+// sweep the whole rows, so that x is read as 4 sequential streams; tiling
+// the columns instead has x read as hundreds of short streams, which the
+// prefetcher cannot follow, and is 2 to 3 times slower. They round as
+// QuantizeValue: the values are clamped, and 0.5 with their sign added
+// before truncating.
+__attribute__((target("avx512f")))
+static int QuantizeTransposedAVX512(const int rows, const int cols,
+    const float* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q) {
+  const __m512 vscale = _mm512_set1_ps(scale);
+  const __m512 vmin = _mm512_set1_ps(range.min);
+  const __m512 vmax = _mm512_set1_ps(range.max);
+  const __m512i sign = _mm512_set1_epi32(0x80000000);
+  const __m512i half = _mm512_castps_si512(_mm512_set1_ps(0.5f));
+  const __m512i voffset = _mm512_set1_epi32(offset);
+  const __m512i byte = _mm512_set1_epi32(0xff);
+  const __m512i lanes = _mm512_mullo_epi32(_mm512_set1_epi32(ldq),
+      _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+  const int rows4 = rows / 4 * 4;
+  for (int i = 0; i < rows4; i += 4) {
+    for (int j = 0; j < cols; j += 16) {
+      const __mmask16 mask = cols - j >= 16 ? 0xffff : (1 << (cols - j)) - 1;
+      __m512i group = _mm512_setzero_si512();
+      for (int r = 0; r < 4; ++r) {
+        __m512 v = _mm512_maskz_loadu_ps(mask, x + (i + r) * cols + j);
+        v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(v, vscale), vmin),
+                          vmax);
+        v = _mm512_add_ps(v, _mm512_castsi512_ps(_mm512_or_si512(half,
+            _mm512_and_si512(_mm512_castps_si512(v), sign))));
+        const __m512i value = _mm512_and_si512(
+            _mm512_add_epi32(_mm512_cvttps_epi32(v), voffset), byte);
+        group = _mm512_or_si512(group, _mm512_slli_epi32(value, 8 * r));
+      }
+      _mm512_mask_i32scatter_epi32(q + j * ldq + i, mask, lanes, group, 1);
+    }
+  }
+  return rows4;
+}
+
+__attribute__((target("avx2")))
+static int QuantizeTransposedAVX2(const int rows, const int cols,
+    const float* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q) {
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 vmin = _mm256_set1_ps(range.min);
+  const __m256 vmax = _mm256_set1_ps(range.max);
+  const __m256i sign = _mm256_set1_epi32(0x80000000);
+  const __m256i half = _mm256_castps_si256(_mm256_set1_ps(0.5f));
+  const __m256i voffset = _mm256_set1_epi32(offset);
+  const __m256i byte = _mm256_set1_epi32(0xff);
+  const int rows4 = rows / 4 * 4;
+  const int cols8 = cols / 8 * 8;
+  for (int i = 0; i < rows4; i += 4) {
+    for (int j = 0; j < cols8; j += 8) {
+      __m256i group = _mm256_setzero_si256();
+      for (int r = 0; r < 4; ++r) {
+        __m256 v = _mm256_loadu_ps(x + (i + r) * cols + j);
+        v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, vscale), vmin),
+                          vmax);
+        v = _mm256_add_ps(v, _mm256_castsi256_ps(_mm256_or_si256(half,
+            _mm256_and_si256(_mm256_castps_si256(v), sign))));
+        const __m256i value = _mm256_and_si256(
+            _mm256_add_epi32(_mm256_cvttps_epi32(v), voffset), byte);
+        group = _mm256_or_si256(group, _mm256_sll_epi32(value,
+            _mm_cvtsi32_si128(8 * r)));
+      }
+      uint32_t groups[8];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(groups), group);
+      for (int l = 0; l < 8; ++l) {
+        memcpy(q + (j + l) * ldq + i, &groups[l], sizeof(groups[l]));
+      }
+    }
+  }
+  // The last columns of the rows done above.
+  for (int i = 0; i < rows4; ++i) {
+    for (int j = cols8; j < cols; ++j) {
+      q[j * ldq + i] = static_cast<uint8_t>(
+          QuantizeValue(x[i * cols + j], scale, range) + offset);
+    }
+  }
+  return rows4;
+}
+#endif  // CAFFE_INT8_X86_KERNELS
+
+// Returns the number of rows the vector kernels quantized, from the first.
+static int QuantizeTransposedVector(const int rows, const int cols,
+    const float* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q) {
+#ifdef CAFFE_INT8_X86_KERNELS
+  if (__builtin_cpu_supports("avx512f")) {
+    return QuantizeTransposedAVX512(rows, cols, x, scale, range, offset, ldq,
+                                    q);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return QuantizeTransposedAVX2(rows, cols, x, scale, range, offset, ldq,
+                                  q);
+  }
+#endif
+  return 0;
+}
+
+static int QuantizeTransposedVector(const int rows, const int cols,
+    const double* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q) {
+  return 0;
+}
+
+template <typename Dtype>
+void caffe_cpu_quantize_transposed(const int rows, const int cols,
+    const Dtype* x, const float scale, const QuantizedRange& range,
+    const int offset, const int ldq, uint8_t* q) {
+  const int done = QuantizeTransposedVector(rows, cols, x, scale, range,
+                                            offset, ldq, q);
+  QuantizeTransposed(done, rows, cols, x, scale, range, offset, ldq, q);
+}
+
+template void caffe_cpu_quantize_transposed<float>(const int rows,
+    const int cols, const float* x, const float scale,
+    const QuantizedRange& range, const int offset, const int ldq, uint8_t* q);
+template void caffe_cpu_quantize_transposed<double>(const int rows,
+    const int cols, const double* x, const float scale,
+    const QuantizedRange& range, const int offset, const int ldq, uint8_t* q);
+
+void caffe_cpu_pack_s8(const int M, const int K, const int8_t* A,
+    int8_t* packed) {
+  const int stride = GemmU8S8Stride(K);
+  std::fill(packed, packed + GemmU8S8PackedSize(M, K), 0);
+  for (int m = 0; m < M; ++m) {
+    int8_t* block = packed + m / 16 * 16 * stride;
+    for (int k = 0; k < K; ++k) {
+      block[(k / 4 * 16 + m % 16) * 4 + k % 4] = A[m * K + k];
+    }
+  }
+}
+
+#ifdef CAFFE_INT8_X86_KERNELS
+// The kernels compute R rows of C by blocks of 16 columns. Each lane of a
+// vector accumulates a row of A, i.e. a column of C, and each group of 4
+// bytes of B is broadcast to all the lanes. The accumulators stay in
+// registers, and each load of A is used R times.
+
+// vpdpbusd multiplies groups of 4 unsigned and signed bytes and adds their
+// sum to the 32 bit lanes. BM blocks are computed at a time, and the columns
+// of the last one past M are masked.
+template <int BM, int R>
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void KernelU8S8VNNI(const int quads, const int8_t* a, const int lda,
+    const uint8_t* b, const int ldb, const int columns, int32_t* c,
+    const int ldc) {
+  __m512i acc[BM][R];
+  for (int i = 0; i < BM; ++i) {
+    for (int r = 0; r < R; ++r) {
+      acc[i][r] = _mm512_setzero_si512();
+    }
+  }
+  for (int q = 0; q < quads; ++q) {
+    __m512i av[BM];
+    for (int i = 0; i < BM; ++i) {
+      av[i] = _mm512_loadu_si512(a + i * lda + q * 64);
+    }
+    for (int r = 0; r < R; ++r) {
+      int32_t group;
+      memcpy(&group, b + r * ldb + q * 4, sizeof(group));
+      const __m512i bv = _mm512_set1_epi32(group);
+      for (int i = 0; i < BM; ++i) {
+        acc[i][r] = _mm512_dpbusd_epi32(acc[i][r], bv, av[i]);
+      }
+    }
+  }
+  const int last = columns - 16 * (BM - 1);
+  const __mmask16 mask = last >= 16 ? 0xffff : (1 << last) - 1;
+  for (int r = 0; r < R; ++r) {
+    for (int i = 0; i < BM - 1; ++i) {
+      _mm512_storeu_si512(c + r * ldc + 16 * i, acc[i][r]);
+    }
+    _mm512_mask_storeu_epi32(c + r * ldc + 16 * (BM - 1), mask,
+                             acc[BM - 1][r]);
+  }
+}
+
+// pmaddubsw adds pairs of products in 16 bits with saturation, which two
+// unsigned values above 127 can exceed. The unsigned values are split in
+// their low 7 bits and their high bit, which keeps both pairs of products in
+// range, and pmaddwd adds the pairs of pairs in 32 bits. A block takes two
+// vectors, so the kernel computes one block at a time within the 16 AVX2
+// registers.
+template <int R>
+__attribute__((target("avx2")))
+static void KernelU8S8AVX2(const int quads, const int8_t* a,
+    const uint8_t* b, const int ldb, const int columns, int32_t* c,
+    const int ldc) {
+  __m256i acc[2][R];
+  for (int i = 0; i < 2; ++i) {
+    for (int r = 0; r < R; ++r) {
+      acc[i][r] = _mm256_setzero_si256();
+    }
+  }
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i low = _mm256_set1_epi8(0x7f);
+  const __m256i high = _mm256_set1_epi8(static_cast<char>(0x80));
+  for (int q = 0; q < quads; ++q) {
+    __m256i av[2];
+    for (int i = 0; i < 2; ++i) {
+      av[i] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(a + q * 64 + i * 32));
+    }
+    for (int r = 0; r < R; ++r) {
+      int32_t group;
+      memcpy(&group, b + r * ldb + q * 4, sizeof(group));
+      const __m256i bv = _mm256_set1_epi32(group);
+      const __m256i bl = _mm256_and_si256(bv, low);
+      const __m256i bh = _mm256_and_si256(bv, high);
+      for (int i = 0; i < 2; ++i) {
+        acc[i][r] = _mm256_add_epi32(acc[i][r], _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_maddubs_epi16(bl, av[i]), ones),
+            _mm256_madd_epi16(_mm256_maddubs_epi16(bh, av[i]), ones)));
+      }
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    if (columns == 16) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + r * ldc),
+                          acc[0][r]);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + r * ldc + 8),
+                          acc[1][r]);
+    } else {
+      int32_t tail[16];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tail), acc[0][r]);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tail + 8), acc[1][r]);
+      memcpy(c + r * ldc, tail, columns * sizeof(int32_t));
+    }
+  }
+}
+
+enum GemmU8S8ISA { GEMM_U8S8_SCALAR, GEMM_U8S8_AVX2, GEMM_U8S8_VNNI };
+
+static GemmU8S8ISA GemmU8S8Kernel() {
+  static const GemmU8S8ISA isa = (__builtin_cpu_supports("avx512vnni")
+      && __builtin_cpu_supports("avx512bw")) ? GEMM_U8S8_VNNI :
+      __builtin_cpu_supports("avx2") ? GEMM_U8S8_AVX2 : GEMM_U8S8_SCALAR;
+  return isa;
+}
+
+// The R rows of B stay in L1 while going through the blocks of A.
+template <int R>
+static void GemmU8S8RowsVNNI(const int M, const int K, const int8_t* A,
+    const uint8_t* B, int32_t* C) {
+  const int stride = GemmU8S8Stride(K);
+  int m = 0;
+  for (; M - m > 16; m += 32) {
+    KernelU8S8VNNI<2, R>(stride / 4, A + m * stride, 16 * stride, B, stride,
+                         std::min(32, M - m), C + m, M);
+  }
+  if (m < M) {
+    KernelU8S8VNNI<1, R>(stride / 4, A + m * stride, 16 * stride, B, stride,
+                         M - m, C + m, M);
+  }
+}
+
+template <int R>
+static void GemmU8S8RowsAVX2(const int M, const int K, const int8_t* A,
+    const uint8_t* B, int32_t* C) {
+  const int stride = GemmU8S8Stride(K);
+  for (int m = 0; m < M; m += 16) {
+    KernelU8S8AVX2<R>(stride / 4, A + m * stride, B, stride,
+                      std::min(16, M - m), C + m, M);
+  }
+}
+#endif  // CAFFE_INT8_X86_KERNELS
+
+void caffe_cpu_gemm_u8s8(const int M, const int N, const int K,
+    const int8_t* A, const uint8_t* B, int32_t* C) {
+  const int stride = GemmU8S8Stride(K);
+#ifdef CAFFE_INT8_X86_KERNELS
+  // 12 rows of 2 blocks take 24 of the 32 AVX512 registers, and 4 rows of a
+  // block 8 of the 16 AVX2 ones.
+  int n = 0;
+  switch (GemmU8S8Kernel()) {
+  case GEMM_U8S8_VNNI:
+    for (; n + 12 <= N; n += 12) {
+      GemmU8S8RowsVNNI<12>(M, K, A, B + n * stride, C + n * M);
+    }
+    for (; n < N; ++n) {
+      GemmU8S8RowsVNNI<1>(M, K, A, B + n * stride, C + n * M);
+    }
+    return;
+  case GEMM_U8S8_AVX2:
+    for (; n + 4 <= N; n += 4) {
+      GemmU8S8RowsAVX2<4>(M, K, A, B + n * stride, C + n * M);
+    }
+    for (; n < N; ++n) {
+      GemmU8S8RowsAVX2<1>(M, K, A, B + n * stride, C + n * M);
+    }
+    return;
+  default:
+    break;
+  }
+#endif
+  for (int n = 0; n < N; ++n) {
+    for (int m = 0; m < M; ++m) {
+      const int8_t* block = A + m / 16 * 16 * stride;
+      int32_t sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += block[(k / 4 * 16 + m % 16) * 4 + k % 4] * B[n * stride + k];
+      }
+      C[n * M + m] = sum;
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,109 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  // Signals workers that a new loop started, or that the pool stops.
+  boost::condition_variable work_;
+  // Signals Run that the last worker left the loop.
+  boost::condition_variable done_;
+};
+
+ThreadPool::ThreadPool(int size)
+    : size_(size), sync_(new sync()), task_(), count_(), next_(),
+      running_(), generation_(), stop_() {
+  CHECK_GE(size, 1) << "A thread pool needs at least one thread.";
+  int device = 0;
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaGetDevice(&device));
+#endif
+  try {
+    for (int i = 1; i < size_; ++i) {
+      threads_.push_back(shared_ptr<boost::thread>(new boost::thread(
+          boost::bind(&ThreadPool::Entry, this, i, device, Caffe::mode(),
+                      Caffe::solver_count(), Caffe::solver_rank()))));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+void ThreadPool::Run(int n, const Task& fn) {
+  boost::this_thread::disable_interruption no_interruption;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    task_ = &fn;
+    count_ = n;
+    next_ = 0;
+    running_ = threads_.size();
+    ++generation_;
+  }
+  sync_->work_.notify_all();
+  Work(0);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (running_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  task_ = NULL;
+}
+
+void ThreadPool::Work(int worker) {
+  for (;;) {
+    int i;
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      if (next_ >= count_) {
+        return;
+      }
+      i = next_++;
+    }
+    (*task_)(i, worker);
+  }
+}
+
+void ThreadPool::Entry(int worker, int device, Caffe::Brew mode,
+    int solver_count, int solver_rank) {
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaSetDevice(device));
+#endif
+  Caffe::set_mode(mode);
+  Caffe::set_solver_count(solver_count);
+  Caffe::set_solver_rank(solver_rank);
+  uint64_t generation = 0;
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!stop_ && generation_ == generation) {
+        sync_->work_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+    Work(worker);
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    if (--running_ == 0) {
+      sync_->done_.notify_one();
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,285 @@
+// This program converts a set of images, and optionally their annotations, to
+// a lmdb/leveldb by storing them as Datum or AnnotatedDatum proto buffers.
+// Usage:
+//   build_dataset [FLAGS] ROOTFOLDER/ LISTFILE DB_NAME
+//
+// where ROOTFOLDER is the root folder that holds all the images, and LISTFILE
+// should be a list of files as well as their labels, in the format as
+//   subfolder1/file1.JPEG 7
+//   ....
+// or, with --anno_type=detection, of files and their annotation files
+//   subfolder1/file1.JPEG subfolder1/file1.xml
+//   ....
+//
+// The images are read, resized and encoded by --threads threads, while the
+// records are written in the order of LISTFILE with the keys of
+// convert_imageset. With --resume, the conversion of an existing DB goes on
+// after its last record.
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::pair;
+using boost::scoped_ptr;
+
+DEFINE_bool(gray, false,
+    "When this option is on, treat images as grayscale ones");
+DEFINE_bool(shuffle, false,
+    "Randomly shuffle the order of images and their labels");
+DEFINE_int32(seed, 1701, "The seed of --shuffle, the same when resuming");
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} for storing the result");
+DEFINE_string(anno_type, "",
+    "Empty to store Datum records, or 'detection' to store AnnotatedDatum "
+    "records with bounding boxes");
+DEFINE_string(label_type, "xml",
+    "The type of the annotation files {xml, json, txt}");
+DEFINE_string(label_map_file, "",
+    "The LabelMap mapping the names of the annotations to labels");
+DEFINE_int32(resize_width, 0, "Width images are resized to");
+DEFINE_int32(resize_height, 0, "Height images are resized to");
+DEFINE_int32(min_dim, 0,
+    "Minimum dimension images are resized to, keeping the aspect ratio");
+DEFINE_int32(max_dim, 0,
+    "Maximum dimension images are resized to, keeping the aspect ratio");
+DEFINE_bool(check_size, false,
+    "When this option is on, check that all the datum have the same size");
+DEFINE_bool(encoded, false,
+    "When this option is on, the encoded image will be save in datum");
+DEFINE_string(encode_type, "",
+    "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Threads reading the images; 0 uses one per hardware thread");
+DEFINE_int32(commit_every, 1000, "Records written per transaction");
+DEFINE_bool(resume, false,
+    "Open an existing DB and go on after its last record");
+
+#ifdef USE_OPENCV
+// The records of a range of lines, serialized by the workers.
+struct Chunk {
+  int begin;
+  vector<string> records;
+  // The size of the data of each record, 0 for the lines that failed.
+  vector<int> data_sizes;
+};
+
+struct Options {
+  string root_folder;
+  bool is_color;
+  bool encoded;
+  string encode_type;
+  bool detection;
+  std::map<string, int> name_to_label;
+};
+
+// Called on the workers: reads line chunk->begin + i into its record.
+static void ReadRecord(const vector<pair<string, string> >* lines,
+    const Options* options, Chunk* chunk, int i, int worker) {
+  const int line_id = chunk->begin + i;
+  const string& filename = (*lines)[line_id].first;
+  std::string enc = options->encode_type;
+  if (options->encoded && !enc.size()) {
+    // Guess the encoding type from the file name
+    size_t p = filename.rfind('.');
+    if ( p == filename.npos )
+      LOG(WARNING) << "Failed to guess the encoding of '" << filename << "'";
+    enc = filename.substr(p+1);
+    std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+  }
+  bool status;
+  Datum* datum;
+  AnnotatedDatum anno_datum;
+  Datum plain_datum;
+  if (options->detection) {
+    anno_datum.set_type(AnnotatedDatum_AnnotationType_BBOX);
+    status = ReadRichImageToAnnotatedDatum(options->root_folder + filename,
+        options->root_folder + (*lines)[line_id].second, FLAGS_resize_height,
+        FLAGS_resize_width, FLAGS_min_dim, FLAGS_max_dim, options->is_color,
+        enc, AnnotatedDatum_AnnotationType_BBOX, FLAGS_label_type,
+        options->name_to_label, &anno_datum);
+    datum = anno_datum.mutable_datum();
+  } else {
+    status = ReadImageToDatum(options->root_folder + filename,
+        atoi((*lines)[line_id].second.c_str()), FLAGS_resize_height,
+        FLAGS_resize_width, options->is_color, enc, &plain_datum);
+    datum = &plain_datum;
+  }
+  chunk->data_sizes[i] = 0;
+  chunk->records[i].clear();
+  if (status == false) {
+    LOG(WARNING) << "Skipping " << filename;
+    return;
+  }
+  chunk->data_sizes[i] = std::max<int>(1,
+      datum->channels() * datum->height() * datum->width());
+  if (options->detection) {
+    CHECK(anno_datum.SerializeToString(&chunk->records[i]));
+  } else {
+    CHECK(plain_datum.SerializeToString(&chunk->records[i]));
+  }
+}
+
+// Called on the writer thread: puts the records of the chunk in the DB, in
+// the order of the lines, and commits them.
+static void WriteChunk(const vector<pair<string, string> >* lines,
+    const Chunk* chunk, db::DB* db, int* count, int* data_size) {
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  for (int i = 0; i < chunk->records.size(); ++i) {
+    if (!chunk->data_sizes[i]) {
+      continue;
+    }
+    if (FLAGS_check_size) {
+      if (!*data_size) {
+        *data_size = chunk->data_sizes[i];
+      } else {
+        CHECK_EQ(chunk->data_sizes[i], *data_size)
+            << "Incorrect data field size " << chunk->data_sizes[i];
+      }
+    }
+    const int line_id = chunk->begin + i;
+    // sequential
+    string key_str = caffe::format_int(line_id, 8) + "_" +
+        (*lines)[line_id].first;
+    txn->Put(key_str, chunk->records[i]);
+    ++*count;
+  }
+  txn->Commit();
+  LOG(INFO) << "Processed " << chunk->begin + chunk->records.size()
+      << " files, " << *count << " records written.";
+}
+
+// The line after the last record of an existing DB.
+static int ResumeLine(db::DB* db) {
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  cursor->SeekToLast();
+  if (!cursor->valid()) {
+    return 0;
+  }
+  // The keys start with the line number, zero-padded, so they sort by line.
+  const string last_key = cursor->key();
+  return atoi(last_key.substr(0, last_key.find('_')).c_str()) + 1;
+}
+#endif  // USE_OPENCV
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a set of images, and optionally their\n"
+        "annotations, to the leveldb/lmdb format used as input for Caffe.\n"
+        "Usage:\n"
+        "    build_dataset [FLAGS] ROOTFOLDER/ LISTFILE DB_NAME\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/build_dataset");
+    return 1;
+  }
+
+  Options options;
+  options.root_folder = argv[1];
+  options.is_color = !FLAGS_gray;
+  options.encoded = FLAGS_encoded;
+  options.encode_type = FLAGS_encode_type;
+  CHECK(FLAGS_anno_type.empty() || FLAGS_anno_type == "detection")
+      << "Unknown annotation type " << FLAGS_anno_type;
+  options.detection = FLAGS_anno_type == "detection";
+  if (options.detection && FLAGS_label_type != "txt") {
+    LabelMap label_map;
+    CHECK(ReadProtoFromTextFile(FLAGS_label_map_file, &label_map))
+        << "Failed to read label map file " << FLAGS_label_map_file;
+    CHECK(MapNameToLabel(label_map, false, &options.name_to_label))
+        << "Failed to convert name to label.";
+  }
+
+  std::ifstream infile(argv[2]);
+  vector<pair<string, string> > lines;
+  std::string line;
+  size_t pos;
+  while (std::getline(infile, line)) {
+    pos = line.find_last_of(' ');
+    lines.push_back(std::make_pair(line.substr(0, pos),
+                                   line.substr(pos + 1)));
+  }
+  if (FLAGS_shuffle) {
+    // randomly shuffle data, the same way at each run so that it can resume
+    LOG(INFO) << "Shuffling data";
+    Caffe::set_random_seed(FLAGS_seed);
+    shuffle(lines.begin(), lines.end());
+  }
+  LOG(INFO) << "A total of " << lines.size() << " images.";
+
+  if (options.encode_type.size() && !options.encoded)
+    LOG(INFO) << "encode_type specified, assuming encoded=true.";
+
+  // Create new DB, or open the DB to resume
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  int begin = 0;
+  if (FLAGS_resume && boost::filesystem::exists(argv[3])) {
+    db->Open(argv[3], db::WRITE);
+    begin = ResumeLine(db.get());
+    LOG(INFO) << "Resuming at line " << begin;
+  } else {
+    db->Open(argv[3], db::NEW);
+  }
+
+  int threads = FLAGS_threads;
+  if (threads == 0) {
+    threads = std::max(1u, boost::thread::hardware_concurrency());
+  }
+  ThreadPool pool(threads);
+  CHECK_GT(FLAGS_commit_every, 0);
+
+  // The workers read a chunk while the writer thread stores the previous one.
+  Chunk chunks[2];
+  shared_ptr<boost::thread> writer;
+  int count = 0;
+  int data_size = 0;
+  for (int c = 0; begin < lines.size(); ++c) {
+    Chunk* chunk = &chunks[c % 2];
+    const int size = std::min<int>(FLAGS_commit_every, lines.size() - begin);
+    chunk->begin = begin;
+    chunk->records.resize(size);
+    chunk->data_sizes.resize(size);
+    pool.Run(size, boost::bind(&ReadRecord, &lines, &options, chunk, _1, _2));
+    if (writer) {
+      writer->join();
+    }
+    writer.reset(new boost::thread(&WriteChunk, &lines, chunk, db.get(),
+                                   &count, &data_size));
+    begin += size;
+  }
+  if (writer) {
+    writer->join();
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
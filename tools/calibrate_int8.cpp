@@ -0,0 +1,143 @@
+// This is a script to calibrate the INT8 engine: it runs batches through a
+// float net and writes the net back with the quantization_param of its
+// Convolution, ConvolutionDepthwise, InnerProduct, Pooling, Eltwise and
+// Concat layers set from the ranges seen, and engine: "INT8".
+// Usage:
+//    calibrate_int8 net_proto_file_in weights iterations net_proto_out
+//
+// The inputs, outputs and weights get 8 bits, fl_* and scale_* mapping the
+// largest absolute value seen to the largest integer. The inputs of a layer
+// are unsigned unless a negative input was seen.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::map;
+using std::set;
+
+const int kBits = 8;
+
+// The ranges seen by a layer.
+struct LayerRange {
+  vector<float> in_max;
+  float in_min;
+  float out_max;
+  float param_max;
+  LayerRange() : in_min(0), out_max(0), param_max(0) {}
+};
+
+static float AbsMax(const Blob<float>& blob) {
+  const float* data = blob.cpu_data();
+  float value = 0;
+  for (int i = 0; i < blob.count(); ++i) {
+    value = std::max(value, std::fabs(data[i]));
+  }
+  return value;
+}
+
+static float Min(const Blob<float>& blob) {
+  const float* data = blob.cpu_data();
+  return blob.count() ? *std::min_element(data, data + blob.count()) : 0;
+}
+
+// The fractional length and scale mapping max to the largest integer.
+static void SetRange(float max, bool is_unsigned,
+    google::protobuf::RepeatedField<int32_t>* fl,
+    google::protobuf::RepeatedField<float>* scale) {
+  max = std::max(max, 1e-8f);
+  const int integer_bits =
+      static_cast<int>(std::ceil(std::log(max) / std::log(2.f)))
+      + (is_unsigned ? 0 : 1);
+  fl->Add(kBits - integer_bits);
+  scale->Add(((1 << (is_unsigned ? kBits : kBits - 1)) - 1) / max);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: calibrate_int8 net_proto_file_in weights "
+        << "iterations net_proto_out";
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+  set<string> types;
+  types.insert("Convolution");
+  types.insert("ConvolutionDepthwise");
+  types.insert("InnerProduct");
+  types.insert("Pooling");
+  types.insert("Eltwise");
+  types.insert("Concat");
+
+  Net<float> net(string(argv[1]), TEST);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+  const int iterations = atoi(argv[3]);
+  CHECK_GT(iterations, 0);
+  map<string, LayerRange> ranges;
+  for (int iter = 0; iter < iterations; ++iter) {
+    // Layer by layer, so that the outputs are seen before in-place layers
+    // such as ReLU change them.
+    for (int i = 0; i < net.layers().size(); ++i) {
+      Layer<float>& layer = *net.layers()[i];
+      const bool calibrated = types.count(layer.type()) > 0;
+      LayerRange* range = calibrated ? &ranges[net.layer_names()[i]] : NULL;
+      if (calibrated) {
+        const vector<Blob<float>*>& bottom = net.bottom_vecs()[i];
+        range->in_max.resize(bottom.size(), 0);
+        for (int j = 0; j < bottom.size(); ++j) {
+          range->in_max[j] = std::max(range->in_max[j], AbsMax(*bottom[j]));
+          range->in_min = std::min(range->in_min, Min(*bottom[j]));
+        }
+      }
+      net.ForwardFromTo(i, i);
+      if (calibrated) {
+        range->out_max = std::max(range->out_max,
+                                  AbsMax(*net.top_vecs()[i][0]));
+        if (layer.blobs().size()) {
+          range->param_max = AbsMax(*layer.blobs()[0]);
+        }
+      }
+    }
+    LOG(INFO) << "Batch " << iter + 1 << " of " << iterations;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  net_param.set_engine("INT8");
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    LayerParameter* layer = net_param.mutable_layer(i);
+    map<string, LayerRange>::const_iterator it = ranges.find(layer->name());
+    if (it == ranges.end()) {
+      continue;
+    }
+    const LayerRange& range = it->second;
+    QuantizationParameter* param = layer->mutable_quantization_param();
+    param->Clear();
+    param->set_bw_layer_in(kBits);
+    param->set_bw_layer_out(kBits);
+    param->set_is_negative_input(range.in_min < 0);
+    for (int j = 0; j < range.in_max.size(); ++j) {
+      SetRange(range.in_max[j], range.in_min >= 0,
+               param->mutable_fl_layer_in(), param->mutable_scale_in());
+    }
+    SetRange(range.out_max, false, param->mutable_fl_layer_out(),
+             param->mutable_scale_out());
+    if (range.param_max > 0) {
+      param->set_bw_params(kBits);
+      SetRange(range.param_max, false, param->mutable_fl_params(),
+               param->mutable_scale_params());
+    }
+  }
+  WriteProtoToTextFile(net_param, argv[4]);
+  LOG(INFO) << "Calibrated " << ranges.size() << " layers; wrote "
+      << argv[4];
+  return 0;
+}
@@ -0,0 +1,48 @@
+// This is a script to fold the BatchNorm, BN and Scale layers of a trained
+// net into the Convolution or InnerProduct layers they follow.
+// Usage:
+//    fold_bn_scale net_proto_file_in weights_in weights_out [net_proto_out]
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 4 && argc != 5) {
+    LOG(ERROR) << "Usage: fold_bn_scale net_proto_file_in weights_in "
+        << "weights_out [net_proto_out]";
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  net_param.mutable_state()->set_phase(TEST);
+  net_param.mutable_compile_net_state()->set_bn_scale_merge(true);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+  LOG(INFO) << "Folded " << net.compile_net_state().fold_size()
+      << " layers; kept " << net.compile_net_state().kept_bn_layers_size()
+      << " BatchNorm/BN layers.";
+
+  NetParameter folded_param;
+  net.ToProto(&folded_param);
+  folded_param.mutable_compile_net_state()->CopyFrom(
+      net.compile_net_state());
+  WriteProtoToBinaryFile(folded_param, argv[3]);
+  LOG(INFO) << "Wrote folded weights to " << argv[3];
+
+  if (argc == 5) {
+    for (int i = 0; i < folded_param.layer_size(); ++i) {
+      folded_param.mutable_layer(i)->clear_blobs();
+    }
+    WriteProtoToTextFile(folded_param, argv[4]);
+    LOG(INFO) << "Wrote folded net to " << argv[4];
+  }
+  return 0;
+}
@@ -0,0 +1,28 @@
+// This is a script to convert trained weights to the memory-mapped format of
+// MappedWeights, which Net::CopyTrainedLayersFrom loads without copying.
+// Usage:
+//    map_weights weights_in mapped_weights_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: map_weights weights_in mapped_weights_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[1]), &net_param);
+  MappedWeights::Write(net_param, string(argv[2]));
+  LOG(INFO) << "Wrote mapped weights to " << argv[2];
+  return 0;
+}